@@ -0,0 +1,27 @@
+// allocation_counter.hpp - Process-wide heap allocation counters
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <atomic>
+#include <cstddef>
+
+// The malloc-backed containers (dynamic_array, aligned_malloc) always count;
+// new/delete allocations only count in programs whose main file includes
+// allocation_hook.hpp (hd.cpp and the benchmarks that report allocations).
+// frame_profiler.hpp reads the counters per frame.
+inline std::atomic<unsigned long long>& allocation_count() {
+    static std::atomic<unsigned long long> count(0);
+    return count;
+}
+
+inline std::atomic<unsigned long long>& allocation_bytes() {
+    static std::atomic<unsigned long long> bytes(0);
+    return bytes;
+}
+
+inline void note_allocation(size_t size) {
+    allocation_count().fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes().fetch_add(size, std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,38 @@
+// allocation_hook.hpp - Replacement global operator new/delete feeding the allocation counters
+#ifndef ALLOCATION_HOOK_HPP
+#define ALLOCATION_HOOK_HPP
+
+// Defines the replaceable global operator new/delete, so include it from
+// exactly one translation unit of a program: the file with main() (hd.cpp
+// and the benchmarks that report allocations). Array and nothrow forms
+// forward here through the library defaults. Kept out of line so GCC does
+// not pair inlined malloc/free with new/delete expressions and warn about a
+// mismatch.
+
+#include "allocation_counter.hpp"
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GNUC__)
+#define ALLOCATION_HOOK_NOINLINE __attribute__((noinline))
+#else
+#define ALLOCATION_HOOK_NOINLINE
+#endif
+
+ALLOCATION_HOOK_NOINLINE void* operator new(size_t size) {
+    note_allocation(size);
+    void* p = malloc(size > 0 ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+ALLOCATION_HOOK_NOINLINE void operator delete(void* p) noexcept {
+    free(p);
+}
+
+ALLOCATION_HOOK_NOINLINE void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+#endif
@@ -0,0 +1,140 @@
+// backtest.hpp - Walk-forward (one-step-ahead) evaluation of every prediction model
+#ifndef BACKTEST_HPP
+#define BACKTEST_HPP
+
+#include "incremental_model.hpp"
+#include "thread_pool.hpp"
+#include <cmath>
+#include <vector>
+
+// A model needs at least this many scored forecasts before its measured hit
+// rate replaces DEFAULT_CONFIDENCE.
+const unsigned long long BACKTEST_MIN_FORECASTS = 30;
+
+// Forecast errors of one model over a walk-forward run.
+struct ForecastAccuracy {
+    unsigned long long forecasts;
+    double sum_abs_error;
+    double sum_sq_error;
+    double sum_abs_pct_error;
+    unsigned long long pct_forecasts;   // forecasts whose actual close was non-zero
+    unsigned long long direction_calls; // forecasts where both the forecast and the close moved
+    unsigned long long direction_hits;
+
+    ForecastAccuracy()
+        : forecasts(0), sum_abs_error(0), sum_sq_error(0), sum_abs_pct_error(0), pct_forecasts(0), direction_calls(0),
+          direction_hits(0) {}
+
+    // `previous` is the last close the forecast was allowed to see.
+    void add(double forecast, double actual, double previous) {
+        double error = forecast - actual;
+        forecasts++;
+        sum_abs_error += std::fabs(error);
+        sum_sq_error += error * error;
+        if (actual != 0) {
+            sum_abs_pct_error += std::fabs(error / actual);
+            pct_forecasts++;
+        }
+        double called = forecast - previous;
+        double moved = actual - previous;
+        if (called != 0 && moved != 0) {
+            direction_calls++;
+            if ((called > 0) == (moved > 0)) direction_hits++;
+        }
+    }
+
+    double mae() const {
+        return forecasts > 0 ? sum_abs_error / forecasts : 0;
+    }
+
+    double rmse() const {
+        return forecasts > 0 ? std::sqrt(sum_sq_error / forecasts) : 0;
+    }
+
+    // Mean absolute percentage error, in percent
+    double mape() const {
+        return pct_forecasts > 0 ? 100.0 * sum_abs_pct_error / pct_forecasts : 0;
+    }
+
+    // Share of forecasts that called the direction of the next move correctly
+    double hit_rate() const {
+        return direction_calls > 0 ? static_cast<double>(direction_hits) / direction_calls : 0;
+    }
+};
+
+struct BacktestReport {
+    ModelParams params;
+    ForecastAccuracy models[MODEL_COUNT];   // indexed by PredictionModel
+};
+
+// Walks the series once: before bar t is added, every model forecasts bar t
+// from bars [0, t) and the forecast is scored against the actual close. All
+// models share one IncrementalPredictor, so the run is O(n) (times the SMA
+// window) instead of one calculate_predictions call per bar. Forecasts
+// start where calculate_predictions would produce them: from the second bar,
+// for the moving average once a full window is available, for the
+// autoregressive model once its regression is determined and for
+// Holt-Winters from the third bar. The autoregressive forecasts reuse
+// coefficients until the history has grown by 1/AR_REFIT_DIVISOR, so they
+// differ slightly from refitting at every bar.
+inline BacktestReport run_backtest(const PriceSeries& series, const ModelParams& params = ModelParams()) {
+    TRACE_SCOPE("run_backtest");
+    BacktestReport report;
+    report.params = params;
+    IncrementalPredictor live(params);
+    const double *close = series.close;
+
+    for (unsigned int t = 0; t < series.size; t++) {
+        double actual = close[t];
+        if (t >= 2) {
+            double previous = close[t - 1];
+            for (int m = 0; m < MODEL_COUNT; m++) {
+                if (!live.ready(ALL_MODELS[m])) continue;
+                report.models[m].add(live.next_prediction(ALL_MODELS[m]), actual, previous);
+            }
+        }
+        live.on_close(actual);
+    }
+    return report;
+}
+
+// Walk-forward run of a single model. Forecasts are scored from bar
+// `score_from` on (at least bar 2), so runs with different parameters can be
+// compared on exactly the same bars.
+inline ForecastAccuracy walk_forward_model(const PriceSeries& series, PredictionModel model,
+                                           const ModelParams& params = ModelParams(), unsigned int score_from = 2) {
+    ForecastAccuracy accuracy;
+    IncrementalPredictor live(params);
+    const double *close = series.close;
+    if (score_from < 2) score_from = 2;
+
+    for (unsigned int t = 0; t < series.size; t++) {
+        double actual = close[t];
+        if (t >= score_from && live.ready(model)) {
+            accuracy.add(live.next_prediction(model), actual, close[t - 1]);
+        }
+        live.on_close(actual);
+    }
+    return accuracy;
+}
+
+// Runs one backtest per parameter set on the pool. Reports keep the input order.
+inline void run_backtests(const PriceSeries& series, const std::vector<ModelParams>& params,
+                          std::vector<BacktestReport>& reports, thread_pool& pool) {
+    reports.assign(params.size(), BacktestReport());
+    pool.run(static_cast<unsigned int>(params.size()), [&](unsigned int task, unsigned int) {
+        reports[task] = run_backtest(series, params[task]);
+    });
+}
+
+// Replaces the predictor's per-model confidence with the measured hit rate
+// wherever the backtest scored enough forecasts.
+inline void apply_backtest_confidence(StockPredictor& predictor, const BacktestReport& report) {
+    for (int m = 0; m < MODEL_COUNT; m++) {
+        const ForecastAccuracy& accuracy = report.models[m];
+        predictor.confidence[m] =
+            accuracy.direction_calls >= BACKTEST_MIN_FORECASTS ? accuracy.hit_rate() : DEFAULT_CONFIDENCE[m];
+    }
+}
+
+#endif
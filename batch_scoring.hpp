@@ -0,0 +1,348 @@
+// batch_scoring.hpp - Headless scoring of many ticker files (no SplashKit dependency)
+#ifndef BATCH_SCORING_HPP
+#define BATCH_SCORING_HPP
+
+#include "backtest.hpp"
+#include "binary_cache.hpp"
+#include "param_search.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// Column/key prefix used for a model in batch output
+inline const char *model_key(PredictionModel model) {
+    switch (model) {
+        case LINEAR_REGRESSION: return "linear_regression";
+        case MOVING_AVERAGE: return "moving_average";
+        case EXPONENTIAL_SMOOTHING: return "exponential_smoothing";
+        case AUTOREGRESSIVE: return "autoregressive";
+        case HOLT_WINTERS: return "holt_winters";
+    }
+    return "unknown";
+}
+
+// What score_ticker does besides loading and predicting
+struct ScoreOptions {
+    CacheOptions cache;
+    bool optimize;          // grid-search each model's parameter before predicting
+    SearchGrid grid;
+    ModelParams params;     // starting parameters (and the ones kept without optimize)
+    bool batched_autoregressive;    // fit models[AUTOREGRESSIVE] with score_autoregressive_batch, not per ticker
+
+    ScoreOptions() : cache(false), optimize(false), grid(default_search_grid()), params(), batched_autoregressive(false) {}
+};
+
+// One output row: every model's stats and walk-forward accuracy for one ticker file.
+struct TickerScore {
+    std::string file;
+    std::string company;
+    bool loaded;
+    int rows;
+    int skipped;
+    double last_close;
+    ModelParams params;             // parameters the models ran with
+    PredictionStats models[MODEL_COUNT];
+    BacktestReport backtest;
+    SearchResult search;            // error surfaces, when optimizing
+
+    TickerScore() : loaded(false), rows(0), skipped(0), last_close(0) {}
+};
+
+// Backtests every model on a loaded predictor and fills in `score`'s
+// predictions with the measured confidence. With optimize, the best
+// walk-forward parameters are searched for first (on this thread, since
+// tickers already run in parallel).
+inline void score_predictor(StockPredictor& predictor, const ScoreOptions& options, TickerScore& score) {
+    TRACE_SCOPE("score_predictor");
+    score.last_close = predictor.series.close[predictor.series.size - 1];
+    predictor.params = options.params;
+    if (options.optimize) {
+        score.search = search_parameters(predictor.series, options.grid, nullptr, options.params);
+        predictor.params = score.search.best;
+    }
+    score.params = predictor.params;
+    score.backtest = run_backtest(predictor.series, predictor.params);
+    apply_backtest_confidence(predictor, score.backtest);
+    for (int m = 0; m < MODEL_COUNT; m++) {
+        if (ALL_MODELS[m] == AUTOREGRESSIVE && options.batched_autoregressive) continue;
+        predictor.model = ALL_MODELS[m];
+        predictor.stats = PredictionStats();
+        calculate_predictions(predictor);
+        score.models[m] = predictor.stats;
+    }
+}
+
+// Fills in models[AUTOREGRESSIVE] of scores that score_predictor left out
+// (batched_autoregressive): one fit_autoregressive_batch per AR order in
+// use, since the search may pick different orders, with its groups spread
+// over `pool`. closes[i] and sizes[i] are the series scores[i] was scored
+// on; tickers that did not load are skipped.
+inline void score_autoregressive_batch(TickerScore *const *scores, const double *const *closes,
+                                       const unsigned int *sizes, size_t count, thread_pool& pool) {
+    TRACE_SCOPE("score_autoregressive_batch");
+    std::vector<const double *> batch_closes;
+    std::vector<unsigned int> batch_sizes;
+    std::vector<size_t> owners;
+    std::vector<ArFit> fits;
+    for (int order = 1; order <= AR_MAX_ORDER; order++) {
+        batch_closes.clear();
+        batch_sizes.clear();
+        owners.clear();
+        for (size_t i = 0; i < count; i++) {
+            if (!scores[i]->loaded || sizes[i] == 0 || clamp_ar_order(scores[i]->params.ar_order) != order) continue;
+            batch_closes.push_back(closes[i]);
+            batch_sizes.push_back(sizes[i]);
+            owners.push_back(i);
+        }
+        if (owners.empty()) continue;
+        fits.assign(owners.size(), ArFit());
+        fit_autoregressive_batch(batch_closes.data(), batch_sizes.data(), owners.size(), order, fits.data(), &pool);
+        for (size_t k = 0; k < owners.size(); k++) {
+            TickerScore& score = *scores[owners[k]];
+            PredictionStats& stats = score.models[AUTOREGRESSIVE];
+            stats = PredictionStats();
+            stats.r_squared = fits[k].r_squared;
+            apply_forecast(stats, autoregressive_series_forecast(fits[k], batch_closes[k], batch_sizes[k]),
+                           score.last_close);
+        }
+    }
+}
+
+// Loads one file on the calling thread and scores it. With the cache
+// enabled each ticker's binary cache is mapped (or written) as well. With
+// batched_autoregressive the closes are copied to `closes` for
+// score_autoregressive_batch.
+inline TickerScore score_ticker(const std::string& filename, const ScoreOptions& options = ScoreOptions(),
+                                std::vector<double> *closes = nullptr) {
+    TickerScore score;
+    score.file = filename;
+
+    StockPredictor predictor;
+    CsvLoadResult result;
+    score.loaded = load_stock_cached(predictor, filename, result, options.cache, 1);
+    score.company = predictor.company_name;
+    score.rows = result.valid_rows;
+    score.skipped = result.skipped_rows;
+    if (!score.loaded || predictor.series.size == 0) return score;
+
+    score_predictor(predictor, options, score);
+    if (closes && options.batched_autoregressive) {
+        closes->assign(predictor.series.close, predictor.series.close + predictor.series.size);
+    }
+    return score;
+}
+
+// Scores every file, one task per file. Results keep the input order. With
+// batched_autoregressive every ticker's closes are kept (8 bytes a bar)
+// until the autoregressive models are fitted together at the end.
+inline void score_tickers(const std::vector<std::string>& files, std::vector<TickerScore>& scores, thread_pool& pool,
+                          const ScoreOptions& options = ScoreOptions()) {
+    scores.assign(files.size(), TickerScore());
+    std::vector<std::vector<double> > closes(options.batched_autoregressive ? files.size() : 0);
+    pool.run(static_cast<unsigned int>(files.size()), [&](unsigned int task, unsigned int) {
+        scores[task] = score_ticker(files[task], options, closes.empty() ? nullptr : &closes[task]);
+    });
+    if (closes.empty()) return;
+
+    std::vector<TickerScore *> batch_scores(files.size());
+    std::vector<const double *> batch_closes(files.size());
+    std::vector<unsigned int> sizes(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        batch_scores[i] = &scores[i];
+        batch_closes[i] = closes[i].data();
+        sizes[i] = static_cast<unsigned int>(closes[i].size());
+    }
+    score_autoregressive_batch(batch_scores.data(), batch_closes.data(), sizes.data(), files.size(), pool);
+}
+
+inline bool has_csv_extension(const std::string& name) {
+    if (name.size() < 4) return false;
+    std::string ext = name.substr(name.size() - 4);
+    for (size_t i = 0; i < ext.size(); i++) ext[i] = static_cast<char>(tolower(ext[i]));
+    return ext == ".csv";
+}
+
+// Appends `path` if it is a file, or every *.csv directly inside it if it is
+// a directory (sorted, so output order is stable). Returns false if the path
+// does not exist.
+inline bool collect_csv_files(const std::string& path, std::vector<std::string>& files) {
+    std::vector<std::string> found;
+#ifdef _WIN32
+    DWORD attrs = GetFileAttributesA(path.c_str());
+    if (attrs == INVALID_FILE_ATTRIBUTES) return false;
+    if (!(attrs & FILE_ATTRIBUTE_DIRECTORY)) {
+        files.push_back(path);
+        return true;
+    }
+    WIN32_FIND_DATAA entry;
+    HANDLE handle = FindFirstFileA((path + "\\*").c_str(), &entry);
+    if (handle != INVALID_HANDLE_VALUE) {
+        do {
+            std::string name = entry.cFileName;
+            if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && has_csv_extension(name)) {
+                found.push_back(path + "\\" + name);
+            }
+        } while (FindNextFileA(handle, &entry));
+        FindClose(handle);
+    }
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    if (!S_ISDIR(st.st_mode)) {
+        files.push_back(path);
+        return true;
+    }
+    DIR *dir = opendir(path.c_str());
+    if (!dir) return false;
+    while (struct dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        std::string full = path + "/" + name;
+        if (has_csv_extension(name) && stat(full.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            found.push_back(full);
+        }
+    }
+    closedir(dir);
+#endif
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+}
+
+inline std::string format_number(double value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.10g", value);
+    return buf;
+}
+
+// JSON has no NaN/Infinity literals
+inline std::string json_number(double value) {
+    return std::isfinite(value) ? format_number(value) : "null";
+}
+
+inline std::string csv_escape(const std::string& value) {
+    if (value.find_first_of(",\"\n") == std::string::npos) return value;
+    std::string out = "\"";
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '"') out += '"';
+        out += value[i];
+    }
+    return out + "\"";
+}
+
+inline std::string json_escape(const std::string& value) {
+    std::string out = "\"";
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+inline void write_scores_csv(std::ostream& out, const std::vector<TickerScore>& scores) {
+    out << "company,file,status,rows,skipped,last_close";
+    for (int m = 0; m < MODEL_COUNT; m++) {
+        std::string key = model_key(ALL_MODELS[m]);
+        out << "," << key << "_" << model_param_name(ALL_MODELS[m]) << "," << key << "_slope," << key << "_intercept," << key << "_r_squared,"
+            << key << "_next_prediction," << key << "_confidence," << key << "_mae," << key << "_rmse,"
+            << key << "_mape," << key << "_hit_rate," << key << "_next_lower," << key << "_next_upper";
+    }
+    out << "\n";
+
+    for (size_t i = 0; i < scores.size(); i++) {
+        const TickerScore& s = scores[i];
+        out << csv_escape(s.company) << "," << csv_escape(s.file) << ","
+            << (!s.loaded ? "unreadable" : s.rows == 0 ? "empty" : "ok") << ","
+            << s.rows << "," << s.skipped << "," << format_number(s.last_close);
+        for (int m = 0; m < MODEL_COUNT; m++) {
+            const PredictionStats& p = s.models[m];
+            out << "," << format_number(model_param_value(s.params, ALL_MODELS[m])) << "," << format_number(p.slope) << "," << format_number(p.intercept) << ","
+                << format_number(p.r_squared) << "," << format_number(p.next_prediction) << ","
+                << format_number(p.confidence);
+            const ForecastAccuracy& a = s.backtest.models[m];
+            out << "," << format_number(a.mae()) << "," << format_number(a.rmse()) << "," << format_number(a.mape())
+                << "," << format_number(a.hit_rate());
+            if (p.forecast.steps > 0) {
+                out << "," << format_number(p.forecast.lower(0)) << "," << format_number(p.forecast.upper(0));
+            } else {
+                out << ",,";
+            }
+        }
+        out << "\n";
+    }
+}
+
+inline void write_scores_json(std::ostream& out, const std::vector<TickerScore>& scores) {
+    out << "[\n";
+    for (size_t i = 0; i < scores.size(); i++) {
+        const TickerScore& s = scores[i];
+        out << "  {\"company\": " << json_escape(s.company) << ", \"file\": " << json_escape(s.file)
+            << ", \"status\": \"" << (!s.loaded ? "unreadable" : s.rows == 0 ? "empty" : "ok") << "\""
+            << ", \"rows\": " << s.rows << ", \"skipped\": " << s.skipped
+            << ", \"last_close\": " << json_number(s.last_close) << ", \"models\": {";
+        for (int m = 0; m < MODEL_COUNT; m++) {
+            const PredictionStats& p = s.models[m];
+            const ForecastAccuracy& a = s.backtest.models[m];
+            out << (m > 0 ? ", " : "") << "\"" << model_key(ALL_MODELS[m]) << "\": {"
+                << "\"" << model_param_name(ALL_MODELS[m]) << "\": " << json_number(model_param_value(s.params, ALL_MODELS[m]))
+                << ", \"slope\": " << json_number(p.slope)
+                << ", \"intercept\": " << json_number(p.intercept)
+                << ", \"r_squared\": " << json_number(p.r_squared)
+                << ", \"next_prediction\": " << json_number(p.next_prediction)
+                << ", \"confidence\": " << json_number(p.confidence)
+                << ", \"mae\": " << json_number(a.mae()) << ", \"rmse\": " << json_number(a.rmse())
+                << ", \"mape\": " << json_number(a.mape()) << ", \"hit_rate\": " << json_number(a.hit_rate());
+            if (p.forecast.steps > 0) {
+                out << ", \"next_lower\": " << json_number(p.forecast.lower(0))
+                    << ", \"next_upper\": " << json_number(p.forecast.upper(0));
+            } else {
+                out << ", \"next_lower\": null, \"next_upper\": null";
+            }
+            out << "}";
+        }
+        out << "}}" << (i + 1 < scores.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+// Error surface of every optimized ticker: one row per model and candidate value.
+inline void write_surfaces_csv(std::ostream& out, const std::vector<TickerScore>& scores) {
+    out << "company,file,model,parameter,value,best,forecasts,mae,rmse,mape,hit_rate\n";
+    for (size_t i = 0; i < scores.size(); i++) {
+        const TickerScore& s = scores[i];
+        for (int m = 0; m < MODEL_COUNT; m++) {
+            PredictionModel model = ALL_MODELS[m];
+            const std::vector<SearchPoint>& surface = s.search.surface[model];
+            for (size_t k = 0; k < surface.size(); k++) {
+                const ForecastAccuracy& a = surface[k].accuracy;
+                out << csv_escape(s.company) << "," << csv_escape(s.file) << "," << model_key(model) << ","
+                    << model_param_name(model) << "," << format_number(surface[k].value) << ","
+                    << (surface[k].value == model_param_value(s.params, model) ? 1 : 0) << "," << a.forecasts << ","
+                    << format_number(a.mae()) << "," << format_number(a.rmse()) << "," << format_number(a.mape()) << ","
+                    << format_number(a.hit_rate()) << "\n";
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,115 @@
+// bench_backtest.cpp - Linear walk-forward backtest vs. one calculate_predictions call per bar
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_backtest.cpp -o bench_backtest
+// Usage: ./bench_backtest [bars] [naive_bars] [max_threads]
+//
+// Checks run_backtest against the naive O(n^2) walk (recompute every model
+// on each prefix) on the first naive_bars bars, times the linear engine on
+// the full random walk, then times a grid of SMA windows x EMA alphas on
+// 1..max_threads threads.
+
+#include "../backtest.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+static void random_walk(PriceSeries& series, unsigned int bars) {
+    series.clear();
+    series.reserve(bars);
+    unsigned long long seed = 11;
+    double price = 100.0;
+    for (unsigned int i = 0; i < bars; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double step = (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5) * 2.0;
+        price = price + step > 1.0 ? price + step : price;
+        series.add(static_cast<int32_t>(i), price, price + 1, price - 1, price, 1000);
+    }
+}
+
+// The O(n^2) walk: calculate_predictions on every prefix of the series.
+static BacktestReport naive_backtest(StockPredictor& predictor) {
+    BacktestReport report;
+    unsigned int n = predictor.series.size;
+    for (unsigned int t = 2; t < n; t++) {
+        predictor.series.size = t;
+        for (int m = 0; m < MODEL_COUNT; m++) {
+            predictor.model = ALL_MODELS[m];
+            predictor.stats = PredictionStats();
+            calculate_predictions(predictor);
+            bool warming_up = (ALL_MODELS[m] == MOVING_AVERAGE && t < static_cast<unsigned int>(SMA_PERIOD)) ||
+                              (ALL_MODELS[m] == AUTOREGRESSIVE && t < ar_min_bars(AR_ORDER)) ||
+                              (ALL_MODELS[m] == HOLT_WINTERS && t < 3);
+            if (warming_up) continue;
+            report.models[m].add(predictor.stats.next_prediction, predictor.series.close[t], predictor.series.close[t - 1]);
+        }
+    }
+    predictor.series.size = n;
+    return report;
+}
+
+static bool close_enough(double a, double b) {
+    return fabs(a - b) <= 1e-9 * (fabs(b) > 1 ? fabs(b) : 1);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int bars = argc > 1 ? static_cast<unsigned int>(atol(argv[1])) : 10000000;
+    unsigned int naive_bars = argc > 2 ? static_cast<unsigned int>(atol(argv[2])) : 20000;
+    unsigned int max_threads = argc > 3 ? static_cast<unsigned int>(atoi(argv[3])) : thread_pool::default_thread_count();
+    if (bars < 10) bars = 10;
+    if (naive_bars > bars) naive_bars = bars;
+    if (max_threads < 1) max_threads = 1;
+
+    StockPredictor predictor;
+    random_walk(predictor.series, naive_bars);
+    auto start = chrono::steady_clock::now();
+    BacktestReport naive = naive_backtest(predictor);
+    double naive_secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    BacktestReport linear = run_backtest(predictor.series);
+    double linear_secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    bool ok = true;
+    for (int m = 0; m < MODEL_COUNT; m++) {
+        const ForecastAccuracy& a = linear.models[m];
+        const ForecastAccuracy& b = naive.models[m];
+        bool same = a.forecasts == b.forecasts && close_enough(a.mae(), b.mae()) && close_enough(a.rmse(), b.rmse()) &&
+                    close_enough(a.mape(), b.mape()) && fabs(a.hit_rate() - b.hit_rate()) < 1e-3;
+        if (ALL_MODELS[m] == AUTOREGRESSIVE) {
+            // The walk reuses AR coefficients between refits (AR_REFIT_DIVISOR)
+            same = a.forecasts == b.forecasts && fabs(a.mae() - b.mae()) <= 1e-3 * b.mae() &&
+                   fabs(a.hit_rate() - b.hit_rate()) < 0.01;
+        }
+        printf("model %d: MAE %.6f RMSE %.6f MAPE %.4f%% hit %.4f  %s\n", m, a.mae(), a.rmse(), a.mape(), a.hit_rate(),
+               same ? "matches naive" : "DIFFERS from naive");
+        ok = ok && same;
+    }
+    printf("%u bars: naive %.3f s, linear %.6f s (%.0fx)\n\n", naive_bars, naive_secs, linear_secs, naive_secs / linear_secs);
+
+    random_walk(predictor.series, bars);
+    start = chrono::steady_clock::now();
+    BacktestReport full = run_backtest(predictor.series);
+    double full_secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%u bars: linear walk-forward %.3f s (%.1f ns/bar), LR hit rate %.4f\n\n", bars, full_secs,
+           full_secs * 1e9 / bars, full.models[LINEAR_REGRESSION].hit_rate());
+
+    vector<ModelParams> grid;
+    for (int period = 2; period <= 20; period += 2) {
+        for (double alpha = 0.1; alpha < 0.95; alpha += 0.2) grid.push_back(ModelParams(period, alpha));
+    }
+    double single = 0;
+    for (unsigned int threads = 1; threads <= max_threads; threads++) {
+        thread_pool pool(threads);
+        vector<BacktestReport> reports;
+        start = chrono::steady_clock::now();
+        run_backtests(predictor.series, grid, reports, pool);
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (threads == 1) single = secs;
+        printf("grid of %zu parameter sets, threads %2u: %8.3f s  speedup %.2fx\n", grid.size(), threads, secs,
+               single / secs);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// bench_batch.cpp - Scaling of headless batch scoring across threads
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_batch.cpp -o bench_batch
+// Usage: ./bench_batch [files] [rows_per_file] [max_threads]
+//
+// Writes a universe of synthetic ticker files (default 5,000 x 2,520 daily
+// bars, ten years) and times score_tickers for 1..max_threads threads, then
+// once more on max_threads with the autoregressive models fitted together
+// (batched_autoregressive, as hd_batch runs). The batched predictions must
+// match the per-ticker ones.
+
+#include "../batch_scoring.hpp"
+#include "synthetic_csv.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    int file_count = argc > 1 ? atoi(argv[1]) : 5000;
+    long rows = argc > 2 ? atol(argv[2]) : 2520;
+    unsigned int max_threads = argc > 3 ? static_cast<unsigned int>(atoi(argv[3])) : thread_pool::default_thread_count();
+    if (file_count < 1) file_count = 1;
+    if (max_threads < 1) max_threads = 1;
+
+    string dir = "/tmp/bench_batch_universe";
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+
+    vector<string> files;
+    for (int i = 0; i < file_count; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "/STOCK_US_XNAS_T%05d.csv", i);
+        string path = dir + name;
+        if (!write_synthetic_csv(path, rows, 1000 + i)) {
+            fprintf(stderr, "Cannot write %s\n", path.c_str());
+            return 1;
+        }
+        files.push_back(path);
+    }
+
+    printf("universe: %d files x %ld rows\n", file_count, rows);
+    double single = 0, last = 0;
+    vector<TickerScore> scores;
+    for (unsigned int threads = 1; threads <= max_threads; threads++) {
+        thread_pool pool(threads);
+        double best = 1e300;
+        for (int r = 0; r < 3; r++) {
+            auto start = chrono::steady_clock::now();
+            score_tickers(files, scores, pool);
+            double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (secs < best) best = secs;
+        }
+        if (threads == 1) single = best;
+        last = best;
+        printf("threads %2u: %8.3f s  %9.0f files/s  speedup %.2fx  efficiency %3.0f%%\n", threads, best,
+               file_count / best, single / best, 100.0 * single / best / threads);
+    }
+
+    thread_pool pool(max_threads);
+    ScoreOptions batched;
+    batched.batched_autoregressive = true;
+    vector<TickerScore> batched_scores;
+    double best = 1e300;
+    for (int r = 0; r < 3; r++) {
+        auto start = chrono::steady_clock::now();
+        score_tickers(files, batched_scores, pool, batched);
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (secs < best) best = secs;
+    }
+    double worst = 0;
+    for (size_t i = 0; i < scores.size(); i++) {
+        double a = scores[i].models[AUTOREGRESSIVE].next_prediction;
+        double b = batched_scores[i].models[AUTOREGRESSIVE].next_prediction;
+        worst = max(worst, fabs(a - b) / max(fabs(a), 1e-12));
+    }
+    printf("batched AR x%-2u: %8.3f s  %9.0f files/s  (%.2fx vs per ticker), predictions within %.1e\n", max_threads,
+           best, file_count / best, last / best, worst);
+    return worst < 1e-9 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// bench_cache.cpp - CSV parse vs binary cache reopen, cold and warm
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_cache.cpp -o bench_cache
+// Usage: ./bench_cache [csv_file | row_count]
+//
+// With no file a synthetic CSV is written (about 55 bytes per row, so
+// 18000000 rows is roughly a 1 GB history). Times the first load (parse and
+// write the cache), a cold reopen with the cache evicted from the page cache
+// (Linux, best effort), a warm reopen, and a reopen with checksum
+// verification. Each reopen also touches every close so page faults are
+// included. Finally the cache is corrupted and must be detected and rebuilt.
+// A synthetic file must load with all but its deliberately invalid rows.
+
+#include "../binary_cache.hpp"
+#include "synthetic_csv.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Asks the kernel to drop the file's clean pages so the next map faults them in from disk.
+static void evict_from_page_cache(const string& path) {
+#if defined(__linux__)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#else
+    (void)path;
+#endif
+}
+
+static double touch_closes(const PriceSeries& series) {
+    double sum = 0;
+    for (unsigned int i = 0; i < series.size; i++) sum += series.close[i];
+    return sum;
+}
+
+static bool same_series(const PriceSeries& a, const PriceSeries& b) {
+    if (a.size != b.size) return false;
+    return memcmp(a.time, b.time, a.size * sizeof(int64_t)) == 0 && memcmp(a.open, b.open, a.size * sizeof(double)) == 0 &&
+           memcmp(a.high, b.high, a.size * sizeof(double)) == 0 && memcmp(a.low, b.low, a.size * sizeof(double)) == 0 &&
+           memcmp(a.close, b.close, a.size * sizeof(double)) == 0 &&
+           memcmp(a.volume, b.volume, a.size * sizeof(double)) == 0;
+}
+
+static double timed_load(const string& path, const CacheOptions& options, StockPredictor& predictor, bool& from_cache,
+                         double& checksum) {
+    CsvLoadResult result;
+    auto start = chrono::steady_clock::now();
+    if (!load_stock_cached(predictor, path, result, options, 0, &from_cache)) {
+        cerr << "Cannot load " << path << endl;
+        exit(1);
+    }
+    checksum = touch_closes(predictor.series);
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    string path;
+    long rows = -1;
+    if (argc > 1 && strtol(argv[1], nullptr, 10) <= 0) {
+        path = argv[1];
+    } else {
+        rows = argc > 1 ? atol(argv[1]) : 2000000;
+        path = "/tmp/bench_cache.csv";
+        if (!write_synthetic_csv(path, rows)) {
+            cerr << "Cannot write " << path << endl;
+            return 1;
+        }
+    }
+    string cache_path = cache_path_for(path);
+    remove(cache_path.c_str());
+
+    StockPredictor parsed;
+    bool from_cache = false;
+    double sum = 0;
+    double parse_secs = timed_load(path, CacheOptions(), parsed, from_cache, sum);
+    if (from_cache) {
+        cerr << "First load unexpectedly came from the cache" << endl;
+        return 1;
+    }
+    printf("rows %u\n", parsed.series.size);
+    if (rows > 0 && parsed.series.size != static_cast<unsigned long>(market_valid_rows(rows))) {
+        cerr << "Expected " << market_valid_rows(rows) << " valid rows of the " << rows << " generated" << endl;
+        return 1;
+    }
+    printf("parse + write cache   %9.3f ms\n", parse_secs * 1e3);
+
+    const char *labels[3] = { "cold reopen", "warm reopen", "warm reopen + verify" };
+    for (int run = 0; run < 3; run++) {
+        if (run == 0) evict_from_page_cache(cache_path);
+        StockPredictor cached;
+        double secs = timed_load(path, CacheOptions(true, run == 2), cached, from_cache, sum);
+        if (!from_cache || !same_series(parsed.series, cached.series)) {
+            cerr << labels[run] << ": cache missing or differs from the parsed series" << endl;
+            return 1;
+        }
+        printf("%-21s %9.3f ms  (%.1fx faster than parsing)\n", labels[run], secs * 1e3, parse_secs / secs);
+    }
+
+    // Flip one byte in the close column: only a verified open may notice.
+    {
+        FILE *file = fopen(cache_path.c_str(), "r+b");
+        if (!file) return 1;
+        CacheHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1) return 1;
+        fseek(file, static_cast<long>(header.column_offset[4]), SEEK_SET);
+        int byte = fgetc(file);
+        fseek(file, static_cast<long>(header.column_offset[4]), SEEK_SET);
+        fputc(byte ^ 0x40, file);
+        fclose(file);
+    }
+    StockPredictor rebuilt;
+    timed_load(path, CacheOptions(true, true), rebuilt, from_cache, sum);
+    if (from_cache || !same_series(parsed.series, rebuilt.series)) {
+        cerr << "Corrupt cache was not detected" << endl;
+        return 1;
+    }
+    StockPredictor reopened;
+    timed_load(path, CacheOptions(true, true), reopened, from_cache, sum);
+    if (!from_cache || !same_series(parsed.series, reopened.series)) {
+        cerr << "Rebuilt cache does not verify" << endl;
+        return 1;
+    }
+    printf("corrupt cache detected and rebuilt\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+// bench_chart.cpp - Per-frame candle preparation: one candle per bar vs. the LOD pyramid
+//
+// Build: clang++ -O2 -std=c++11 bench/bench_chart.cpp -o bench_chart
+// Usage: ./bench_chart [max_bars] [pixels]
+//
+// For histories of 1e3..max_bars bars, reports how many candles a frame
+// would draw and how long preparing them takes, with the original loop (one
+// candle per bar) and with CandlePyramid::visible_candles. Also times
+// building the pyramid and keeping it in sync while bars are appended.
+
+#include "../candle_pyramid.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+static void random_bars(PriceSeries& series, unsigned int bars) {
+    series.clear();
+    series.reserve(bars);
+    unsigned long long seed = 23;
+    double price = 100.0;
+    for (unsigned int i = 0; i < bars; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double open = price;
+        price += (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5) * 2.0;
+        if (price < 1) price = 1;
+        double high = (open > price ? open : price) + 0.5;
+        double low = (open < price ? open : price) - 0.5;
+        series.add(static_cast<int32_t>(i), open, high, low, price, 1000);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int max_bars = argc > 1 ? static_cast<unsigned int>(atol(argv[1])) : 10000000;
+    int pixels = argc > 2 ? atoi(argv[2]) : 820;
+    if (pixels < 1) pixels = 1;
+
+    printf("%10s %12s %12s %12s %12s %10s\n", "bars", "naive cands", "naive us", "lod cands", "lod us", "build ms");
+    PriceSeries series;
+    vector<ChartCandle> candles;
+    for (unsigned int bars = 1000; bars <= max_bars; bars *= 10) {
+        random_bars(series, bars);
+
+        // The original draw_chart loop: one candle (and two draw calls) per bar
+        int frames = bars >= 1000000 ? 5 : 50;
+        auto start = chrono::steady_clock::now();
+        double checksum = 0;
+        for (int f = 0; f < frames; f++) {
+            candles.clear();
+            double width = static_cast<double>(pixels) / bars;
+            for (unsigned int i = 0; i < bars; i++) {
+                ChartCandle c = { i * width, (i + 1) * width, series.open[i], series.high[i], series.low[i], series.close[i] };
+                candles.push_back(c);
+            }
+            checksum += candles.back().close;
+        }
+        double naive_us = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6 / frames;
+        size_t naive_count = candles.size();
+
+        start = chrono::steady_clock::now();
+        CandlePyramid pyramid;
+        pyramid.build(series);
+        double build_ms = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e3;
+
+        frames = 200;
+        start = chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) {
+            pyramid.visible_candles(series, 0, series.size, pixels, candles);
+            checksum += candles.back().close;
+        }
+        double lod_us = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6 / frames;
+
+        printf("%10u %12zu %12.1f %12zu %12.1f %10.1f\n", bars, naive_count, naive_us, candles.size(), lod_us, build_ms);
+        if (checksum == 0) printf(" ");
+    }
+
+    // Appending: sync after every bar
+    unsigned int base = max_bars / 2, appended = 100000;
+    random_bars(series, base + appended);
+    unsigned int full = series.size;
+    series.size = base;
+    CandlePyramid pyramid;
+    pyramid.build(series);
+    auto start = chrono::steady_clock::now();
+    while (series.size < full) {
+        series.size++;
+        pyramid.sync(series);
+    }
+    double per_bar = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e9 / appended;
+    CandlePyramid rebuilt;
+    rebuilt.build(series);
+    bool same = rebuilt.levels.size() == pyramid.levels.size();
+    for (size_t i = 0; same && i < rebuilt.levels.size(); i++) {
+        for (size_t j = 0; same && j < rebuilt.levels[i].size(); j++) {
+            const Candle& a = rebuilt.levels[i][j];
+            const Candle& b = pyramid.levels[i][j];
+            same = a.open == b.open && a.high == b.high && a.low == b.low && a.close == b.close;
+        }
+    }
+    printf("\nsync after each appended bar: %.0f ns/bar, %s a full rebuild\n", per_bar, same ? "matches" : "DIFFERS from");
+    return same ? 0 : 1;
+}
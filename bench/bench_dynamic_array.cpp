@@ -0,0 +1,189 @@
+// bench_dynamic_array.cpp - Load and scan time of dynamic_array against the copy-on-grow version it replaced
+//
+// Build: clang++ -O2 -std=c++11 bench/bench_dynamic_array.cpp -o bench_dynamic_array
+// Usage: ./bench_dynamic_array [rows]
+//
+// Parses a synthetic CSV (default 2,000,000 rows) into the previous container
+// (kept below as legacy_dynamic_array: new T[] storage, copy on growth, get()
+// by value) and into the current one with and without the loader's row
+// estimate, then scans the closes through get(). Also appends doubles to show
+// growth by memcpy (std::allocator) and by realloc (malloc_allocator). The
+// run passes if every valid generated row loads and the reserved load beats
+// the legacy one. The get() scans are only reported: StockData is 64
+// trivially copyable bytes, so the legacy by-value get() costs the same as a
+// reference and either may win a run.
+
+#include "../csv_loader.hpp"
+#include "synthetic_csv.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace std;
+
+// dynamic_array as it was before the rewrite, for comparison.
+template <typename T>
+struct legacy_dynamic_array {
+    unsigned int size;
+    unsigned int capacity;
+    T *data;
+    T default_value;
+
+    legacy_dynamic_array(unsigned int initial_capacity, T default_val)
+        : size(0), capacity(initial_capacity), data(capacity > 0 ? new T[capacity] : nullptr), default_value(default_val) {}
+
+    ~legacy_dynamic_array() {
+        delete[] data;
+    }
+
+    bool add(T value) {
+        if (size >= capacity) {
+            unsigned int new_capacity = capacity > 0 ? capacity * 2 : 1;
+            T *new_data = new T[new_capacity];
+            for (unsigned int i = 0; i < size; i++) new_data[i] = data[i];
+            delete[] data;
+            data = new_data;
+            capacity = new_capacity;
+        }
+        data[size] = value;
+        size++;
+        return true;
+    }
+
+    T get(unsigned int index) const {
+        if (index >= size) return default_value;
+        return data[index];
+    }
+
+private:
+    legacy_dynamic_array(const legacy_dynamic_array&);
+    legacy_dynamic_array& operator=(const legacy_dynamic_array&);
+};
+
+static volatile double sink;
+
+// parse_csv_lines for any container with add().
+template <typename Array>
+static void parse_into(const char *begin, const char *end, Array& out) {
+    StockData stock;
+    const char *p = begin;
+    while (p < end) {
+        const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+        const char *line_end = newline ? newline : end;
+        if (line_end != p) {
+            parse_stock_row(p, line_end, stock);
+            if (valid_stock_row(stock)) out.add(stock);
+        }
+        p = newline ? newline + 1 : end;
+    }
+}
+
+template <typename Fn>
+static double best_of(int runs, Fn fn) {
+    double best = 1e300;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (secs < best) best = secs;
+    }
+    return best;
+}
+
+static void report(const char *name, double secs, size_t items) {
+    printf("%-40s %9.2f ms  %7.2f ns/item\n", name, secs * 1e3, secs * 1e9 / items);
+}
+
+int main(int argc, char *argv[]) {
+    long rows = argc > 1 ? atol(argv[1]) : 2000000;
+    if (rows < 2) rows = 2;
+    const int runs = 3;
+
+    string path = "/tmp/bench_dynamic_array.csv";
+    if (!write_synthetic_csv(path, rows)) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return 1;
+    }
+    mapped_file file;
+    if (!file.open(path)) return 1;
+    const char *end = file.data + file.size;
+    const char *body = skip_csv_header(file.data, end);
+    size_t estimate = estimate_csv_rows(body, end);
+
+    size_t loaded = 0;
+    double legacy_load = best_of(runs, [&]() {
+        legacy_dynamic_array<StockData> out(50, StockData());
+        parse_into(body, end, out);
+        loaded = out.size;
+    });
+    double grow_load = best_of(runs, [&]() {
+        dynamic_array<StockData> out;
+        parse_into(body, end, out);
+    });
+    double reserved_load = best_of(runs, [&]() {
+        dynamic_array<StockData> out;
+        out.reserve(estimate);
+        parse_into(body, end, out);
+    });
+    printf("rows: %zu loaded, %zu estimated from the first %zu bytes, sizeof(StockData)=%zu\n\n", loaded, estimate,
+           CSV_ROW_SAMPLE_BYTES, sizeof(StockData));
+    report("load, legacy (copy on growth)", legacy_load, loaded);
+    report("load, dynamic_array (move on growth)", grow_load, loaded);
+    report("load, dynamic_array reserved", reserved_load, loaded);
+
+    legacy_dynamic_array<StockData> legacy(50, StockData());
+    dynamic_array<StockData> current;
+    parse_into(body, end, legacy);
+    parse_into(body, end, current);
+
+    double legacy_scan = best_of(runs, [&]() {
+        double sum = 0;
+        for (unsigned int i = 0; i < legacy.size; i++) sum += legacy.get(i).close;
+        sink = sum;
+    });
+    double get_scan = best_of(runs, [&]() {
+        double sum = 0;
+        for (size_t i = 0; i < current.size; i++) sum += current.get(i).close;
+        sink = sum;
+    });
+    double iterator_scan = best_of(runs, [&]() {
+        double sum = 0;
+        for (const StockData& row : current) sum += row.close;
+        sink = sum;
+    });
+    printf("\n");
+    report("close scan, legacy get() by value", legacy_scan, loaded);
+    report("close scan, get() by reference", get_scan, loaded);
+    report("close scan, iterators", iterator_scan, loaded);
+    printf("get() by reference vs legacy by value: %.2fx\n", legacy_scan / get_scan);
+
+    // Trivially copyable elements: growth is a memcpy or a realloc
+    size_t values = static_cast<size_t>(rows) * 8;
+    double legacy_doubles = best_of(runs, [&]() {
+        legacy_dynamic_array<double> out(50, 0.0);
+        for (size_t i = 0; i < values; i++) out.add(static_cast<double>(i));
+        sink = out.data[out.size - 1];
+    });
+    double memcpy_doubles = best_of(runs, [&]() {
+        dynamic_array<double> out;
+        for (size_t i = 0; i < values; i++) out.add(static_cast<double>(i));
+        sink = out.last();
+    });
+    double realloc_doubles = best_of(runs, [&]() {
+        dynamic_array<double, malloc_allocator<double> > out;
+        for (size_t i = 0; i < values; i++) out.add(static_cast<double>(i));
+        sink = out.last();
+    });
+    printf("\n");
+    report("append doubles, legacy", legacy_doubles, values);
+    report("append doubles, std::allocator (memcpy)", memcpy_doubles, values);
+    report("append doubles, malloc_allocator (realloc)", realloc_doubles, values);
+
+    remove(path.c_str());
+    bool all_rows = loaded == static_cast<size_t>(market_valid_rows(rows));
+    if (!all_rows) printf("\nexpected %ld valid rows of the %ld generated\n", market_valid_rows(rows), rows);
+    bool ok = all_rows && current.size == loaded && reserved_load < legacy_load;
+    printf("\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
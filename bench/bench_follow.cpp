@@ -0,0 +1,154 @@
+// bench_follow.cpp - Write-to-prediction latency of follow mode on a growing CSV
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_follow.cpp -o bench_follow
+// Usage: ./bench_follow [bars_per_second] [seconds] [history_rows]
+//
+// Loads a synthetic history, then a writer thread appends one bar per line
+// at a fixed rate (one write() each, O_APPEND) while the main thread follows
+// the file the way hd --follow does: prepare_follow, then
+// tail_follower::wait, read_bars and append_bar per bar. Latency runs from
+// just before a bar's write() to the moment its prediction is updated, on
+// the same steady clock. Then a bar older than the newest and one repeating
+// the newest timestamp are appended: the first must be skipped, the second
+// must replace the newest bar. The run passes if the 99th percentile stays
+// under a millisecond, both late bars are handled so, and the incremental
+// regression still matches a full recompute over the grown series.
+
+#include "../tail_follower.hpp"
+#include "../incremental_model.hpp"
+#include "synthetic_csv.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static long long now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char *argv[]) {
+    double rate = argc > 1 ? atof(argv[1]) : 10000;
+    double seconds = argc > 2 ? atof(argv[2]) : 3;
+    long history = argc > 3 ? atol(argv[3]) : 100000;
+    if (rate <= 0) rate = 10000;
+    unsigned int total = static_cast<unsigned int>(rate * seconds);
+    if (total < 1) total = 1;
+
+    const string path = "bench_follow.csv";
+    if (!write_synthetic_csv(path, history)) {
+        printf("cannot write %s\n", path.c_str());
+        return 1;
+    }
+
+    StockPredictor predictor;
+    CsvLoadResult loaded;
+    load_stock_file(predictor, path, loaded, 1);
+    prepare_follow(predictor);
+    IncrementalPredictor live(predictor.params);
+    prime_incremental(live, predictor.series);
+
+    tail_follower follower;
+    if (!follower.follow_file(path, loaded.source_bytes, predictor.series.time[predictor.series.size - 1])) {
+        printf("cannot follow %s\n", path.c_str());
+        return 1;
+    }
+
+    vector<atomic<long long> > written(total);
+    thread writer([&]() {
+        int fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+        if (fd < 0) return;
+        double price = predictor.series.close[predictor.series.size - 1];
+        unsigned long long seed = 7;
+        auto start = chrono::steady_clock::now();
+        char line[128];
+        for (unsigned int i = 0; i < total; i++) {
+            this_thread::sleep_until(start + chrono::nanoseconds(static_cast<long long>(i * 1e9 / rate)));
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            double step = (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5) * 2.0;
+            price = price + step > 1.0 ? price + step : price;
+            int day = static_cast<int>(i % 28) + 1;
+            int month = static_cast<int>((i / 28) % 12) + 1;
+            int year = 2025 + static_cast<int>(i / 336);
+            int length = snprintf(line, sizeof(line), "%02d/%02d/%04d,\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\",\"1,000,000\"\n",
+                                  month, day, year, price - step / 2, price + 1.25, price - step / 2 - 1.25, price);
+            written[i].store(now_ns(), memory_order_release);
+            if (::write(fd, line, length) != length) break;
+        }
+        ::close(fd);
+    });
+
+    vector<double> latency_us;
+    latency_us.reserve(total);
+    vector<StockData> bars;
+    CsvLoadResult appended;
+    double update_ns = 0;
+    long long deadline = now_ns() + static_cast<long long>((seconds + 5) * 1e9);
+    while (latency_us.size() < total && now_ns() < deadline) {
+        follower.wait(50);
+        bars.clear();
+        follower.read_bars(bars, appended);
+        for (size_t b = 0; b < bars.size(); b++) {
+            long long before = now_ns();
+            append_bar(predictor, live, bars[b]);
+            long long done = now_ns();
+            update_ns += done - before;
+            size_t index = latency_us.size();
+            latency_us.push_back((done - written[index].load(memory_order_acquire)) / 1e3);
+        }
+    }
+    writer.join();
+
+    // An out-of-order bar, then a revision of the newest one
+    unsigned int grown = predictor.series.size;
+    int skipped_before = appended.skipped_rows;
+    const double revised_close = 123.25;
+    FILE *late = fopen(path.c_str(), "a");
+    if (late) {
+        fprintf(late, "01/02/2000,\"10.00\",\"11.00\",\"9.00\",\"10.50\",\"1,000\"\n");
+        fprintf(late, "%s,\"120.00\",\"125.00\",\"119.00\",\"%.2f\",\"2,000\"\n",
+                format_timestamp(predictor.series.time[grown - 1]).c_str(), revised_close);
+        fclose(late);
+    }
+    for (int tries = 0; tries < 100 && appended.valid_rows + appended.skipped_rows < static_cast<int>(total) + 2;
+         tries++) {
+        follower.wait(50);
+        bars.clear();
+        follower.read_bars(bars, appended);
+        for (size_t b = 0; b < bars.size(); b++) append_bar(predictor, live, bars[b]);
+    }
+    remove(path.c_str());
+    bool late_ok = predictor.series.size == grown && appended.skipped_rows == skipped_before + 1 &&
+                   predictor.series.close[grown - 1] == revised_close;
+    printf("late bars: older one %s, repeated timestamp %s\n",
+           appended.skipped_rows == skipped_before + 1 ? "skipped" : "NOT SKIPPED",
+           predictor.series.size == grown && predictor.series.close[grown - 1] == revised_close ? "replaced the newest"
+                                                                                                  : "NOT REPLACED");
+
+    size_t received = latency_us.size();
+    if (received == 0) {
+        printf("no bars received\n");
+        return 1;
+    }
+    vector<double> sorted = latency_us;
+    sort(sorted.begin(), sorted.end());
+    double p50 = sorted[received / 2];
+    double p99 = sorted[min(received - 1, received * 99 / 100)];
+    printf("%u history rows, %u bars at %.0f bars/s: received %zu (%d rejected)\n", predictor.series.size - total,
+           total, rate, received, appended.skipped_rows);
+    printf("write -> prediction latency: p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n", p50,
+           sorted[received * 9 / 10], p99, sorted.back());
+    printf("append_bar + model update: %.0f ns/bar\n", update_ns / received);
+
+    RegressionFit full = fit_from_sums(regression_sums(predictor.series.close, predictor.series.size));
+    double drift = fabs(live.slope() - full.slope) / max(fabs(full.slope), 1e-12);
+    printf("incremental slope vs full recompute: relative difference %.2e\n", drift);
+
+    bool ok = received == total && late_ok && p99 < 1000 && drift < 1e-9;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+// bench_forecast.cpp - Batched autoregressive fits across tickers and forecast interval coverage
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_forecast.cpp -o bench_forecast
+// Usage: ./bench_forecast [tickers] [bars]
+//
+// Simulates `tickers` series (default 4,000) of up to `bars` closes (default
+// 2,520, ten years of days) whose changes follow a known AR(2) process, then
+//   - fits AR(2) to every ticker one at a time and with
+//     fit_autoregressive_batch at each SIMD level, checking that every
+//     batched fit is bit-identical to the scalar one;
+//   - checks that the mean fitted coefficients recover the true ones;
+//   - fits each ticker without its last FORECAST_HORIZON bars and counts how
+//     often the held-out closes fall inside the 95% forecast interval at
+//     one step and at the full horizon;
+//   - reports the same coverage for Holt's trend and Holt-Winters on a
+//     seasonal series (informational: those models are not the process that
+//     generated the data).
+// The run passes if the batch matches, the coefficients are recovered and
+// the AR coverage is within 93-97% at both horizons (wider for a few hundred
+// tickers, where the count itself is that noisy).
+
+#include "../stock_predictor.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+static const double TRUE_INTERCEPT = 0.01;
+static const double TRUE_PHI[2] = { 0.35, -0.2 };
+
+struct Normal {
+    uint64_t state;
+
+    explicit Normal(uint64_t seed) : state(seed) {}
+
+    double uniform() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (static_cast<double>(state >> 11) + 0.5) / 9007199254740992.0;
+    }
+
+    // Box-Muller, one value per call
+    double next() {
+        double u = uniform(), v = uniform();
+        return sqrt(-2 * log(u)) * cos(6.283185307179586 * v);
+    }
+};
+
+template <typename Fn>
+static double best_of(int runs, Fn fn) {
+    double best = 1e300;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (secs < best) best = secs;
+    }
+    return best;
+}
+
+static bool same_fit(const ArFit& a, const ArFit& b) {
+    if (a.ok != b.ok || a.order != b.order || a.rows != b.rows) return false;
+    if (a.intercept != b.intercept || a.sigma != b.sigma) return false;
+    for (int k = 0; k < a.order; k++) {
+        if (a.phi[k] != b.phi[k]) return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    long tickers_arg = argc > 1 ? atol(argv[1]) : 4000;
+    long bars_arg = argc > 2 ? atol(argv[2]) : 2520;
+    size_t tickers = static_cast<size_t>(tickers_arg > 8 ? tickers_arg : 8);
+    unsigned int bars = static_cast<unsigned int>(bars_arg > 100 ? bars_arg : 100);
+    const int order = 2;
+    const int runs = 3;
+
+    // Lengths from bars/2 to bars, so batch lanes finish at different times
+    Normal noise(7);
+    vector<vector<double> > series(tickers);
+    vector<const double *> closes(tickers);
+    vector<unsigned int> sizes(tickers);
+    unsigned long long total_bars = 0;
+    for (size_t i = 0; i < tickers; i++) {
+        unsigned int n = bars / 2 + static_cast<unsigned int>(noise.uniform() * (bars / 2 + 1));
+        if (n > bars) n = bars;
+        vector<double>& close = series[i];
+        close.resize(n);
+        double price = 100, d1 = 0, d2 = 0;
+        for (unsigned int t = 0; t < n; t++) {
+            double d = TRUE_INTERCEPT + TRUE_PHI[0] * d1 + TRUE_PHI[1] * d2 + noise.next();
+            price += d;
+            close[t] = price;
+            d2 = d1;
+            d1 = d;
+        }
+        closes[i] = close.data();
+        sizes[i] = n;
+        total_bars += n;
+    }
+
+    vector<ArFit> reference(tickers);
+    double scalar_s = best_of(runs, [&]() {
+        for (size_t i = 0; i < tickers; i++) reference[i] = fit_autoregressive(closes[i], sizes[i], order);
+    });
+    printf("%zu tickers, %llu bars, AR(%d)\n\n", tickers, total_bars, order);
+    printf("one ticker at a time     %8.2f ms  %6.2f ns/bar\n", scalar_s * 1e3, scalar_s * 1e9 / total_bars);
+
+    bool ok = true;
+    SimdLevel levels[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+    vector<ArFit> batched(tickers);
+    for (int l = 0; l < 3; l++) {
+        set_simd_level(levels[l]);
+        if (active_simd_level() != levels[l]) continue;
+        double secs = best_of(runs, [&]() {
+            fit_autoregressive_batch(closes.data(), sizes.data(), tickers, order, batched.data(), nullptr, levels[l]);
+        });
+        size_t mismatches = 0;
+        for (size_t i = 0; i < tickers; i++) {
+            if (!same_fit(batched[i], reference[i])) mismatches++;
+        }
+        printf("batch, %-6s (%u lanes)  %8.2f ms  %6.2f ns/bar  %.2fx  %zu fits differ\n", simd_level_name(levels[l]),
+               ar_batch_lanes(levels[l]), secs * 1e3, secs * 1e9 / total_bars, scalar_s / secs, mismatches);
+        ok = ok && mismatches == 0;
+    }
+    set_simd_level(detect_simd_level());
+
+    double phi_mean[2] = { 0, 0 };
+    for (size_t i = 0; i < tickers; i++) {
+        phi_mean[0] += reference[i].phi[0] / tickers;
+        phi_mean[1] += reference[i].phi[1] / tickers;
+    }
+    bool recovered = fabs(phi_mean[0] - TRUE_PHI[0]) < 0.01 && fabs(phi_mean[1] - TRUE_PHI[1]) < 0.01;
+    printf("\nmean coefficients %.4f, %.4f (true %.2f, %.2f)  %s\n", phi_mean[0], phi_mean[1], TRUE_PHI[0], TRUE_PHI[1],
+           recovered ? "recovered" : "NOT recovered");
+    ok = ok && recovered;
+
+    // Held-out coverage of the 95% intervals
+    const int last = FORECAST_HORIZON - 1;
+    size_t inside_first = 0, inside_last = 0, forecasts = 0;
+    for (size_t i = 0; i < tickers; i++) {
+        unsigned int n = sizes[i] - FORECAST_HORIZON;
+        ArFit fit = fit_autoregressive(closes[i], n, order);
+        ForecastPath path = autoregressive_series_forecast(fit, closes[i], n);
+        if (path.steps != FORECAST_HORIZON) continue;
+        double first_actual = closes[i][n], last_actual = closes[i][n + last];
+        inside_first += first_actual >= path.lower(0) && first_actual <= path.upper(0);
+        inside_last += last_actual >= path.lower(last) && last_actual <= path.upper(last);
+        forecasts++;
+    }
+    double coverage_first = forecasts ? static_cast<double>(inside_first) / forecasts : 0;
+    double coverage_last = forecasts ? static_cast<double>(inside_last) / forecasts : 0;
+    // 95% +- 2 points, or 3 standard errors of the count when there are few tickers
+    double tolerance = max(0.02, 3 * sqrt(0.95 * 0.05 / (forecasts ? forecasts : 1)));
+    bool covered = fabs(coverage_first - 0.95) <= tolerance && fabs(coverage_last - 0.95) <= tolerance;
+    printf("AR 95%% interval coverage: %.1f%% at 1 bar, %.1f%% at %d bars  %s\n", coverage_first * 100,
+           coverage_last * 100, FORECAST_HORIZON, covered ? "ok" : "OFF");
+    ok = ok && covered;
+
+    // Holt and Holt-Winters on a trending series with a 5-bar season
+    const unsigned int season = 5;
+    const double pattern[season] = { 1.5, -0.5, 0.8, -1.2, -0.6 };
+    double holt_secs = 0;
+    size_t holt_inside[2] = { 0, 0 }, holt_forecasts = 0;
+    for (size_t i = 0; i < tickers; i++) {
+        unsigned int n = sizes[i] - FORECAST_HORIZON;
+        vector<double>& close = series[i];
+        double level = 100;
+        for (unsigned int t = 0; t < sizes[i]; t++) {
+            level += 0.05 + 0.5 * noise.next();
+            close[t] = level + pattern[t % season] + 0.5 * noise.next();
+        }
+        for (int seasonal = 0; seasonal < 2; seasonal++) {
+            HoltWinters smoother(0.3, 0.05, 0.2, seasonal ? season : 0);
+            auto start = chrono::steady_clock::now();
+            for (unsigned int t = 0; t < n; t++) smoother.add(close[t]);
+            holt_secs += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            ForecastPath path = smoother.forecast();
+            holt_inside[seasonal] += close[n] >= path.lower(0) && close[n] <= path.upper(0);
+        }
+        holt_forecasts++;
+    }
+    printf("Holt-Winters: %.2f ns/bar; 1-bar coverage %.1f%% without season, %.1f%% with a %u-bar season\n",
+           holt_secs * 1e9 / (2.0 * (total_bars - tickers * FORECAST_HORIZON)),
+           100.0 * holt_inside[0] / holt_forecasts, 100.0 * holt_inside[1] / holt_forecasts, season);
+
+    printf("\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// bench_kernels.cpp - SIMD regression, min/max and EMA kernels: timing and accuracy against scalar
+//
+// Build: clang++ -O2 -std=c++11 bench/bench_kernels.cpp -o bench_kernels
+// Usage: ./bench_kernels [rows]
+//
+// Every vector level the CPU supports is timed and checked against the
+// scalar kernels using the tolerances documented in simd_kernels.hpp. The
+// original two-pass regression is timed as the baseline. Exits non-zero if a
+// tolerance is exceeded.
+
+#include "../simd_kernels.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+static volatile double sink;
+
+template <typename Fn>
+static double best_time(Fn fn) {
+    double best = 1e300;
+    for (int r = 0; r < 5; r++) {
+        auto start = chrono::steady_clock::now();
+        sink = fn();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (secs < best) best = secs;
+    }
+    return best;
+}
+
+// The LINEAR_REGRESSION case as it was: mean, then covariance.
+static void two_pass_regression(const double *close, unsigned int n, double& slope, double& intercept) {
+    double x_mean = (n - 1) / 2.0;
+    double y_mean = 0;
+    for (unsigned int i = 0; i < n; i++) y_mean += close[i];
+    y_mean /= n;
+
+    double numerator = 0, denominator = 0;
+    for (unsigned int i = 0; i < n; i++) {
+        double x_diff = i - x_mean;
+        double y_diff = close[i] - y_mean;
+        numerator += x_diff * y_diff;
+        denominator += x_diff * x_diff;
+    }
+    slope = (denominator != 0) ? numerator / denominator : 0;
+    intercept = y_mean - slope * x_mean;
+}
+
+// ULP distance measured at the scale of `magnitude`, for quantities such as a
+// near-zero slope whose own ULP is meaningless.
+static double scaled_ulps(double a, double b, double magnitude) {
+    double unit = nextafter(fabs(magnitude), INFINITY) - fabs(magnitude);
+    return unit > 0 ? fabs(a - b) / unit : 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int rows = argc > 1 ? static_cast<unsigned int>(atol(argv[1])) : 10000000;
+    if (rows < 16) rows = 16;
+
+    vector<double> close(rows), low(rows), high(rows);
+    unsigned long long seed = 11;
+    double price = 100.0;
+    for (unsigned int i = 0; i < rows; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double step = (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5);
+        price = price + step > 1.0 ? price + step : price;
+        close[i] = price;
+        low[i] = price - 0.75;
+        high[i] = price + 0.75;
+    }
+
+    const double alpha = 0.3;
+    RegressionFit ref_fit = fit_from_sums(regression_sums(close.data(), rows, SIMD_SCALAR));
+    double ref_next = ref_fit.slope * rows + ref_fit.intercept;
+    double ref_lo = low[0], ref_hi = high[0];
+    minmax_reduce(low.data(), high.data(), rows, ref_lo, ref_hi, SIMD_SCALAR);
+    double ref_ema = ema_last_scalar(close.data(), rows, alpha);
+
+    double base_slope, base_intercept;
+    double two_pass_secs = best_time([&]() {
+        two_pass_regression(close.data(), rows, base_slope, base_intercept);
+        return base_slope;
+    });
+
+    printf("rows: %u  detected: %s\n", rows, simd_level_name(detect_simd_level()));
+    printf("two-pass regression (original): %8.3f ms\n", two_pass_secs * 1e3);
+    printf("  fused scalar vs two-pass: slope %.3g, intercept %.3g (relative)\n\n",
+           fabs(ref_fit.slope - base_slope) / (fabs(base_slope) + 1e-300),
+           fabs(ref_fit.intercept - base_intercept) / fabs(base_intercept));
+
+    bool ok = true;
+    for (int level = SIMD_SCALAR; level <= detect_simd_level(); level++) {
+        SimdLevel l = static_cast<SimdLevel>(level);
+
+        RegressionFit fit;
+        double reg_secs = best_time([&]() {
+            fit = fit_from_sums(regression_sums(close.data(), rows, l));
+            return fit.slope;
+        });
+        double lo = 0, hi = 0;
+        double mm_secs = best_time([&]() {
+            lo = low[0];
+            hi = high[0];
+            minmax_reduce(low.data(), high.data(), rows, lo, hi, l);
+            return lo + hi;
+        });
+        double ema = 0;
+        double ema_secs = best_time([&]() {
+            ema = ema_last(close.data(), rows, alpha, l);
+            return ema;
+        });
+
+        double next = fit.slope * rows + fit.intercept;
+        // Slope and r^2 are compared at the scale of their largest term
+        double slope_scale = fabs(ref_fit.slope) + fabs(ref_fit.intercept) / rows;
+        double slope_ulps = scaled_ulps(fit.slope, ref_fit.slope, slope_scale);
+        double r2_ulps = scaled_ulps(fit.r_squared, ref_fit.r_squared, 1.0);
+        int64_t intercept_ulps = ulp_distance(fit.intercept, ref_fit.intercept);
+        int64_t next_ulps = ulp_distance(next, ref_next);
+        int64_t ema_ulps = ulp_distance(ema, ref_ema);
+        bool minmax_exact = lo == ref_lo && hi == ref_hi;
+
+        bool level_ok = slope_ulps <= REGRESSION_ULP_TOLERANCE && r2_ulps <= REGRESSION_ULP_TOLERANCE &&
+                        intercept_ulps <= REGRESSION_ULP_TOLERANCE && next_ulps <= REGRESSION_ULP_TOLERANCE &&
+                        ema_ulps <= EMA_ULP_TOLERANCE && minmax_exact;
+        ok = ok && level_ok;
+
+        printf("[%s]\n", simd_level_name(l));
+        printf("  fused regression: %8.3f ms (%.2fx vs two-pass)  r2=%.6f\n", reg_secs * 1e3, two_pass_secs / reg_secs, fit.r_squared);
+        printf("  min/max:          %8.3f ms\n", mm_secs * 1e3);
+        printf("  ema:              %8.3f ms\n", ema_secs * 1e3);
+        printf("  ulps vs scalar: slope %.1f, intercept %lld, r2 %.1f, next %lld, ema %lld, min/max %s -> %s\n",
+               slope_ulps, static_cast<long long>(intercept_ulps), r2_ulps, static_cast<long long>(next_ulps),
+               static_cast<long long>(ema_ulps), minmax_exact ? "exact" : "DIFFERENT", level_ok ? "ok" : "OUT OF TOLERANCE");
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+// bench_loader.cpp - Throughput of the mmap and parallel loaders against the getline/stringstream loader
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_loader.cpp -o bench_loader
+// Usage: ./bench_loader [csv_file | row_count] [max_threads]
+//
+// With no file a synthetic newest-first CSV in the README format is written
+// to a temporary file, and the loaders must keep every row of it but the
+// deliberately invalid ones. Every loader must agree row for row with the
+// original one; the parallel loader is timed for 1..max_threads threads.
+
+#include "../csv_loader.hpp"
+#include "synthetic_csv.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+static bool same_double(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static bool same_rows(const dynamic_array<StockData>& a, const dynamic_array<StockData>& b) {
+    if (a.size != b.size) return false;
+    for (unsigned int i = 0; i < a.size; i++) {
+        const StockData& x = a.data[i];
+        const StockData& y = b.data[i];
+        if (x.time != y.time || !same_double(x.open, y.open) || !same_double(x.high, y.high) ||
+            !same_double(x.low, y.low) || !same_double(x.close, y.close) || !same_double(x.volume, y.volume)) {
+            cerr << "Row " << i << " differs: " << format_timestamp(x.time) << " vs " << format_timestamp(y.time) << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Loader>
+static double time_loader(Loader loader, const string& path, int runs, dynamic_array<StockData>& out, CsvLoadResult& result) {
+    double best = 1e300;
+    for (int r = 0; r < runs; r++) {
+        dynamic_array<StockData> rows(50, StockData());
+        CsvLoadResult res;
+        auto start = chrono::steady_clock::now();
+        loader(path, rows, res);
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (secs < best) best = secs;
+        if (r == runs - 1) {
+            out.swap(rows);
+            result = res;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    string path = "/tmp/bench_loader.csv";
+    long rows = 1000000;
+
+    unsigned int max_threads = thread_pool::default_thread_count();
+
+    if (argc > 2) {
+        max_threads = static_cast<unsigned int>(atoi(argv[2]));
+        if (max_threads == 0) max_threads = 1;
+    }
+    if (argc > 1) {
+        char *end;
+        long n = strtol(argv[1], &end, 10);
+        if (*end == '\0' && n > 0) {
+            rows = n;
+        } else {
+            path = argv[1];
+            rows = -1;
+        }
+    }
+
+    if (rows > 0 && !write_synthetic_csv(path, rows)) {
+        cerr << "Cannot write " << path << endl;
+        return 1;
+    }
+
+    mapped_file probe;
+    if (!probe.open(path)) {
+        cerr << "Cannot open " << path << endl;
+        return 1;
+    }
+    double mb = probe.size / (1024.0 * 1024.0);
+    probe.close();
+
+    dynamic_array<StockData> stream_rows(50, StockData()), mmap_rows(50, StockData());
+    CsvLoadResult stream_result, mmap_result;
+    double stream_secs = time_loader(load_csv_stream, path, 3, stream_rows, stream_result);
+    double mmap_secs = time_loader(load_csv_mmap, path, 3, mmap_rows, mmap_result);
+
+    bool parity = stream_result.valid_rows == mmap_result.valid_rows &&
+                  stream_result.skipped_rows == mmap_result.skipped_rows &&
+                  same_rows(stream_rows, mmap_rows);
+
+    printf("file: %s (%.1f MB)\n", path.c_str(), mb);
+    printf("rows: valid=%d skipped=%d\n", mmap_result.valid_rows, mmap_result.skipped_rows);
+    if (rows > 0 && mmap_result.valid_rows != market_valid_rows(rows)) {
+        printf("expected %ld valid rows of the %ld generated\n", market_valid_rows(rows), rows);
+        parity = false;
+    }
+    printf("getline/stringstream: %8.3f s  %8.1f MB/s\n", stream_secs, mb / stream_secs);
+    printf("mmap tokenizer:       %8.3f s  %8.1f MB/s  (%.1fx)\n", mmap_secs, mb / mmap_secs, stream_secs / mmap_secs);
+
+    for (unsigned int threads = 1; threads <= max_threads; threads++) {
+        thread_pool pool(threads);
+        dynamic_array<StockData> parallel_rows(50, StockData());
+        CsvLoadResult parallel_result;
+        double secs = time_loader([&pool](const string& p, dynamic_array<StockData>& out, CsvLoadResult& res) {
+            return load_csv_parallel(p, out, res, pool);
+        }, path, 3, parallel_rows, parallel_result);
+
+        bool same = parallel_result.valid_rows == stream_result.valid_rows &&
+                    parallel_result.skipped_rows == stream_result.skipped_rows &&
+                    same_rows(stream_rows, parallel_rows);
+        parity = parity && same;
+        printf("parallel x%-2u:          %8.3f s  %8.1f MB/s  (%.2fx vs mmap)%s\n", threads, secs, mb / secs,
+               mmap_secs / secs, same ? "" : "  MISMATCH");
+    }
+
+    printf("parity: %s\n", parity ? "identical" : "MISMATCH");
+    return parity ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+// bench_monte_carlo.cpp - Monte Carlo path simulation: Philox throughput, determinism and accuracy
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_monte_carlo.cpp -o bench_monte_carlo
+// Usage: ./bench_monte_carlo [paths] [horizon]
+//
+// Checks the Philox4x32-10 generator against the Random123 known-answer
+// vectors at every SIMD level, then simulates `paths` paths (default
+// 1,048,576) of `horizon` bars (default 20) from a synthetic random-walk
+// history, with GBM and with the bootstrap, at every SIMD level on one
+// thread and on all cores (at least four threads). Every run must give
+// bit-identical bands and VaR/CVaR. The GBM quantiles, VaR and CVaR are
+// compared with the lognormal closed forms for the fitted drift and
+// volatility. The run passes if the generator matches, all runs agree and
+// the GBM figures are within 1% of the analytic values (relative to the
+// price, or of the 95% VaR for the tail figures).
+
+#include "../monte_carlo.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+template <typename Fn>
+static double best_of(int runs, Fn fn) {
+    double best = 1e300;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (secs < best) best = secs;
+    }
+    return best;
+}
+
+struct KnownAnswer {
+    uint32_t counter[4];
+    uint32_t key[2];
+    uint32_t expected[4];
+};
+
+static const KnownAnswer KNOWN_ANSWERS[3] = {
+    { { 0, 0, 0, 0 }, { 0, 0 }, { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+    { { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }, { 0xffffffff, 0xffffffff },
+      { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+    { { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, { 0xa4093822, 0x299f31d0 },
+      { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+};
+
+// The vector generators take the middle words from a 64-bit path index, so
+// each vector is placed in the lane whose path gives those words.
+static bool known_answers_match(SimdLevel level) {
+    for (int v = 0; v < 3; v++) {
+        const KnownAnswer& ka = KNOWN_ANSWERS[v];
+        uint64_t path = ka.counter[1] | static_cast<uint64_t>(ka.counter[2]) << 32;
+        uint32_t out[4][MC_LANES];
+        for (unsigned int lane = 0; lane < MC_LANES; lane++) {
+            philox_lanes(ka.counter[0], path - lane, ka.counter[3], ka.key, out, level);
+            for (int w = 0; w < 4; w++) {
+                if (out[w][lane] != ka.expected[w]) return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool same_result(const MonteCarloResult& a, const MonteCarloResult& b) {
+    if (a.var != b.var || a.cvar != b.cvar || a.expected_return != b.expected_return) return false;
+    for (int q = 0; q < MC_QUANTILE_COUNT; q++) {
+        for (unsigned int h = 0; h < a.horizon; h++) {
+            if (a.bands[q][h] != b.bands[q][h]) return false;
+        }
+    }
+    return true;
+}
+
+static double normal_cdf(double z) {
+    return 0.5 * erfc(-z / sqrt(2.0));
+}
+
+// Standard normal quantiles of MC_QUANTILES and of the 5% tail
+static const double NORMAL_QUANTILES[MC_QUANTILE_COUNT] = { -1.6448536269514722, -0.6744897501960817, 0.0,
+                                                            0.6744897501960817, 1.6448536269514722 };
+
+int main(int argc, char *argv[]) {
+    unsigned int paths = argc > 1 ? static_cast<unsigned int>(atol(argv[1])) : MC_DEFAULT_PATHS;
+    unsigned int horizon = argc > 2 ? static_cast<unsigned int>(atol(argv[2])) : MC_DEFAULT_HORIZON;
+    if (paths < 10000) paths = 10000;
+    if (horizon < 1 || horizon > MC_MAX_HORIZON) horizon = MC_DEFAULT_HORIZON;
+    const int runs = 3;
+    bool ok = true;
+
+    SimdLevel best_level = detect_simd_level();
+    printf("Philox4x32-10 known answers:");
+    for (int level = SIMD_SCALAR; level <= best_level; level++) {
+        bool match = known_answers_match(static_cast<SimdLevel>(level));
+        printf("  %s %s", simd_level_name(static_cast<SimdLevel>(level)), match ? "ok" : "WRONG");
+        ok = ok && match;
+    }
+    printf("\n");
+
+    // Raw generator throughput: 128 bits per counter
+    const uint32_t key[2] = { 42, 0 };
+    const unsigned int blocks = 1 << 21;
+    for (int level = SIMD_SCALAR; level <= best_level; level++) {
+        uint32_t out[4][MC_LANES];
+        volatile uint32_t sink = 0;
+        double secs = best_of(runs, [&]() {
+            uint32_t acc = 0;
+            for (unsigned int b = 0; b < blocks; b += MC_LANES) {
+                philox_lanes(0, b, 0, key, out, static_cast<SimdLevel>(level));
+                acc ^= out[0][0] ^ out[3][MC_LANES - 1];
+            }
+            sink = acc;
+        });
+        (void)sink;
+        printf("  philox %-6s  %6.2f ns/block  %6.2f GB/s\n", simd_level_name(static_cast<SimdLevel>(level)),
+               secs * 1e9 / blocks, blocks * 16.0 / secs / 1e9);
+    }
+
+    // Two years of daily closes: a random walk with 0.04% drift and 1.5%
+    // volatility per bar, from the generator itself
+    vector<double> close(504);
+    close[0] = 100;
+    for (size_t t = 1; t < close.size(); t++) {
+        uint32_t counter[4] = { static_cast<uint32_t>(t), 0, 0, 7 }, words[4];
+        philox4x32(counter, key, words);
+        double z = sqrt(-2 * log(philox_uniform(words[0]))) * cos(6.283185307179586 * philox_uniform(words[1]));
+        close[t] = close[t - 1] * exp(0.0004 + 0.015 * z);
+    }
+
+    // At least four threads, so the split into tasks differs from one thread's
+    // even on a small machine
+    thread_pool one(1), all(max(4u, thread_pool::default_thread_count()));
+    printf("\n%u paths x %u bars, %u hardware threads\n", paths, horizon, thread_pool::default_thread_count());
+    for (int m = 0; m < 2; m++) {
+        MonteCarloOptions options;
+        options.model = m == 0 ? MC_GBM : MC_BOOTSTRAP;
+        options.paths = paths;
+        options.horizon = horizon;
+        MonteCarloResult reference;
+        bool have_reference = false, identical = true;
+        for (int level = SIMD_SCALAR; level <= best_level; level++) {
+            for (int threads = 0; threads < 2; threads++) {
+                thread_pool& pool = threads ? all : one;
+                MonteCarloResult result;
+                double secs = best_of(runs, [&]() {
+                    run_monte_carlo(close.data(), static_cast<unsigned int>(close.size()), options, result, &pool,
+                                    static_cast<SimdLevel>(level));
+                });
+                printf("  %-9s %-6s %2u thread%s  %8.2f ms  %6.2f ns/path-step\n", m == 0 ? "gbm" : "bootstrap",
+                       simd_level_name(static_cast<SimdLevel>(level)), pool.size(), pool.size() == 1 ? " " : "s",
+                       secs * 1e3, secs * 1e9 / (static_cast<double>(paths) * horizon));
+                if (!have_reference) {
+                    reference = result;
+                    have_reference = true;
+                } else {
+                    identical = identical && same_result(reference, result);
+                }
+            }
+        }
+        printf("  bit-identical across levels and threads: %s\n", identical ? "yes" : "NO");
+        ok = ok && identical && reference.ok;
+
+        const MonteCarloResult& r = reference;
+        unsigned int last = r.horizon - 1;
+        printf("  fit: drift %.5f, volatility %.5f per bar; last close %.2f\n", r.drift, r.volatility, r.last_close);
+        printf("  bands at %u bars:", r.horizon);
+        for (int q = 0; q < MC_QUANTILE_COUNT; q++) printf(" p%02.0f %.2f", MC_QUANTILES[q] * 100, r.band(q, last));
+        printf("\n  %.0f%% VaR %.2f%%  CVaR %.2f%%  expected return %+.2f%%\n", (1 - r.tail) * 100, r.var * 100,
+               r.cvar * 100, r.expected_return * 100);
+        if (m != 0) continue;
+
+        // Lognormal closed forms for the fitted drift and volatility
+        double mu = r.drift * r.horizon, sigma = r.volatility * sqrt(static_cast<double>(r.horizon));
+        double worst = 0;
+        for (int q = 0; q < MC_QUANTILE_COUNT; q++) {
+            double exact = r.last_close * exp(mu + sigma * NORMAL_QUANTILES[q]);
+            worst = max(worst, fabs(r.band(q, last) / exact - 1));
+        }
+        double exact_var = -expm1(mu + sigma * NORMAL_QUANTILES[0]);
+        double exact_cvar = 1 - exp(mu + sigma * sigma / 2) * normal_cdf(NORMAL_QUANTILES[0] - sigma) / r.tail;
+        double exact_mean = expm1(mu + sigma * sigma / 2);
+        double var_error = fabs(r.var - exact_var) / exact_var, cvar_error = fabs(r.cvar - exact_cvar) / exact_var;
+        double mean_error = fabs(r.expected_return - exact_mean);
+        printf("  analytic: VaR %.2f%%  CVaR %.2f%%  expected return %+.2f%%\n", exact_var * 100, exact_cvar * 100,
+               exact_mean * 100);
+        printf("  worst band error %.3f%%, VaR %.3f%%, CVaR %.3f%%, mean %.3f points  %s\n", worst * 100,
+               var_error * 100, cvar_error * 100, mean_error * 100,
+               worst < 0.01 && var_error < 0.01 && cvar_error < 0.01 && mean_error < 0.001 ? "ok" : "WRONG");
+        ok = ok && worst < 0.01 && var_error < 0.01 && cvar_error < 0.01 && mean_error < 0.001;
+    }
+
+    printf("\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+// bench_param_search.cpp - SIMD alpha sweep and threaded parameter search
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_param_search.cpp -o bench_param_search
+// Usage: ./bench_param_search [bars] [max_threads]
+//
+// Sweeps 64 EMA alphas over a random walk at every SIMD level and checks
+// each lane against the scalar walk-forward run, then times the full
+// default grid search (lookbacks, windows, alphas with refinement, AR
+// orders, Holt-Winters alphas) on
+// 1..max_threads threads and prints the chosen parameters.
+
+#include "../param_search.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+static bool same_accuracy(const ForecastAccuracy& a, const ForecastAccuracy& b) {
+    return a.forecasts == b.forecasts && a.pct_forecasts == b.pct_forecasts && a.direction_calls == b.direction_calls &&
+           a.direction_hits == b.direction_hits && ulp_distance(a.sum_abs_error, b.sum_abs_error) <= 4 &&
+           ulp_distance(a.sum_sq_error, b.sum_sq_error) <= 4 && ulp_distance(a.sum_abs_pct_error, b.sum_abs_pct_error) <= 4;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int bars = argc > 1 ? static_cast<unsigned int>(atol(argv[1])) : 2000000;
+    unsigned int max_threads = argc > 2 ? static_cast<unsigned int>(atoi(argv[2])) : thread_pool::default_thread_count();
+    if (bars < 100) bars = 100;
+    if (max_threads < 1) max_threads = 1;
+
+    PriceSeries series;
+    series.reserve(bars);
+    unsigned long long seed = 17;
+    double price = 100.0;
+    for (unsigned int i = 0; i < bars; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double step = (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5) * 2.0;
+        price = price + step > 1.0 ? price + step : price;
+        series.add(static_cast<int32_t>(i), price, price, price, price, 1000);
+    }
+
+    vector<double> alphas;
+    for (int i = 1; i <= 64; i++) alphas.push_back(i / 65.0);
+    unsigned int score_from = 50;
+
+    vector<ForecastAccuracy> reference(alphas.size());
+    bool ok = true;
+    SimdLevel levels[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+    double scalar_secs = 0;
+    for (int l = 0; l < 3; l++) {
+        SimdLevel level = levels[l];
+        if (level > detect_simd_level()) continue;
+        unsigned int lanes = ema_sweep_lanes(level);
+        vector<ForecastAccuracy> results(alphas.size());
+        auto start = chrono::steady_clock::now();
+        for (unsigned int first = 0; first < alphas.size(); first += lanes) {
+            unsigned int count = min(lanes, static_cast<unsigned int>(alphas.size()) - first);
+            ema_sweep_group(series.close, series.size, &alphas[first], count, score_from, &results[first], level);
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (level == SIMD_SCALAR) {
+            scalar_secs = secs;
+            reference = results;
+        }
+        int mismatches = 0;
+        for (size_t k = 0; k < alphas.size(); k++) {
+            if (!same_accuracy(results[k], reference[k])) mismatches++;
+        }
+        ok = ok && mismatches == 0;
+        printf("%-6s %2u alphas/pass: %8.3f s for %zu alphas (%.2f ns per alpha-bar, %.1fx)  %d mismatches\n",
+               simd_level_name(level), lanes, secs, alphas.size(), secs * 1e9 / (alphas.size() * double(bars)),
+               scalar_secs / secs, mismatches);
+    }
+
+    // The scalar sweep itself must agree with the IncrementalPredictor walk
+    ForecastAccuracy walk = walk_forward_model(series, EXPONENTIAL_SMOOTHING, ModelParams(SMA_PERIOD, alphas[7]), score_from);
+    if (!same_accuracy(walk, reference[7])) {
+        printf("scalar sweep differs from walk_forward_model\n");
+        ok = false;
+    }
+
+    SearchGrid grid = default_search_grid();
+    double single = 0;
+    for (unsigned int threads = 1; threads <= max_threads; threads++) {
+        thread_pool pool(threads);
+        auto start = chrono::steady_clock::now();
+        SearchResult result = search_parameters(series, grid, &pool);
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (threads == 1) single = secs;
+        printf("grid search, threads %2u: %8.3f s  speedup %.2fx  best lookback %u, window %d, alpha %.4f, order %d, "
+               "holt alpha %.1f\n", threads, secs, single / secs, result.best.regression_lookback, result.best.sma_period,
+               result.best.ema_alpha, result.best.ar_order, result.best.holt_alpha);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// bench_pipeline.cpp - SPSC ring throughput and follow-mode ingest under a stalling renderer
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_pipeline.cpp -o bench_pipeline
+// Usage: ./bench_pipeline [bars_per_second] [seconds] [history_rows] [stall_ms]
+//
+// Part one moves 10M integers between two threads through spsc_ring and
+// through a mutex-guarded deque, checking that every value arrives in order.
+//
+// Part two runs the IngestPipeline that hd --follow uses: a writer thread
+// appends bars to a CSV at a fixed rate while the main thread plays the
+// render loop, draining bars every 16 ms but sleeping `stall_ms` on every
+// 60th frame. Write -> prediction latency (the model thread's publish time)
+// should not notice the stalls; write -> drawn latency will. The run passes
+// if every bar arrives once and in order, write -> prediction p99 stays under
+// a millisecond, and the final snapshot's regression matches a full
+// recompute over the grown series.
+
+#include "../ingest_pipeline.hpp"
+#include "synthetic_csv.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static double percentile(vector<double>& values, double p) {
+    if (values.empty()) return 0;
+    sort(values.begin(), values.end());
+    return values[min(values.size() - 1, static_cast<size_t>(values.size() * p))];
+}
+
+static void bench_rings() {
+    const unsigned long long count = 10000000;
+
+    spsc_ring<unsigned long long> ring(4096);
+    bool ordered = true;
+    long long start = pipeline_now_ns();
+    thread producer([&]() {
+        for (unsigned long long i = 0; i < count; i++) {
+            while (!ring.try_push(i)) this_thread::yield();
+        }
+    });
+    unsigned long long value;
+    for (unsigned long long i = 0; i < count; i++) {
+        while (!ring.try_pop(value)) this_thread::yield();
+        if (value != i) ordered = false;
+    }
+    producer.join();
+    double ring_s = (pipeline_now_ns() - start) / 1e9;
+
+    mutex lock;
+    deque<unsigned long long> queue;
+    bool locked_ordered = true;
+    start = pipeline_now_ns();
+    thread locked_producer([&]() {
+        for (unsigned long long i = 0; i < count; i++) {
+            lock_guard<mutex> guard(lock);
+            queue.push_back(i);
+        }
+    });
+    for (unsigned long long i = 0; i < count;) {
+        lock_guard<mutex> guard(lock);
+        while (!queue.empty()) {
+            if (queue.front() != i) locked_ordered = false;
+            queue.pop_front();
+            i++;
+        }
+    }
+    locked_producer.join();
+    double locked_s = (pipeline_now_ns() - start) / 1e9;
+
+    printf("spsc_ring:     %6.1f M items/s (%s)\n", count / ring_s / 1e6, ordered ? "in order" : "OUT OF ORDER");
+    printf("mutex + deque: %6.1f M items/s (%s)\n", count / locked_s / 1e6, locked_ordered ? "in order" : "OUT OF ORDER");
+}
+
+int main(int argc, char *argv[]) {
+    double rate = argc > 1 ? atof(argv[1]) : 10000;
+    double seconds = argc > 2 ? atof(argv[2]) : 3;
+    long history = argc > 3 ? atol(argv[3]) : 100000;
+    int stall_ms = argc > 4 ? atoi(argv[4]) : 200;
+    if (rate <= 0) rate = 10000;
+    unsigned int total = static_cast<unsigned int>(rate * seconds);
+    if (total < 1) total = 1;
+
+    bench_rings();
+
+    const string path = "bench_pipeline.csv";
+    if (!write_synthetic_csv(path, history)) {
+        printf("cannot write %s\n", path.c_str());
+        return 1;
+    }
+    StockPredictor predictor;
+    CsvLoadResult loaded;
+    load_stock_file(predictor, path, loaded, 1);
+    prepare_follow(predictor);
+
+    IngestPipeline pipeline;
+    if (!pipeline.start(path, loaded.source_bytes, predictor.series, predictor.params, predictor.confidence)) {
+        printf("cannot follow %s\n", path.c_str());
+        return 1;
+    }
+
+    vector<long long> written(total);
+    vector<double> closes(total);
+    thread writer([&]() {
+        int fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+        if (fd < 0) return;
+        double price = predictor.series.close[predictor.series.size - 1];
+        unsigned long long seed = 7;
+        auto start = chrono::steady_clock::now();
+        char line[128];
+        for (unsigned int i = 0; i < total; i++) {
+            this_thread::sleep_until(start + chrono::nanoseconds(static_cast<long long>(i * 1e9 / rate)));
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            double step = (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5) * 2.0;
+            price = price + step > 1.0 ? price + step : price;
+            int day = static_cast<int>(i % 28) + 1;
+            int month = static_cast<int>((i / 28) % 12) + 1;
+            int year = 2025 + static_cast<int>(i / 336);
+            char close_text[32];
+            snprintf(close_text, sizeof(close_text), "%.2f", price);
+            closes[i] = atof(close_text);
+            int length = snprintf(line, sizeof(line), "%02d/%02d/%04d,\"%.2f\",\"%.2f\",\"%.2f\",\"%s\",\"1,000,000\"\n",
+                                  month, day, year, price - step / 2, price + 1.25, price - step / 2 - 1.25, close_text);
+            written[i] = pipeline_now_ns();
+            if (::write(fd, line, length) != length) break;
+        }
+        ::close(fd);
+    });
+
+    // The render loop: 16 ms frames with a long one about once a second
+    vector<LiveBar> bars;
+    vector<double> to_model_us, to_drawn_us;
+    size_t received = 0;
+    bool ordered = true;
+    int frames = 0, stalls = 0;
+    long long deadline = pipeline_now_ns() + static_cast<long long>((seconds + 5) * 1e9);
+    auto next_frame = chrono::steady_clock::now();
+    while (received < total && pipeline_now_ns() < deadline) {
+        next_frame += chrono::milliseconds(16);
+        this_thread::sleep_until(next_frame);
+        bars.clear();
+        pipeline.drain(bars);
+        long long drawn = pipeline_now_ns();
+        for (size_t b = 0; b < bars.size(); b++, received++) {
+            if (received >= total || bars[b].close != closes[received]) {
+                ordered = false;
+                continue;
+            }
+            const LiveBar& bar = bars[b];
+            add_followed_bar(predictor.series, bar);
+            to_model_us.push_back((bar.modeled_ns - written[received]) / 1e3);
+            to_drawn_us.push_back((drawn - written[received]) / 1e3);
+        }
+        if (++frames % 60 == 0) {
+            this_thread::sleep_for(chrono::milliseconds(stall_ms));
+            next_frame = chrono::steady_clock::now();
+            stalls++;
+        }
+    }
+    writer.join();
+
+    ModelSnapshot snapshot;
+    while (pipeline.bars_modeled.load() < received && pipeline_now_ns() < deadline) this_thread::yield();
+    pipeline.latest(snapshot);
+    pipeline.stop();
+    remove(path.c_str());
+
+    printf("%ld history rows, %u bars at %.0f bars/s, %d frames with %d stalls of %d ms\n", history, total, rate,
+           frames, stalls, stall_ms);
+    printf("%s\n", pipeline.summary().c_str());
+    double model_p50 = percentile(to_model_us, 0.5), model_p99 = percentile(to_model_us, 0.99);
+    double drawn_p50 = percentile(to_drawn_us, 0.5), drawn_p99 = percentile(to_drawn_us, 0.99);
+    printf("write -> prediction: p50 %.1f us, p99 %.1f us, max %.1f us\n", model_p50, model_p99,
+           to_model_us.empty() ? 0 : to_model_us.back());
+    printf("write -> drawn:      p50 %.1f us, p99 %.1f us, max %.1f us\n", drawn_p50, drawn_p99,
+           to_drawn_us.empty() ? 0 : to_drawn_us.back());
+
+    RegressionFit full = fit_from_sums(regression_sums(predictor.series.close, predictor.series.size));
+    double drift = fabs(snapshot.stats[LINEAR_REGRESSION].slope - full.slope) / max(fabs(full.slope), 1e-12);
+    printf("received %zu of %u (%s), snapshot covers %llu bars, slope vs full recompute: %.2e\n", received, total,
+           ordered ? "in order" : "OUT OF ORDER", snapshot.bars, drift);
+
+    bool ok = received == total && ordered && snapshot.bars == predictor.series.size && model_p99 < 1000 &&
+              drift < 1e-9;
+    return ok ? 0 : 1;
+}
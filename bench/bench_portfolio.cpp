@@ -0,0 +1,105 @@
+// bench_portfolio.cpp - Opening a many-ticker portfolio: first parse vs. binary cache, and arena footprint
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_portfolio.cpp -o bench_portfolio
+// Usage: ./bench_portfolio [files] [rows_per_file] [threads]
+//
+// Writes a universe of synthetic tickers (default 500 x 2,520 daily bars, ten
+// years each), loads it with load_portfolio once from CSV (writing the
+// caches) and then again from the caches, the way hd opens a directory. The
+// run passes if the cached open takes under a second and the arena stays
+// within PORTFOLIO_BYTES_PER_BAR per bar plus one cache line per column, and
+// reports what separately grown per-ticker columns would have held instead.
+
+#include "../portfolio.hpp"
+#include "synthetic_csv.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static double peak_rss_mb() {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    int file_count = argc > 1 ? atoi(argv[1]) : 500;
+    long rows = argc > 2 ? atol(argv[2]) : 2520;
+    unsigned int threads = argc > 3 ? static_cast<unsigned int>(atoi(argv[3])) : thread_pool::default_thread_count();
+    if (file_count < 1) file_count = 1;
+    if (threads < 1) threads = 1;
+
+    string dir = "/tmp/bench_portfolio_universe";
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+    vector<string> files;
+    for (int i = 0; i < file_count; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "/STOCK_US_XNAS_P%05d.csv", i);
+        string path = dir + name;
+        remove(cache_path_for(path).c_str());
+        if (!write_synthetic_csv(path, rows, 2000 + i)) {
+            fprintf(stderr, "Cannot write %s\n", path.c_str());
+            return 1;
+        }
+        files.push_back(path);
+    }
+
+    thread_pool pool(threads);
+    ScoreOptions options;
+    options.cache = CacheOptions();
+    printf("universe: %d files x %ld rows, %u threads\n", file_count, rows, threads);
+
+    double cached_s = 0;
+    Portfolio portfolio;
+    for (int pass = 0; pass < 2; pass++) {
+        load_portfolio(files, portfolio, pool, options);
+        cached_s = portfolio.load_seconds;
+        printf("%-12s %8.3f s  %llu bars\n", pass == 0 ? "from CSV:" : "from cache:", portfolio.load_seconds,
+               portfolio.bars);
+    }
+
+    size_t loaded = 0;
+    double grown_bytes = 0;
+    for (size_t i = 0; i < portfolio.size(); i++) {
+        if (portfolio.tickers[i].score.loaded) loaded++;
+        unsigned int capacity = 64;
+        while (capacity < portfolio.series[i].size) capacity *= 2;
+        grown_bytes += static_cast<double>(capacity) * PORTFOLIO_BYTES_PER_BAR;
+    }
+    double budget = static_cast<double>(portfolio.bars) * PORTFOLIO_BYTES_PER_BAR + portfolio.size() * 6.0 * SERIES_ALIGNMENT;
+    printf("arena: %.1f MB used (budget %.1f MB), %.1f MB reserved in %zu blocks\n", portfolio.arena.used() / 1048576.0,
+           budget / 1048576.0, portfolio.arena.reserved() / 1048576.0, portfolio.arena.block_count());
+    printf("separately grown columns would hold %.1f MB in %zu allocations\n", grown_bytes / 1048576.0,
+           portfolio.size() * 6);
+    printf("peak RSS: %.1f MB\n", peak_rss_mb());
+
+    vector<unsigned int> order;
+    auto start = chrono::steady_clock::now();
+    sort_portfolio(portfolio, SORT_CHANGE, LINEAR_REGRESSION, true, order);
+    double sort_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    const PortfolioTicker& top = portfolio.tickers[order[0]];
+    printf("sort by predicted change: %.0f us, top %s %+.2f%%\n", sort_us, top.score.company.c_str(),
+           top.change_pct[LINEAR_REGRESSION]);
+
+    bool ok = loaded == portfolio.size() && cached_s < 1.0 && portfolio.arena.used() <= budget;
+    return ok ? 0 : 1;
+}
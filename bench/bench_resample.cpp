@@ -0,0 +1,282 @@
+// bench_resample.cpp - Streaming OHLCV resampling, the timeframe cascade and day partitions
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_resample.cpp -o bench_resample
+// Usage: ./bench_resample [rows] [dir]
+//
+// Writes a newest-first file of `rows` one-minute bars (default 1,000,000)
+// and resamples it to hourly bars in one streamed pass, reporting GB/s and
+// the bytes allocated against the size of the file, next to loading the
+// whole file first. The streamed bars, the 1m -> 5m -> 1h -> 1d -> 1w
+// cascade of build_resolutions and a BarResampler fed every bucket in two
+// pieces must equal resample_series on the loaded history. The file is then
+// split into day partitions under `dir` (default the current directory):
+// four whole weeks, and a range from a Wednesday to the Tuesday of the week
+// after next, are loaded at every timeframe and compared with the same
+// slices resampled in memory (weekly bars of a partial week hold only its
+// days in the range). The whole weeks are loaded again after every day file
+// outside them has been truncated, which only works if none is opened. A
+// trades file (time, price, size) that visits every day twice goes through
+// the same partition round trip. `dir` is created if missing. PASS if
+// everything matches.
+
+#include "../allocation_hook.hpp"
+#include "../day_partitions.hpp"
+#include "synthetic_csv.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+template <typename Fn>
+static double best_of(int runs, Fn fn) {
+    double best = 1e300;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (secs < best) best = secs;
+    }
+    return best;
+}
+
+static bool same_bars(const PriceSeries& a, const PriceSeries& b) {
+    if (a.size != b.size) return false;
+    for (unsigned int i = 0; i < a.size; i++) {
+        if (a.time[i] != b.time[i] || a.open[i] != b.open[i] || a.high[i] != b.high[i] || a.low[i] != b.low[i] ||
+            a.close[i] != b.close[i] || a.volume[i] != b.volume[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const char *verdict(bool ok) {
+    return ok ? "ok" : "WRONG";
+}
+
+// Compares a loaded partition range with `expected` (the raw rows of the
+// range) resampled in memory, for every timeframe the set offers.
+static bool range_matches(const ResolutionSet& set, const PriceSeries& shown, const PriceSeries& expected) {
+    bool ok = same_bars(shown, expected) && set.rows[TIMEFRAME_RAW] == expected.size;
+    for (int t = TIMEFRAME_1M; t < TIMEFRAME_COUNT && ok; t++) {
+        PriceSeries direct;
+        ok = resample_series(expected, timeframe_period(static_cast<Timeframe>(t)), direct);
+        if (direct.size < expected.size) {
+            ok = ok && set.available(static_cast<Timeframe>(t)) && same_bars(set.bars[t], direct);
+        } else {
+            ok = ok && !set.available(static_cast<Timeframe>(t));
+        }
+    }
+    return ok;
+}
+
+// Bars of days [from_day, to_day] of a chronological series.
+static void day_slice(const PriceSeries& series, int32_t from_day, int32_t to_day, PriceSeries& slice) {
+    const int64_t *begin = lower_bound(series.time, series.time + series.size,
+                                       static_cast<int64_t>(from_day) * SECONDS_PER_DAY);
+    const int64_t *end = lower_bound(series.time, series.time + series.size,
+                                     static_cast<int64_t>(to_day + 1) * SECONDS_PER_DAY);
+    slice.clear();
+    slice.append(series, static_cast<unsigned int>(begin - series.time), static_cast<unsigned int>(end - series.time));
+}
+
+static void remove_partitions(const string& dir, const PartitionManifest& manifest) {
+    for (size_t i = 0; i < manifest.days.size(); i++) remove(day_partition_path(dir, manifest.days[i]).c_str());
+    remove((dir + "/" + PARTITION_HISTORY).c_str());
+    remove((dir + "/" + PARTITION_MANIFEST).c_str());
+    remove(dir.c_str());
+}
+
+// Trades on `days` weekdays, about three a second from 09:30, written as
+// the first half of every day and then the second half, so each day is
+// seen twice. Sizes are whole shares, so volume sums are exact.
+static bool write_trades_csv(const string& path, int days, int per_day) {
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "Time,Price,Size\n");
+    unsigned long long seed = 11;
+    int32_t first_day = days_from_civil(2024, 6, 3);    // a Monday
+    for (int half = 0; half < 2; half++) {
+        for (int d = 0; d < days; d++) {
+            int32_t day = first_day + d / 5 * 7 + d % 5;
+            for (int k = half * per_day / 2; k < (half + 1) * per_day / 2; k++) {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                int64_t time = static_cast<int64_t>(day) * SECONDS_PER_DAY + 9 * 3600 + 1800 + k / 3;
+                double price = 100 + static_cast<double>((seed >> 33) % 2000) / 100;
+                double size = static_cast<double>(1 + (seed >> 20) % 500);
+                int year, month, date;
+                civil_from_days(day, year, month, date);
+                fprintf(f, "%04d-%02d-%02d %02d:%02d:%02d,%.2f,%.0f\n", year, month, date,
+                        static_cast<int>(time % SECONDS_PER_DAY / 3600), static_cast<int>(time % 3600 / 60),
+                        static_cast<int>(time % 60), price, size);
+            }
+        }
+    }
+    return fclose(f) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    long rows = argc > 1 ? atol(argv[1]) : 1000000;
+    string dir = argc > 2 ? argv[2] : ".";
+    if (rows < 20000) rows = 20000;
+    const int runs = 3;
+    bool ok = true;
+
+    if (!make_directory(dir)) {
+        printf("Cannot create %s\n", dir.c_str());
+        return 1;
+    }
+    string csv = dir + "/bench_resample_minutes.csv";
+    if (!write_market_csv(csv, rows, 42, MARKET_MINUTE)) {
+        printf("Cannot write %s\n", csv.c_str());
+        return 1;
+    }
+
+    // Whole file in memory, the reference for everything below
+    StockPredictor predictor;
+    CsvLoadResult loaded;
+    double load_secs = best_of(runs, [&]() {
+        loaded = CsvLoadResult();
+        load_stock_file(predictor, csv, loaded, 1);
+    });
+    const PriceSeries& series = predictor.series;
+    PriceSeries direct[TIMEFRAME_COUNT];
+    for (int t = TIMEFRAME_1M; t < TIMEFRAME_COUNT; t++) {
+        resample_series(series, timeframe_period(static_cast<Timeframe>(t)), direct[t]);
+    }
+    double bytes = static_cast<double>(loaded.source_bytes);
+    printf("%ld minute bars, %.1f MB, %u kept, %u days\n", rows, bytes / 1e6, series.size, direct[TIMEFRAME_1D].size);
+
+    // One streamed pass to hourly bars
+    BarResampler hourly(timeframe_period(TIMEFRAME_1H));
+    CsvLoadResult streamed;
+    unsigned long long stream_bytes = 0, stream_allocations = 0;
+    double stream_secs = best_of(runs, [&]() {
+        unsigned long long count = allocation_count().load(), total = allocation_bytes().load();
+        hourly.clear();
+        streamed = CsvLoadResult();
+        stream_csv_rows(csv, streamed, [&](const StockData& row) {
+            hourly.add(row.time, row.open, row.high, row.low, row.close, row.volume);
+        });
+        hourly.finish();
+        stream_allocations = allocation_count().load() - count;
+        stream_bytes = allocation_bytes().load() - total;
+    });
+    double resample_secs = best_of(runs, [&]() {
+        PriceSeries bars;
+        resample_series(series, timeframe_period(TIMEFRAME_1H), bars);
+    });
+    bool stream_ok = same_bars(hourly.bars, direct[TIMEFRAME_1H]) && streamed.valid_rows == loaded.valid_rows;
+    bool bounded = stream_bytes < 2 * CSV_STREAM_BUFFER_BYTES + bytes / 16;
+    printf("  streamed to 1h    %8.2f ms  %6.2f GB/s  %llu allocations, %.2f MB (%.1f%% of the file)  %s\n",
+           stream_secs * 1e3, bytes / stream_secs / 1e9, stream_allocations, stream_bytes / 1e6,
+           100.0 * stream_bytes / bytes, stream_ok && bounded ? "ok" : "WRONG");
+    printf("  load, then 1h     %8.2f ms  %6.2f GB/s  (resample alone %.2f ms)\n", (load_secs + resample_secs) * 1e3,
+           bytes / (load_secs + resample_secs) / 1e9, resample_secs * 1e3);
+    ok = ok && stream_ok && bounded;
+
+    // Cascade against resampling the raw bars for every timeframe
+    ResolutionSet set;
+    double cascade_secs = best_of(runs, [&]() { build_resolutions(series, set); });
+    double separate_secs = best_of(runs, [&]() {
+        PriceSeries bars;
+        for (int t = TIMEFRAME_1M; t < TIMEFRAME_COUNT; t++) {
+            resample_series(series, timeframe_period(static_cast<Timeframe>(t)), bars);
+        }
+    });
+    bool cascade_ok = !set.available(TIMEFRAME_1M);
+    for (int t = TIMEFRAME_5M; t < TIMEFRAME_COUNT; t++) cascade_ok = cascade_ok && same_bars(set.bars[t], direct[t]);
+    printf("  cascade           %8.2f ms  (each from raw %.2f ms)  %s\n", cascade_secs * 1e3, separate_secs * 1e3,
+           verdict(cascade_ok));
+    ok = ok && cascade_ok;
+
+    // Every hour in two pieces: the even rows, then the odd ones
+    BarResampler split(timeframe_period(TIMEFRAME_1H));
+    for (int pass = 0; pass < 2; pass++) {
+        for (unsigned int i = pass; i < series.size; i += 2) {
+            split.add(series.time[i], series.open[i], series.high[i], series.low[i], series.close[i], series.volume[i]);
+        }
+    }
+    split.finish();
+    bool split_ok = same_bars(split.bars, direct[TIMEFRAME_1H]);
+    printf("  split buckets     %s\n", verdict(split_ok));
+    ok = ok && split_ok;
+
+    // Day partitions: write, then four whole weeks from the middle
+    string parts = dir + "/bench_resample_parts";
+    PartitionManifest manifest;
+    CsvLoadResult written;
+    double write_secs = best_of(1, [&]() { write_day_partitions(csv, parts, written, &manifest); });
+    printf("\n  partitions        %8.2f ms  %6.2f GB/s  %zu days\n", write_secs * 1e3, bytes / write_secs / 1e9,
+           manifest.days.size());
+    ok = ok && manifest.days.size() == direct[TIMEFRAME_1D].size && written.valid_rows == loaded.valid_rows;
+
+    int64_t week = bucket_start(series.time[series.size / 2], timeframe_period(TIMEFRAME_1W));
+    int32_t from_day = epoch_day(week), to_day = from_day + 27;
+    PriceSeries slice;
+    day_slice(series, from_day, to_day, slice);
+
+    ResolutionSet range;
+    PriceSeries shown;
+    PartitionManifest read_back;
+    double range_secs = best_of(runs, [&]() { load_partition_range(parts, from_day, to_day, range, shown, read_back, true); });
+    bool range_ok = range_matches(range, shown, slice);
+    printf("  load %s..%s  %8.2f ms  %u bars (whole file %.2f ms)  %s\n", iso_date(from_day).c_str(),
+           iso_date(to_day).c_str(), range_secs * 1e3, shown.size, load_secs * 1e3, verdict(range_ok));
+    ok = ok && range_ok;
+
+    // Wednesday to Tuesday: partial weeks at both ends
+    PriceSeries partial;
+    day_slice(series, from_day - 5, from_day + 8, partial);
+    bool partial_ok = load_partition_range(parts, from_day - 5, from_day + 8, range, shown, read_back) &&
+                      range_matches(range, shown, partial) && range.rows[TIMEFRAME_1W] == 3;
+    printf("  load %s..%s  partial weeks, %u weekly bars  %s\n", iso_date(from_day - 5).c_str(),
+           iso_date(from_day + 8).c_str(), range.rows[TIMEFRAME_1W], verdict(partial_ok));
+    ok = ok && partial_ok;
+
+    for (size_t i = 0; i < manifest.days.size(); i++) {
+        if (manifest.days[i] < from_day || manifest.days[i] > to_day) {
+            FILE *f = fopen(day_partition_path(parts, manifest.days[i]).c_str(), "w");
+            if (f) fclose(f);
+        }
+    }
+    bool untouched = load_partition_range(parts, from_day, to_day, range, shown, read_back) &&
+                     range_matches(range, shown, slice) &&
+                     !load_partition_range(parts, INT32_MIN, INT32_MAX, range, shown, read_back);
+    printf("  only the range's day files are read: %s\n", untouched ? "yes" : "NO");
+    ok = ok && untouched;
+    remove_partitions(parts, manifest);
+
+    // Trades: three columns, several per second, every day written twice
+    string trades_csv = dir + "/bench_resample_trades.csv";
+    if (!write_trades_csv(trades_csv, 10, 60000)) {
+        printf("Cannot write %s\n", trades_csv.c_str());
+        return 1;
+    }
+    // The reference: every trade as parsed, in time order, ties in file order
+    PriceSeries trades;
+    CsvLoadResult parsed;
+    stream_csv_rows(trades_csv, parsed, [&](const StockData& row) {
+        trades.add(row.time, row.open, row.high, row.low, row.close, row.volume);
+    });
+    vector<uint32_t> order;
+    radix_sort_order(trades.time, trades.size, order);
+    trades.permute(order.data(), trades.size);
+    string trade_parts = dir + "/bench_resample_trade_parts";
+    PartitionManifest trade_manifest;
+    bool trades_ok = write_day_partitions(trades_csv, trade_parts, written, &trade_manifest) && trade_manifest.trades &&
+                     load_partition_range(trade_parts, INT32_MIN, INT32_MAX, range, shown, read_back, true) &&
+                     range_matches(range, shown, trades);
+    printf("  trades: %u in %zu days, every timeframe %s\n", trades.size, trade_manifest.days.size(),
+           verdict(trades_ok));
+    ok = ok && trades_ok;
+    remove_partitions(trade_parts, trade_manifest);
+    remove(trades_csv.c_str());
+    remove(csv.c_str());
+
+    printf("\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+// bench_series.cpp - Close-only and range scans: dynamic_array<StockData> vs. columnar PriceSeries
+//
+// Build: clang++ -O2 -std=c++11 bench/bench_series.cpp -o bench_series
+// Usage: ./bench_series [rows]
+//
+// Reports time per bar and, on Linux when perf events are permitted,
+// last-level cache misses per scan.
+
+#include "../stock_predictor.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Hardware cache-miss counter for the calling thread; reads -1 when unavailable.
+struct cache_miss_counter {
+    int fd;
+
+    cache_miss_counter() : fd(-1) {
+#ifdef __linux__
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~cache_miss_counter() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    long long stop() {
+#ifdef __linux__
+        if (fd < 0) return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+        return count;
+#else
+        return -1;
+#endif
+    }
+};
+
+static volatile double sink;
+
+template <typename Scan>
+static void run_scan(const char *name, unsigned int rows, Scan scan) {
+    cache_miss_counter misses;
+    double best = 1e300;
+    long long best_misses = -1;
+    for (int r = 0; r < 5; r++) {
+        misses.start();
+        auto start = chrono::steady_clock::now();
+        sink = scan();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        long long m = misses.stop();
+        if (secs < best) {
+            best = secs;
+            best_misses = m;
+        }
+    }
+
+    printf("%-34s %8.3f ms  %7.2f ns/bar", name, best * 1e3, best * 1e9 / rows);
+    if (best_misses >= 0) {
+        printf("  %10lld cache misses (%.3f/bar)", best_misses, static_cast<double>(best_misses) / rows);
+    } else {
+        printf("  cache misses n/a");
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int rows = argc > 1 ? static_cast<unsigned int>(atol(argv[1])) : 5000000;
+    if (rows < 2) rows = 2;
+
+    StockPredictor predictor;
+    unsigned long long seed = 7;
+    double price = 100.0;
+    for (unsigned int i = 0; i < rows; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double step = (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5);
+        price = price + step > 1.0 ? price + step : price;
+
+        StockData bar;
+        bar.time = parse_timestamp("05/23/2024") + i * SECONDS_PER_DAY;
+        bar.open = price - step;
+        bar.close = price;
+        bar.high = price + 0.5;
+        bar.low = price - 0.5;
+        bar.volume = 1e6;
+        predictor.data.add(bar);
+    }
+    build_price_series(predictor.data, predictor.series);
+
+    const dynamic_array<StockData>& data = predictor.data;
+    const PriceSeries& series = predictor.series;
+
+    printf("rows: %u  sizeof(StockData)=%zu bytes, close column=8 bytes/bar\n\n", rows, sizeof(StockData));
+
+    run_scan("close sum, dynamic_array::get", rows, [&]() {
+        double sum = 0;
+        for (unsigned int i = 0; i < data.size; i++) sum += data.get(i).close;
+        return sum;
+    });
+    run_scan("close sum, StockData by reference", rows, [&]() {
+        double sum = 0;
+        for (unsigned int i = 0; i < data.size; i++) sum += data.data[i].close;
+        return sum;
+    });
+    run_scan("close sum, PriceSeries", rows, [&]() {
+        double sum = 0;
+        for (unsigned int i = 0; i < series.size; i++) sum += series.close[i];
+        return sum;
+    });
+
+    run_scan("low/high range, dynamic_array::get", rows, [&]() {
+        double min_price = 999999, max_price = 0;
+        for (unsigned int i = 0; i < data.size; i++) {
+            min_price = std::min(min_price, data.get(i).low);
+            max_price = std::max(max_price, data.get(i).high);
+        }
+        return max_price - min_price;
+    });
+    run_scan("low/high range, PriceSeries", rows, [&]() {
+        double min_price, max_price;
+        price_range(series, min_price, max_price);
+        return max_price - min_price;
+    });
+
+    return 0;
+}
@@ -0,0 +1,342 @@
+// bench_suite.cpp - End-to-end benchmark suite on generated market data, with JSON output for comparing runs
+//
+// Build: clang++ -O2 -std=c++11 -pthread bench/bench_suite.cpp -o bench_suite
+// Usage: ./bench_suite [--rows 1K,100K,1M] [--daily] [--seed N] [--runs N] [--dir DIR] [--keep]
+//                      [--json FILE]
+//        ./bench_suite --generate FILE [--rows N] [--daily] [--seed N]
+//
+// For each row count, writes a deterministic random-walk CSV in the README
+// format (quoted prices, comma-grouped volumes, a few invalid rows; one-minute
+// bars unless --daily, see write_market_csv) and times
+//   - parse: load_stock_file on one thread and on all cores, from a warm
+//     page cache (ns/row and GB/s of CSV);
+//   - fit: calculate_predictions for every model on the loaded series;
+//   - scan: price_range (a SIMD pass over the lows and highs) and
+//     CandlePyramid::range over 1,000 windows of 1-100% of the history (the
+//     y-axis query of every frame);
+//   - render prep: building the candle pyramid, then 1,000 frames of a zoom
+//     and pan sweep that do what draw_chart does short of drawing: the y range,
+//     the visible candles at CHART_WIDTH pixels and their screen coordinates.
+// Each case reports the best of --runs runs (default 3) and the heap
+// allocations of the last one. --json writes the results in a stable schema
+// that scripts/compare_bench.py diffs against an earlier run. Row counts take
+// K/M suffixes; 100M one-minute rows is a 6 GB file and needs about 10 GB of
+// memory. Generated files go in --dir (the current directory by default,
+// created if missing) and are deleted afterwards unless --keep is given.
+// The run passes if every load keeps exactly the rows the generator wrote as
+// valid and both parsers produce the same series.
+
+#include "../allocation_hook.hpp"
+#include "../batch_scoring.hpp"
+#include "../candle_pyramid.hpp"
+#include "../csv_loader.hpp"
+#include "../frame_profiler.hpp"
+#include "../stock_predictor.hpp"
+#include "synthetic_csv.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Same geometry as hd.cpp
+static const int CHART_WIDTH = 880;
+static const double CHART_HEIGHT = 400;
+static const int SWEEP_FRAMES = 1000;
+static const int SCAN_WINDOWS = 1000;
+
+static volatile double sink;
+
+// One timed case. `items` are what ns_per_item divides by (rows, queries or
+// frames, named by `unit`); `bytes` is the data the case streams, 0 if none.
+struct BenchResult {
+    string name;
+    long rows;
+    const char *unit;
+    double items;
+    double bytes;
+    double seconds;
+    unsigned long long allocations;
+    unsigned long long alloc_bytes;
+};
+
+template <typename Fn>
+static BenchResult measure(const string& name, long rows, const char *unit, double items, double bytes, int runs, Fn fn) {
+    BenchResult r;
+    r.name = name;
+    r.rows = rows;
+    r.unit = unit;
+    r.items = items;
+    r.bytes = bytes;
+    r.seconds = 1e300;
+    r.allocations = r.alloc_bytes = 0;
+    for (int run = 0; run < runs; run++) {
+        unsigned long long count = allocation_count().load(), total = allocation_bytes().load();
+        auto start = chrono::steady_clock::now();
+        fn();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (secs < r.seconds) r.seconds = secs;
+        r.allocations = allocation_count().load() - count;
+        r.alloc_bytes = allocation_bytes().load() - total;
+    }
+    return r;
+}
+
+static void print_result(const BenchResult& r) {
+    char rate[32] = "";
+    if (r.bytes > 0) snprintf(rate, sizeof(rate), "%6.2f GB/s", r.bytes / r.seconds / 1e9);
+    printf("  %-28s %10.3f ms  %10.2f ns/%-5s %11s  %8llu allocs  %10.1f KB\n", r.name.c_str(), r.seconds * 1e3,
+           r.seconds * 1e9 / r.items, r.unit, rate, r.allocations, r.alloc_bytes / 1024.0);
+}
+
+static void write_results_json(ostream& out, const vector<BenchResult>& results, int runs, bool daily,
+                               unsigned long long seed) {
+    out << "{\"suite\": \"bench_suite\", \"schema\": 1, \"simd\": " << json_escape(simd_level_name(active_simd_level()))
+        << ", \"threads\": " << thread::hardware_concurrency() << ", \"runs\": " << runs
+        << ", \"bars\": " << (daily ? "\"daily\"" : "\"minute\"") << ", \"seed\": " << seed << ",\n \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << "  {\"name\": " << json_escape(r.name) << ", \"rows\": " << r.rows << ", \"unit\": " << json_escape(r.unit)
+            << ", \"items\": " << json_number(r.items) << ", \"seconds\": " << json_number(r.seconds)
+            << ", \"ns_per_item\": " << json_number(r.seconds * 1e9 / r.items)
+            << ", \"gb_per_s\": " << (r.bytes > 0 ? json_number(r.bytes / r.seconds / 1e9) : "null")
+            << ", \"allocations\": " << r.allocations << ", \"alloc_bytes\": " << r.alloc_bytes << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << " ]}\n";
+}
+
+// "1000", "100K", "1.5M"
+static long parse_count(const char *text) {
+    char *end;
+    double value = strtod(text, &end);
+    if (*end == 'k' || *end == 'K') value *= 1e3;
+    if (*end == 'm' || *end == 'M') value *= 1e6;
+    return static_cast<long>(value + 0.5);
+}
+
+static vector<long> parse_counts(const string& list) {
+    vector<long> counts;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos) comma = list.size();
+        long count = parse_count(list.substr(start, comma - start).c_str());
+        if (count > 0) counts.push_back(count);
+        start = comma + 1;
+    }
+    return counts;
+}
+
+static long file_size(const string& path) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static bool same_series(const PriceSeries& a, const PriceSeries& b) {
+    if (a.size != b.size) return false;
+    for (unsigned int i = 0; i < a.size; i++) {
+        if (a.time[i] != b.time[i] || a.close[i] != b.close[i] || a.volume[i] != b.volume[i]) return false;
+    }
+    return true;
+}
+
+// Windows of 1-100% of the history, log-uniform in length, anywhere in it
+static void scan_windows(unsigned int size, vector<unsigned int>& begins, vector<unsigned int>& ends) {
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    begins.resize(SCAN_WINDOWS);
+    ends.resize(SCAN_WINDOWS);
+    for (int w = 0; w < SCAN_WINDOWS; w++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double fraction = pow(100.0, static_cast<double>(state >> 11) / 9007199254740992.0) / 100;
+        unsigned int length = max(1u, static_cast<unsigned int>(size * fraction));
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        begins[w] = static_cast<unsigned int>((state >> 32) % (size - length + 1));
+        ends[w] = begins[w] + length;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    vector<long> row_counts;
+    string json_path, generate_path, dir = ".";
+    bool daily = false, keep = false;
+    unsigned long long seed = 42;
+    int runs = 3;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--rows" && has_value) {
+            row_counts = parse_counts(argv[++i]);
+        } else if (arg == "--json" && has_value) {
+            json_path = argv[++i];
+        } else if (arg == "--generate" && has_value) {
+            generate_path = argv[++i];
+        } else if (arg == "--dir" && has_value) {
+            dir = argv[++i];
+        } else if (arg == "--seed" && has_value) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--runs" && has_value) {
+            runs = max(1, atoi(argv[++i]));
+        } else if (arg == "--daily") {
+            daily = true;
+        } else if (arg == "--keep") {
+            keep = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--rows 1K,100K,1M] [--daily] [--seed N] [--runs N] [--dir DIR] [--keep] "
+                            "[--json FILE]\n       %s --generate FILE [--rows N] [--daily] [--seed N]\n",
+                    argv[0], argv[0]);
+            return 2;
+        }
+    }
+    MarketBars bars = daily ? MARKET_DAILY : MARKET_MINUTE;
+
+    if (!generate_path.empty()) {
+        long rows = row_counts.empty() ? 1000000 : row_counts[0];
+        auto start = chrono::steady_clock::now();
+        if (!write_market_csv(generate_path, rows, seed, bars)) {
+            fprintf(stderr, "Cannot write %ld rows to %s\n", rows, generate_path.c_str());
+            return 1;
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%s: %ld rows, %.1f MB in %.2f s\n", generate_path.c_str(), rows, file_size(generate_path) / 1e6, secs);
+        return 0;
+    }
+    if (row_counts.empty()) row_counts = parse_counts("1K,100K,1M");
+
+    printf("bench_suite: %s bars, SIMD %s, %u hardware threads, best of %d runs\n", daily ? "daily" : "one-minute",
+           simd_level_name(active_simd_level()), thread::hardware_concurrency(), runs);
+    if (!make_directory(dir)) {
+        fprintf(stderr, "Cannot create %s\n", dir.c_str());
+        return 1;
+    }
+    vector<BenchResult> results;
+    bool ok = true;
+
+    for (size_t c = 0; c < row_counts.size(); c++) {
+        long rows = row_counts[c];
+        char name[64];
+        snprintf(name, sizeof(name), "/bench_suite_%ld.csv", rows);
+        string path = dir + name;
+
+        auto start = chrono::steady_clock::now();
+        if (!write_market_csv(path, rows, seed, bars)) {
+            fprintf(stderr, "Cannot write %ld rows to %s\n", rows, path.c_str());
+            return 1;
+        }
+        double generate_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        long bytes = file_size(path);
+        long valid = market_valid_rows(rows);
+        printf("\n%ld rows (%.1f MB CSV, generated in %.2f s)\n", rows, bytes / 1e6, generate_s);
+        size_t first = results.size();
+
+        // Parse
+        StockPredictor single, parallel;
+        CsvLoadResult single_result, parallel_result;
+        results.push_back(measure("parse/1_thread", rows, "row", rows, bytes, runs, [&]() {
+            single_result = CsvLoadResult();
+            load_stock_file(single, path, single_result, 1);
+        }));
+        results.push_back(measure("parse/all_threads", rows, "row", rows, bytes, runs, [&]() {
+            parallel_result = CsvLoadResult();
+            load_stock_file(parallel, path, parallel_result, 0);
+        }));
+        bool loaded = single_result.valid_rows == valid && parallel_result.valid_rows == valid &&
+                      single.series.size == static_cast<unsigned int>(valid) && same_series(single.series, parallel.series);
+        if (!loaded) {
+            printf("  load mismatch: %d and %d valid rows, expected %ld\n", single_result.valid_rows,
+                   parallel_result.valid_rows, valid);
+        }
+        ok = ok && loaded;
+        dynamic_array<StockData>().swap(parallel.data);
+        parallel.series.clear();
+
+        // Fit, every model on the whole series
+        StockPredictor& predictor = single;
+        PriceSeries& series = predictor.series;
+        if (series.size < 2) continue;
+        for (int m = 0; m < MODEL_COUNT; m++) {
+            string key = string("fit/") + model_key(ALL_MODELS[m]);
+            predictor.model = ALL_MODELS[m];
+            results.push_back(measure(key, rows, "row", series.size, 0, runs, [&]() {
+                calculate_predictions(predictor);
+                sink = predictor.stats.next_prediction;
+            }));
+        }
+
+        // Range scans
+        vector<unsigned int> begins, ends;
+        scan_windows(series.size, begins, ends);
+        double scanned = 0;
+        for (int w = 0; w < SCAN_WINDOWS; w++) scanned += ends[w] - begins[w];
+        results.push_back(measure("scan/price_range", rows, "row", scanned, scanned * 2 * sizeof(double), runs, [&]() {
+            for (int w = 0; w < SCAN_WINDOWS; w++) {
+                double lo = 0, hi = 0;
+                price_range(series, begins[w], ends[w], lo, hi);
+                sink = hi - lo;
+            }
+        }));
+        CandlePyramid pyramid;
+        results.push_back(measure("render/pyramid_build", rows, "row", series.size, 0, runs, [&]() {
+            pyramid.build(series);
+        }));
+        results.push_back(measure("scan/pyramid_range", rows, "query", SCAN_WINDOWS, 0, runs, [&]() {
+            for (int w = 0; w < SCAN_WINDOWS; w++) {
+                double lo = 0, hi = 0;
+                pyramid.range(series, begins[w], ends[w], lo, hi);
+                sink = hi - lo;
+            }
+        }));
+
+        // Render prep: zoom from the whole history to 100 bars while panning
+        // back and forth, as draw_chart would, minus the SplashKit calls
+        vector<ChartCandle> candles;
+        vector<float> screen;
+        results.push_back(measure("render/frame_prep", rows, "frame", SWEEP_FRAMES, 0, runs, [&]() {
+            for (int f = 0; f < SWEEP_FRAMES; f++) {
+                double zoom = static_cast<double>(f) / (SWEEP_FRAMES - 1);
+                unsigned int visible = max(min(100u, series.size),
+                                           static_cast<unsigned int>(series.size * pow(100.0 / series.size, zoom)));
+                double pan = 0.5 + 0.5 * sin(f * 0.05);
+                unsigned int begin = static_cast<unsigned int>((series.size - visible) * pan);
+                double lo = 0, hi = 0;
+                if (!pyramid.range(series, begin, begin + visible, lo, hi) || hi <= lo) hi = lo + 1;
+                double y_scale = CHART_HEIGHT / (hi - lo);
+                pyramid.visible_candles(series, begin, begin + visible, CHART_WIDTH, candles);
+                screen.resize(candles.size() * 4);
+                for (size_t i = 0; i < candles.size(); i++) {
+                    screen[4 * i] = static_cast<float>(80 + CHART_HEIGHT - (candles[i].high - lo) * y_scale);
+                    screen[4 * i + 1] = static_cast<float>(80 + CHART_HEIGHT - (candles[i].low - lo) * y_scale);
+                    screen[4 * i + 2] = static_cast<float>(80 + CHART_HEIGHT - (candles[i].open - lo) * y_scale);
+                    screen[4 * i + 3] = static_cast<float>(80 + CHART_HEIGHT - (candles[i].close - lo) * y_scale);
+                }
+                sink = screen.empty() ? 0 : screen[0];
+            }
+        }));
+
+        for (size_t i = first; i < results.size(); i++) print_result(results[i]);
+        if (!keep) remove(path.c_str());
+    }
+
+    if (!json_path.empty()) {
+        ofstream out(json_path.c_str());
+        write_results_json(out, results, runs, daily, seed);
+        if (!out) {
+            fprintf(stderr, "Cannot write %s\n", json_path.c_str());
+            return 1;
+        }
+        printf("\nresults written to %s\n", json_path.c_str());
+    }
+
+    printf("\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
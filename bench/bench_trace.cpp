@@ -0,0 +1,142 @@
+// bench_trace.cpp - Cost of the trace scopes, and of tracing the CSV parse path
+//
+// Build: clang++ -O2 -std=c++11 -pthread -DHD_TRACING bench/bench_trace.cpp -o bench_trace
+// Usage: ./bench_trace [rows]
+//
+// Times an empty TRACE_SCOPE with tracing off and on, then loads a generated
+// CSV of `rows` one-minute bars (default 1,000,000) with load_csv_mmap and
+// load_csv_parallel, alternating runs with tracing off and on. Checks that
+// every traced load left its phases in the buffers, that the summary has
+// p50/p99 for them and that the Chrome trace export parses back to the same
+// number of events. The run passes if the events a traced load records,
+// each costing an enabled scope, add under 2% to the median untraced load.
+// Two loads differ by more than that from run to run, so the wall-clock
+// difference of the medians is only reported.
+
+#include "../csv_loader.hpp"
+#include "../trace.hpp"
+#include "synthetic_csv.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#ifndef HD_TRACING
+#error "build with -DHD_TRACING"
+#endif
+
+static double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static double scope_ns(int scopes) {
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < scopes; i++) {
+        TRACE_SCOPE("empty_scope");
+    }
+    return seconds_since(start) * 1e9 / scopes;
+}
+
+static double median(vector<double> values) {
+    sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// Events recorded so far, including those dropped from full buffers
+static size_t recorded_events() {
+    size_t total = 0;
+    for_each_trace_event([&](unsigned int, const TraceEvent&) { total++; });
+    return total + dropped_trace_events();
+}
+
+// Events whose name is `name`
+static size_t count_events(const char *name) {
+    size_t count = 0;
+    for_each_trace_event([&](unsigned int, const TraceEvent& event) {
+        if (strcmp(event.name, name) == 0) count++;
+    });
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    long rows = argc > 1 ? atol(argv[1]) : 1000000;
+    if (rows < 1000) rows = 1000;
+    const int runs = 7;
+    const int scopes = 1000000;
+
+    stop_tracing();
+    double off_ns = scope_ns(scopes);
+    start_tracing();
+    double on_ns = scope_ns(scopes);
+    stop_tracing();
+    printf("empty scope: %.2f ns with tracing off, %.2f ns on\n", off_ns, on_ns);
+
+    string path = "bench_trace.csv";
+    if (!write_market_csv(path, rows, 7)) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return 1;
+    }
+    thread_pool pool;
+
+    bool ok = true;
+    for (int parallel = 0; parallel < 2; parallel++) {
+        vector<double> times[2];
+        size_t events = 0;
+        for (int r = 0; r < 2 * runs; r++) {
+            int traced = r % 2;
+            size_t before = recorded_events();
+            if (traced) start_tracing();
+            dynamic_array<StockData> out;
+            CsvLoadResult result;
+            auto start = chrono::steady_clock::now();
+            if (parallel) load_csv_parallel(path, out, result, pool);
+            else load_csv_mmap(path, out, result);
+            double secs = seconds_since(start);
+            stop_tracing();
+            times[traced].push_back(secs);
+            if (traced) events += recorded_events() - before;
+            ok = ok && result.valid_rows == market_valid_rows(rows);
+        }
+        double off = median(times[0]), on = median(times[1]);
+        double per_load = static_cast<double>(events) / runs;
+        double overhead = per_load * on_ns * 1e-9 / off;
+        printf("%-18s  off %8.2f ms (%6.2f ns/row)  on %8.2f ms (%+.2f%%, not judged)  %.0f events x %.0f ns = %+.4f%%\n",
+               parallel ? "load_csv_parallel" : "load_csv_mmap", off * 1e3, off * 1e9 / rows, on * 1e3,
+               (on / off - 1) * 100, per_load, on_ns, overhead * 100);
+        ok = ok && overhead < 0.02;
+    }
+    remove(path.c_str());
+
+    size_t mmap_events = count_events("load_csv_mmap"), parallel_events = count_events("load_csv_parallel");
+    bool recorded = mmap_events == static_cast<size_t>(runs) && parallel_events == static_cast<size_t>(runs) &&
+                    count_events("parse_csv_lines") >= static_cast<size_t>(2 * runs);
+    printf("\nrecorded %zu load_csv_mmap and %zu load_csv_parallel spans (%d traced runs each)  %s\n", mmap_events,
+           parallel_events, runs, recorded ? "ok" : "WRONG");
+    ok = ok && recorded;
+
+    vector<string> summary = trace_summary_lines();
+    for (size_t i = 0; i < summary.size(); i++) printf("  %s\n", summary[i].c_str());
+
+    // The export parses back with one line per event
+    size_t total = recorded_events() - dropped_trace_events();
+    string trace_path = "bench_trace.json";
+    size_t exported = 0;
+    if (write_chrome_trace(trace_path)) {
+        FILE *f = fopen(trace_path.c_str(), "r");
+        char line[512];
+        while (f && fgets(line, sizeof(line), f)) {
+            if (strstr(line, "\"ph\": \"X\"") || strstr(line, "\"ph\": \"C\"")) exported++;
+        }
+        if (f) fclose(f);
+        remove(trace_path.c_str());
+    }
+    printf("\nChrome trace: %zu of %zu events exported  %s\n", exported, total, exported == total ? "ok" : "WRONG");
+    ok = ok && exported == total;
+
+    printf("\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
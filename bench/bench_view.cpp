@@ -0,0 +1,102 @@
+// bench_view.cpp - Zoomed-view queries: price range and trend refit per frame
+//
+// Build: clang++ -O2 -std=c++11 bench/bench_view.cpp -o bench_view
+// Usage: ./bench_view [bars] [queries]
+//
+// For random visible windows over a random walk, compares the y-axis range
+// from a SIMD min/max scan with CandlePyramid::range, and a regression_sums
+// pass over the window with RegressionPrefix::fit. Every answer is checked
+// against the scan (ranges exactly, slopes to a relative tolerance).
+
+#include "../candle_pyramid.hpp"
+#include "../prefix_regression.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    unsigned int bars = argc > 1 ? static_cast<unsigned int>(atol(argv[1])) : 10000000;
+    unsigned int queries = argc > 2 ? static_cast<unsigned int>(atol(argv[2])) : 2000;
+    if (bars < 100) bars = 100;
+
+    PriceSeries series;
+    series.reserve(bars);
+    unsigned long long seed = 29;
+    double price = 100.0;
+    for (unsigned int i = 0; i < bars; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double open = price;
+        price += (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5) * 2.0;
+        if (price < 1) price = 1;
+        double high = (open > price ? open : price) + 0.5;
+        double low = (open < price ? open : price) - 0.5;
+        series.add(static_cast<int32_t>(i), open, high, low, price, 1000);
+    }
+
+    auto start = chrono::steady_clock::now();
+    CandlePyramid pyramid;
+    pyramid.build(series);
+    double pyramid_ms = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e3;
+    start = chrono::steady_clock::now();
+    RegressionPrefix prefix;
+    prefix.sync(series);
+    double prefix_ms = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e3;
+    printf("%u bars: pyramid built in %.1f ms, prefix sums in %.1f ms\n", bars, pyramid_ms, prefix_ms);
+
+    // Windows from 10 bars to the whole history, log-uniform in length
+    vector<unsigned int> begins(queries), ends(queries);
+    for (unsigned int q = 0; q < queries; q++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double u = static_cast<double>(seed >> 11) / 9007199254740992.0;
+        unsigned int length = static_cast<unsigned int>(10 * pow(bars / 10.0, u));
+        if (length > bars) length = bars;
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        begins[q] = static_cast<unsigned int>((seed >> 11) % (bars - length + 1));
+        ends[q] = begins[q] + length;
+    }
+
+    vector<double> scan_lo(queries), scan_hi(queries), scan_slope(queries);
+    start = chrono::steady_clock::now();
+    for (unsigned int q = 0; q < queries; q++) {
+        double lo = series.low[begins[q]], hi = series.high[begins[q]];
+        minmax_reduce(series.low + begins[q], series.high + begins[q], ends[q] - begins[q], lo, hi);
+        scan_lo[q] = lo;
+        scan_hi[q] = hi;
+    }
+    double scan_range_us = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6 / queries;
+
+    start = chrono::steady_clock::now();
+    for (unsigned int q = 0; q < queries; q++) {
+        scan_slope[q] = fit_from_sums(regression_sums(series.close + begins[q], ends[q] - begins[q])).slope;
+    }
+    double scan_fit_us = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6 / queries;
+
+    int range_mismatches = 0;
+    start = chrono::steady_clock::now();
+    for (unsigned int q = 0; q < queries; q++) {
+        double lo = 0, hi = 0;
+        pyramid.range(series, begins[q], ends[q], lo, hi);
+        if (lo != scan_lo[q] || hi != scan_hi[q]) range_mismatches++;
+    }
+    double tree_range_us = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6 / queries;
+
+    double worst = 0;
+    start = chrono::steady_clock::now();
+    for (unsigned int q = 0; q < queries; q++) {
+        double slope = prefix.fit(begins[q], ends[q]).slope;
+        double scale = fabs(scan_slope[q]) > 1e-3 ? fabs(scan_slope[q]) : 1e-3;
+        double error = fabs(slope - scan_slope[q]) / scale;
+        if (error > worst) worst = error;
+    }
+    double prefix_fit_us = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6 / queries;
+
+    printf("y range:   scan %10.2f us/query   pyramid %8.3f us/query   %d mismatches\n", scan_range_us, tree_range_us,
+           range_mismatches);
+    printf("trend fit: scan %10.2f us/query   prefix  %8.3f us/query   worst slope error %.2e\n", scan_fit_us,
+           prefix_fit_us, worst);
+    return range_mismatches == 0 && worst < 1e-6 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// synthetic_csv.hpp - Deterministic random-walk CSV files in the README format, for benchmarks
+#ifndef SYNTHETIC_CSV_HPP
+#define SYNTHETIC_CSV_HPP
+
+#include "../price_series.hpp"
+#include <cstdio>
+#include <string>
+
+// Bar spacing of write_market_csv.
+enum MarketBars { MARKET_DAILY, MARKET_MINUTE };
+
+// One row in MARKET_INVALID_EVERY is written with unparseable prices (by
+// write_synthetic_csv and write_market_csv alike).
+const long MARKET_INVALID_EVERY = 9973;
+
+inline bool market_row_invalid(long i) {
+    return i % MARKET_INVALID_EVERY == 17;
+}
+
+// Rows of a write_synthetic_csv or write_market_csv file the loader should keep.
+inline long market_valid_rows(long rows) {
+    long invalid = rows > 17 ? (rows - 18) / MARKET_INVALID_EVERY + 1 : 0;
+    return rows - invalid;
+}
+
+// Rows write_synthetic_csv can give one date each (28-day months, years
+// 2024 back to 1); longer files get minute bars instead.
+const long SYNTHETIC_DAILY_ROWS = 336L * 2024;
+
+// Writes `rows` bars with quoted prices and comma-grouped volumes, dates
+// running through 28-day months from 2024 backwards. Up to
+// SYNTHETIC_DAILY_ROWS rows every row has its own date; longer files give
+// each date 390 newest-first minute bars (09:30-15:59), so every row keeps a
+// valid, distinct timestamp at any row count. market_row_invalid rows carry
+// "N/A" prices, so market_valid_rows says how many the loader keeps. The
+// same seed always produces the same file.
+inline bool write_synthetic_csv(const std::string& path, long rows, unsigned long long seed = 42) {
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f) return false;
+
+    fprintf(f, "Date,Open,High,Low,Close,Volume\n");
+    const long per_date = rows > SYNTHETIC_DAILY_ROWS ? 390 : 1;
+    double price = 150.0;
+    for (long i = 0; i < rows; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double step = (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5) * 2.0;
+        price = price + step > 1.0 ? price + step : price;
+        double open = price - step / 2;
+        double high = price + 1.25;
+        double low = open - 1.25;
+        long volume = 1000000 + static_cast<long>(seed % 20000000);
+        long date = i / per_date;
+        int day = static_cast<int>(date % 28) + 1;
+        int month = static_cast<int>((date / 28) % 12) + 1;
+        int year = 2024 - static_cast<int>(date / 336);
+        char time[16] = "";
+        if (per_date > 1) {
+            long minute = 9 * 60 + 30 + per_date - 1 - i % per_date;
+            snprintf(time, sizeof(time), " %02ld:%02ld", minute / 60, minute % 60);
+        }
+
+        // A sprinkling of rows the loader must reject in the same way as before
+        if (market_row_invalid(i)) {
+            fprintf(f, "%02d/%02d/%04d%s,\"N/A\",\"\",\"\",\"0\",\"0\"\n", month, day, year, time);
+            continue;
+        }
+
+        fprintf(f, "%02d/%02d/%04d%s,\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\",\"%ld,%03ld,%03ld\"\n",
+                month, day, year, time, open, high, low, price,
+                volume / 1000000, (volume / 1000) % 1000, volume % 1000);
+    }
+    fclose(f);
+    return true;
+}
+
+// Writes `rows` newest-first OHLCV bars ending on 12/31/2024 with real
+// calendar dates: one bar per weekday, or 390 one-minute bars per weekday
+// (09:30-15:59) with MARKET_MINUTE, so every row has its own timestamp.
+// Minute bars reach back about 1,000 years at 100M rows; daily bars run out
+// of four-digit years at about 520K rows, where this returns false. Prices
+// are quoted, volumes comma-grouped, and market_row_invalid rows carry
+// "N/A" prices. The same seed always produces the same file.
+inline bool write_market_csv(const std::string& path, long rows, unsigned long long seed = 42,
+                             MarketBars bars = MARKET_MINUTE) {
+    const long per_day = bars == MARKET_MINUTE ? 390 : 1;
+    if (rows < 0 || (rows + per_day - 1) / per_day > 2020L * 52 * 5) return false;
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    static char buffer[1 << 16];
+    setvbuf(f, buffer, _IOFBF, sizeof(buffer));
+
+    fprintf(f, "Date,Open,High,Low,Close,Volume\n");
+    int32_t day = days_from_civil(2024, 12, 31) + 1;
+    char date[32] = "";
+    double price = 150.0;
+    for (long i = 0; i < rows; i++) {
+        long slot = per_day - 1 - i % per_day;
+        if (slot == per_day - 1) {
+            // Previous weekday (1970-01-01 was a Thursday)
+            do {
+                day--;
+            } while ((day % 7 + 7 + 3) % 7 >= 5);
+            int year, month, d;
+            civil_from_days(day, year, month, d);
+            snprintf(date, sizeof(date), "%02d/%02d/%04d", month, d, year);
+        }
+
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double step = (static_cast<double>(seed >> 11) / 9007199254740992.0 - 0.5) * (per_day > 1 ? 0.1 : 2.0);
+        price = price + step > 1.0 ? price + step : price;
+        double open = price - step / 2;
+        double spread = static_cast<double>(seed & 255) / (per_day > 1 ? 2000.0 : 200.0);
+        double high = (open > price ? open : price) + spread;
+        double low = (open < price ? open : price) - spread;
+        long volume = (per_day > 1 ? 1000 : 1000000) + static_cast<long>((seed >> 24) % (per_day > 1 ? 50000 : 20000000));
+
+        char time[16] = "";
+        if (per_day > 1) {
+            long minute = 9 * 60 + 30 + slot;
+            snprintf(time, sizeof(time), " %02ld:%02ld", minute / 60, minute % 60);
+        }
+        if (market_row_invalid(i)) {
+            fprintf(f, "%s%s,\"N/A\",\"\",\"\",\"0\",\"0\"\n", date, time);
+            continue;
+        }
+        if (volume >= 1000000) {
+            fprintf(f, "%s%s,\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\",\"%ld,%03ld,%03ld\"\n", date, time, open, high, low,
+                    price, volume / 1000000, (volume / 1000) % 1000, volume % 1000);
+        } else {
+            fprintf(f, "%s%s,\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\",\"%ld,%03ld\"\n", date, time, open, high, low, price,
+                    volume / 1000, volume % 1000);
+        }
+    }
+    bool ok = ferror(f) == 0;
+    return fclose(f) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,296 @@
+// binary_cache.hpp - Versioned binary columnar cache next to each CSV for fast reopen
+#ifndef BINARY_CACHE_HPP
+#define BINARY_CACHE_HPP
+
+#include "csv_loader.hpp"
+#include "mapped_file.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+// File layout (host byte order, checked through `byte_order`):
+//
+//   CacheHeader                      192 bytes
+//   time column    int64_t[rows]     each column starts on a 64-byte boundary
+//   open, high, low, close, volume   double[rows]
+//
+// A cache is only used when the CSV's size and modification time match the
+// values recorded when it was written, so editing or replacing the CSV
+// always triggers a reparse. Reopening a valid cache is a single mmap: the
+// PriceSeries columns point straight into the mapping and no row is parsed
+// or copied.
+const char CACHE_MAGIC[8] = { 'S', 'P', 'C', 'A', 'C', 'H', 'E', '\0' };
+const uint32_t CACHE_VERSION = 2;    // 2: int64 timestamps instead of int32 days
+const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+const uint32_t CACHE_FLAG_CHECKSUM = 1;
+const int CACHE_COLUMNS = 6;
+const uint64_t CACHE_ALIGNMENT = 64;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t flags;
+    uint32_t row_count;
+    uint64_t file_size;           // total cache size, catches truncated files
+    uint64_t source_size;
+    int64_t source_mtime_sec;
+    int64_t source_mtime_nsec;
+    uint32_t valid_rows;          // CsvLoadResult of the original parse
+    uint32_t skipped_rows;
+    char ticker[64];
+    uint64_t column_offset[CACHE_COLUMNS];   // time, open, high, low, close, volume
+    uint64_t checksum;            // over every byte after the header
+    char reserved[8];
+};
+
+static_assert(sizeof(CacheHeader) % 64 == 0, "columns must start on a 64-byte boundary");
+
+struct CacheOptions {
+    bool enabled;
+    bool verify_checksum;   // hash the columns on open; a mismatch rebuilds the cache
+
+    explicit CacheOptions(bool enable = true, bool verify = false) : enabled(enable), verify_checksum(verify) {}
+};
+
+inline std::string cache_path_for(const std::string& csv_filename) {
+    return csv_filename + ".cache";
+}
+
+// Size and modification time of the source CSV, as recorded in the header
+struct SourceStamp {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+};
+
+inline bool stamp_source(const std::string& filename, SourceStamp& stamp) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return false;
+    stamp.size = static_cast<uint64_t>(st.st_size);
+    stamp.mtime_sec = static_cast<int64_t>(st.st_mtime);
+#if defined(__linux__)
+    stamp.mtime_nsec = static_cast<int64_t>(st.st_mtim.tv_nsec);
+#elif defined(__APPLE__)
+    stamp.mtime_nsec = static_cast<int64_t>(st.st_mtimespec.tv_nsec);
+#else
+    stamp.mtime_nsec = 0;
+#endif
+    return true;
+}
+
+// 64-bit FNV-1a style hash over 8-byte words. The column area is a run of
+// 64-byte aligned blocks, so it is always a whole number of words. Not
+// cryptographic; it only has to catch torn writes and bit rot.
+struct cache_hash {
+    uint64_t value;
+
+    cache_hash() : value(14695981039346656037ULL) {}
+
+    void add_words(const char *data, size_t size) {
+        for (size_t i = 0; i + 8 <= size; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            value = (value ^ word) * 1099511628211ULL;
+            value ^= value >> 29;
+        }
+    }
+};
+
+inline uint64_t align_cache_offset(uint64_t offset) {
+    return (offset + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+}
+
+// Fills in the column offsets and total size for `rows` rows.
+inline void layout_cache(CacheHeader& header, uint32_t rows) {
+    uint64_t offset = align_cache_offset(sizeof(CacheHeader));
+    for (int c = 0; c < CACHE_COLUMNS; c++) {
+        header.column_offset[c] = offset;
+        uint64_t width = c == 0 ? sizeof(int64_t) : sizeof(double);
+        offset = align_cache_offset(offset + width * rows);
+    }
+    header.file_size = offset;
+}
+
+// Writes the series to `cache_path` through a temporary file, so a reader
+// never sees a half-written cache. Returns false if the cache cannot be
+// written; the caller just carries on without one.
+inline bool write_stock_cache(const std::string& cache_path, const StockPredictor& predictor, const CsvLoadResult& result,
+                              const SourceStamp& stamp) {
+    TRACE_SCOPE("write_stock_cache");
+    const PriceSeries& series = predictor.series;
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.byte_order = CACHE_BYTE_ORDER;
+    header.flags = CACHE_FLAG_CHECKSUM;
+    header.row_count = series.size;
+    header.source_size = stamp.size;
+    header.source_mtime_sec = stamp.mtime_sec;
+    header.source_mtime_nsec = stamp.mtime_nsec;
+    header.valid_rows = static_cast<uint32_t>(result.valid_rows);
+    header.skipped_rows = static_cast<uint32_t>(result.skipped_rows);
+    strncpy(header.ticker, predictor.company_name.c_str(), sizeof(header.ticker) - 1);
+    layout_cache(header, series.size);
+
+    // Columns are streamed straight from the series (no second copy of a
+    // large history in memory); the checksum is patched in afterwards.
+    const char *columns[CACHE_COLUMNS] = {
+        reinterpret_cast<const char *>(series.time), reinterpret_cast<const char *>(series.open),
+        reinterpret_cast<const char *>(series.high), reinterpret_cast<const char *>(series.low),
+        reinterpret_cast<const char *>(series.close), reinterpret_cast<const char *>(series.volume) };
+    static const char zeros[CACHE_ALIGNMENT] = {};
+
+    std::string temp_path = cache_path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        cache_hash hash;
+        for (int c = 0; c < CACHE_COLUMNS; c++) {
+            size_t bytes = (c == 0 ? sizeof(int64_t) : sizeof(double)) * series.size;
+            uint64_t end = c + 1 < CACHE_COLUMNS ? header.column_offset[c + 1] : header.file_size;
+            size_t padding = static_cast<size_t>(end - header.column_offset[c]) - bytes;
+            if (bytes > 0) out.write(columns[c], static_cast<std::streamsize>(bytes));
+            out.write(zeros, static_cast<std::streamsize>(padding));
+
+            size_t whole = bytes / 8 * 8;
+            hash.add_words(columns[c], whole);
+            char tail[CACHE_ALIGNMENT] = {};
+            memcpy(tail, columns[c] + whole, bytes - whole);
+            hash.add_words(tail, bytes - whole + padding);
+        }
+        header.checksum = hash.value;
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (!out) {
+            out.close();
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(cache_path.c_str());
+#endif
+    if (std::rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Maps `cache_path` and attaches its columns to predictor.series. Fails (and
+// leaves the predictor untouched) if the cache is missing, stale, from
+// another version or byte order, malformed, or - with verify_checksum - corrupt.
+inline bool open_stock_cache(const std::string& cache_path, const SourceStamp& stamp, bool verify_checksum,
+                             StockPredictor& predictor, CsvLoadResult& result) {
+    TRACE_SCOPE("open_stock_cache");
+    mapped_file *mapping = new mapped_file();
+    if (!mapping->open(cache_path) || mapping->size < sizeof(CacheHeader)) {
+        delete mapping;
+        return false;
+    }
+
+    CacheHeader header;
+    memcpy(&header, mapping->data, sizeof(header));
+    bool valid = memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 && header.version == CACHE_VERSION &&
+                 header.byte_order == CACHE_BYTE_ORDER && header.file_size == mapping->size &&
+                 header.source_size == stamp.size && header.source_mtime_sec == stamp.mtime_sec &&
+                 header.source_mtime_nsec == stamp.mtime_nsec && header.ticker[sizeof(header.ticker) - 1] == '\0';
+    for (int c = 0; valid && c < CACHE_COLUMNS; c++) {
+        uint64_t width = c == 0 ? sizeof(int64_t) : sizeof(double);
+        uint64_t offset = header.column_offset[c];
+        valid = offset >= sizeof(CacheHeader) && offset % CACHE_ALIGNMENT == 0 &&
+                offset + width * header.row_count <= header.file_size;
+    }
+    if (valid && verify_checksum) {
+        cache_hash hash;
+        hash.add_words(mapping->data + sizeof(CacheHeader), mapping->size - sizeof(CacheHeader));
+        valid = (header.flags & CACHE_FLAG_CHECKSUM) && hash.value == header.checksum;
+    }
+    if (!valid) {
+        delete mapping;
+        return false;
+    }
+
+    const char *base = mapping->data;
+    predictor.data.clear();
+    predictor.series.attach(mapping, header.row_count,
+                            reinterpret_cast<const int64_t *>(base + header.column_offset[0]),
+                            reinterpret_cast<const double *>(base + header.column_offset[1]),
+                            reinterpret_cast<const double *>(base + header.column_offset[2]),
+                            reinterpret_cast<const double *>(base + header.column_offset[3]),
+                            reinterpret_cast<const double *>(base + header.column_offset[4]),
+                            reinterpret_cast<const double *>(base + header.column_offset[5]));
+    predictor.company_name = header.ticker;
+    result = CsvLoadResult();
+    result.valid_rows = static_cast<int>(header.valid_rows);
+    result.skipped_rows = static_cast<int>(header.skipped_rows);
+    result.source_bytes = static_cast<size_t>(header.source_size);
+    return true;
+}
+
+// load_stock_file() with a binary cache in front of it. A valid cache is
+// mapped as is (predictor.data stays empty; everything reads the series).
+// Otherwise the CSV is parsed and a fresh cache is written next to it.
+// `from_cache`, if given, reports which path was taken.
+inline bool load_stock_cached(StockPredictor& predictor, const std::string& filename, CsvLoadResult& result,
+                              const CacheOptions& options = CacheOptions(), unsigned int threads = 0,
+                              bool *from_cache = nullptr) {
+    if (from_cache) *from_cache = false;
+    SourceStamp stamp;
+    bool stamped = stamp_source(filename, stamp);
+    std::string cache_path = cache_path_for(filename);
+
+    if (options.enabled && stamped && open_stock_cache(cache_path, stamp, options.verify_checksum, predictor, result)) {
+        predictor.filename = filename;
+        if (from_cache) *from_cache = true;
+        return true;
+    }
+
+    if (!load_stock_file(predictor, filename, result, threads)) {
+        return false;
+    }
+    if (options.enabled && stamped && predictor.series.size > 0) {
+        write_stock_cache(cache_path, predictor, result, stamp);
+    }
+    return true;
+}
+
+// Loads several files of one ticker (overlapping exports, say) through
+// load_stock_cached and merges them into a single chronological series.
+// Where files share a timestamp the later file in `files` wins. `result`
+// adds up the rows of every file. Returns false if any file cannot be opened.
+inline bool load_stock_files(StockPredictor& predictor, const std::vector<std::string>& files, CsvLoadResult& result,
+                             const CacheOptions& options = CacheOptions(), unsigned int threads = 0) {
+    if (files.size() == 1) return load_stock_cached(predictor, files[0], result, options, threads);
+
+    std::vector<StockPredictor> parts(files.size());
+    std::vector<const PriceSeries *> inputs(files.size());
+    result = CsvLoadResult();
+    for (size_t i = 0; i < files.size(); i++) {
+        CsvLoadResult part;
+        if (!load_stock_cached(parts[i], files[i], part, options, threads)) return false;
+        for (int d = 0; d < part.debug_count && result.debug_count < 3; d++) {
+            result.debug_rows[result.debug_count++] = part.debug_rows[d];
+        }
+        result.valid_rows += part.valid_rows;
+        result.skipped_rows += part.skipped_rows;
+        result.source_bytes += part.source_bytes;
+        inputs[i] = &parts[i].series;
+    }
+
+    predictor.data.clear();
+    predictor.filename = files.back();
+    predictor.company_name = parts.back().company_name;
+    return merge_series(inputs.data(), inputs.size(), predictor.series);
+}
+
+#endif
@@ -0,0 +1,241 @@
+// candle_pyramid.hpp - Power-of-two OHLC aggregation for drawing huge histories
+#ifndef CANDLE_PYRAMID_HPP
+#define CANDLE_PYRAMID_HPP
+
+#include "price_series.hpp"
+#include <algorithm>
+#include <vector>
+
+// Aggregate of a run of bars: first open, highest high, lowest low, last close
+struct Candle {
+    double open, high, low, close;
+};
+
+// One candle to draw, spanning [x0, x1) pixels from the chart's left edge
+struct ChartCandle {
+    double x0, x1;
+    double open, high, low, close;
+};
+
+// Finest pyramid level: buckets of 2^PYRAMID_BASE_LEVEL bars. Finer views
+// read the series directly (at most that many bars per pixel), which keeps
+// the pyramid at half a candle per bar.
+const int PYRAMID_BASE_LEVEL = 2;
+
+// levels[i] holds buckets of 2^(i + PYRAMID_BASE_LEVEL) bars: bucket j covers
+// bars [j << k, (j + 1) << k), the last one possibly partial. A chart W pixels
+// wide showing n bars reads the level whose buckets are just under n / W
+// bars, so each pixel merges one or two buckets and a frame costs O(W)
+// whatever the history length.
+struct CandlePyramid {
+    std::vector<std::vector<Candle> > levels;
+    unsigned int bars;      // bars of the series aggregated so far
+
+    CandlePyramid() : bars(0) {}
+
+    void clear() {
+        levels.clear();
+        bars = 0;
+    }
+
+    void build(const PriceSeries& series) {
+        clear();
+        sync(series);
+    }
+
+    // Treats bars from `row` on as new, so the next sync recomputes the
+    // buckets holding them (after a followed bar revised the newest one).
+    void rewind(unsigned int row) {
+        if (row < bars) bars = row;
+    }
+
+    // Brings the pyramid up to date after bars were appended to the series.
+    // Only buckets that contain new bars are recomputed, so appending m bars
+    // costs O(m + number of levels). A series that shrank is rebuilt.
+    void sync(const PriceSeries& series) {
+        if (series.size < bars) clear();
+        if (series.size == bars) return;
+        unsigned int old_bars = bars;
+        bars = series.size;
+
+        for (int i = 0;; i++) {
+            int k = i + PYRAMID_BASE_LEVEL;
+            unsigned int count = static_cast<unsigned int>((static_cast<unsigned long long>(bars) + (1ULL << k) - 1) >> k);
+            if (i == static_cast<int>(levels.size())) {
+                if (i > 0 && levels[i - 1].size() <= 1) break;
+                levels.push_back(std::vector<Candle>());
+            }
+            std::vector<Candle>& level = levels[i];
+            unsigned int first_dirty = std::min(old_bars >> k, static_cast<unsigned int>(level.size()));
+            level.resize(count);
+            for (unsigned int j = first_dirty; j < count; j++) {
+                if (i == 0) {
+                    unsigned int begin = j << k;
+                    level[j] = aggregate_bars(series, begin, std::min(begin + (1u << k), bars));
+                } else {
+                    const std::vector<Candle>& below = levels[i - 1];
+                    level[j] = below[2 * j];
+                    if (2 * j + 1 < below.size()) merge(level[j], below[2 * j + 1]);
+                }
+            }
+            if (count <= 1) {
+                levels.resize(i + 1);
+                break;
+            }
+        }
+    }
+
+    // Candles for bars [begin, end) on a chart `pixels` wide. With fewer bars
+    // than pixels every bar is its own candle; otherwise there is at most one
+    // candle per pixel, each aggregating the bars that start in that pixel.
+    void visible_candles(const PriceSeries& series, unsigned int begin, unsigned int end, int pixels,
+                         std::vector<ChartCandle>& out) const {
+        out.clear();
+        if (end > series.size) end = series.size;
+        if (begin >= end || pixels <= 0) return;
+        unsigned int visible = end - begin;
+        double px_per_bar = static_cast<double>(pixels) / visible;
+
+        if (visible <= static_cast<unsigned int>(pixels)) {
+            out.reserve(visible);
+            for (unsigned int i = begin; i < end; i++) {
+                ChartCandle c;
+                c.x0 = (i - begin) * px_per_bar;
+                c.x1 = c.x0 + px_per_bar;
+                c.open = series.open[i];
+                c.high = series.high[i];
+                c.low = series.low[i];
+                c.close = series.close[i];
+                out.push_back(c);
+            }
+            return;
+        }
+
+        // Coarsest level whose buckets still fit inside one pixel
+        int k = 0;
+        while ((1ULL << (k + 1)) * pixels <= visible) k++;
+        int level_index = k - PYRAMID_BASE_LEVEL;
+        if (level_index >= static_cast<int>(levels.size())) level_index = static_cast<int>(levels.size()) - 1;
+
+        std::vector<Candle> pixel_candles(pixels);
+        std::vector<char> used(pixels, 0);
+        if (level_index < 0 || bars < end) {
+            // Fine zoom (or pyramid not synced): merge bars directly
+            for (unsigned int i = begin; i < end; i++) {
+                add_to_pixel(pixel_candles, used, pixel_of(i, begin, px_per_bar, pixels), bar_candle(series, i));
+            }
+        } else {
+            k = level_index + PYRAMID_BASE_LEVEL;
+            const std::vector<Candle>& level = levels[level_index];
+            unsigned long long size = 1ULL << k;
+            // Whole buckets inside [begin, end); the partial edges come from the bars
+            unsigned int first = static_cast<unsigned int>((begin + size - 1) >> k);
+            unsigned int last = static_cast<unsigned int>(end >> k);
+            unsigned int head_end = first < last ? static_cast<unsigned int>(first * size) : end;
+            for (unsigned int i = begin; i < head_end; i++) {
+                add_to_pixel(pixel_candles, used, pixel_of(i, begin, px_per_bar, pixels), bar_candle(series, i));
+            }
+            for (unsigned int j = first; j < last; j++) {
+                unsigned int bucket_begin = static_cast<unsigned int>(j * size);
+                add_to_pixel(pixel_candles, used, pixel_of(bucket_begin, begin, px_per_bar, pixels), level[j]);
+            }
+            for (unsigned int i = std::max(head_end, static_cast<unsigned int>(last * size)); i < end; i++) {
+                add_to_pixel(pixel_candles, used, pixel_of(i, begin, px_per_bar, pixels), bar_candle(series, i));
+            }
+        }
+
+        out.reserve(pixels);
+        for (int p = 0; p < pixels; p++) {
+            if (!used[p]) continue;
+            ChartCandle c;
+            c.x0 = p;
+            c.x1 = p + 1;
+            c.open = pixel_candles[p].open;
+            c.high = pixel_candles[p].high;
+            c.low = pixel_candles[p].low;
+            c.close = pixel_candles[p].close;
+            out.push_back(c);
+        }
+    }
+
+    // Low/high of the whole series, from the top level.
+    bool full_range(double& lo, double& hi) const {
+        if (levels.empty() || levels.back().empty()) return false;
+        lo = levels.back()[0].low;
+        hi = levels.back()[0].high;
+        return true;
+    }
+
+    // Low/high of bars [begin, end) for the y axis of a zoomed view. The
+    // range is covered greedily by the largest aligned buckets that fit, like
+    // a segment tree walk: bucket sizes rise then fall, so it touches
+    // O(log n) buckets plus at most 2 * (2^PYRAMID_BASE_LEVEL - 1) single bars.
+    bool range(const PriceSeries& series, unsigned int begin, unsigned int end, double& lo, double& hi) const {
+        if (end > bars) end = bars;
+        if (end > series.size) end = series.size;
+        if (begin >= end) return false;
+        lo = series.low[begin];
+        hi = series.high[begin];
+        unsigned int i = begin;
+        int level_index = -1;
+        while (i < end) {
+            // Grow while i stays aligned and the bucket fits, shrink otherwise
+            while (level_index + 1 < static_cast<int>(levels.size()) && fits(i, end, level_index + 1)) level_index++;
+            while (level_index >= 0 && !fits(i, end, level_index)) level_index--;
+            if (level_index < 0) {
+                if (series.low[i] < lo) lo = series.low[i];
+                if (series.high[i] > hi) hi = series.high[i];
+                i++;
+            } else {
+                int k = level_index + PYRAMID_BASE_LEVEL;
+                const Candle& c = levels[level_index][i >> k];
+                if (c.low < lo) lo = c.low;
+                if (c.high > hi) hi = c.high;
+                i += 1u << k;
+            }
+        }
+        return true;
+    }
+
+private:
+    // Whether the bucket of `level_index` starting at bar i lies inside [i, end)
+    static bool fits(unsigned int i, unsigned int end, int level_index) {
+        int k = level_index + PYRAMID_BASE_LEVEL;
+        unsigned long long size = 1ULL << k;
+        return (i & (size - 1)) == 0 && i + size <= end;
+    }
+
+    static Candle bar_candle(const PriceSeries& series, unsigned int i) {
+        Candle c = { series.open[i], series.high[i], series.low[i], series.close[i] };
+        return c;
+    }
+
+    static Candle aggregate_bars(const PriceSeries& series, unsigned int begin, unsigned int end) {
+        Candle c = bar_candle(series, begin);
+        for (unsigned int i = begin + 1; i < end; i++) merge(c, bar_candle(series, i));
+        return c;
+    }
+
+    // Appends `next` (later in time) to `c`
+    static void merge(Candle& c, const Candle& next) {
+        if (next.high > c.high) c.high = next.high;
+        if (next.low < c.low) c.low = next.low;
+        c.close = next.close;
+    }
+
+    static int pixel_of(unsigned int bar, unsigned int begin, double px_per_bar, int pixels) {
+        int p = static_cast<int>((bar - begin) * px_per_bar);
+        return p < pixels ? p : pixels - 1;
+    }
+
+    static void add_to_pixel(std::vector<Candle>& pixel_candles, std::vector<char>& used, int p, const Candle& c) {
+        if (used[p]) {
+            merge(pixel_candles[p], c);
+        } else {
+            pixel_candles[p] = c;
+            used[p] = 1;
+        }
+    }
+};
+
+#endif
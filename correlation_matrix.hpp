@@ -0,0 +1,242 @@
+// correlation_matrix.hpp - Rolling covariance / correlation of daily returns across many tickers
+#ifndef CORRELATION_MATRIX_HPP
+#define CORRELATION_MATRIX_HPP
+
+#include "price_series.hpp"
+#include "simd_kernels.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <vector>
+
+// Rows and columns of the matrix handled per task. A 64 x 64 tile of sums is
+// 32 KB, so it stays in L1/L2 while the window's returns stream past it.
+const unsigned int CORRELATION_TILE = 64;
+
+// The sums drift by rounding as days are added and removed; they are
+// rebuilt from scratch after this many slides (about 12% extra work for a
+// 250-day window).
+const unsigned int CORRELATION_REBUILD_SLIDES = 1024;
+
+// Close-to-close returns of many tickers on one shared calendar: the union
+// of their dates. A ticker's return on a date it has no bar for is 0 (the
+// price is carried forward), and its first bar has no return either. Row t
+// holds the returns for dates[t], symbols contiguous, rows padded to a
+// multiple of 8 doubles so each starts on a cache line.
+struct ReturnPanel {
+    unsigned int symbols;
+    unsigned int days;
+    unsigned int stride;
+    std::vector<int64_t> dates;
+    double *returns;
+
+    ReturnPanel() : symbols(0), days(0), stride(0), returns(nullptr) {}
+
+    ~ReturnPanel() {
+        aligned_free(returns);
+    }
+
+    const double *row(unsigned int day) const {
+        return returns + static_cast<size_t>(day) * stride;
+    }
+
+private:
+    ReturnPanel(const ReturnPanel&);
+    ReturnPanel& operator=(const ReturnPanel&);
+};
+
+// Builds the panel from `count` series (dates ascending). With max_days,
+// only the newest max_days return rows are kept.
+inline bool build_return_panel(const PriceSeries *series, unsigned int count, ReturnPanel& panel,
+                               unsigned int max_days = 0) {
+    // Union of the calendars, one linear merge per series
+    std::vector<int64_t> calendar, merged;
+    for (unsigned int s = 0; s < count; s++) {
+        merged.clear();
+        std::set_union(calendar.begin(), calendar.end(), series[s].time, series[s].time + series[s].size,
+                       std::back_inserter(merged));
+        calendar.swap(merged);
+    }
+    calendar.erase(std::unique(calendar.begin(), calendar.end()), calendar.end());
+    calendar.erase(std::remove(calendar.begin(), calendar.end(), INVALID_TIMESTAMP), calendar.end());
+
+    unsigned int first = 1;     // the first date has no return
+    if (calendar.size() <= 1) first = static_cast<unsigned int>(calendar.size());
+    if (max_days > 0 && calendar.size() > first + max_days) first = static_cast<unsigned int>(calendar.size()) - max_days;
+
+    aligned_free(panel.returns);
+    panel.symbols = count;
+    panel.stride = (count + 7) & ~7u;
+    panel.days = static_cast<unsigned int>(calendar.size()) - first;
+    panel.dates.assign(calendar.begin() + first, calendar.end());
+    size_t cells = static_cast<size_t>(panel.days) * panel.stride;
+    panel.returns = static_cast<double *>(aligned_malloc((cells > 0 ? cells : 1) * sizeof(double)));
+    if (!panel.returns) {
+        panel.days = 0;
+        return false;
+    }
+    std::fill(panel.returns, panel.returns + cells, 0.0);
+
+    for (unsigned int s = 0; s < count; s++) {
+        const PriceSeries& ticker = series[s];
+        unsigned int k = 0;
+        double previous = 0;
+        for (unsigned int d = 0; d < calendar.size() && k < ticker.size; d++) {
+            while (k < ticker.size && ticker.time[k] < calendar[d]) k++;     // invalid or repeated dates
+            if (k == ticker.size || ticker.time[k] != calendar[d]) continue;
+            double close = ticker.close[k++];
+            if (d >= first && previous != 0) {
+                panel.returns[static_cast<size_t>(d - first) * panel.stride + s] = close / previous - 1;
+            }
+            previous = close;
+        }
+    }
+    return true;
+}
+
+// Covariance and correlation of the returns in a rolling window of panel
+// rows, for every pair of symbols.
+//
+// The engine keeps S = sum of r r^T (upper triangle) and s = sum of r over
+// the window. Sliding one day is the rank-2 update S += r_new r_new^T -
+// r_old r_old^T, O(N^2) instead of the O(W N^2) of recomputing the window.
+// Building S from scratch pairs the window's days into the same rank-2
+// updates. Both run tile by tile (CORRELATION_TILE rows by columns, upper
+// triangle only) on a thread pool, with each tile row updated by the
+// rank2_update SIMD kernel.
+struct RollingCovariance {
+    RollingCovariance() : window(0), symbols(0), stride(0), end(0), slides(0), sums(nullptr) {}
+
+    ~RollingCovariance() {
+        aligned_free(sums);
+    }
+
+    // Sums over panel rows [window_end - window_days, window_end).
+    bool reset(const ReturnPanel& panel, unsigned int window_days, unsigned int window_end, thread_pool *pool = nullptr) {
+        if (window_days < 2 || window_end < window_days || window_end > panel.days) return false;
+        if (panel.stride != stride || !sums) {
+            aligned_free(sums);
+            stride = panel.stride;
+            sums = static_cast<double *>(aligned_malloc(static_cast<size_t>(stride) * stride * sizeof(double)));
+            if (!sums) return false;
+        }
+        symbols = panel.symbols;
+        window = window_days;
+        end = window_end;
+        slides = 0;
+        std::fill(sums, sums + static_cast<size_t>(stride) * stride, 0.0);
+        return_sums.assign(symbols, 0.0);
+
+        unsigned int begin = end - window;
+        for (unsigned int t = begin; t < end; t++) {
+            const double *r = panel.row(t);
+            for (unsigned int i = 0; i < symbols; i++) return_sums[i] += r[i];
+        }
+        run_tiles(pool, [&](unsigned int row_begin, unsigned int row_end, unsigned int col_begin, unsigned int col_end) {
+            for (unsigned int t = begin; t < end; t += 2) {
+                const double *x = panel.row(t);
+                const double *y = t + 1 < end ? panel.row(t + 1) : x;
+                for (unsigned int i = row_begin; i < row_end; i++) {
+                    unsigned int j = std::max(i, col_begin);
+                    if (j >= col_end) continue;
+                    double b = t + 1 < end ? y[i] : 0;
+                    rank2_update(sums + static_cast<size_t>(i) * stride + j, x + j, x[i], y + j, b, col_end - j);
+                }
+            }
+        });
+        return true;
+    }
+
+    // Moves the window one day later; false at the end of the panel.
+    bool advance(const ReturnPanel& panel, thread_pool *pool = nullptr) {
+        if (!sums || end >= panel.days) return false;
+        if (++slides >= CORRELATION_REBUILD_SLIDES) return reset(panel, window, end + 1, pool);
+
+        const double *added = panel.row(end);
+        const double *dropped = panel.row(end - window);
+        for (unsigned int i = 0; i < symbols; i++) return_sums[i] += added[i] - dropped[i];
+        run_tiles(pool, [&](unsigned int row_begin, unsigned int row_end, unsigned int col_begin, unsigned int col_end) {
+            for (unsigned int i = row_begin; i < row_end; i++) {
+                unsigned int j = std::max(i, col_begin);
+                if (j >= col_end) continue;
+                rank2_update(sums + static_cast<size_t>(i) * stride + j, added + j, added[i], dropped + j, -dropped[i],
+                             col_end - j);
+            }
+        });
+        end++;
+        return true;
+    }
+
+    // Moves the window to end at `window_end`, sliding when that is cheaper
+    // than a rebuild.
+    bool seek(const ReturnPanel& panel, unsigned int window_end, thread_pool *pool = nullptr) {
+        if (sums && window_end >= end && window_end - end < window / 2) {
+            while (end < window_end) {
+                if (!advance(panel, pool)) return false;
+            }
+            return true;
+        }
+        return reset(panel, window, window_end, pool);
+    }
+
+    // Sample covariance of the returns of symbols i and j over the window.
+    double covariance(unsigned int i, unsigned int j) const {
+        if (i > j) std::swap(i, j);
+        double n = window;
+        return (sums[static_cast<size_t>(i) * stride + j] - return_sums[i] * return_sums[j] / n) / (n - 1);
+    }
+
+    // Pearson correlation; 0 when either symbol did not move in the window.
+    double correlation(unsigned int i, unsigned int j) const {
+        double var = covariance(i, i) * covariance(j, j);
+        if (var <= 0) return 0;
+        double c = covariance(i, j) / std::sqrt(var);
+        return c > 1 ? 1 : (c < -1 ? -1 : c);
+    }
+
+    unsigned int window_days() const {
+        return window;
+    }
+
+    // Panel rows [window_end() - window_days(), window_end()) are in the sums.
+    unsigned int window_end() const {
+        return end;
+    }
+
+private:
+    unsigned int window;
+    unsigned int symbols;
+    unsigned int stride;
+    unsigned int end;
+    unsigned int slides;
+    double *sums;                   // stride x stride, upper triangle used
+    std::vector<double> return_sums;      // per-symbol sum of returns (divided by n when read)
+
+    // Calls fn(row_begin, row_end, col_begin, col_end) for each tile of the
+    // upper triangle, on the pool when there is one.
+    template <typename Fn>
+    void run_tiles(thread_pool *pool, Fn fn) {
+        unsigned int blocks = (symbols + CORRELATION_TILE - 1) / CORRELATION_TILE;
+        unsigned int tiles = blocks * (blocks + 1) / 2;
+        auto tile = [&](unsigned int task, unsigned int) {
+            unsigned int row_block = 0;
+            while (task >= blocks - row_block) task -= blocks - row_block++;
+            unsigned int col_block = row_block + task;
+            unsigned int row_begin = row_block * CORRELATION_TILE;
+            unsigned int col_begin = col_block * CORRELATION_TILE;
+            fn(row_begin, std::min(symbols, row_begin + CORRELATION_TILE), col_begin,
+               std::min(symbols, col_begin + CORRELATION_TILE));
+        };
+        if (pool) {
+            pool->run(tiles, tile);
+        } else {
+            for (unsigned int t = 0; t < tiles; t++) tile(t, 0);
+        }
+    }
+
+    RollingCovariance(const RollingCovariance&);
+    RollingCovariance& operator=(const RollingCovariance&);
+};
+
+#endif
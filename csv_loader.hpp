@@ -0,0 +1,560 @@
+// csv_loader.hpp - Memory-mapped, allocation-free CSV loader for stock data
+#ifndef CSV_LOADER_HPP
+#define CSV_LOADER_HPP
+
+#include "mapped_file.hpp"
+#include "series_order.hpp"
+#include "stock_predictor.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Outcome of a load, including the first few rows rejected before any valid
+// row was seen (the UI prints these to help diagnose format problems).
+struct CsvLoadResult {
+    int valid_rows;
+    int skipped_rows;
+    int debug_count;
+    StockData debug_rows[3];
+    size_t source_bytes;    // bytes of the file the rows came from; a follower resumes here
+
+    CsvLoadResult() : valid_rows(0), skipped_rows(0), debug_count(0), source_bytes(0) {}
+};
+
+// ---------------------------------------------------------------------------
+// Reference getline/stringstream path (the original loader). Kept for parity
+// checks and benchmarking; load_csv_mmap must produce identical results.
+// ---------------------------------------------------------------------------
+
+inline std::string clean_volume_string(const std::string& str) {
+    std::string clean;
+    for (size_t i = 0; i < str.length(); i++) {
+        char c = str[i];
+        if (isdigit(c) || c == '.') {
+            clean += c;
+        }
+    }
+    return clean.empty() ? "0" : clean;
+}
+
+inline std::string remove_quotes(const std::string& str) {
+    std::string result = str;
+    if (!result.empty() && result.front() == '"') {
+        result.erase(0, 1);
+    }
+    if (!result.empty() && result.back() == '"') {
+        result.pop_back();
+    }
+    return result;
+}
+
+inline double safe_stod(const std::string& str, double default_val = 0.0) {
+    try {
+        std::string clean_str = remove_quotes(str);
+        return std::stod(clean_str);
+    } catch (...) {
+        return default_val;
+    }
+}
+
+inline void record_skipped_row(CsvLoadResult& result, const StockData& stock) {
+    result.skipped_rows++;
+    if (result.valid_rows == 0 && result.skipped_rows <= 3) {
+        result.debug_rows[result.debug_count++] = stock;
+    }
+}
+
+// Rows need a parseable date and positive open and close prices.
+inline bool valid_stock_row(const StockData& stock) {
+    return stock.open > 0 && stock.close > 0 && stock.time != INVALID_TIMESTAMP;
+}
+
+inline bool load_csv_stream(const std::string& filename, dynamic_array<StockData>& out, CsvLoadResult& result) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line, date;
+    getline(file, line); // Skip header
+
+    while (getline(file, line)) {
+        if (line.empty()) continue;
+
+        StockData stock;
+        std::stringstream ss(line);
+        std::string temp;
+
+        try {
+            getline(ss, date, ','); stock.time = parse_timestamp(date);
+            getline(ss, temp, ','); stock.open = safe_stod(temp);
+            getline(ss, temp, ','); stock.high = safe_stod(temp);
+            getline(ss, temp, ','); stock.low = safe_stod(temp);
+            getline(ss, temp, ','); stock.close = safe_stod(temp);
+            getline(ss, temp); stock.volume = safe_stod(clean_volume_string(temp));
+
+            if (valid_stock_row(stock)) {
+                out.add(stock);
+                result.valid_rows++;
+            } else {
+                record_skipped_row(result, stock);
+            }
+        } catch (...) {
+            result.skipped_rows++;
+        }
+    }
+
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// In-place tokenizer and number parsing
+// ---------------------------------------------------------------------------
+
+// Exact strtod on a non-terminated range, with std::stod's failure rules
+// (no conversion or ERANGE) mapped to 0. Only used for unusual fields.
+inline double parse_double_slow(const char *begin, const char *end) {
+    size_t n = static_cast<size_t>(end - begin);
+    char stack_buf[64];
+    std::string heap_buf;
+    const char *str;
+    if (n < sizeof(stack_buf)) {
+        memcpy(stack_buf, begin, n);
+        stack_buf[n] = '\0';
+        str = stack_buf;
+    } else {
+        heap_buf.assign(begin, end);
+        str = heap_buf.c_str();
+    }
+
+    char *parse_end;
+    int saved_errno = errno;
+    errno = 0;
+    double value = strtod(str, &parse_end);
+    bool failed = (parse_end == str || errno == ERANGE);
+    errno = saved_errno;
+    return failed ? 0.0 : value;
+}
+
+// Powers of ten that are exactly representable as doubles.
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Same result as std::stod (0 on failure) for [begin, end). Plain decimals
+// such as "178.78" take the exact fast path: an integer mantissa below 2^53
+// divided by an exactly representable power of ten rounds correctly, so it
+// matches strtod bit for bit. Anything else (whitespace, '+', exponents, hex,
+// inf/nan, very long digit strings) falls back to strtod.
+inline double parse_double_field(const char *begin, const char *end) {
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int frac_digits = 0;
+    const char *int_start = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        ++digits;
+        ++p;
+    }
+    const char *int_end = p;
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            ++digits;
+            ++frac_digits;
+            ++p;
+        }
+    }
+
+    bool simple = digits > 0 && digits <= 19 && frac_digits <= 22 && mantissa <= (1ULL << 53);
+    if (simple && p < end) {
+        char c = *p;
+        if (c == 'e' || c == 'E') simple = false;
+        if ((c == 'x' || c == 'X') && int_end - int_start == 1 && *int_start == '0' && frac_digits == 0 && p == int_end) {
+            simple = false;
+        }
+    }
+    if (!simple) {
+        return parse_double_slow(begin, end);
+    }
+
+    double value = static_cast<double>(mantissa) / exact_powers_of_ten[frac_digits];
+    return negative ? -value : value;
+}
+
+// safe_stod(field) without the copies: strip one leading and one trailing quote.
+inline double parse_price_field(const char *begin, const char *end) {
+    if (begin < end && *begin == '"') ++begin;
+    if (begin < end && end[-1] == '"') --end;
+    return parse_double_field(begin, end);
+}
+
+// safe_stod(clean_volume_string(field)): keep only digits and '.', so
+// "14,928,360" becomes 14928360.
+inline double parse_volume_field(const char *begin, const char *end) {
+    char stack_buf[64];
+    size_t n = 0;
+    const char *p = begin;
+    for (; p < end; ++p) {
+        char c = *p;
+        if ((c >= '0' && c <= '9') || c == '.') {
+            if (n == sizeof(stack_buf)) break;
+            stack_buf[n++] = c;
+        }
+    }
+    if (p < end) {
+        // Pathologically long volume field
+        return safe_stod(clean_volume_string(std::string(begin, end)));
+    }
+    if (n == 0) return 0.0;
+    return parse_double_field(stack_buf, stack_buf + n);
+}
+
+// Splits one line exactly the way the getline(ss, field, ',') sequence does.
+// Once the line runs out, std::getline leaves its target untouched, so later
+// fields keep repeating the last value read into `temp`.
+inline void parse_stock_row(const char *line, const char *line_end, StockData& stock) {
+    const char *p = line;
+    bool exhausted = false;
+
+    const char *comma = static_cast<const char *>(memchr(p, ',', line_end - p));
+    if (comma) {
+        stock.time = parse_timestamp(p, comma - p);
+        p = comma + 1;
+    } else {
+        stock.time = parse_timestamp(p, line_end - p);
+        exhausted = true;
+    }
+
+    const char *temp_begin = line_end;
+    const char *temp_end = line_end;
+    double *targets[4] = { &stock.open, &stock.high, &stock.low, &stock.close };
+    for (int i = 0; i < 4; i++) {
+        if (!exhausted) {
+            comma = static_cast<const char *>(memchr(p, ',', line_end - p));
+            temp_begin = p;
+            if (comma) {
+                temp_end = comma;
+                p = comma + 1;
+            } else {
+                temp_end = line_end;
+                p = line_end;
+                exhausted = true;
+            }
+        }
+        *targets[i] = parse_price_field(temp_begin, temp_end);
+    }
+
+    if (!exhausted) {
+        temp_begin = p;
+        temp_end = line_end;
+    }
+    stock.volume = parse_volume_field(temp_begin, temp_end);
+}
+
+// Returns the first byte after the header line.
+inline const char *skip_csv_header(const char *begin, const char *end) {
+    const char *newline = static_cast<const char *>(memchr(begin, '\n', end - begin));
+    return newline ? newline + 1 : end;
+}
+
+// Bytes of the body sampled by estimate_csv_rows.
+const size_t CSV_ROW_SAMPLE_BYTES = 64 * 1024;
+
+// Rows expected in [begin, end) (no header), from the mean length of the
+// lines in its first CSV_ROW_SAMPLE_BYTES, plus 1/16 slack. Reserving this
+// up front means the loader's array is allocated once instead of doubling
+// (and moving every row) about log2(rows) times.
+inline size_t estimate_csv_rows(const char *begin, const char *end) {
+    size_t bytes = static_cast<size_t>(end - begin);
+    const char *sample_end = bytes > CSV_ROW_SAMPLE_BYTES ? begin + CSV_ROW_SAMPLE_BYTES : end;
+    size_t lines = 0;
+    const char *last_line = begin;
+    for (const char *p = begin; p < sample_end; p++) {
+        p = static_cast<const char *>(memchr(p, '\n', sample_end - p));
+        if (!p) break;
+        lines++;
+        last_line = p + 1;
+    }
+    if (lines == 0) return 16;
+    double line_bytes = static_cast<double>(last_line - begin) / lines;
+    size_t rows = static_cast<size_t>(bytes / line_bytes);
+    return rows + rows / 16 + 16;
+}
+
+// Parses every line in [begin, end) (no header) and appends valid rows.
+inline void parse_csv_lines(const char *begin, const char *end, dynamic_array<StockData>& out, CsvLoadResult& result) {
+    TRACE_SCOPE("parse_csv_lines");
+    StockData stock;
+    const char *p = begin;
+    while (p < end) {
+        const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+        const char *line_end = newline ? newline : end;
+
+        if (line_end != p) {
+            parse_stock_row(p, line_end, stock);
+            if (valid_stock_row(stock)) {
+                out.add(stock);
+                result.valid_rows++;
+            } else {
+                record_skipped_row(result, stock);
+            }
+        }
+
+        p = newline ? newline + 1 : end;
+    }
+}
+
+inline bool load_csv_mmap(const std::string& filename, dynamic_array<StockData>& out, CsvLoadResult& result) {
+    TRACE_SCOPE("load_csv_mmap");
+    mapped_file file;
+    if (!file.open(filename)) {
+        return false;
+    }
+    result.source_bytes = file.size;
+    if (file.size == 0) {
+        return true;
+    }
+
+    const char *end = file.data + file.size;
+    const char *body = skip_csv_header(file.data, end);
+    out.reserve(out.size + estimate_csv_rows(body, end));
+    parse_csv_lines(body, end, out, result);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Parallel chunked parsing
+// ---------------------------------------------------------------------------
+
+// Files smaller than this are parsed serially; thread start-up would dominate.
+const size_t PARALLEL_CSV_MIN_BYTES = 4 * 1024 * 1024;
+const size_t PARALLEL_CSV_MIN_CHUNK = 1024 * 1024;
+
+// Splits [begin, end) into roughly equal chunks that each start at a line
+// start. The loader ends a row at every '\n', even inside quotes, so cutting
+// just after a newline never separates bytes the serial loader would keep
+// together - including the quoted "14,928,360" volumes, whose commas never
+// affect where a row ends.
+inline std::vector<const char *> split_csv_chunks(const char *begin, const char *end, size_t chunk_count) {
+    std::vector<const char *> bounds;
+    bounds.push_back(begin);
+    size_t total = static_cast<size_t>(end - begin);
+    for (size_t i = 1; i < chunk_count; i++) {
+        const char *cut = begin + total / chunk_count * i;
+        if (cut < bounds.back()) cut = bounds.back();
+        const char *newline = static_cast<const char *>(memchr(cut, '\n', end - cut));
+        cut = newline ? newline + 1 : end;
+        if (cut > bounds.back() && cut < end) bounds.push_back(cut);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+// Folds a chunk's counts into the running total. Debug rows only count while
+// no earlier chunk has produced a valid row, as in the serial loader.
+inline void merge_load_result(CsvLoadResult& total, const CsvLoadResult& chunk) {
+    if (total.valid_rows == 0) {
+        for (int i = 0; i < chunk.debug_count && total.skipped_rows + i + 1 <= 3; i++) {
+            total.debug_rows[total.debug_count++] = chunk.debug_rows[i];
+        }
+    }
+    total.valid_rows += chunk.valid_rows;
+    total.skipped_rows += chunk.skipped_rows;
+}
+
+// Parses chunks of the file on a thread pool into per-chunk buffers, then
+// appends them to `out` in file order after a single reservation. Rows,
+// order and counts are identical to load_csv_mmap.
+inline bool load_csv_parallel(const std::string& filename, dynamic_array<StockData>& out, CsvLoadResult& result,
+                              thread_pool& pool) {
+    TRACE_SCOPE("load_csv_parallel");
+    mapped_file file;
+    if (!file.open(filename)) {
+        return false;
+    }
+    result.source_bytes = file.size;
+    if (file.size == 0) {
+        return true;
+    }
+
+    const char *end = file.data + file.size;
+    const char *body = skip_csv_header(file.data, end);
+    size_t body_size = static_cast<size_t>(end - body);
+    if (pool.size() == 1 || body_size < PARALLEL_CSV_MIN_BYTES) {
+        out.reserve(out.size + estimate_csv_rows(body, end));
+        parse_csv_lines(body, end, out, result);
+        return true;
+    }
+
+    // A few chunks per thread keeps the workers busy when row density varies
+    size_t chunk_count = pool.size() * 4;
+    if (body_size / chunk_count < PARALLEL_CSV_MIN_CHUNK) {
+        chunk_count = body_size / PARALLEL_CSV_MIN_CHUNK + 1;
+    }
+    std::vector<const char *> bounds = split_csv_chunks(body, end, chunk_count);
+    size_t chunks = bounds.size() - 1;
+
+    std::vector<dynamic_array<StockData> > buffers(chunks);
+    std::vector<CsvLoadResult> results(chunks);
+
+    pool.run(static_cast<unsigned int>(chunks), [&](unsigned int task, unsigned int) {
+        buffers[task].reserve(estimate_csv_rows(bounds[task], bounds[task + 1]));
+        parse_csv_lines(bounds[task], bounds[task + 1], buffers[task], results[task]);
+    });
+
+    TRACE_SCOPE("merge_csv_chunks");
+    size_t total_rows = out.size;
+    for (size_t i = 0; i < chunks; i++) {
+        total_rows += buffers[i].size;
+    }
+    out.reserve(total_rows);
+
+    for (size_t i = 0; i < chunks; i++) {
+        for (size_t j = 0; j < buffers[i].size; j++) {
+            out.add(buffers[i][j]);
+        }
+        merge_load_result(result, results[i]);
+        buffers[i].clear();
+    }
+    return true;
+}
+
+inline bool load_csv_parallel(const std::string& filename, dynamic_array<StockData>& out, CsvLoadResult& result,
+                              unsigned int threads = 0) {
+    thread_pool pool(threads);
+    return load_csv_parallel(filename, out, result, pool);
+}
+
+// ---------------------------------------------------------------------------
+// Streaming pass in bounded memory
+// ---------------------------------------------------------------------------
+
+// Read size of stream_csv_rows. Memory stays at this (or the longest line,
+// if that is longer) however large the file is.
+const size_t CSV_STREAM_BUFFER_BYTES = 4 * 1024 * 1024;
+
+// Trade exports have three columns: time, price and size.
+inline bool is_trade_header(const char *begin, const char *end) {
+    int commas = 0;
+    for (const char *p = begin; p < end && *p != '\n'; p++) commas += *p == ',';
+    return commas == 2;
+}
+
+// One trade as a bar: open, high, low and close are the price, volume the size.
+inline void parse_trade_row(const char *line, const char *line_end, StockData& stock) {
+    const char *first = static_cast<const char *>(memchr(line, ',', line_end - line));
+    const char *second = first ? static_cast<const char *>(memchr(first + 1, ',', line_end - first - 1)) : nullptr;
+    stock.time = parse_timestamp(line, (first ? first : line_end) - line);
+    double price = first ? parse_price_field(first + 1, second ? second : line_end) : 0;
+    stock.open = stock.high = stock.low = stock.close = price;
+    stock.volume = second ? parse_volume_field(second + 1, line_end) : 0;
+}
+
+// Calls fn(row) for every valid row in file order. The file is read through
+// one fixed buffer instead of being mapped or loaded, so a multi-GB export
+// costs CSV_STREAM_BUFFER_BYTES of memory. Bar files go through the loader's
+// row parser; a file whose header has three columns is read as trades (see
+// parse_trade_row), and `trades`, if given, says which it is from the
+// first call to fn on. Returns false if the file cannot be opened.
+template <typename Fn>
+inline bool stream_csv_rows(const std::string& filename, CsvLoadResult& result, Fn fn, bool *trades = nullptr,
+                            size_t buffer_bytes = CSV_STREAM_BUFFER_BYTES) {
+    TRACE_SCOPE("stream_csv_rows");
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) return false;
+    std::vector<char> buffer(std::max<size_t>(buffer_bytes, 4096));
+    size_t kept = 0;            // partial line carried over from the last read
+    bool header = true, trade_rows = false, at_end = false;
+    StockData stock;
+    while (!at_end) {
+        if (kept == buffer.size()) buffer.resize(buffer.size() * 2);   // a line longer than the buffer
+        size_t got = fread(buffer.data() + kept, 1, buffer.size() - kept, file);
+        result.source_bytes += got;
+        at_end = got == 0;
+        const char *begin = buffer.data(), *end = begin + kept + got;
+        const char *last = end;
+        if (!at_end) {
+            while (last > begin && last[-1] != '\n') last--;
+            if (last == begin) {    // no complete line yet
+                kept += got;
+                continue;
+            }
+        }
+        const char *p = begin;
+        if (header) {
+            const char *newline = static_cast<const char *>(memchr(p, '\n', last - p));
+            trade_rows = is_trade_header(p, last);
+            if (trades) *trades = trade_rows;
+            p = newline ? newline + 1 : last;
+            header = false;
+        }
+        while (p < last) {
+            const char *newline = static_cast<const char *>(memchr(p, '\n', last - p));
+            const char *line_end = newline ? newline : last;
+            if (line_end != p) {
+                if (trade_rows) parse_trade_row(p, line_end, stock);
+                else parse_stock_row(p, line_end, stock);
+                if (valid_stock_row(stock)) {
+                    fn(stock);
+                    result.valid_rows++;
+                } else {
+                    record_skipped_row(result, stock);
+                }
+            }
+            p = newline ? newline + 1 : last;
+        }
+        kept = static_cast<size_t>(end - last);
+        memmove(buffer.data(), last, kept);
+    }
+    fclose(file);
+    if (trades) *trades = trade_rows;   // also for a file without rows
+    return true;
+}
+
+// Loads a CSV into the predictor's columnar series, in chronological order
+// whatever order the file is in, with one bar per timestamp (the later row
+// in the file wins). predictor.data is only the parse buffer and is emptied
+// afterwards. Returns false only if the file cannot be opened.
+inline bool load_stock_file(StockPredictor& predictor, const std::string& filename, CsvLoadResult& result,
+                            unsigned int threads = 0) {
+    TRACE_SCOPE("load_stock_file");
+    predictor.filename = filename;
+    predictor.company_name = extract_company_name(filename);
+
+    bool opened = threads == 1 ? load_csv_mmap(filename, predictor.data, result)
+                               : load_csv_parallel(filename, predictor.data, result, threads);
+    if (!opened) {
+        return false;
+    }
+
+    predictor.series.clear();
+    if (predictor.data.size > 0) {
+        build_price_series(predictor.data, predictor.series);
+        sort_series(predictor.series);
+    }
+    dynamic_array<StockData>().swap(predictor.data);
+    TRACE_COUNTER("rows_loaded", predictor.series.size);
+    return true;
+}
+
+#endif
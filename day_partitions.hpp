@@ -0,0 +1,433 @@
+// day_partitions.hpp - Intraday history split into one file per day, with precomputed timeframes
+#ifndef DAY_PARTITIONS_HPP
+#define DAY_PARTITIONS_HPP
+
+#include "binary_cache.hpp"
+#include "csv_loader.hpp"
+#include "mapped_file.hpp"
+#include "resampler.hpp"
+#include "series_order.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// A partition directory, written by write_day_partitions in one streaming
+// pass over a CSV of bars or trades:
+//
+//   manifest          text: format, ticker, row counts and one line per day
+//   YYYY-MM-DD.bars   one day: the raw rows and their 1m, 5m and 1h bars
+//   history.bars      the daily bars of the whole history
+//
+// A .bars file is a BarFileHeader followed by the columns of each section
+// (time as int64_t, then open, high, low, close, volume as double), every
+// column on a 64-byte boundary as in the binary cache. Readers map the file
+// and copy only the section they want, so loading a date range reads the
+// day files inside it and nothing else. Every section is written, even one
+// that is no coarser than the raw rows (1m bars of a one-minute export);
+// the loader drops those, as build_resolutions does.
+const char BAR_FILE_MAGIC[8] = { 'S', 'P', 'B', 'A', 'R', 'S', '\0', '\0' };
+const uint32_t BAR_FILE_VERSION = 1;
+const int BAR_FILE_MAX_SECTIONS = 4;
+const char *const PARTITION_MANIFEST = "manifest";
+const char *const PARTITION_HISTORY = "history.bars";
+const int PARTITION_FORMAT = 1;
+
+struct BarFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;          // CACHE_BYTE_ORDER
+    uint32_t section_count;
+    int32_t day;                  // epoch day of a day file, -1 for the history file
+    uint64_t file_size;
+    uint32_t timeframe[BAR_FILE_MAX_SECTIONS];
+    uint32_t rows[BAR_FILE_MAX_SECTIONS];
+    uint64_t column_offset[BAR_FILE_MAX_SECTIONS][CACHE_COLUMNS];
+    uint64_t checksum;            // over every byte after the header
+    char reserved[56];
+};
+
+static_assert(sizeof(BarFileHeader) % 64 == 0, "columns must start on a 64-byte boundary");
+
+// "2024-01-02"; sorts by date, unlike the CSV's MM/DD/YYYY.
+inline std::string iso_date(int32_t day) {
+    int year, month, date;
+    civil_from_days(day, year, month, date);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%04d-%02d-%02d", year, month, date);
+    return buf;
+}
+
+inline std::string day_partition_path(const std::string& dir, int32_t day) {
+    return dir + "/" + iso_date(day) + ".bars";
+}
+
+// Writes `count` sections through a temporary file, like write_stock_cache.
+inline bool write_bar_file(const std::string& path, int32_t day, const PriceSeries *const *sections,
+                           const Timeframe *timeframes, int count) {
+    TRACE_SCOPE("write_bar_file");
+    BarFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BAR_FILE_MAGIC, sizeof(header.magic));
+    header.version = BAR_FILE_VERSION;
+    header.byte_order = CACHE_BYTE_ORDER;
+    header.section_count = static_cast<uint32_t>(count);
+    header.day = day;
+    uint64_t offset = align_cache_offset(sizeof(BarFileHeader));
+    for (int s = 0; s < count; s++) {
+        header.timeframe[s] = static_cast<uint32_t>(timeframes[s]);
+        header.rows[s] = sections[s]->size;
+        for (int c = 0; c < CACHE_COLUMNS; c++) {
+            header.column_offset[s][c] = offset;
+            uint64_t width = c == 0 ? sizeof(int64_t) : sizeof(double);
+            offset = align_cache_offset(offset + width * sections[s]->size);
+        }
+    }
+    header.file_size = offset;
+
+    static const char zeros[CACHE_ALIGNMENT] = {};
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        cache_hash hash;
+        for (int s = 0; s < count; s++) {
+            const PriceSeries& series = *sections[s];
+            const char *columns[CACHE_COLUMNS] = {
+                reinterpret_cast<const char *>(series.time), reinterpret_cast<const char *>(series.open),
+                reinterpret_cast<const char *>(series.high), reinterpret_cast<const char *>(series.low),
+                reinterpret_cast<const char *>(series.close), reinterpret_cast<const char *>(series.volume) };
+            for (int c = 0; c < CACHE_COLUMNS; c++) {
+                size_t bytes = (c == 0 ? sizeof(int64_t) : sizeof(double)) * series.size;
+                size_t padding = static_cast<size_t>(align_cache_offset(bytes) - bytes);
+                if (bytes > 0) out.write(columns[c], static_cast<std::streamsize>(bytes));
+                out.write(zeros, static_cast<std::streamsize>(padding));
+                hash.add_words(columns[c], bytes);
+                hash.add_words(zeros, padding);
+            }
+        }
+        header.checksum = hash.value;
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (!out) {
+            out.close();
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// A mapped .bars file, checked on open.
+struct BarFile {
+    mapped_file file;
+    BarFileHeader header;
+
+    // False if the file is missing, from another version or byte order,
+    // malformed, or - with verify_checksum - corrupt.
+    bool open(const std::string& path, bool verify_checksum = false) {
+        if (!file.open(path) || file.size < sizeof(BarFileHeader)) return false;
+        memcpy(&header, file.data, sizeof(header));
+        bool valid = memcmp(header.magic, BAR_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                     header.version == BAR_FILE_VERSION && header.byte_order == CACHE_BYTE_ORDER &&
+                     header.file_size == file.size && header.section_count <= BAR_FILE_MAX_SECTIONS;
+        for (uint32_t s = 0; valid && s < header.section_count; s++) {
+            for (int c = 0; valid && c < CACHE_COLUMNS; c++) {
+                uint64_t width = c == 0 ? sizeof(int64_t) : sizeof(double);
+                uint64_t offset = header.column_offset[s][c];
+                valid = offset >= sizeof(BarFileHeader) && offset % CACHE_ALIGNMENT == 0 &&
+                        offset + width * header.rows[s] <= header.file_size;
+            }
+        }
+        if (valid && verify_checksum) {
+            cache_hash hash;
+            hash.add_words(file.data + sizeof(BarFileHeader), file.size - sizeof(BarFileHeader));
+            valid = hash.value == header.checksum;
+        }
+        if (!valid) file.close();
+        return valid;
+    }
+
+    // Section holding `timeframe`, or -1
+    int section(Timeframe timeframe) const {
+        for (uint32_t s = 0; s < header.section_count; s++) {
+            if (header.timeframe[s] == static_cast<uint32_t>(timeframe)) return static_cast<int>(s);
+        }
+        return -1;
+    }
+
+    const int64_t *times(int s) const {
+        return reinterpret_cast<const int64_t *>(file.data + header.column_offset[s][0]);
+    }
+
+    // Appends the bars of `timeframe` with from <= time < to (sections are
+    // chronological, so the slice is found by binary search).
+    bool append_to(Timeframe timeframe, PriceSeries& out, int64_t from = INT64_MIN, int64_t to = INT64_MAX) const {
+        int s = section(timeframe);
+        if (s < 0 || header.rows[s] == 0) return true;
+        const int64_t *time = times(s);
+        unsigned int begin = static_cast<unsigned int>(std::lower_bound(time, time + header.rows[s], from) - time);
+        unsigned int end = static_cast<unsigned int>(std::lower_bound(time, time + header.rows[s], to) - time);
+        const double *column[5];
+        for (int c = 0; c < 5; c++) column[c] = reinterpret_cast<const double *>(file.data + header.column_offset[s][c + 1]);
+        return begin >= end || out.append(end - begin, time + begin, column[0] + begin, column[1] + begin,
+                                          column[2] + begin, column[3] + begin, column[4] + begin);
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Manifest
+// ---------------------------------------------------------------------------
+
+struct PartitionManifest {
+    std::string ticker;
+    bool trades;                        // raw rows are trades rather than bars
+    int valid_rows, skipped_rows;       // of the source CSV
+    std::vector<int32_t> days;          // ascending
+    std::vector<unsigned int> day_rows; // raw rows of each day
+
+    PartitionManifest() : trades(false), valid_rows(0), skipped_rows(0) {}
+};
+
+inline bool write_partition_manifest(const std::string& dir, const PartitionManifest& manifest) {
+    std::string path = dir + "/" + PARTITION_MANIFEST, temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::trunc);
+        if (!out.is_open()) return false;
+        out << "hd-partitions " << PARTITION_FORMAT << "\n"
+            << "ticker " << manifest.ticker << "\n"
+            << "trades " << (manifest.trades ? 1 : 0) << "\n"
+            << "rows " << manifest.valid_rows << " " << manifest.skipped_rows << "\n";
+        for (size_t i = 0; i < manifest.days.size(); i++) {
+            out << "day " << iso_date(manifest.days[i]) << " " << manifest.day_rows[i] << "\n";
+        }
+        if (!out) {
+            out.close();
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+// False if `dir` has no manifest or it is not one this version reads.
+inline bool read_partition_manifest(const std::string& dir, PartitionManifest& manifest) {
+    std::ifstream in(dir + "/" + PARTITION_MANIFEST);
+    std::string line, key;
+    int format = 0;
+    if (!in.is_open() || !getline(in, line) || sscanf(line.c_str(), "hd-partitions %d", &format) != 1 ||
+        format != PARTITION_FORMAT) {
+        return false;
+    }
+    manifest = PartitionManifest();
+    while (getline(in, line)) {
+        std::istringstream fields(line);
+        fields >> key;
+        if (key == "ticker") {
+            getline(fields >> std::ws, manifest.ticker);
+        } else if (key == "trades") {
+            int trades = 0;
+            fields >> trades;
+            manifest.trades = trades != 0;
+        } else if (key == "rows") {
+            fields >> manifest.valid_rows >> manifest.skipped_rows;
+        } else if (key == "day") {
+            std::string date;
+            unsigned int rows = 0;
+            fields >> date >> rows;
+            int64_t time = parse_timestamp(date);
+            if (time == INVALID_TIMESTAMP) return false;
+            manifest.days.push_back(epoch_day(time));
+            manifest.day_rows.push_back(rows);
+        }
+    }
+    return true;
+}
+
+// True if `path` is a partition directory (has a readable manifest).
+inline bool is_partition_dir(const std::string& path) {
+    PartitionManifest manifest;
+    return read_partition_manifest(path, manifest);
+}
+
+// ---------------------------------------------------------------------------
+// Writing
+// ---------------------------------------------------------------------------
+
+// Day files are aggregated 1m -> 5m -> 1h from the raw rows.
+const Timeframe DAY_FILE_TIMEFRAMES[BAR_FILE_MAX_SECTIONS] = { TIMEFRAME_RAW, TIMEFRAME_1M, TIMEFRAME_5M, TIMEFRAME_1H };
+
+// Splits `csv_path` into a partition directory `dir` (created if needed) in
+// one pass: the file is streamed through stream_csv_rows and rows are
+// buffered one day at a time, so memory stays at a day of rows plus one
+// daily bar per day, whatever the size of the file. Each day is put in time
+// order before it is written: bars keep the last row of a repeated
+// timestamp, as load_stock_file does, while trades keep every row. Days may
+// come in any order; a day that shows up again is merged with what was
+// written for it. Files of an earlier split that are not in the new
+// manifest are ignored. `written`, if given, receives the manifest.
+inline bool write_day_partitions(const std::string& csv_path, const std::string& dir, CsvLoadResult& result,
+                                 PartitionManifest *written = nullptr) {
+    TRACE_SCOPE("write_day_partitions");
+    if (!make_directory(dir)) return false;
+    PriceSeries day_rows, sections[BAR_FILE_MAX_SECTIONS - 1], merged;
+    std::map<int32_t, unsigned int> days;   // day -> raw rows written
+    std::map<int32_t, int> daily_index;     // day -> its bar in the daily scratch series below
+    PriceSeries daily_bars;
+    std::vector<uint32_t> order;
+    bool trades = false, ok = true;
+    int32_t current = 0;
+
+    auto flush_day = [&]() -> bool {
+        if (day_rows.size == 0) return true;
+        std::string path = day_partition_path(dir, current);
+        if (days.count(current)) {
+            // Back to a day already written: earlier rows first, so later ones win
+            BarFile existing;
+            if (!existing.open(path)) return false;
+            merged.clear();
+            if (!existing.append_to(TIMEFRAME_RAW, merged) || !merged.append(day_rows, 0, day_rows.size)) return false;
+            existing.file.close();
+            day_rows.swap(merged);
+        }
+        if (trades) {
+            radix_sort_order(day_rows.time, day_rows.size, order);
+            if (!day_rows.permute(order.data(), day_rows.size)) return false;
+        } else if (!sort_series(day_rows, &order)) {
+            return false;
+        }
+
+        const PriceSeries *written_sections[BAR_FILE_MAX_SECTIONS] = { &day_rows };
+        const PriceSeries *source = &day_rows;
+        for (int s = 1; s < BAR_FILE_MAX_SECTIONS; s++) {
+            PriceSeries& bars = sections[s - 1];
+            if (!resample_series(*source, timeframe_period(DAY_FILE_TIMEFRAMES[s]), bars)) return false;
+            source = written_sections[s] = &bars;
+        }
+        if (!write_bar_file(path, current, written_sections, DAY_FILE_TIMEFRAMES, BAR_FILE_MAX_SECTIONS)) return false;
+        days[current] = day_rows.size;
+
+        // The day's daily bar, replacing the one from an earlier visit
+        PriceSeries day_bar;
+        if (!resample_series(*source, timeframe_period(TIMEFRAME_1D), day_bar) || day_bar.size != 1) return false;
+        std::map<int32_t, int>::iterator found = daily_index.find(current);
+        if (found == daily_index.end()) {
+            daily_index[current] = static_cast<int>(daily_bars.size);
+            if (!daily_bars.append(day_bar, 0, 1)) return false;
+        } else {
+            int i = found->second;
+            daily_bars.open[i] = day_bar.open[0];
+            daily_bars.high[i] = day_bar.high[0];
+            daily_bars.low[i] = day_bar.low[0];
+            daily_bars.close[i] = day_bar.close[0];
+            daily_bars.volume[i] = day_bar.volume[0];
+        }
+        day_rows.clear();
+        return true;
+    };
+
+    result = CsvLoadResult();
+    bool opened = stream_csv_rows(csv_path, result, [&](const StockData& row) {
+        int32_t day = epoch_day(row.time);
+        if (day != current && day_rows.size > 0) ok = ok && flush_day();
+        current = day;
+        ok = ok && day_rows.add(row.time, row.open, row.high, row.low, row.close, row.volume);
+    }, &trades);
+    if (!opened) return false;
+    ok = ok && flush_day();
+
+    // Daily bars in day order. Weeks are not stored: a range that starts or
+    // ends mid-week needs weeks of just its own days, which the loader
+    // aggregates from these.
+    PriceSeries history;
+    order.clear();
+    for (std::map<int32_t, int>::iterator it = daily_index.begin(); it != daily_index.end(); ++it) {
+        order.push_back(static_cast<uint32_t>(it->second));
+    }
+    ok = ok && daily_bars.permute(order.data(), static_cast<unsigned int>(order.size()));
+    history.swap(daily_bars);
+    const PriceSeries *history_section = &history;
+    const Timeframe history_timeframe = TIMEFRAME_1D;
+    ok = ok && write_bar_file(dir + "/" + PARTITION_HISTORY, -1, &history_section, &history_timeframe, 1);
+
+    PartitionManifest manifest;
+    manifest.ticker = extract_company_name(csv_path);
+    manifest.trades = trades;
+    manifest.valid_rows = result.valid_rows;
+    manifest.skipped_rows = result.skipped_rows;
+    for (std::map<int32_t, unsigned int>::iterator it = days.begin(); it != days.end(); ++it) {
+        manifest.days.push_back(it->first);
+        manifest.day_rows.push_back(it->second);
+    }
+    ok = ok && write_partition_manifest(dir, manifest);
+    if (written) *written = manifest;
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Reading
+// ---------------------------------------------------------------------------
+
+// Loads days [from_day, to_day] (epoch days, inclusive) at every timeframe:
+// the raw rows into `shown` and the rest into `set`, with raw active. Only
+// the manifest, the day files in the range and the history file are opened,
+// each once. Daily bars are read from the history file; weekly bars are
+// aggregated from them, so a partial week at either end holds only the
+// days in the range. False if the directory is not a partition set or a file in the
+// range is missing or damaged (with verify_checksum, corrupt).
+inline bool load_partition_range(const std::string& dir, int32_t from_day, int32_t to_day, ResolutionSet& set,
+                                 PriceSeries& shown, PartitionManifest& manifest, bool verify_checksum = false) {
+    TRACE_SCOPE("load_partition_range");
+    set.clear();
+    shown.clear();
+    if (!read_partition_manifest(dir, manifest)) return false;
+    std::vector<int32_t>::const_iterator first = std::lower_bound(manifest.days.begin(), manifest.days.end(), from_day);
+    std::vector<int32_t>::const_iterator last = std::upper_bound(manifest.days.begin(), manifest.days.end(), to_day);
+    size_t raw_rows = 0;
+    for (size_t i = first - manifest.days.begin(); i < static_cast<size_t>(last - manifest.days.begin()); i++) {
+        raw_rows += manifest.day_rows[i];
+    }
+    if (raw_rows > 0xFFFFFFFFu || !shown.reserve(static_cast<unsigned int>(raw_rows))) return false;
+
+    for (std::vector<int32_t>::const_iterator day = first; day != last; ++day) {
+        BarFile file;
+        if (!file.open(day_partition_path(dir, *day), verify_checksum) || file.header.day != *day) return false;
+        if (!file.append_to(TIMEFRAME_RAW, shown)) return false;
+        for (int s = 1; s < BAR_FILE_MAX_SECTIONS; s++) {
+            if (!file.append_to(DAY_FILE_TIMEFRAMES[s], set.bars[DAY_FILE_TIMEFRAMES[s]])) return false;
+        }
+    }
+    BarFile history;
+    if (!history.open(dir + "/" + PARTITION_HISTORY, verify_checksum)) return false;
+    int64_t from = static_cast<int64_t>(from_day) * SECONDS_PER_DAY, to = (static_cast<int64_t>(to_day) + 1) * SECONDS_PER_DAY;
+    if (!history.append_to(TIMEFRAME_1D, set.bars[TIMEFRAME_1D], from, to) ||
+        !resample_series(set.bars[TIMEFRAME_1D], timeframe_period(TIMEFRAME_1W), set.bars[TIMEFRAME_1W])) {
+        return false;
+    }
+
+    set.rows[TIMEFRAME_RAW] = shown.size;
+    for (int t = TIMEFRAME_1M; t < TIMEFRAME_COUNT; t++) {
+        set.rows[t] = set.bars[t].size;
+        if (set.rows[t] == shown.size) set.bars[t].clear();     // no coarser than the raw rows
+    }
+    return true;
+}
+
+#endif
@@ -2,142 +2,338 @@
 #ifndef DYNAMIC_ARRAY_HPP
 #define DYNAMIC_ARRAY_HPP
 
+#include "allocation_counter.hpp"
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
+// malloc-backed allocator whose storage can grow in place with realloc. The
+// container uses reallocate() for trivially copyable element types.
 template <typename T>
+struct malloc_allocator {
+    typedef T value_type;
+
+    malloc_allocator() {}
+    template <typename U>
+    malloc_allocator(const malloc_allocator<U>&) {}
+
+    T *allocate(size_t n) {
+        if (n > SIZE_MAX / sizeof(T)) throw std::bad_alloc();
+        void *p = std::malloc(n * sizeof(T));
+        if (!p) throw std::bad_alloc();
+        note_allocation(n * sizeof(T));
+        return static_cast<T *>(p);
+    }
+
+    void deallocate(T *p, size_t) {
+        std::free(p);
+    }
+
+    T *reallocate(T *p, size_t, size_t new_n) {
+        if (new_n > SIZE_MAX / sizeof(T)) throw std::bad_alloc();
+        void *grown = std::realloc(p, new_n * sizeof(T));
+        if (!grown) throw std::bad_alloc();
+        note_allocation(new_n * sizeof(T));
+        return static_cast<T *>(grown);
+    }
+
+    bool operator==(const malloc_allocator&) const { return true; }
+    bool operator!=(const malloc_allocator&) const { return false; }
+};
+
+// True for allocators with a reallocate(p, old_n, new_n) member.
+template <typename A>
+struct allocator_can_reallocate {
+    template <typename U>
+    static char test(decltype(std::declval<U&>().reallocate(nullptr, 0, 0)) *);
+    template <typename U>
+    static long test(...);
+    static const bool value = sizeof(test<A>(nullptr)) == sizeof(char);
+};
+
+// Growable array over uninitialized storage: only the first `size` slots
+// hold constructed elements, so reserving room for a million rows costs one
+// allocation and no constructor calls. Growth moves the elements (or
+// memcpy/reallocs them when T is trivially copyable). Storage comes from
+// `Allocator` (std::allocator by default).
+//
+// `size`, `capacity` and `data` stay public for the loops that index
+// data[i] directly; treat them as read-only.
+template <typename T, typename Allocator = std::allocator<T> >
 struct dynamic_array {
-    unsigned int size;
-    unsigned int capacity;
+    typedef T value_type;
+    typedef T *iterator;
+    typedef const T *const_iterator;
+
+    size_t size;
+    size_t capacity;
     T *data;
-    T default_value;
-    
+    T default_value;    // returned by get()/last() for a missing element
+
     // Constructor
-    dynamic_array(unsigned int initial_capacity, T default_val) {
-        size = 0;
-        capacity = initial_capacity;
-        default_value = default_val;
-        
-        if (capacity > 0) {
-            data = new T[capacity];
-        } else {
-            data = nullptr;
+    explicit dynamic_array(size_t initial_capacity = 0, const T& default_val = T(),
+                           const Allocator& alloc = Allocator())
+        : size(0), capacity(0), data(nullptr), default_value(default_val), allocator(alloc) {
+        reserve(initial_capacity);
+    }
+
+    dynamic_array(const dynamic_array& other)
+        : size(0), capacity(0), data(nullptr), default_value(other.default_value), allocator(other.allocator) {
+        if (reserve(other.size)) {
+            std::uninitialized_copy(other.data, other.data + other.size, data);
+            size = other.size;
         }
     }
-    
+
+    dynamic_array(dynamic_array&& other)
+        : size(other.size), capacity(other.capacity), data(other.data),
+          default_value(std::move(other.default_value)), allocator(std::move(other.allocator)) {
+        other.size = other.capacity = 0;
+        other.data = nullptr;
+    }
+
+    dynamic_array& operator=(dynamic_array other) {
+        swap(other);
+        return *this;
+    }
+
     // Destructor
     ~dynamic_array() {
-        if (data) {
-            delete[] data;
-            data = nullptr;
-        }
+        release();
     }
-    
-    // Add an element
-    bool add(T value) {
+
+    void swap(dynamic_array& other) {
+        std::swap(size, other.size);
+        std::swap(capacity, other.capacity);
+        std::swap(data, other.data);
+        std::swap(default_value, other.default_value);
+        std::swap(allocator, other.allocator);
+    }
+
+    // Add an element (which may be one of this array's own, as in a.add(a[0]))
+    bool add(const T& value) {
+        return emplace(value);
+    }
+
+    bool add(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    // Construct an element in place at the end
+    template <typename... Args>
+    bool emplace(Args&&... args) {
         if (size >= capacity) {
-            unsigned int new_capacity = (capacity > 0) ? capacity * 2 : 1;
-            if (!resize(new_capacity)) {
-                return false;
-            }
+            return grow_and_emplace(std::integral_constant<bool, can_reallocate>(), std::forward<Args>(args)...);
         }
-        
-        data[size] = value;
+        ::new (static_cast<void *>(data + size)) T(std::forward<Args>(args)...);
         size++;
         return true;
     }
-    
-    // Remove an element at index
-    bool remove(unsigned int index) {
+
+    // Remove an element at index, keeping the order (moves the tail down)
+    bool remove(size_t index) {
         if (index >= size) {
             return false;
         }
-        
-        for (unsigned int i = index; i < size - 1; i++) {
-            data[i] = data[i + 1];
+        std::move(data + index + 1, data + size, data + index);
+        data[--size].~T();
+        return true;
+    }
+
+    // Remove an element at index in O(1) by moving the last one into its place
+    bool remove_unordered(size_t index) {
+        if (index >= size) {
+            return false;
         }
-        size--;
+        if (index != size - 1) data[index] = std::move(data[size - 1]);
+        data[--size].~T();
         return true;
     }
-    
-    // Get element at index
-    T get(unsigned int index) const {
+
+    // Get element at index (default_value if out of range)
+    const T& get(size_t index) const {
         if (index >= size) {
             return default_value;
         }
         return data[index];
     }
-    
+
     // Set element at index
-    bool set(unsigned int index, T value) {
+    bool set(size_t index, const T& value) {
         if (index >= size) {
             return false;
         }
         data[index] = value;
         return true;
     }
-    
-    // Clear all elements
+
+    T& operator[](size_t index) {
+        return data[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data[index];
+    }
+
+    // Make room for at least new_capacity elements without changing size
+    bool reserve(size_t new_capacity) {
+        if (new_capacity <= capacity) {
+            return true;
+        }
+        return reallocate(new_capacity);
+    }
+
+    // Clear all elements (the storage is kept)
     void clear() {
+        destroy(data, data + size);
         size = 0;
     }
-    
-    // Get last element
-    T last() const {
+
+    // Get last element (default_value if empty)
+    const T& last() const {
         if (size > 0) {
             return data[size - 1];
         }
         return default_value;
     }
-    
+
     // Check if empty
     bool empty() const {
         return size == 0;
     }
-    
+
+    iterator begin() { return data; }
+    iterator end() { return data + size; }
+    const_iterator begin() const { return data; }
+    const_iterator end() const { return data + size; }
+
     // Find min/max (useful for price ranges)
-    T min() const {
+    const T& min() const {
         if (size == 0) return default_value;
-        T min_val = data[0];
-        for (unsigned int i = 1; i < size; i++) {
-            if (data[i] < min_val) min_val = data[i];
-        }
-        return min_val;
+        return *std::min_element(begin(), end());
     }
-    
-    T max() const {
+
+    const T& max() const {
         if (size == 0) return default_value;
-        T max_val = data[0];
-        for (unsigned int i = 1; i < size; i++) {
-            if (data[i] > max_val) max_val = data[i];
-        }
-        return max_val;
+        return *std::max_element(begin(), end());
     }
-    
+
 private:
-    bool resize(unsigned int new_capacity) {
-        T *new_data = new T[new_capacity];
-        if (!new_data) {
+    Allocator allocator;
+
+    static const bool can_reallocate =
+        std::is_trivially_copyable<T>::value && allocator_can_reallocate<Allocator>::value;
+
+    static void destroy(T *first, T *last) {
+        if (!std::is_trivially_destructible<T>::value) {
+            for (; first != last; ++first) first->~T();
+        }
+    }
+
+    size_t grown_capacity(size_t needed) const {
+        size_t new_capacity = capacity > 0 ? capacity * 2 : 4;
+        return new_capacity > needed ? new_capacity : needed;
+    }
+
+    // Growth path of emplace(). The arguments may refer to an element of
+    // this array, so they are read before the old storage is released:
+    // copied out first when realloc may free the block (T is trivially
+    // copyable there, so the copy is cheap), otherwise constructed straight
+    // into the new block before the old elements are moved over.
+    template <typename... Args>
+    bool grow_and_emplace(std::true_type, Args&&... args) {
+        T value(std::forward<Args>(args)...);
+        if (!reallocate(grown_capacity(size + 1))) {
+            return false;
+        }
+        ::new (static_cast<void *>(data + size)) T(value);
+        size++;
+        return true;
+    }
+
+    template <typename... Args>
+    bool grow_and_emplace(std::false_type, Args&&... args) {
+        size_t new_capacity = grown_capacity(size + 1);
+        T *new_data;
+        try {
+            new_data = allocator.allocate(new_capacity);
+        } catch (const std::bad_alloc&) {
             return false;
         }
-        
-        unsigned int items_to_copy = (size < new_capacity) ? size : new_capacity;
-        for (unsigned int i = 0; i < items_to_copy; i++) {
-            new_data[i] = data[i];
+        try {
+            ::new (static_cast<void *>(new_data + size)) T(std::forward<Args>(args)...);
+        } catch (...) {
+            allocator.deallocate(new_data, new_capacity);
+            throw;
         }
-        
         if (data) {
-            delete[] data;
+            relocate(data, data + size, new_data, std::is_trivially_copyable<T>());
+            allocator.deallocate(data, capacity);
         }
-        
         data = new_data;
         capacity = new_capacity;
-        
-        if (size > capacity) {
-            size = capacity;
+        size++;
+        return true;
+    }
+
+    // Storage for exactly new_capacity elements; new_capacity >= size
+    bool reallocate(size_t new_capacity) {
+        return reallocate(new_capacity, std::integral_constant<bool, can_reallocate>());
+    }
+
+    // realloc in place for trivially copyable types
+    bool reallocate(size_t new_capacity, std::true_type) {
+        try {
+            data = data ? allocator.reallocate(data, capacity, new_capacity) : allocator.allocate(new_capacity);
+        } catch (const std::bad_alloc&) {
+            return false;
+        }
+        capacity = new_capacity;
+        return true;
+    }
+
+    // New block, then move (or memcpy) the elements across
+    bool reallocate(size_t new_capacity, std::false_type) {
+        T *new_data;
+        try {
+            new_data = allocator.allocate(new_capacity);
+        } catch (const std::bad_alloc&) {
+            return false;
+        }
+        if (data) {
+            relocate(data, data + size, new_data, std::is_trivially_copyable<T>());
+            allocator.deallocate(data, capacity);
         }
-        
+        data = new_data;
+        capacity = new_capacity;
         return true;
     }
+
+    static void relocate(T *first, T *last, T *out, std::true_type) {
+        if (first != last) std::memcpy(static_cast<void *>(out), first, (last - first) * sizeof(T));
+    }
+
+    static void relocate(T *first, T *last, T *out, std::false_type) {
+        for (T *p = first; p != last; ++p, ++out) {
+            ::new (static_cast<void *>(out)) T(std::move_if_noexcept(*p));
+            p->~T();
+        }
+    }
+
+    void release() {
+        if (data) {
+            destroy(data, data + size);
+            allocator.deallocate(data, capacity);
+        }
+        data = nullptr;
+        size = capacity = 0;
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
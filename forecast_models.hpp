@@ -0,0 +1,413 @@
+// forecast_models.hpp - Autoregressive and Holt-Winters forecasts with prediction intervals
+//
+// Both models forecast FORECAST_HORIZON bars ahead with a standard error per
+// step, so the UI can draw a fan and the confidence of a prediction comes
+// from the fit instead of a fixed per-model number.
+//
+//  - AR(p) is fitted to the bar-to-bar changes of the close (prices wander,
+//    their changes are close to stationary) with an intercept for drift, by
+//    least squares on normal equations accumulated in one pass (see
+//    least_squares.hpp). Many tickers are fitted side by side with one
+//    ticker per SIMD lane; every lane performs the scalar fit's multiplies
+//    and adds in the same order, so the batch is bit-identical to it (up to
+//    FMA contraction if the scalar build enables it).
+//  - Holt-Winters is additive exponential smoothing of level, trend and an
+//    optional season of season_length bars (0 gives Holt's linear trend).
+#ifndef FORECAST_MODELS_HPP
+#define FORECAST_MODELS_HPP
+
+#include "least_squares.hpp"
+#include "simd_kernels.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+const int FORECAST_HORIZON = 10;
+const double FORECAST_INTERVAL_Z = 1.959963984540054;  // two-sided 95% normal quantile
+const int AR_MAX_ORDER = LSQ_MAX_TERMS - 1;
+
+// Forecast means and standard errors for the next `steps` bars.
+struct ForecastPath {
+    int steps;      // 0 when the model could not be fitted
+    double mean[FORECAST_HORIZON];
+    double sd[FORECAST_HORIZON];
+
+    ForecastPath() : steps(0) {
+        for (int h = 0; h < FORECAST_HORIZON; h++) mean[h] = sd[h] = 0;
+    }
+
+    double lower(int h) const {
+        return mean[h] - FORECAST_INTERVAL_Z * sd[h];
+    }
+
+    double upper(int h) const {
+        return mean[h] + FORECAST_INTERVAL_Z * sd[h];
+    }
+};
+
+// Probability, under the forecast's own error distribution, that the next
+// close lands on the side of the last close the forecast points to: 0.5 for
+// a forecast of no change, near 1 when the move is large next to its error.
+inline double direction_confidence(const ForecastPath& path, double last_close) {
+    if (path.steps == 0) return 0;
+    double move = std::fabs(path.mean[0] - last_close);
+    if (!(path.sd[0] > 0)) return move > 0 ? 1 : 0.5;
+    return 0.5 * std::erfc(-move / path.sd[0] / std::sqrt(2.0));
+}
+
+// --- Autoregressive model ---
+
+struct ArFit {
+    bool ok;
+    int order;
+    double intercept;           // mean change not explained by the lags (drift)
+    double phi[AR_MAX_ORDER];   // phi[k] multiplies the change k + 1 bars back
+    double sigma;               // standard error of a one-bar change
+    double r_squared;           // of the changes, not the prices
+    double rows;
+
+    ArFit() : ok(false), order(0), intercept(0), sigma(0), r_squared(0), rows(0) {
+        for (int k = 0; k < AR_MAX_ORDER; k++) phi[k] = 0;
+    }
+};
+
+inline int clamp_ar_order(int order) {
+    return order < 1 ? 1 : (order > AR_MAX_ORDER ? AR_MAX_ORDER : order);
+}
+
+// Bars needed before an AR(order) fit has more rows than coefficients
+inline unsigned int ar_min_bars(int order) {
+    return 2 * static_cast<unsigned int>(clamp_ar_order(order)) + 3;
+}
+
+// Normal equations of the AR(order) regression d[t] = c + sum phi[k] d[t-1-k]
+// over the changes d[t] = close[t] - close[t-1], one row per t >= order + 1.
+inline void autoregressive_equations(const double *close, unsigned int n, int order, NormalEquations& eq) {
+    eq.reset(order + 1);
+    if (n < static_cast<unsigned int>(order) + 2) return;
+    double x[LSQ_MAX_TERMS];
+    x[0] = 1;
+    for (int k = 1; k <= order; k++) x[k] = close[order + 1 - k] - close[order - k];
+    for (unsigned int t = order + 1; t < n; t++) {
+        double d = close[t] - close[t - 1];
+        eq.add(x, d);
+        for (int k = order; k > 1; k--) x[k] = x[k - 1];
+        x[1] = d;
+    }
+}
+
+inline ArFit solve_autoregressive(const NormalEquations& eq) {
+    ArFit fit;
+    fit.order = eq.terms - 1;
+    fit.rows = eq.rows;
+    if (eq.rows < eq.terms + 1) return fit;
+    double beta[LSQ_MAX_TERMS];
+    if (!eq.solve(beta)) return fit;
+    fit.intercept = beta[0];
+    for (int k = 0; k < fit.order; k++) fit.phi[k] = beta[k + 1];
+    double rss = eq.residual_ss(beta);
+    double centered = eq.yty - eq.xty[0] * eq.xty[0] / eq.rows;
+    fit.sigma = std::sqrt(rss / (eq.rows - eq.terms));
+    fit.r_squared = centered > 0 ? std::max(0.0, 1 - rss / centered) : 0;
+    fit.ok = true;
+    return fit;
+}
+
+inline ArFit fit_autoregressive(const double *close, unsigned int n, int order) {
+    NormalEquations eq;
+    autoregressive_equations(close, n, clamp_ar_order(order), eq);
+    return solve_autoregressive(eq);
+}
+
+// Forecast of the close from the last close and the most recent changes
+// (lags[0] the newest, at least fit.order of them). The changes are run
+// forward through the AR recurrence and summed onto the close; the h-step
+// price error is the sum of h change errors, whose variance follows from
+// the impulse response (psi weights) of the recurrence.
+inline ForecastPath autoregressive_forecast(const ArFit& fit, const double *lags, double last_close,
+                                            int steps = FORECAST_HORIZON) {
+    ForecastPath path;
+    if (!fit.ok) return path;
+    steps = std::min(steps, FORECAST_HORIZON);
+    int p = fit.order;
+    double changes[AR_MAX_ORDER + FORECAST_HORIZON];   // oldest first
+    for (int k = 0; k < p; k++) changes[k] = lags[p - 1 - k];
+    double psi[FORECAST_HORIZON];
+    double price = last_close, psi_sum = 0, variance = 0;
+    for (int h = 0; h < steps; h++) {
+        double d = fit.intercept;
+        for (int k = 0; k < p; k++) d += fit.phi[k] * changes[p + h - 1 - k];
+        changes[p + h] = d;
+        price += d;
+
+        psi[h] = h == 0 ? 1 : 0;
+        for (int k = 0; k < p && k < h; k++) psi[h] += fit.phi[k] * psi[h - 1 - k];
+        psi_sum += psi[h];
+        variance += psi_sum * psi_sum;
+        path.mean[h] = price;
+        path.sd[h] = fit.sigma * std::sqrt(variance);
+    }
+    path.steps = steps;
+    return path;
+}
+
+// Forecast from the end of a close series
+inline ForecastPath autoregressive_series_forecast(const ArFit& fit, const double *close, unsigned int n,
+                                                   int steps = FORECAST_HORIZON) {
+    if (!fit.ok || n < static_cast<unsigned int>(fit.order) + 1) return ForecastPath();
+    double lags[AR_MAX_ORDER];
+    for (int k = 0; k < fit.order; k++) lags[k] = close[n - 1 - k] - close[n - 2 - k];
+    return autoregressive_forecast(fit, lags, close[n - 1], steps);
+}
+
+// Tickers fitted together by one pass of fit_autoregressive_batch
+inline unsigned int ar_batch_lanes(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX2: return 4;
+        case SIMD_SSE2: return 2;
+        default: return 1;
+    }
+}
+
+inline double lane_close(const double *const *closes, const unsigned int *sizes, int lane, unsigned int t) {
+    return t < sizes[lane] ? closes[lane][t] : 0;
+}
+
+#ifdef SIMD_KERNELS_X86
+// autoregressive_equations for four series at once. Each lane's regressors
+// and target are scaled by a 1/0 weight that drops to 0 past the end of its
+// series, so shorter series stop accumulating; while it is 1 the products
+// are exactly the scalar ones.
+SIMD_TARGET_AVX2 inline void autoregressive_equations_avx2(const double *const *closes, const unsigned int *sizes,
+                                                           int order, NormalEquations *out) {
+    const int terms = order + 1;
+    const int packed = packed_index(terms, 0);
+    __m256d xtx[LSQ_MAX_PACKED], xty[LSQ_MAX_TERMS], lag[LSQ_MAX_TERMS], x[LSQ_MAX_TERMS];
+    for (int i = 0; i < packed; i++) xtx[i] = _mm256_setzero_pd();
+    for (int i = 0; i < terms; i++) xty[i] = _mm256_setzero_pd();
+    __m256d yty = _mm256_setzero_pd(), rows = _mm256_setzero_pd();
+    unsigned int longest = std::max(std::max(sizes[0], sizes[1]), std::max(sizes[2], sizes[3]));
+
+#define AR_LOAD4(t) _mm256_set_pd(lane_close(closes, sizes, 3, t), lane_close(closes, sizes, 2, t), \
+                                  lane_close(closes, sizes, 1, t), lane_close(closes, sizes, 0, t))
+    for (int k = 1; k <= order; k++) lag[k] = _mm256_sub_pd(AR_LOAD4(order + 1 - k), AR_LOAD4(order - k));
+    __m256d previous = AR_LOAD4(order);
+    for (unsigned int t = order + 1; t < longest; t++) {
+        __m256d current = AR_LOAD4(t);
+        __m256d d = _mm256_sub_pd(current, previous);
+        __m256d w = _mm256_set_pd(t < sizes[3], t < sizes[2], t < sizes[1], t < sizes[0]);
+        x[0] = w;
+        for (int k = 1; k <= order; k++) x[k] = _mm256_mul_pd(w, lag[k]);
+        __m256d y = _mm256_mul_pd(w, d);
+        __m256d *row = xtx;
+        for (int i = 0; i < terms; i++) {
+            for (int j = 0; j <= i; j++) row[j] = _mm256_add_pd(row[j], _mm256_mul_pd(x[i], x[j]));
+            row += i + 1;
+            xty[i] = _mm256_add_pd(xty[i], _mm256_mul_pd(x[i], y));
+        }
+        yty = _mm256_add_pd(yty, _mm256_mul_pd(y, y));
+        rows = _mm256_add_pd(rows, w);
+        for (int k = order; k > 1; k--) lag[k] = lag[k - 1];
+        lag[1] = d;
+        previous = current;
+    }
+#undef AR_LOAD4
+
+    alignas(32) double lanes[4];
+    for (int l = 0; l < 4; l++) out[l].reset(terms);
+    for (int i = 0; i < packed; i++) {
+        _mm256_store_pd(lanes, xtx[i]);
+        for (int l = 0; l < 4; l++) out[l].xtx[i] = lanes[l];
+    }
+    for (int i = 0; i < terms; i++) {
+        _mm256_store_pd(lanes, xty[i]);
+        for (int l = 0; l < 4; l++) out[l].xty[i] = lanes[l];
+    }
+    _mm256_store_pd(lanes, yty);
+    for (int l = 0; l < 4; l++) out[l].yty = lanes[l];
+    _mm256_store_pd(lanes, rows);
+    for (int l = 0; l < 4; l++) out[l].rows = lanes[l];
+}
+
+SIMD_TARGET_SSE2 inline void autoregressive_equations_sse2(const double *const *closes, const unsigned int *sizes,
+                                                           int order, NormalEquations *out) {
+    const int terms = order + 1;
+    const int packed = packed_index(terms, 0);
+    __m128d xtx[LSQ_MAX_PACKED], xty[LSQ_MAX_TERMS], lag[LSQ_MAX_TERMS], x[LSQ_MAX_TERMS];
+    for (int i = 0; i < packed; i++) xtx[i] = _mm_setzero_pd();
+    for (int i = 0; i < terms; i++) xty[i] = _mm_setzero_pd();
+    __m128d yty = _mm_setzero_pd(), rows = _mm_setzero_pd();
+    unsigned int longest = std::max(sizes[0], sizes[1]);
+
+#define AR_LOAD2(t) _mm_set_pd(lane_close(closes, sizes, 1, t), lane_close(closes, sizes, 0, t))
+    for (int k = 1; k <= order; k++) lag[k] = _mm_sub_pd(AR_LOAD2(order + 1 - k), AR_LOAD2(order - k));
+    __m128d previous = AR_LOAD2(order);
+    for (unsigned int t = order + 1; t < longest; t++) {
+        __m128d current = AR_LOAD2(t);
+        __m128d d = _mm_sub_pd(current, previous);
+        __m128d w = _mm_set_pd(t < sizes[1], t < sizes[0]);
+        x[0] = w;
+        for (int k = 1; k <= order; k++) x[k] = _mm_mul_pd(w, lag[k]);
+        __m128d y = _mm_mul_pd(w, d);
+        __m128d *row = xtx;
+        for (int i = 0; i < terms; i++) {
+            for (int j = 0; j <= i; j++) row[j] = _mm_add_pd(row[j], _mm_mul_pd(x[i], x[j]));
+            row += i + 1;
+            xty[i] = _mm_add_pd(xty[i], _mm_mul_pd(x[i], y));
+        }
+        yty = _mm_add_pd(yty, _mm_mul_pd(y, y));
+        rows = _mm_add_pd(rows, w);
+        for (int k = order; k > 1; k--) lag[k] = lag[k - 1];
+        lag[1] = d;
+        previous = current;
+    }
+#undef AR_LOAD2
+
+    alignas(16) double lanes[2];
+    for (int l = 0; l < 2; l++) out[l].reset(terms);
+    for (int i = 0; i < packed; i++) {
+        _mm_store_pd(lanes, xtx[i]);
+        for (int l = 0; l < 2; l++) out[l].xtx[i] = lanes[l];
+    }
+    for (int i = 0; i < terms; i++) {
+        _mm_store_pd(lanes, xty[i]);
+        for (int l = 0; l < 2; l++) out[l].xty[i] = lanes[l];
+    }
+    _mm_store_pd(lanes, yty);
+    for (int l = 0; l < 2; l++) out[l].yty = lanes[l];
+    _mm_store_pd(lanes, rows);
+    for (int l = 0; l < 2; l++) out[l].rows = lanes[l];
+}
+#endif
+
+// Fits AR(order) to `count` close series; fits[i] belongs to closes[i].
+// Series are sorted by length and fitted in groups of ar_batch_lanes(level),
+// so one pass over the longest series of a group fits the whole group and
+// lanes rarely idle. Groups are spread over `pool` when one is given.
+inline void fit_autoregressive_batch(const double *const *closes, const unsigned int *sizes, size_t count, int order,
+                                     ArFit *fits, thread_pool *pool = nullptr,
+                                     SimdLevel level = active_simd_level()) {
+    order = clamp_ar_order(order);
+    unsigned int lanes = ar_batch_lanes(level);
+    std::vector<size_t> by_length(count);
+    for (size_t i = 0; i < count; i++) by_length[i] = i;
+    std::stable_sort(by_length.begin(), by_length.end(), [sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    unsigned int groups = static_cast<unsigned int>((count + lanes - 1) / lanes);
+    thread_pool::task_fn fit_group = [&](unsigned int group, unsigned int) {
+        size_t first = static_cast<size_t>(group) * lanes;
+        size_t members = std::min<size_t>(lanes, count - first);
+        const double *group_closes[4];
+        unsigned int group_sizes[4];
+        for (size_t l = 0; l < 4; l++) {
+            bool used = l < members;
+            group_closes[l] = used ? closes[by_length[first + l]] : nullptr;
+            group_sizes[l] = used ? sizes[by_length[first + l]] : 0;
+        }
+        NormalEquations eq[4];
+        switch (level) {
+#ifdef SIMD_KERNELS_X86
+            case SIMD_AVX2: autoregressive_equations_avx2(group_closes, group_sizes, order, eq); break;
+            case SIMD_SSE2: autoregressive_equations_sse2(group_closes, group_sizes, order, eq); break;
+#endif
+            default:
+                for (size_t l = 0; l < members; l++) {
+                    autoregressive_equations(group_closes[l], group_sizes[l], order, eq[l]);
+                }
+                break;
+        }
+        for (size_t l = 0; l < members; l++) fits[by_length[first + l]] = solve_autoregressive(eq[l]);
+    };
+    if (pool) {
+        pool->run(groups, fit_group);
+    } else {
+        for (unsigned int g = 0; g < groups; g++) fit_group(g, 0);
+    }
+}
+
+// --- Holt-Winters ---
+
+// Additive Holt-Winters in O(1) per bar. The first bar sets the level, the
+// second the trend; from the third on each bar's one-step-ahead error is
+// recorded for the interval width. Intervals use the variance of the
+// equivalent additive state-space model, whose level, trend and season take
+// alpha, alpha * beta and gamma * (1 - alpha) of each error.
+struct HoltWinters {
+    double alpha, beta, gamma;
+    unsigned int season_length;     // below 2: no seasonal term (Holt's linear trend)
+    unsigned long long count;
+    double level, trend;
+    std::vector<double> season;     // seasonal terms, one per bar of the cycle
+    unsigned int season_pos;        // slot of the next bar's term
+    double sse;
+    unsigned long long errors;
+
+    explicit HoltWinters(double level_alpha = 0.5, double trend_beta = 0.1, double season_gamma = 0.1,
+                         unsigned int length = 0)
+        : alpha(level_alpha), beta(trend_beta), gamma(season_gamma), season_length(length < 2 ? 0 : length) {
+        season.assign(season_length, 0.0);
+        reset();
+    }
+
+    void reset() {
+        count = 0;
+        level = trend = 0;
+        for (size_t i = 0; i < season.size(); i++) season[i] = 0;
+        season_pos = 0;
+        sse = 0;
+        errors = 0;
+    }
+
+    double seasonal(unsigned int ahead = 0) const {
+        return season_length ? season[(season_pos + ahead) % season_length] : 0;
+    }
+
+    void add(double y) {
+        if (count == 0) {
+            level = y;
+        } else if (count == 1) {
+            trend = y - level;
+            level = y;
+        } else {
+            double s = seasonal();
+            double error = y - (level + trend + s);
+            sse += error * error;
+            errors++;
+            double previous = level;
+            level = alpha * (y - s) + (1 - alpha) * (level + trend);
+            trend = beta * (level - previous) + (1 - beta) * trend;
+            if (season_length) season[season_pos] = gamma * (y - level) + (1 - gamma) * s;
+        }
+        if (season_length) season_pos = season_pos + 1 == season_length ? 0 : season_pos + 1;
+        count++;
+    }
+
+    double next() const {
+        return level + trend + seasonal();
+    }
+
+    double sigma() const {
+        return errors > 0 ? std::sqrt(sse / errors) : 0;
+    }
+
+    ForecastPath forecast(int steps = FORECAST_HORIZON) const {
+        ForecastPath path;
+        if (errors == 0) return path;
+        steps = std::min(steps, FORECAST_HORIZON);
+        double s2 = sigma() * sigma(), variance = 1;
+        for (int h = 0; h < steps; h++) {
+            if (h > 0) {
+                bool season_repeats = season_length && h % season_length == 0;
+                double c = alpha * (1 + beta * h) + (season_repeats ? gamma * (1 - alpha) : 0);
+                variance += c * c;
+            }
+            path.mean[h] = level + (h + 1) * trend + seasonal(h);
+            path.sd[h] = std::sqrt(s2 * variance);
+        }
+        path.steps = steps;
+        return path;
+    }
+};
+
+#endif
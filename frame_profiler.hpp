@@ -0,0 +1,105 @@
+// frame_profiler.hpp - Per-frame CPU time, wall time and heap allocation counts for the render loop
+#ifndef FRAME_PROFILER_HPP
+#define FRAME_PROFILER_HPP
+
+#include "allocation_counter.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+// CPU time of the calling thread in milliseconds (process CPU time where
+// per-thread clocks are unavailable).
+inline double thread_cpu_ms() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+    }
+#endif
+    return 1e3 * std::clock() / CLOCKS_PER_SEC;
+}
+
+// Totals for one kind of frame over a reporting interval
+struct FrameStats {
+    unsigned long frames;
+    double cpu_ms;
+    double max_cpu_ms;
+    unsigned long long allocations;
+    unsigned long long bytes;
+
+    FrameStats() : frames(0), cpu_ms(0), max_cpu_ms(0), allocations(0), bytes(0) {}
+
+    void add(double frame_cpu_ms, unsigned long long frame_allocations, unsigned long long frame_bytes) {
+        frames++;
+        cpu_ms += frame_cpu_ms;
+        if (frame_cpu_ms > max_cpu_ms) max_cpu_ms = frame_cpu_ms;
+        allocations += frame_allocations;
+        bytes += frame_bytes;
+    }
+
+    double avg_cpu_ms() const {
+        return frames > 0 ? cpu_ms / frames : 0;
+    }
+
+    double avg_allocations() const {
+        return frames > 0 ? static_cast<double>(allocations) / frames : 0;
+    }
+
+    double avg_bytes() const {
+        return frames > 0 ? static_cast<double>(bytes) / frames : 0;
+    }
+};
+
+// Brackets each iteration of the render loop. Frames that repainted the
+// screen and idle frames (input polling only) are accounted separately;
+// every report_interval_ms a summary is published and the counters restart.
+struct FrameProfiler {
+    unsigned int report_interval_ms;
+    FrameStats drawn;
+    FrameStats idle;
+    std::string last_summary;
+
+    explicit FrameProfiler(unsigned int interval_ms = 2000)
+        : report_interval_ms(interval_ms), frame_cpu_start(0), frame_allocations_start(0), frame_bytes_start(0),
+          interval_start(std::chrono::steady_clock::now()) {}
+
+    void begin_frame() {
+        frame_cpu_start = thread_cpu_ms();
+        frame_allocations_start = allocation_count().load(std::memory_order_relaxed);
+        frame_bytes_start = allocation_bytes().load(std::memory_order_relaxed);
+    }
+
+    // Returns true when a new summary is available in last_summary.
+    bool end_frame(bool presented) {
+        double cpu = thread_cpu_ms() - frame_cpu_start;
+        unsigned long long allocations = allocation_count().load(std::memory_order_relaxed) - frame_allocations_start;
+        unsigned long long bytes = allocation_bytes().load(std::memory_order_relaxed) - frame_bytes_start;
+        (presented ? drawn : idle).add(cpu, allocations, bytes);
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double elapsed_ms = std::chrono::duration<double, std::milli>(now - interval_start).count();
+        if (elapsed_ms < report_interval_ms) return false;
+
+        char buf[256];
+        snprintf(buf, sizeof(buf),
+                 "frames: %lu drawn (%.3f ms cpu avg, %.3f max, %.1f allocs, %.0f B) / %lu idle (%.3f ms cpu, %.1f allocs) in %.1f s",
+                 drawn.frames, drawn.avg_cpu_ms(), drawn.max_cpu_ms, drawn.avg_allocations(), drawn.avg_bytes(),
+                 idle.frames, idle.avg_cpu_ms(), idle.avg_allocations(), elapsed_ms / 1000);
+        last_summary = buf;
+        drawn = FrameStats();
+        idle = FrameStats();
+        interval_start = now;
+        return true;
+    }
+
+private:
+    double frame_cpu_start;
+    unsigned long long frame_allocations_start;
+    unsigned long long frame_bytes_start;
+    std::chrono::steady_clock::time_point interval_start;
+};
+
+#endif
@@ -1,42 +1,29 @@
 #include "splashkit.h"
-#include "dynamic_array.hpp"
+#include "allocation_hook.hpp"
+#include "stock_predictor.hpp"
+#include "binary_cache.hpp"
+#include "backtest.hpp"
+#include "param_search.hpp"
+#include "candle_pyramid.hpp"
+#include "frame_profiler.hpp"
+#include "prefix_regression.hpp"
+#include "ingest_pipeline.hpp"
+#include "portfolio.hpp"
+#include "correlation_matrix.hpp"
+#include "indicators.hpp"
+#include "monte_carlo.hpp"
+#include "day_partitions.hpp"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <cmath>
 #include <iomanip>
 #include <string>
 #include <algorithm>
+#include <vector>
+#include <cstdlib>
+#include <new>
 
 using namespace std;
 
-// Enums and structures
-enum PredictionModel { LINEAR_REGRESSION, MOVING_AVERAGE, EXPONENTIAL_SMOOTHING };
-
-struct StockData {
-    string date;
-    double open, high, low, close, volume;
-    double sma5, prediction;
-    
-    StockData() : open(0), high(0), low(0), close(0), volume(0), sma5(0), prediction(0) {}
-};
-
-struct PredictionStats {
-    double slope, intercept, r_squared, next_prediction, confidence;
-    
-    PredictionStats() : slope(0), intercept(0), r_squared(0), next_prediction(0), confidence(0) {}
-};
-
-struct StockPredictor {
-    dynamic_array<StockData> data;
-    PredictionModel model;
-    PredictionStats stats;
-    string company_name;
-    string filename;
-    
-    StockPredictor() : data(50, StockData()), model(LINEAR_REGRESSION), stats(), company_name("Unknown"), filename("") {}
-};
-
 // Constants
 const int WINDOW_WIDTH = 1200;
 const int WINDOW_HEIGHT = 700;
@@ -48,361 +35,1019 @@ const color GRID_COLOR = rgb_color(220, 220, 225);
 const color UP_COLOR = rgb_color(34, 197, 94);
 const color DOWN_COLOR = rgb_color(239, 68, 68);
 
-// Utility functions
-string extract_company_name(const string& filename) {
-    // Extract company ticker from filename like "STOCK_US_XNAS_GOOG.csv"
-    size_t last_underscore = filename.find_last_of('_');
-    size_t dot_pos = filename.find_last_of('.');
+// Button labels and colours, indexed by PredictionModel
+const string MODEL_NAMES[MODEL_COUNT] = {"Linear Regression", "Moving Average", "Exp. Smoothing", "Autoregressive",
+                                         "Holt-Winters"};
+const color MODEL_COLORS[MODEL_COUNT] = {COLOR_BLUE, COLOR_GREEN, COLOR_PURPLE, COLOR_ORANGE, rgb_color(13, 148, 136)};
+
+// Model buttons in the control panel, relative to its top
+const int MODEL_BUTTON_TOP = 40;
+const int MODEL_BUTTON_HEIGHT = 28;
+const int MODEL_BUTTON_SPACING = 34;
+
+// Render loop pacing: with nothing invalidated the loop only polls input,
+// sleeping IDLE_DELAY_MS between polls, and re-presents the cached scene at
+// least every IDLE_REFRESH_MS (so a window uncovered by another one repaints).
+const int IDLE_DELAY_MS = 15;
+const unsigned int IDLE_REFRESH_MS = 500;
+
+// Regions of the scene bitmap that need redrawing before the next present
+const unsigned int DIRTY_CHART = 1;      // background, title, grid, price labels, candles
+const unsigned int DIRTY_CONTROLS = 2;   // model buttons, prediction, parameters
+const unsigned int DIRTY_INFO = 4;       // latest bar panel
+const unsigned int DIRTY_OVERLAY = 8;    // trend line and profiler text (drawn every present)
+const unsigned int DIRTY_ALL = DIRTY_CHART | DIRTY_CONTROLS | DIRTY_INFO | DIRTY_OVERLAY;
+
+// Data loading: the file is memory-mapped and parsed in place (see csv_loader.hpp).
+// Large files are split into chunks parsed on `threads` threads (0 = all cores).
+// The parsed columns are cached next to the CSV (<file>.cache) and mapped
+// directly on later runs while the CSV is unchanged (see binary_cache.hpp).
+// Several files of one ticker are merged into one history (see series_order.hpp).
+// `source_bytes` receives how much of the file was read, where follow mode resumes.
+bool load_stock_data(StockPredictor& predictor, const vector<string>& files, unsigned int threads = 0,
+                     const CacheOptions& cache = CacheOptions(), size_t *source_bytes = nullptr) {
+    TRACE_SCOPE("load_stock_data");
+    CsvLoadResult result;
+    bool from_cache = false;
+    bool opened = files.size() == 1 ? load_stock_cached(predictor, files[0], result, cache, threads, &from_cache)
+                                    : load_stock_files(predictor, files, result, cache, threads);
+    if (!opened) {
+        write_line("Error: Cannot open " + files[0] + (files.size() > 1 ? " (or another of the merged files)" : ""));
+        return false;
+    }
+    if (source_bytes) *source_bytes = result.source_bytes;
     
-    if (last_underscore != string::npos && dot_pos != string::npos && dot_pos > last_underscore) {
-        return filename.substr(last_underscore + 1, dot_pos - last_underscore - 1);
+    for (int i = 0; i < result.debug_count; i++) {
+        const StockData& stock = result.debug_rows[i];
+        write_line("Debug - Skipped row: date=" + format_timestamp(stock.time) + 
+                  " open=" + std::to_string(stock.open) + 
+                  " close=" + std::to_string(stock.close));
     }
     
-    // Fallback: use filename without extension
-    size_t last_slash = filename.find_last_of("/\\");
-    string base_name = (last_slash != string::npos) ? filename.substr(last_slash + 1) : filename;
-    size_t ext_pos = base_name.find_last_of('.');
-    return (ext_pos != string::npos) ? base_name.substr(0, ext_pos) : base_name;
-}
-
-void reverse_data_order(StockPredictor& predictor) {
-    // Reverse the data since CSV is from latest to oldest, but we need oldest to latest for predictions
-    unsigned int size = predictor.data.size;
-    for (unsigned int i = 0; i < size / 2; i++) {
-        StockData temp = predictor.data.get(i);
-        predictor.data.set(i, predictor.data.get(size - 1 - i));
-        predictor.data.set(size - 1 - i, temp);
+    if (predictor.series.size > 0) {
+        write_line("Loaded " + std::to_string(result.valid_rows) + " rows for " + predictor.company_name + 
+                  ", skipped " + std::to_string(result.skipped_rows) +
+                  (from_cache ? " (from cache " + cache_path_for(files[0]) + ")" :
+                   files.size() > 1 ? " (merged " + std::to_string(files.size()) + " files, " +
+                                      std::to_string(predictor.series.size) + " distinct bars)"
+                                    : " (sorted to chronological order)"));
     }
+    
+    return predictor.series.size > 0;
 }
 
-string clean_volume_string(const string& str) {
-    string clean;
-    for (size_t i = 0; i < str.length(); i++) {
-        char c = str[i];
-        if (isdigit(c) || c == '.') {
-            clean += c;
-        }
+// Opens days [from_day, to_day] of a partition directory written by
+// hd_partition (see day_partitions.hpp): only the day files in the range are
+// read, with every timeframe already aggregated into `resolutions`.
+bool load_partition_data(StockPredictor& predictor, const string& dir, int32_t from_day, int32_t to_day,
+                         ResolutionSet& resolutions) {
+    TRACE_SCOPE("load_partition_data");
+    PartitionManifest manifest;
+    if (!load_partition_range(dir, from_day, to_day, resolutions, predictor.series, manifest)) {
+        write_line("Error: Cannot read the partitions in " + dir);
+        return false;
+    }
+    predictor.company_name = manifest.ticker;
+    if (predictor.series.size == 0) {
+        write_line("Error: No bars in " + dir + " between " + iso_date(from_day) + " and " + iso_date(to_day));
+        return false;
     }
-    return clean.empty() ? "0" : clean;
+    write_line("Loaded " + std::to_string(predictor.series.size) + (manifest.trades ? " trades" : " rows") +
+               " for " + predictor.company_name + " from " + format_timestamp(predictor.series.time[0]) + " to " +
+               format_timestamp(predictor.series.time[predictor.series.size - 1]) + " (partitions in " + dir + ")");
+    return true;
 }
 
-string remove_quotes(const string& str) {
-    string result = str;
-    if (!result.empty() && result.front() == '"') {
-        result.erase(0, 1);
+// Visible part of the history: bars [begin, end) and their price range.
+// The range comes from CandlePyramid::range in O(log n), so zooming and
+// panning never rescan the bars.
+struct ChartView {
+    unsigned int begin, end;
+    double min_price, max_price;
+    double pan_remainder;       // sub-bar part of a drag, carried to the next frame
+    
+    ChartView() : begin(0), end(0), min_price(0), max_price(1), pan_remainder(0) {}
+    
+    unsigned int visible() const { return end - begin; }
+};
+
+const unsigned int MIN_VISIBLE_BARS = 10;
+const double ZOOM_STEP = 0.8;   // fraction of the visible bars kept per wheel notch in
+
+void update_view_range(ChartView& view, const CandlePyramid& pyramid, const PriceSeries& series) {
+    if (!pyramid.range(series, view.begin, view.end, view.min_price, view.max_price)) {
+        view.min_price = 0;
+        view.max_price = 1;
     }
-    if (!result.empty() && result.back() == '"') {
-        result.pop_back();
+    if (view.max_price <= view.min_price) {
+        view.min_price -= 1;
+        view.max_price += 1;
     }
-    return result;
 }
 
-double safe_stod(const string& str, double default_val = 0.0) {
-    try {
-        string clean_str = remove_quotes(str);
-        return stod(clean_str);
-    } catch (...) {
-        return default_val;
-    }
+void show_all_bars(ChartView& view, const CandlePyramid& pyramid, const PriceSeries& series) {
+    view.begin = 0;
+    view.end = series.size;
+    view.pan_remainder = 0;
+    update_view_range(view, pyramid, series);
 }
 
-// Improved data loading with better error handling
-bool load_stock_data(StockPredictor& predictor, const string& filename) {
-    predictor.filename = filename;
-    predictor.company_name = extract_company_name(filename);
-    
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        write_line("Error: Cannot open " + filename);
-        return false;
-    }
+// Scales the visible bar count by `factor`, keeping the bar under `anchor`
+// (0 = left edge, 1 = right edge of the chart) in place.
+bool zoom_view(ChartView& view, unsigned int bars, double factor, double anchor) {
+    unsigned int visible = view.visible();
+    unsigned int min_bars = std::min(MIN_VISIBLE_BARS, bars);
+    double wanted = visible * factor;
+    unsigned int next = wanted <= min_bars ? min_bars : wanted >= bars ? bars : static_cast<unsigned int>(wanted + 0.5);
+    if (next == visible) return false;
     
-    string line;
-    getline(file, line); // Skip header
-    
-    int valid_rows = 0;
-    int skipped_rows = 0;
-    
-    while (getline(file, line)) {
-        if (line.empty()) continue;
-        
-        StockData stock;
-        std::stringstream ss(line);
-        string temp;
-        
-        try {
-            getline(ss, stock.date, ',');
-            getline(ss, temp, ','); stock.open = safe_stod(temp);
-            getline(ss, temp, ','); stock.high = safe_stod(temp);
-            getline(ss, temp, ','); stock.low = safe_stod(temp);
-            getline(ss, temp, ','); stock.close = safe_stod(temp);
-            getline(ss, temp); stock.volume = safe_stod(clean_volume_string(temp));
-            
-            if (stock.open > 0 && stock.close > 0) {
-                predictor.data.add(stock);
-                valid_rows++;
-            } else {
-                skipped_rows++;
-                if (valid_rows == 0 && skipped_rows <= 3) {
-                    write_line("Debug - Skipped row: date=" + stock.date + 
-                              " open=" + std::to_string(stock.open) + 
-                              " close=" + std::to_string(stock.close));
-                }
-            }
-        } catch (...) {
-            skipped_rows++;
-        }
-    }
-    
-    file.close();
+    double begin = view.begin + anchor * visible - anchor * next;
+    if (begin < 0) begin = 0;
+    if (begin > bars - next) begin = bars - next;
+    view.begin = static_cast<unsigned int>(begin + 0.5);
+    view.end = view.begin + next;
+    view.pan_remainder = 0;
+    return true;
+}
+
+// Moves the view by `bars_delta` bars (positive = later), clamped to the history.
+bool pan_view(ChartView& view, unsigned int bars, double bars_delta) {
+    double total = bars_delta + view.pan_remainder;
+    long long shift = static_cast<long long>(total);
+    view.pan_remainder = total - shift;
     
-    // Reverse data order since CSV is from latest to oldest, but we need oldest to latest
-    if (predictor.data.size > 0) {
-        reverse_data_order(predictor);
-        write_line("Loaded " + std::to_string(valid_rows) + " rows for " + predictor.company_name + 
-                  ", skipped " + std::to_string(skipped_rows) + " (data reversed to chronological order)");
-    }
+    long long begin = static_cast<long long>(view.begin) + shift;
+    long long last_begin = static_cast<long long>(bars) - view.visible();
+    if (begin < 0) begin = 0;
+    if (begin > last_begin) begin = last_begin;
+    if (begin == view.begin) return false;
     
-    return predictor.data.size > 0;
+    unsigned int visible = view.visible();
+    view.begin = static_cast<unsigned int>(begin);
+    view.end = view.begin + visible;
+    return true;
 }
 
-// Simplified prediction calculations
-void calculate_predictions(StockPredictor& predictor) {
-    if (predictor.data.size < 2) return;
-    
-    switch (predictor.model) {
-        case LINEAR_REGRESSION: {
-            double x_mean = (predictor.data.size - 1) / 2.0;
-            double y_mean = 0;
-            for (unsigned int i = 0; i < predictor.data.size; i++) {
-                y_mean += predictor.data.get(i).close;
-            }
-            y_mean /= predictor.data.size;
-            
-            double numerator = 0, denominator = 0;
-            for (unsigned int i = 0; i < predictor.data.size; i++) {
-                double x_diff = i - x_mean;
-                double y_diff = predictor.data.get(i).close - y_mean;
-                numerator += x_diff * y_diff;
-                denominator += x_diff * x_diff;
-            }
-            
-            predictor.stats.slope = (denominator != 0) ? numerator / denominator : 0;
-            predictor.stats.intercept = y_mean - predictor.stats.slope * x_mean;
-            predictor.stats.next_prediction = predictor.stats.slope * predictor.data.size + predictor.stats.intercept;
-            predictor.stats.confidence = 0.8;
-            break;
-        }
-        
-        case MOVING_AVERAGE: {
-            if (predictor.data.size >= 5) {
-                double sum = 0;
-                for (int i = 0; i < 5; i++) {
-                    sum += predictor.data.get(predictor.data.size - 1 - i).close;
-                }
-                predictor.stats.next_prediction = sum / 5.0;
-                predictor.stats.confidence = 0.7;
-            }
-            break;
-        }
-        
-        case EXPONENTIAL_SMOOTHING: {
-            double alpha = 0.3;
-            double ema = predictor.data.get(0).close;
-            for (unsigned int i = 1; i < predictor.data.size; i++) {
-                ema = alpha * predictor.data.get(i).close + (1 - alpha) * ema;
-            }
-            predictor.stats.next_prediction = ema;
-            predictor.stats.confidence = 0.75;
-            break;
-        }
-    }
+// Clips the segment to the chart's price band; false when it lies outside.
+bool clip_to_chart(double& x0, double& y0, double& x1, double& y1) {
+    double top = 80, bottom = 80 + CHART_HEIGHT;
+    double dy = y1 - y0;
+    if (dy == 0) return y0 >= top && y0 <= bottom;
+    double ta = (top - y0) / dy, tb = (bottom - y0) / dy;
+    double t0 = std::max(0.0, std::min(ta, tb));
+    double t1 = std::min(1.0, std::max(ta, tb));
+    if (t0 > t1) return false;
+    double dx = x1 - x0;
+    double nx0 = x0 + t0 * dx, ny0 = y0 + t0 * dy;
+    x1 = x0 + t1 * dx;
+    y1 = y0 + t1 * dy;
+    x0 = nx0;
+    y0 = ny0;
+    return true;
 }
 
-// Simplified drawing functions
-void draw_trend_line(const StockPredictor& predictor, double min_price, double max_price) {
-    if (predictor.data.size < 2 || predictor.model != LINEAR_REGRESSION) return;
+// Simplified drawing functions. Everything except the trend line renders into
+// the offscreen scene bitmap, which is only redrawn where it is invalidated.
+// With `refit` the trend line is the least-squares line of the visible bars
+// (O(1) from the prefix sums) instead of the model's own fit.
+void draw_trend_line(const StockPredictor& predictor, const ChartView& view, const RegressionPrefix* refit) {
+    TRACE_SCOPE("draw_trend_line");
+    if (view.visible() < 2 || predictor.model != LINEAR_REGRESSION) return;
     
-    double y_scale = CHART_HEIGHT / (max_price - min_price);
-    double bar_width = CHART_WIDTH / static_cast<double>(predictor.data.size);
+    double slope = predictor.stats.slope;
+    double intercept = predictor.stats.intercept;
+    string label = "Trend Line";
+    if (refit) {
+        RegressionFit fit = refit->fit(view.begin, view.end);
+        slope = fit.slope;
+        intercept = fit.intercept;
+        label = "Visible fit, R² " + std::to_string(fit.r_squared).substr(0, 4);
+    }
+    
+    double y_scale = CHART_HEIGHT / (view.max_price - view.min_price);
+    double bar_width = CHART_WIDTH / static_cast<double>(view.visible());
     
     // Draw trend line using linear regression
+    unsigned int last = view.end - 1;
     double x_start = MARGIN + bar_width / 2;
-    double x_end = MARGIN + (predictor.data.size - 1) * bar_width + bar_width / 2;
+    double x_end = MARGIN + (last - view.begin) * bar_width + bar_width / 2;
     
-    double y_start = predictor.stats.intercept;
-    double y_end = predictor.stats.slope * (predictor.data.size - 1) + predictor.stats.intercept;
+    double y_start = slope * view.begin + intercept;
+    double y_end = slope * last + intercept;
     
     // Convert to screen coordinates
-    double screen_y_start = 80 + CHART_HEIGHT - (y_start - min_price) * y_scale;
-    double screen_y_end = 80 + CHART_HEIGHT - (y_end - min_price) * y_scale;
+    double screen_y_start = 80 + CHART_HEIGHT - (y_start - view.min_price) * y_scale;
+    double screen_y_end = 80 + CHART_HEIGHT - (y_end - view.min_price) * y_scale;
+    if (!clip_to_chart(x_start, screen_y_start, x_end, screen_y_end)) return;
     
     // Draw the trend line
     draw_line(COLOR_RED, x_start, screen_y_start, x_end, screen_y_end);
     
     // Draw trend line label
-    draw_text("Trend Line", COLOR_RED, "Arial", 10, x_end - 60, screen_y_end - 15);
+    draw_text(label, COLOR_RED, "Arial", 10, x_end - (refit ? 100 : 60), screen_y_end - 15);
 }
 
-void draw_chart(const StockPredictor& predictor) {
-    if (predictor.data.size == 0) return;
+// Forecast of the autoregressive and Holt-Winters models: the mean path and
+// its 95% band, fanned out from the last close into the gap between the
+// chart and the control panel. Only drawn while the newest bar is in view.
+void draw_forecast_fan(const StockPredictor& predictor, const ChartView& view) {
+    TRACE_SCOPE("draw_forecast_fan");
+    const ForecastPath& path = predictor.stats.forecast;
+    const PriceSeries& series = predictor.series;
+    if (!has_forecast_path(predictor.model) || path.steps == 0 || view.visible() < 2 || view.end != series.size) return;
     
-    // Find price range
-    double min_price = 999999, max_price = 0;
-    for (unsigned int i = 0; i < predictor.data.size; i++) {
-        min_price = std::min(min_price, predictor.data.get(i).low);
-        max_price = std::max(max_price, predictor.data.get(i).high);
+    double y_scale = CHART_HEIGHT / (view.max_price - view.min_price);
+    double bar_width = CHART_WIDTH / static_cast<double>(view.visible());
+    double x_last = MARGIN + (view.end - 1 - view.begin) * bar_width + bar_width / 2;
+    double step = (MARGIN + CHART_WIDTH + 26 - x_last) / path.steps;
+    double last_y = 80 + CHART_HEIGHT - (series.close[series.size - 1] - view.min_price) * y_scale;
+    
+    double prev_x = x_last, prev_mean = last_y, prev_lower = last_y, prev_upper = last_y;
+    for (int h = 0; h < path.steps; h++) {
+        double x = x_last + (h + 1) * step;
+        double mean = 80 + CHART_HEIGHT - (path.mean[h] - view.min_price) * y_scale;
+        double lower = 80 + CHART_HEIGHT - (path.lower(h) - view.min_price) * y_scale;
+        double upper = 80 + CHART_HEIGHT - (path.upper(h) - view.min_price) * y_scale;
+        double segments[3][4] = {{prev_x, prev_lower, x, lower}, {prev_x, prev_upper, x, upper}, {prev_x, prev_mean, x, mean}};
+        for (int k = 0; k < 3; k++) {
+            if (clip_to_chart(segments[k][0], segments[k][1], segments[k][2], segments[k][3])) {
+                draw_line(k == 2 ? MODEL_COLORS[predictor.model] : COLOR_GRAY, segments[k][0], segments[k][1],
+                          segments[k][2], segments[k][3]);
+            }
+        }
+        prev_x = x;
+        prev_mean = mean;
+        prev_lower = lower;
+        prev_upper = upper;
     }
+}
+
+// Draws at most one candle per horizontal pixel: the pyramid aggregates the
+// bars behind each pixel, so a frame costs the same for 1,000 or 10,000,000 bars.
+// Candles go to the cached chart layer; the trend line, which depends on the
+// selected model, is drawn over it when the frame is composed.
+void draw_chart(bitmap layer, const StockPredictor& predictor, const CandlePyramid& pyramid, const ChartView& view) {
+    TRACE_SCOPE("draw_chart");
+    const PriceSeries& series = predictor.series;
+    if (series.size == 0) return;
+    
+    double min_price = view.min_price;
+    double y_scale = CHART_HEIGHT / (view.max_price - min_price);
     
-    double y_scale = CHART_HEIGHT / (max_price - min_price);
-    double bar_width = CHART_WIDTH / static_cast<double>(predictor.data.size);
+    static std::vector<ChartCandle> candles;
+    pyramid.visible_candles(series, view.begin, view.end, CHART_WIDTH, candles);
     
     // Draw candlesticks
-    for (unsigned int i = 0; i < predictor.data.size; i++) {
-        const StockData& data = predictor.data.get(i);
-        double x = MARGIN + i * bar_width + bar_width / 2;
+    for (size_t i = 0; i < candles.size(); i++) {
+        const ChartCandle& candle = candles[i];
+        double width = candle.x1 - candle.x0;
+        double x = MARGIN + candle.x0 + width / 2;
         
-        color candle_color = (data.close >= data.open) ? UP_COLOR : DOWN_COLOR;
-        double high_y = 80 + CHART_HEIGHT - (data.high - min_price) * y_scale;
-        double low_y = 80 + CHART_HEIGHT - (data.low - min_price) * y_scale;
-        double open_y = 80 + CHART_HEIGHT - (data.open - min_price) * y_scale;
-        double close_y = 80 + CHART_HEIGHT - (data.close - min_price) * y_scale;
+        color candle_color = (candle.close >= candle.open) ? UP_COLOR : DOWN_COLOR;
+        double high_y = 80 + CHART_HEIGHT - (candle.high - min_price) * y_scale;
+        double low_y = 80 + CHART_HEIGHT - (candle.low - min_price) * y_scale;
+        double open_y = 80 + CHART_HEIGHT - (candle.open - min_price) * y_scale;
+        double close_y = 80 + CHART_HEIGHT - (candle.close - min_price) * y_scale;
         
-        draw_line(candle_color, x, high_y, x, low_y);
-        fill_rectangle(candle_color, x - bar_width/3, std::min(open_y, close_y), 
-                      2*bar_width/3, abs(close_y - open_y));
+        draw_line_on_bitmap(layer, candle_color, x, high_y, x, low_y);
+        if (width >= 3) {
+            fill_rectangle_on_bitmap(layer, candle_color, x - width/3, std::min(open_y, close_y), 
+                          2*width/3, abs(close_y - open_y));
+        }
+    }
+}
+
+// Indicators shown over the chart and in the info panel. They are computed
+// together (indicators.hpp) the first time I is pressed and extended with
+// each batch of bars in follow mode; I then cycles the overlay.
+enum IndicatorOverlay { OVERLAY_NONE, OVERLAY_AVERAGES, OVERLAY_BOLLINGER, OVERLAY_CHANNEL, OVERLAY_COUNT };
+
+struct ChartIndicators {
+    IndicatorSet set;
+    size_t sma20, sma50, ema20, bollinger, high20, low20, vwap, rsi, macd, atr;
+    IndicatorOverlay overlay;
+    
+    ChartIndicators() : overlay(OVERLAY_NONE) {
+        sma20 = set.add(IndicatorSpec(INDICATOR_SMA, 20));
+        sma50 = set.add(IndicatorSpec(INDICATOR_SMA, 50));
+        ema20 = set.add(IndicatorSpec(INDICATOR_EMA, 20));
+        bollinger = set.add(IndicatorSpec(INDICATOR_BOLLINGER, 20, 2.0));
+        high20 = set.add(IndicatorSpec(INDICATOR_ROLLING_MAX, 20));
+        low20 = set.add(IndicatorSpec(INDICATOR_ROLLING_MIN, 20));
+        vwap = set.add(IndicatorSpec(INDICATOR_VWAP, 20));
+        rsi = set.add(IndicatorSpec(INDICATOR_RSI, 14));
+        macd = set.add(IndicatorSpec(INDICATOR_MACD, 12, 0, 26, 9));
+        atr = set.add(IndicatorSpec(INDICATOR_ATR, 14));
+    }
+    
+    bool active() const { return overlay != OVERLAY_NONE; }
+};
+
+// One indicator column over the view, one point per pixel column (the last
+// bar behind the pixel). Warm-up rows (NaN) break the line.
+void draw_indicator_line(bitmap layer, const double* column, const ChartView& view, color line_color) {
+    unsigned int visible = view.visible();
+    if (visible == 0) return;
+    double y_scale = CHART_HEIGHT / (view.max_price - view.min_price);
+    bool have_previous = false;
+    double previous_x = 0, previous_y = 0;
+    
+    for (int px = 0; px < CHART_WIDTH; px++) {
+        unsigned int first = view.begin + static_cast<unsigned int>(static_cast<double>(px) * visible / CHART_WIDTH);
+        unsigned int last = view.begin + static_cast<unsigned int>(static_cast<double>(px + 1) * visible / CHART_WIDTH);
+        if (last <= first) continue;    // fewer bars than pixels: this pixel is between two bars
+        double value = column[last - 1];
+        if (std::isnan(value)) {
+            have_previous = false;
+            continue;
+        }
+        double x = MARGIN + px + 0.5;
+        double y = 80 + CHART_HEIGHT - (value - view.min_price) * y_scale;
+        y = std::max(80.0, std::min(80.0 + CHART_HEIGHT, y));
+        if (have_previous) draw_line_on_bitmap(layer, line_color, previous_x, previous_y, x, y);
+        have_previous = true;
+        previous_x = x;
+        previous_y = y;
+    }
+}
+
+void draw_indicator_overlay(bitmap layer, const ChartIndicators& indicators, const ChartView& view) {
+    TRACE_SCOPE("draw_indicator_overlay");
+    const IndicatorSet& set = indicators.set;
+    if (set.size() < view.end) return;
+    switch (indicators.overlay) {
+        case OVERLAY_NONE:
+        case OVERLAY_COUNT:
+            return;
+        case OVERLAY_AVERAGES:
+            draw_indicator_line(layer, set.column(indicators.sma20), view, COLOR_BLUE);
+            draw_indicator_line(layer, set.column(indicators.sma50), view, COLOR_ORANGE);
+            draw_indicator_line(layer, set.column(indicators.ema20), view, COLOR_PURPLE);
+            break;
+        case OVERLAY_BOLLINGER:
+            draw_indicator_line(layer, set.column(indicators.bollinger), view, COLOR_BLUE);
+            draw_indicator_line(layer, set.column(indicators.bollinger + 1), view, COLOR_GRAY);
+            draw_indicator_line(layer, set.column(indicators.bollinger + 2), view, COLOR_GRAY);
+            break;
+        case OVERLAY_CHANNEL:
+            draw_indicator_line(layer, set.column(indicators.high20), view, COLOR_GREEN);
+            draw_indicator_line(layer, set.column(indicators.low20), view, COLOR_RED);
+            draw_indicator_line(layer, set.column(indicators.vwap), view, COLOR_PURPLE);
+            break;
     }
     
-    // Draw trend line
-    draw_trend_line(predictor, min_price, max_price);
+    string legend;
+    size_t columns[3] = { indicators.sma20, indicators.sma50, indicators.ema20 };
+    if (indicators.overlay == OVERLAY_BOLLINGER) {
+        columns[0] = indicators.bollinger;
+        columns[1] = indicators.bollinger + 1;
+        columns[2] = indicators.bollinger + 2;
+    } else if (indicators.overlay == OVERLAY_CHANNEL) {
+        columns[0] = indicators.high20;
+        columns[1] = indicators.low20;
+        columns[2] = indicators.vwap;
+    }
+    for (int i = 0; i < 3; i++) legend += (i > 0 ? "   " : "") + set.column_name(columns[i]);
+    draw_text_on_bitmap(layer, legend, COLOR_DARK_GRAY, "Arial", 10, MARGIN + 8, 86);
+}
+
+// Monte Carlo inset, top right of the chart: the 5-95% and 25-75% bands of
+// the simulated price one pixel column at a time, from the last close at
+// the left edge to the horizon at the right, with the median over them.
+const int MC_INSET_WIDTH = 240;
+const int MC_INSET_HEIGHT = 150;
+const int MC_INSET_X = MARGIN + CHART_WIDTH - MC_INSET_WIDTH - 10;
+const int MC_INSET_Y = 90;
+const int MC_PLOT_TOP = 22;         // below the title
+const int MC_PLOT_HEIGHT = 90;      // above the VaR lines
+
+// Band q of the simulation at a fractional step (0 = the last close)
+double monte_carlo_band_at(const MonteCarloResult& mc, int q, double step) {
+    if (step <= 0) return mc.last_close;
+    unsigned int h = static_cast<unsigned int>(step);
+    double before = h == 0 ? mc.last_close : mc.band(q, h - 1);
+    if (h >= mc.horizon) return mc.band(q, mc.horizon - 1);
+    return before + (mc.band(q, h) - before) * (step - h);
 }
 
-void draw_background(const StockPredictor& predictor) {
-    clear_screen(BG_COLOR);
+void draw_monte_carlo_inset(bitmap layer, const MonteCarloResult& mc, const PriceSeries& series, unsigned int at_bar) {
+    TRACE_SCOPE("draw_monte_carlo_inset");
+    if (!mc.ok || mc.horizon == 0) return;
+    fill_rectangle_on_bitmap(layer, COLOR_WHITE, MC_INSET_X, MC_INSET_Y, MC_INSET_WIDTH, MC_INSET_HEIGHT);
+    draw_rectangle_on_bitmap(layer, COLOR_LIGHT_GRAY, MC_INSET_X, MC_INSET_Y, MC_INSET_WIDTH, MC_INSET_HEIGHT);
+    string title = string("Monte Carlo, ") + (mc.model == MC_GBM ? "GBM" : "bootstrap") + ", " +
+                   std::to_string(mc.horizon) + " bars";
+    draw_text_on_bitmap(layer, title, COLOR_BLACK, "Arial", 11, MC_INSET_X + 8, MC_INSET_Y + 6);
+    
+    double lo = mc.last_close, hi = mc.last_close;
+    for (unsigned int h = 0; h < mc.horizon; h++) {
+        lo = std::min(lo, mc.band(0, h));
+        hi = std::max(hi, mc.band(MC_QUANTILE_COUNT - 1, h));
+    }
+    if (hi <= lo) hi = lo + 1;
+    double plot_x = MC_INSET_X + 50, plot_width = MC_INSET_WIDTH - 58;
+    double plot_y = MC_INSET_Y + MC_PLOT_TOP;
+    double y_scale = MC_PLOT_HEIGHT / (hi - lo);
+    draw_text_on_bitmap(layer, "$" + std::to_string(static_cast<int>(hi)), COLOR_GRAY, "Arial", 9, MC_INSET_X + 8, plot_y - 4);
+    draw_text_on_bitmap(layer, "$" + std::to_string(static_cast<int>(lo)), COLOR_GRAY, "Arial", 9, MC_INSET_X + 8,
+                        plot_y + MC_PLOT_HEIGHT - 8);
+    
+    const color outer = rgb_color(199, 210, 254), inner = rgb_color(129, 140, 248);
+    double prev_x = plot_x, prev_median = plot_y + MC_PLOT_HEIGHT - (mc.last_close - lo) * y_scale;
+    for (int px = 0; px < static_cast<int>(plot_width); px++) {
+        double step = (px + 1) * mc.horizon / plot_width;
+        double y[MC_QUANTILE_COUNT];
+        for (int q = 0; q < MC_QUANTILE_COUNT; q++) {
+            y[q] = plot_y + MC_PLOT_HEIGHT - (monte_carlo_band_at(mc, q, step) - lo) * y_scale;
+        }
+        double x = plot_x + px + 1;
+        draw_line_on_bitmap(layer, outer, x, y[4], x, y[0]);
+        draw_line_on_bitmap(layer, inner, x, y[3], x, y[1]);
+        draw_line_on_bitmap(layer, COLOR_BLUE, prev_x, prev_median, x, y[2]);
+        prev_x = x;
+        prev_median = y[2];
+    }
+    
+    char line[96];
+    snprintf(line, sizeof(line), "%.0f%% VaR %.2f%%   CVaR %.2f%%   mean %+.2f%%", (1 - mc.tail) * 100, mc.var * 100,
+             mc.cvar * 100, mc.expected_return * 100);
+    draw_text_on_bitmap(layer, line, COLOR_DARK_GRAY, "Arial", 9, MC_INSET_X + 8, MC_INSET_Y + MC_INSET_HEIGHT - 30);
+    snprintf(line, sizeof(line), "%u paths in %.0f ms, from ", mc.paths, mc.seconds * 1e3);
+    string from = at_bar > 0 && at_bar <= series.size ? format_timestamp(series.time[at_bar - 1]) : string("?");
+    draw_text_on_bitmap(layer, line + from, COLOR_GRAY, "Arial", 9, MC_INSET_X + 8, MC_INSET_Y + MC_INSET_HEIGHT - 16);
+}
+
+void draw_background(bitmap layer, const StockPredictor& predictor) {
+    TRACE_SCOPE("draw_background");
+    clear_bitmap(layer, BG_COLOR);
     
     // Title
-    draw_text("Stock Price Predictor - Machine Learning", COLOR_BLACK, 
+    draw_text_on_bitmap(layer, "Stock Price Predictor - Machine Learning", COLOR_BLACK, 
               "Arial", 24, MARGIN, 20);
     
     // Subtitle with dynamic company name
     string subtitle = predictor.company_name + " Historical Data Analysis";
-    draw_text(subtitle, COLOR_GRAY, "Arial", 14, MARGIN, 48);
+    draw_text_on_bitmap(layer, subtitle, COLOR_GRAY, "Arial", 14, MARGIN, 48);
 }
 
-void draw_grid_and_axes(const StockPredictor& predictor, double min_price, double max_price) {
+void draw_grid_and_axes(bitmap layer, const ChartView& view) {
+    TRACE_SCOPE("draw_grid_and_axes");
+    double min_price = view.min_price, max_price = view.max_price;
+    
     // Draw chart background
-    fill_rectangle(COLOR_WHITE, MARGIN, 80, CHART_WIDTH, CHART_HEIGHT);
+    fill_rectangle_on_bitmap(layer, COLOR_WHITE, MARGIN, 80, CHART_WIDTH, CHART_HEIGHT);
     
     // Grid lines
     for (int i = 0; i <= 5; i++) {
         double y = 80 + i * (CHART_HEIGHT / 5.0);
-        draw_line(GRID_COLOR, MARGIN, y, MARGIN + CHART_WIDTH, y);
+        draw_line_on_bitmap(layer, GRID_COLOR, MARGIN, y, MARGIN + CHART_WIDTH, y);
         
         // Price labels
         double price = max_price - (i * (max_price - min_price) / 5.0);
-        draw_text("$" + std::to_string(static_cast<int>(price)), COLOR_GRAY, 
+        draw_text_on_bitmap(layer, "$" + std::to_string(static_cast<int>(price)), COLOR_GRAY, 
                   "Arial", 11, MARGIN - 45, y - 6);
     }
     
     // Date grid (vertical)
-    int date_count = std::min(10, static_cast<int>(predictor.data.size));
+    int date_count = std::min(10, static_cast<int>(view.visible()));
     for (int i = 0; i <= date_count; i++) {
         double x = MARGIN + i * (CHART_WIDTH / static_cast<double>(date_count));
-        draw_line(GRID_COLOR, x, 80, x, 80 + CHART_HEIGHT);
+        draw_line_on_bitmap(layer, GRID_COLOR, x, 80, x, 80 + CHART_HEIGHT);
     }
     
     // Axes
-    draw_line(COLOR_BLACK, MARGIN, 80, MARGIN, 80 + CHART_HEIGHT);
-    draw_line(COLOR_BLACK, MARGIN, 80 + CHART_HEIGHT, 
+    draw_line_on_bitmap(layer, COLOR_BLACK, MARGIN, 80, MARGIN, 80 + CHART_HEIGHT);
+    draw_line_on_bitmap(layer, COLOR_BLACK, MARGIN, 80 + CHART_HEIGHT, 
               MARGIN + CHART_WIDTH, 80 + CHART_HEIGHT);
 }
 
-void draw_controls(const StockPredictor& predictor) {
+void draw_controls(bitmap layer, const StockPredictor& predictor) {
+    TRACE_SCOPE("draw_controls");
     int panel_x = MARGIN + CHART_WIDTH + 30;
     int panel_y = 80;
     
     // Control panel background
-    fill_rectangle(COLOR_WHITE, panel_x, panel_y, 160, 400);
-    draw_rectangle(COLOR_LIGHT_GRAY, panel_x, panel_y, 160, 400);
+    fill_rectangle_on_bitmap(layer, COLOR_WHITE, panel_x, panel_y, 160, 470);
+    draw_rectangle_on_bitmap(layer, COLOR_LIGHT_GRAY, panel_x, panel_y, 160, 470);
     
     // Model selection
-    draw_text("Prediction Model", COLOR_BLACK, "Arial", 14, panel_x + 10, panel_y + 10);
-    
-    string models[] = {"Linear Regression", "Moving Average", "Exp. Smoothing"};
-    color colors[] = {COLOR_BLUE, COLOR_GREEN, COLOR_PURPLE};
+    draw_text_on_bitmap(layer, "Prediction Model", COLOR_BLACK, "Arial", 14, panel_x + 10, panel_y + 10);
     
-    for (int i = 0; i < 3; i++) {
-        color btn_color = (predictor.model == i) ? colors[i] : COLOR_LIGHT_GRAY;
-        fill_rectangle(btn_color, panel_x + 10, panel_y + 40 + i * 40, 140, 30);
+    for (int i = 0; i < MODEL_COUNT; i++) {
+        int button_y = panel_y + MODEL_BUTTON_TOP + i * MODEL_BUTTON_SPACING;
+        color btn_color = (predictor.model == i) ? MODEL_COLORS[i] : COLOR_LIGHT_GRAY;
+        fill_rectangle_on_bitmap(layer, btn_color, panel_x + 10, button_y, 140, MODEL_BUTTON_HEIGHT);
         
         color text_color = (predictor.model == i) ? COLOR_WHITE : COLOR_BLACK;
-        draw_text(models[i], text_color, "Arial", 11, 
-                  panel_x + 20, panel_y + 48 + i * 40);
+        draw_text_on_bitmap(layer, MODEL_NAMES[i], text_color, "Arial", 11, 
+                  panel_x + 20, button_y + 7);
     }
     
     // Prediction display
-    draw_text("Next Prediction", COLOR_BLACK, "Arial", 14, 
-              panel_x + 10, panel_y + 180);
+    draw_text_on_bitmap(layer, "Next Prediction", COLOR_BLACK, "Arial", 14, 
+              panel_x + 10, panel_y + 220);
     
     if (predictor.stats.next_prediction > 0) {
         // Predicted value
-        draw_text("$" + std::to_string(static_cast<int>(predictor.stats.next_prediction)), 
-                  COLOR_BLUE, "Arial", 20, panel_x + 10, panel_y + 210);
+        draw_text_on_bitmap(layer, "$" + std::to_string(static_cast<int>(predictor.stats.next_prediction)), 
+                  COLOR_BLUE, "Arial", 20, panel_x + 10, panel_y + 250);
         
         // Change from last close
-        if (predictor.data.size > 0) {
-            double last_close = predictor.data.get(predictor.data.size - 1).close;
+        if (predictor.series.size > 0) {
+            double last_close = predictor.series.close[predictor.series.size - 1];
             double change = predictor.stats.next_prediction - last_close;
             double change_pct = (change / last_close) * 100;
             
             color change_color = (change >= 0) ? UP_COLOR : DOWN_COLOR;
             string sign = (change >= 0) ? "+" : "";
             
-            draw_text(sign + std::to_string(static_cast<int>(change_pct)) + "%", 
-                      change_color, "Arial", 16, panel_x + 10, panel_y + 240);
+            draw_text_on_bitmap(layer, sign + std::to_string(static_cast<int>(change_pct)) + "%", 
+                      change_color, "Arial", 16, panel_x + 10, panel_y + 280);
+        }
+        
+        // 95% prediction interval of the next close
+        const ForecastPath& path = predictor.stats.forecast;
+        if (has_forecast_path(predictor.model) && path.steps > 0) {
+            draw_text_on_bitmap(layer, "95%: $" + std::to_string(path.lower(0)).substr(0, 7) + " - $" +
+                                std::to_string(path.upper(0)).substr(0, 7), COLOR_GRAY, "Arial", 10,
+                                panel_x + 10, panel_y + 302);
         }
         
         // Confidence
-        draw_text("Confidence", COLOR_BLACK, "Arial", 12, panel_x + 10, panel_y + 280);
+        draw_text_on_bitmap(layer, "Confidence", COLOR_BLACK, "Arial", 12, panel_x + 10, panel_y + 320);
         
         // Confidence bar
-        fill_rectangle(COLOR_LIGHT_GRAY, panel_x + 10, panel_y + 300, 140, 20);
-        fill_rectangle(COLOR_BLUE, panel_x + 10, panel_y + 300, 
+        fill_rectangle_on_bitmap(layer, COLOR_LIGHT_GRAY, panel_x + 10, panel_y + 340, 140, 20);
+        fill_rectangle_on_bitmap(layer, COLOR_BLUE, panel_x + 10, panel_y + 340, 
                       140 * predictor.stats.confidence, 20);
         
-        draw_text(std::to_string(static_cast<int>(predictor.stats.confidence * 100)) + "%", 
-                  COLOR_BLACK, "Arial", 11, panel_x + 60, panel_y + 303);
+        draw_text_on_bitmap(layer, std::to_string(static_cast<int>(predictor.stats.confidence * 100)) + "%", 
+                  COLOR_BLACK, "Arial", 11, panel_x + 60, panel_y + 343);
+    }
+    
+    // Fit quality: of the prices for linear regression, of their changes for AR
+    if (predictor.model == LINEAR_REGRESSION || predictor.model == AUTOREGRESSIVE) {
+        draw_text_on_bitmap(layer, "R² = " + std::to_string(predictor.stats.r_squared).substr(0, 5), 
+                  COLOR_GRAY, "Arial", 11, panel_x + 10, panel_y + 380);
     }
     
-    // Stats for linear regression
-    if (predictor.model == LINEAR_REGRESSION) {
-        draw_text("R² = " + std::to_string(predictor.stats.r_squared).substr(0, 5), 
-                  COLOR_GRAY, "Arial", 11, panel_x + 10, panel_y + 340);
+    // Parameter of the selected model (O searches for the best one)
+    string param;
+    switch (predictor.model) {
+        case LINEAR_REGRESSION:
+            param = predictor.params.regression_lookback >= 2
+                ? "Lookback: " + std::to_string(predictor.params.regression_lookback) + " bars" : "Lookback: all";
+            break;
+        case MOVING_AVERAGE: param = "Window: " + std::to_string(predictor.params.sma_period) + " bars"; break;
+        case EXPONENTIAL_SMOOTHING: param = "Alpha: " + std::to_string(predictor.params.ema_alpha).substr(0, 5); break;
+        case AUTOREGRESSIVE: param = "Order: " + std::to_string(predictor.params.ar_order) + " lags"; break;
+        case HOLT_WINTERS:
+            param = "Alpha: " + std::to_string(predictor.params.holt_alpha).substr(0, 4) +
+                    (predictor.params.season_length ? ", season " + std::to_string(predictor.params.season_length) : "");
+            break;
     }
+    draw_text_on_bitmap(layer, param, COLOR_GRAY, "Arial", 11, panel_x + 10, panel_y + 398);
+    draw_text_on_bitmap(layer, "O: optimize   H: full view", COLOR_GRAY, "Arial", 10, panel_x + 10, panel_y + 414);
+    draw_text_on_bitmap(layer, "R: refit trend   I: indicators", COLOR_GRAY, "Arial", 10, panel_x + 10, panel_y + 428);
+    draw_text_on_bitmap(layer, "M: Monte Carlo fan   T: timeframe", COLOR_GRAY, "Arial", 10, panel_x + 10, panel_y + 442);
+    draw_text_on_bitmap(layer, "Wheel: zoom   Drag: pan", COLOR_GRAY, "Arial", 10, panel_x + 10, panel_y + 456);
 }
 
-void draw_info_panel(const StockPredictor& predictor) {
-    if (predictor.data.size == 0) return;
+// Backtests the current parameters and makes the hit rates the confidence.
+void run_and_report_backtest(StockPredictor& predictor) {
+    TRACE_SCOPE("run_and_report_backtest");
+    BacktestReport backtest = run_backtest(predictor.series, predictor.params);
+    apply_backtest_confidence(predictor, backtest);
+    for (int m = 0; m < MODEL_COUNT; m++) {
+        const ForecastAccuracy& accuracy = backtest.models[m];
+        write_line("Backtest " + MODEL_NAMES[m] + ": MAE " + std::to_string(accuracy.mae()) +
+                   ", RMSE " + std::to_string(accuracy.rmse()) + ", MAPE " + std::to_string(accuracy.mape()) +
+                   "%, hit rate " + std::to_string(static_cast<int>(accuracy.hit_rate() * 100)) + "% over " +
+                   std::to_string(accuracy.forecasts) + " forecasts");
+    }
+}
+
+// Grid-searches every model's parameter on walk-forward error and adopts the best.
+void optimize_parameters(StockPredictor& predictor, thread_pool& pool) {
+    TRACE_SCOPE("optimize_parameters");
+    SearchGrid grid = default_search_grid();
+    SearchResult result = search_parameters(predictor.series, grid, &pool, predictor.params);
+    predictor.params = result.best;
+    write_line("Optimized (" + string(objective_name(grid.objective)) + "): lookback " +
+               (result.best.regression_lookback >= 2 ? std::to_string(result.best.regression_lookback) : string("all")) +
+               ", window " + std::to_string(result.best.sma_period) +
+               ", alpha " + std::to_string(result.best.ema_alpha) +
+               ", AR order " + std::to_string(result.best.ar_order) +
+               ", Holt-Winters alpha " + std::to_string(result.best.holt_alpha));
+    run_and_report_backtest(predictor);
+    calculate_predictions(predictor);
+}
+
+// Simulates MC_DEFAULT_PATHS paths from the last close on every core (see
+// monte_carlo.hpp) and logs the tail risk.
+bool run_forecast_simulation(const StockPredictor& predictor, MonteCarloModel model, thread_pool& pool,
+                             MonteCarloResult& result) {
+    MonteCarloOptions options;
+    options.model = model;
+    if (!run_monte_carlo(predictor.series.close, predictor.series.size, options, result, &pool)) {
+        write_line("Error: Monte Carlo needs at least 3 positive closes");
+        return false;
+    }
+    char line[200];
+    snprintf(line, sizeof(line),
+             "Monte Carlo (%s): %u paths x %u bars in %.0f ms; p5/p50/p95 $%.2f / $%.2f / $%.2f; "
+             "%.0f%% VaR %.2f%%, CVaR %.2f%%",
+             model == MC_GBM ? "GBM" : "bootstrap", result.paths, result.horizon, result.seconds * 1e3,
+             result.band(0, result.horizon - 1), result.band(2, result.horizon - 1),
+             result.band(MC_QUANTILE_COUNT - 1, result.horizon - 1), (1 - result.tail) * 100, result.var * 100,
+             result.cvar * 100);
+    write_line(line);
+    return true;
+}
+
+void draw_info_panel(bitmap layer, const StockPredictor& predictor, const ChartView& view,
+                     const ChartIndicators& indicators, Timeframe timeframe) {
+    TRACE_SCOPE("draw_info_panel");
+    const PriceSeries& series = predictor.series;
+    if (series.size == 0) return;
     
     // Latest data info
-    const StockData& latest = predictor.data.get(predictor.data.size - 1);
+    unsigned int latest = series.size - 1;
     
     int info_y = 80 + CHART_HEIGHT + 30;
     
-    fill_rectangle(COLOR_WHITE, MARGIN, info_y, CHART_WIDTH, 80);
-    draw_rectangle(COLOR_LIGHT_GRAY, MARGIN, info_y, CHART_WIDTH, 80);
+    fill_rectangle_on_bitmap(layer, COLOR_WHITE, MARGIN, info_y, CHART_WIDTH, 80);
+    draw_rectangle_on_bitmap(layer, COLOR_LIGHT_GRAY, MARGIN, info_y, CHART_WIDTH, 80);
+    
+    draw_text_on_bitmap(layer, "Latest: " + format_timestamp(series.time[latest]), COLOR_BLACK, "Arial", 12, MARGIN + 10, info_y + 10);
     
-    draw_text("Latest: " + latest.date, COLOR_BLACK, "Arial", 12, MARGIN + 10, info_y + 10);
+    if (view.visible() > 0) {
+        draw_text_on_bitmap(layer, "Showing " + format_timestamp(series.time[view.begin]) + " to " +
+                            format_timestamp(series.time[view.end - 1]) + " (" + std::to_string(view.visible()) +
+                            " of " + std::to_string(series.size) +
+                            (timeframe == TIMEFRAME_RAW ? string(" bars)") : " " + string(TIMEFRAME_NAMES[timeframe]) + " bars)"),
+                            COLOR_GRAY, "Arial", 11, MARGIN + 250, info_y + 11);
+    }
     
-    string info = "Open: $" + std::to_string(static_cast<int>(latest.open)) +
-                  "  High: $" + std::to_string(static_cast<int>(latest.high)) +
-                  "  Low: $" + std::to_string(static_cast<int>(latest.low)) +
-                  "  Close: $" + std::to_string(static_cast<int>(latest.close));
+    string info = "Open: $" + std::to_string(static_cast<int>(series.open[latest])) +
+                  "  High: $" + std::to_string(static_cast<int>(series.high[latest])) +
+                  "  Low: $" + std::to_string(static_cast<int>(series.low[latest])) +
+                  "  Close: $" + std::to_string(static_cast<int>(series.close[latest]));
     
-    draw_text(info, COLOR_GRAY, "Arial", 12, MARGIN + 10, info_y + 35);
+    draw_text_on_bitmap(layer, info, COLOR_GRAY, "Arial", 12, MARGIN + 10, info_y + 35);
     
-    draw_text("Volume: " + std::to_string(static_cast<long>(latest.volume)) + " shares", 
+    draw_text_on_bitmap(layer, "Volume: " + std::to_string(static_cast<long>(series.volume[latest])) + " shares", 
               COLOR_GRAY, "Arial", 12, MARGIN + 10, info_y + 55);
+    
+    // Oscillators at the last visible bar
+    const IndicatorSet& set = indicators.set;
+    if (indicators.active() && view.visible() > 0 && set.size() >= view.end) {
+        unsigned int row = view.end - 1;
+        char values[160];
+        snprintf(values, sizeof(values), "%s: %.1f   MACD: %.2f / %.2f   %s: %.2f   (at %s)",
+                 set.column_name(indicators.rsi).c_str(), set.value(indicators.rsi, row),
+                 set.value(indicators.macd, row), set.value(indicators.macd + 1, row),
+                 set.column_name(indicators.atr).c_str(), set.value(indicators.atr, row),
+                 format_timestamp(series.time[row]).c_str());
+        draw_text_on_bitmap(layer, values, COLOR_GRAY, "Arial", 11, MARGIN + 250, info_y + 56);
+    }
+}
+
+// Portfolio view
+// ---------------------------------------------------------------------------
+//
+// Opened when several files (or a directory) are given: a page of sparkline
+// cells on the left and a sortable table of predicted change on the right,
+// both showing the same tickers in the table's order. C swaps the cells for
+// a heatmap of the rolling return correlation of every ticker.
+
+const int GRID_COLUMNS = 4;
+const int GRID_ROWS = 5;
+const int CELL_WIDTH = 160;
+const int CELL_HEIGHT = 100;
+const int PAGE_SIZE = GRID_COLUMNS * GRID_ROWS;
+const int TABLE_X = MARGIN + GRID_COLUMNS * CELL_WIDTH + 30;
+const int TABLE_WIDTH = WINDOW_WIDTH - MARGIN - TABLE_X;
+const int TABLE_ROW_HEIGHT = 24;
+const int TABLE_TOP = 80 + TABLE_ROW_HEIGHT;
+const int TABLE_COLUMN_X[] = { 10, 170, 250, 340 };   // ticker, last, predicted change, confidence
+const int MODEL_BUTTONS_Y = 80 + GRID_ROWS * CELL_HEIGHT + 30;
+const int MODEL_BUTTONS_STEP = 128;
+const int HEATMAP_SIZE = GRID_ROWS * CELL_HEIGHT;
+const unsigned int CORRELATION_WINDOW_DAYS = 250;
+
+string format_percent(double value, bool sign) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), sign ? "%+.2f%%" : "%.0f%%", value);
+    return buf;
+}
+
+void draw_sparkline_cell(bitmap layer, const PortfolioTicker& ticker, PredictionModel model, double x, double y) {
+    fill_rectangle_on_bitmap(layer, COLOR_WHITE, x + 2, y + 2, CELL_WIDTH - 4, CELL_HEIGHT - 4);
+    draw_rectangle_on_bitmap(layer, COLOR_LIGHT_GRAY, x + 2, y + 2, CELL_WIDTH - 4, CELL_HEIGHT - 4);
+    const TickerScore& score = ticker.score;
+    draw_text_on_bitmap(layer, score.company.substr(0, 14), COLOR_BLACK, "Arial", 11, x + 8, y + 8);
+    if (!score.loaded || score.last_close == 0) {
+        draw_text_on_bitmap(layer, "not loaded", COLOR_GRAY, "Arial", 10, x + 8, y + 40);
+        return;
+    }
+
+    double change = ticker.change_pct[model];
+    draw_text_on_bitmap(layer, format_percent(change, true), change >= 0 ? UP_COLOR : DOWN_COLOR, "Arial", 10,
+                        x + CELL_WIDTH - 60, y + 8);
+
+    double left = x + 8, width = CELL_WIDTH - 16;
+    double top = y + 28, height = CELL_HEIGHT - 40;
+    const float *points = ticker.sparkline;
+    color line = points[SPARKLINE_POINTS - 1] >= points[0] ? UP_COLOR : DOWN_COLOR;
+    for (int p = 1; p < SPARKLINE_POINTS; p++) {
+        double x0 = left + (p - 1) * width / (SPARKLINE_POINTS - 1);
+        double x1 = left + p * width / (SPARKLINE_POINTS - 1);
+        draw_line_on_bitmap(layer, line, x0, top + (1 - points[p - 1]) * height, x1, top + (1 - points[p]) * height);
+    }
+}
+
+void draw_portfolio_table(bitmap layer, const Portfolio& portfolio, const vector<unsigned int>& order,
+                          unsigned int first, PredictionModel model, PortfolioColumn column, bool descending) {
+    TRACE_SCOPE("draw_portfolio_table");
+    fill_rectangle_on_bitmap(layer, COLOR_WHITE, TABLE_X, 80, TABLE_WIDTH, TABLE_ROW_HEIGHT * (PAGE_SIZE + 1));
+    draw_rectangle_on_bitmap(layer, COLOR_LIGHT_GRAY, TABLE_X, 80, TABLE_WIDTH, TABLE_ROW_HEIGHT * (PAGE_SIZE + 1));
+
+    string headers[] = {"Ticker", "Last", "Pred. change", "Confidence"};
+    for (int c = 0; c < 4; c++) {
+        string label = headers[c];
+        if (c == column) label += descending ? " v" : " ^";
+        draw_text_on_bitmap(layer, label, c == column ? COLOR_BLUE : COLOR_BLACK, "Arial", 11,
+                            TABLE_X + TABLE_COLUMN_X[c], 86);
+    }
+
+    for (int row = 0; row < PAGE_SIZE && first + row < order.size(); row++) {
+        const PortfolioTicker& ticker = portfolio.tickers[order[first + row]];
+        const TickerScore& score = ticker.score;
+        double y = TABLE_TOP + row * TABLE_ROW_HEIGHT;
+        if (row % 2 == 1) fill_rectangle_on_bitmap(layer, BG_COLOR, TABLE_X + 1, y, TABLE_WIDTH - 2, TABLE_ROW_HEIGHT);
+        draw_text_on_bitmap(layer, to_string(first + row + 1) + ". " + score.company.substr(0, 16), COLOR_BLACK,
+                            "Arial", 11, TABLE_X + TABLE_COLUMN_X[0], y + 6);
+        if (!score.loaded || score.last_close == 0) continue;
+
+        char last[32];
+        snprintf(last, sizeof(last), "$%.2f", score.last_close);
+        double change = ticker.change_pct[model];
+        draw_text_on_bitmap(layer, last, COLOR_BLACK, "Arial", 11, TABLE_X + TABLE_COLUMN_X[1], y + 6);
+        draw_text_on_bitmap(layer, format_percent(change, true), change >= 0 ? UP_COLOR : DOWN_COLOR, "Arial", 11,
+                            TABLE_X + TABLE_COLUMN_X[2], y + 6);
+        draw_text_on_bitmap(layer, format_percent(score.models[model].confidence * 100, false), COLOR_BLACK, "Arial",
+                            11, TABLE_X + TABLE_COLUMN_X[3], y + 6);
+    }
+}
+
+// -1 blue, 0 white, +1 red
+color heat_color(double correlation) {
+    double t = fabs(correlation);
+    if (correlation >= 0) return rgb_color(255 - static_cast<int>(t * 16), 255 - static_cast<int>(t * 187), 255 - static_cast<int>(t * 187));
+    return rgb_color(255 - static_cast<int>(t * 196), 255 - static_cast<int>(t * 125), 255 - static_cast<int>(t * 9));
+}
+
+// Heatmap cell (in table order) under a window position; false outside the map.
+bool heatmap_cell(const vector<unsigned int>& order, double mx, double my, unsigned int& i, unsigned int& j) {
+    if (order.empty() || mx < MARGIN || my < 80 || mx >= MARGIN + HEATMAP_SIZE || my >= 80 + HEATMAP_SIZE) return false;
+    size_t n = order.size();
+    i = order[static_cast<size_t>((my - 80) * n / HEATMAP_SIZE)];
+    j = order[static_cast<size_t>((mx - MARGIN) * n / HEATMAP_SIZE)];
+    return true;
+}
+
+// Every pair in table order, one cell per pair (or per pixel past
+// HEATMAP_SIZE tickers), with a colour scale beside it.
+void draw_heatmap(bitmap layer, const vector<unsigned int>& order, const RollingCovariance& correlations,
+                  const ReturnPanel& panel) {
+    TRACE_SCOPE("draw_heatmap");
+    size_t n = order.size();
+    size_t cells = min(n, static_cast<size_t>(HEATMAP_SIZE));
+    double cell = HEATMAP_SIZE / static_cast<double>(cells);
+    for (size_t a = 0; a < cells; a++) {
+        unsigned int i = order[a * n / cells];
+        for (size_t b = 0; b < cells; b++) {
+            unsigned int j = order[b * n / cells];
+            fill_rectangle_on_bitmap(layer, heat_color(correlations.correlation(i, j)), MARGIN + b * cell, 80 + a * cell,
+                                     ceil(cell), ceil(cell));
+        }
+    }
+    draw_rectangle_on_bitmap(layer, COLOR_LIGHT_GRAY, MARGIN, 80, HEATMAP_SIZE, HEATMAP_SIZE);
+
+    double legend_x = MARGIN + HEATMAP_SIZE + 20;
+    for (int y = 0; y < HEATMAP_SIZE; y++) {
+        fill_rectangle_on_bitmap(layer, heat_color(1 - 2.0 * y / HEATMAP_SIZE), legend_x, 80 + y, 16, 1);
+    }
+    draw_text_on_bitmap(layer, "+1", COLOR_BLACK, "Arial", 10, legend_x + 20, 80);
+    draw_text_on_bitmap(layer, "0", COLOR_BLACK, "Arial", 10, legend_x + 20, 80 + HEATMAP_SIZE / 2 - 5);
+    draw_text_on_bitmap(layer, "-1", COLOR_BLACK, "Arial", 10, legend_x + 20, 80 + HEATMAP_SIZE - 10);
+
+    unsigned int end = correlations.window_end();
+    string span = format_timestamp(panel.dates[end - correlations.window_days()]) + " - " +
+                  format_timestamp(panel.dates[end - 1]);
+    draw_text_on_bitmap(layer, "Correlation of daily returns, " + to_string(correlations.window_days()) + " days: " + span,
+                        COLOR_GRAY, "Arial", 11, MARGIN, 66);
+}
+
+void draw_portfolio(bitmap layer, const Portfolio& portfolio, const vector<unsigned int>& order, unsigned int first,
+                    PredictionModel model, PortfolioColumn column, bool descending, const RollingCovariance* heatmap,
+                    const ReturnPanel& panel) {
+    TRACE_SCOPE("draw_portfolio");
+    clear_bitmap(layer, BG_COLOR);
+    draw_text_on_bitmap(layer, "Portfolio: " + to_string(portfolio.size()) + " tickers", COLOR_BLACK, "Arial", 24,
+                        MARGIN, 20);
+    char subtitle[160];
+    snprintf(subtitle, sizeof(subtitle), "%llu bars in %.1f MB (%zu arena blocks), loaded in %.2f s", portfolio.bars,
+             portfolio.arena.used() / 1048576.0, portfolio.arena.block_count(), portfolio.load_seconds);
+    draw_text_on_bitmap(layer, subtitle, COLOR_GRAY, "Arial", 14, MARGIN, 48);
+
+    if (heatmap) {
+        draw_heatmap(layer, order, *heatmap, panel);
+    } else {
+        for (int cell = 0; cell < PAGE_SIZE && first + cell < order.size(); cell++) {
+            double x = MARGIN + (cell % GRID_COLUMNS) * CELL_WIDTH;
+            double y = 80 + (cell / GRID_COLUMNS) * CELL_HEIGHT;
+            draw_sparkline_cell(layer, portfolio.tickers[order[first + cell]], model, x, y);
+        }
+    }
+    draw_portfolio_table(layer, portfolio, order, first, model, column, descending);
+
+    for (int i = 0; i < MODEL_COUNT; i++) {
+        bool selected = model == i;
+        fill_rectangle_on_bitmap(layer, selected ? MODEL_COLORS[i] : COLOR_LIGHT_GRAY,
+                                 MARGIN + i * MODEL_BUTTONS_STEP, MODEL_BUTTONS_Y, MODEL_BUTTONS_STEP - 8, 30);
+        draw_text_on_bitmap(layer, MODEL_NAMES[i], selected ? COLOR_WHITE : COLOR_BLACK, "Arial", 11,
+                            MARGIN + i * MODEL_BUTTONS_STEP + 8, MODEL_BUTTONS_Y + 8);
+    }
+    draw_text_on_bitmap(layer, "Click a column to sort   Wheel / arrows: scroll", COLOR_GRAY, "Arial", 10,
+                        TABLE_X, MODEL_BUTTONS_Y + 4);
+    draw_text_on_bitmap(layer, "C: correlation heatmap   Left / right: move its window", COLOR_GRAY, "Arial", 10,
+                        TABLE_X, MODEL_BUTTONS_Y + 18);
+}
+
+int run_portfolio_view(const vector<string>& files) {
+    write_line("Loading " + to_string(files.size()) + " tickers...");
+    thread_pool pool;
+    Portfolio portfolio;
+    ScoreOptions options;
+    options.cache = CacheOptions();
+    load_portfolio(files, portfolio, pool, options);
+    write_line("Loaded " + to_string(portfolio.bars) + " bars in " + to_string(portfolio.load_seconds) + " s, arena " +
+               to_string(portfolio.arena.used() / 1048576) + " MB");
+
+    open_window("Stock Predictor - Portfolio", WINDOW_WIDTH, WINDOW_HEIGHT);
+    bitmap scene = create_bitmap("portfolio", WINDOW_WIDTH, WINDOW_HEIGHT);
+    PredictionModel model = LINEAR_REGRESSION;
+    PortfolioColumn column = SORT_CHANGE;
+    bool descending = true;
+    vector<unsigned int> order;
+    sort_portfolio(portfolio, column, model, descending, order);
+    int first = 0;
+    bool dirty = true;
+    
+    // Return panel and rolling correlations, built the first time C is pressed
+    ReturnPanel panel;
+    RollingCovariance correlations;
+    bool have_correlations = false, show_heatmap = false;
+
+    while (!quit_requested()) {
+        process_events();
+        bool resort = false;
+        int scroll_rows = 0;
+        bool present = dirty;
+
+        if (key_typed(C_KEY)) {
+            if (!have_correlations) {
+                unsigned int start = current_ticks();
+                build_return_panel(portfolio.series, static_cast<unsigned int>(portfolio.size()), panel);
+                unsigned int window = min(CORRELATION_WINDOW_DAYS, panel.days);
+                have_correlations = correlations.reset(panel, window, panel.days, &pool);
+                write_line("Correlation matrix of " + to_string(portfolio.size()) + " tickers over " + to_string(window) +
+                           " days in " + to_string(current_ticks() - start) + " ms");
+            }
+            show_heatmap = have_correlations && !show_heatmap;
+            dirty = true;
+        }
+        if (show_heatmap && (key_typed(LEFT_KEY) || key_typed(RIGHT_KEY))) {
+            unsigned int end = correlations.window_end();
+            if (key_typed(RIGHT_KEY)) end++;
+            else end--;
+            if (end >= correlations.window_days() && end <= panel.days) {
+                correlations.seek(panel, end, &pool);
+                dirty = true;
+            }
+        }
+        if (show_heatmap && (mouse_movement().x != 0 || mouse_movement().y != 0)) present = true;
+
+        if (mouse_clicked(LEFT_BUTTON)) {
+            double mx = mouse_x(), my = mouse_y();
+            if (my >= 80 && my <= TABLE_TOP && mx >= TABLE_X && mx <= TABLE_X + TABLE_WIDTH) {
+                int clicked = 0;
+                for (int c = 1; c < 4; c++) {
+                    if (mx >= TABLE_X + TABLE_COLUMN_X[c]) clicked = c;
+                }
+                descending = clicked == column ? !descending : clicked != SORT_TICKER;
+                column = static_cast<PortfolioColumn>(clicked);
+                resort = true;
+            } else if (my >= MODEL_BUTTONS_Y && my <= MODEL_BUTTONS_Y + 30 && mx >= MARGIN &&
+                       mx < MARGIN + MODEL_COUNT * MODEL_BUTTONS_STEP) {
+                model = ALL_MODELS[min(MODEL_COUNT - 1, static_cast<int>((mx - MARGIN) / MODEL_BUTTONS_STEP))];
+                resort = true;
+            }
+        }
+        vector_2d scroll = mouse_wheel_scroll();
+        if (scroll.y != 0) scroll_rows = scroll.y > 0 ? -GRID_COLUMNS : GRID_COLUMNS;
+        if (key_typed(UP_KEY)) scroll_rows = -GRID_COLUMNS;
+        if (key_typed(DOWN_KEY)) scroll_rows = GRID_COLUMNS;
+
+        if (resort) {
+            sort_portfolio(portfolio, column, model, descending, order);
+            first = 0;
+            dirty = true;
+        }
+        if (scroll_rows != 0) {
+            int last_page = max(0, (static_cast<int>(order.size()) - PAGE_SIZE + GRID_COLUMNS - 1) / GRID_COLUMNS * GRID_COLUMNS);
+            int moved = max(0, min(last_page, first + scroll_rows));
+            dirty |= moved != first;
+            first = moved;
+        }
+
+        if (dirty) {
+            draw_portfolio(scene, portfolio, order, first, model, column, descending,
+                           show_heatmap ? &correlations : nullptr, panel);
+        }
+        if (dirty || present) {
+            draw_bitmap(scene, 0, 0);
+            unsigned int i, j;
+            if (show_heatmap && heatmap_cell(order, mouse_x(), mouse_y(), i, j)) {
+                char pair[160];
+                snprintf(pair, sizeof(pair), "%s / %s: correlation %.3f, covariance %.3g",
+                         portfolio.tickers[i].score.company.c_str(), portfolio.tickers[j].score.company.c_str(),
+                         correlations.correlation(i, j), correlations.covariance(i, j));
+                draw_text(pair, COLOR_BLACK, "Arial", 11, MARGIN, 80 + HEATMAP_SIZE + 6);
+            }
+            {
+                TRACE_SCOPE("refresh_screen");
+                refresh_screen(60);
+            }
+            dirty = false;
+        } else {
+            delay(IDLE_DELAY_MS);
+        }
+    }
+
+    free_bitmap(scene);
+    close_all_windows();
+    return 0;
+}
+
+// Every argument is a CSV or a directory of them. The arguments joined with
+// spaces are tried first, so an unquoted filename with spaces still opens as
+// one file.
+vector<string> input_files(int argc, char* argv[], int first_arg) {
+    vector<string> files;
+    if (argc <= first_arg) return files;
+    string joined = argv[first_arg];
+    for (int i = first_arg + 1; i < argc; i++) joined += " " + string(argv[i]);
+    SourceStamp stamp;
+    if (argc == first_arg + 1 || joined == "-" || stamp_source(joined, stamp)) {
+        collect_csv_files(joined, files);
+        if (files.empty()) files.push_back(joined);
+        return files;
+    }
+    for (int i = first_arg; i < argc; i++) {
+        if (!collect_csv_files(argv[i], files)) write_line("Warning: cannot open " + string(argv[i]));
+    }
+    return files;
+}
+
+// True when every file is named for the same ticker (STOCK_US_XNAS_GOOG.csv, ...).
+bool same_ticker(const vector<string>& files) {
+    for (size_t i = 1; i < files.size(); i++) {
+        if (extract_company_name(files[i]) != extract_company_name(files[0])) return false;
+    }
+    return true;
+}
+
+// --trace FILE: loading, models and drawing are timed from startup (see
+// trace.hpp) and written to FILE as Chrome trace events at exit, with the
+// p50/p99 of every phase on the console. Builds without -DHD_TRACING warn.
+void start_trace_output() {
+    if (!TRACING_COMPILED_IN) {
+        write_line("Warning: --trace needs a build with -DHD_TRACING; not tracing");
+        return;
+    }
+    start_tracing();
+}
+
+void finish_trace_output(const string& path) {
+    if (path.empty() || !TRACING_COMPILED_IN) return;
+    stop_tracing();
+    vector<string> summary = trace_summary_lines();
+    for (size_t i = 0; i < summary.size(); i++) write_line(summary[i]);
+    if (write_chrome_trace(path)) write_line("Trace written to " + path);
+    else write_line("Error: Cannot write " + path);
 }
 
 // Main program
@@ -410,39 +1055,136 @@ int main(int argc, char* argv[]) {
     // Default filename
     string filename = "stock_data.csv";
     
-    // Check for command line arguments
-    if (argc > 1) {
-        // Concatenate all arguments after program name to handle spaces in filename
-        filename = argv[1];
-        for (int i = 2; i < argc; i++) {
-            filename += " " + string(argv[i]);
+    // --follow keeps reading bars appended to the file (or stdin for "-");
+    // --from and --to pick the days opened from a partition directory
+    int first_arg = 1;
+    bool follow = false;
+    string trace_path;
+    int64_t from_time = INVALID_TIMESTAMP, to_time = INVALID_TIMESTAMP;
+    while (first_arg < argc) {
+        string option = argv[first_arg];
+        if (option == "--follow") {
+            follow = true;
+            first_arg++;
+        } else if (option == "--trace" && first_arg + 1 < argc) {
+            trace_path = argv[first_arg + 1];
+            first_arg += 2;
+        } else if ((option == "--from" || option == "--to") && first_arg + 1 < argc) {
+            int64_t& bound = option == "--from" ? from_time : to_time;
+            bound = parse_timestamp(argv[first_arg + 1]);
+            first_arg += 2;
+        } else {
+            break;
         }
     }
+    if (!trace_path.empty()) start_trace_output();
+    
+    // A directory written by hd_partition opens the days asked for, already
+    // aggregated to every timeframe; otherwise T switches between timeframes
+    // built from the loaded bars
+    bool partitioned = argc == first_arg + 1 && !follow && is_partition_dir(argv[first_arg]);
+    ResolutionSet resolutions;
+    
+    // Several files, or a directory of them, open the portfolio view; several
+    // exports of one ticker are merged into a single history instead
+    vector<string> files = partitioned ? vector<string>() : input_files(argc, argv, first_arg);
+    bool merge = files.size() > 1 && !follow && same_ticker(files);
+    if (files.size() > 1 && !follow && !merge) {
+        int status = run_portfolio_view(files);
+        finish_trace_output(trace_path);
+        return status;
+    }
+    if (files.size() > 1 && follow) write_line("Warning: --follow takes one file; following " + files[0]);
+    if (!files.empty()) filename = files[0];
+    if (!merge) files.assign(1, filename);
+    bool from_stdin = follow && filename == "-";
     
     write_line("Starting Stock Price Predictor...");
-    write_line("Loading data from: " + filename);
+    if (partitioned) filename = argv[first_arg];
+    write_line(from_stdin ? string("Reading bars from stdin") : "Loading data from: " + filename);
     
     open_window("Stock Predictor", WINDOW_WIDTH, WINDOW_HEIGHT);
     
     StockPredictor predictor;
-    if (!load_stock_data(predictor, filename)) {
+    size_t source_bytes = 0;
+    bool loaded;
+    if (partitioned) {
+        int32_t from_day = from_time == INVALID_TIMESTAMP ? INT32_MIN : epoch_day(from_time);
+        int32_t to_day = to_time == INVALID_TIMESTAMP ? INT32_MAX : epoch_day(to_time);
+        loaded = load_partition_data(predictor, filename, from_day, to_day, resolutions);
+    } else {
+        loaded = from_stdin || load_stock_data(predictor, files, 0, CacheOptions(), &source_bytes);
+        if (loaded && !follow && !build_resolutions(predictor.series, resolutions)) {
+            write_line("Warning: Not enough memory for other timeframes");
+        }
+    }
+    SourceStamp stamp;
+    if (!loaded && follow && stamp_source(filename, stamp)) {
+        loaded = true;  // no bars yet, but the file exists and may grow
+    }
+    if (!loaded) {
         write_line("Error: Could not load stock data from " + filename);
-        write_line("Usage: " + string(argv[0]) + " [csv_filename]");
+        write_line("Usage: " + string(argv[0]) + " [--follow] [--trace FILE] [csv_filename | -] | csv_files... | directory");
+        write_line("       " + string(argv[0]) + " [--from DATE] [--to DATE] partition_directory");
         write_line("Expected CSV format: Date,Open,High,Low,Close,Volume");
+        finish_trace_output(trace_path);
         delay(3000);
         return 1;
     }
+    if (from_stdin) predictor.company_name = "stdin";
     
+    // Measure every model one step ahead on the history; the hit rates become
+    // the confidence shown in the panel.
+    run_and_report_backtest(predictor);
     calculate_predictions(predictor);
+    thread_pool pool;
     
-    // Find price range for grid drawing
-    double min_price = 999999, max_price = 0;
-    for (unsigned int i = 0; i < predictor.data.size; i++) {
-        min_price = std::min(min_price, predictor.data.get(i).low);
-        max_price = std::max(max_price, predictor.data.get(i).high);
+    // Follow mode: a parser thread and a model thread (ingest_pipeline.hpp)
+    // turn appended lines into bars and predictions; each frame only drains
+    // the bars that are ready and takes the newest model snapshot, so a burst
+    // never blocks drawing and a slow frame never delays the models
+    IngestPipeline pipeline;
+    std::vector<LiveBar> new_bars;
+    ModelSnapshot snapshot;
+    bool have_snapshot = false;
+    if (follow) {
+        prepare_follow(predictor);
+        if (!pipeline.start(filename, source_bytes, predictor.series, predictor.params, predictor.confidence)) {
+            write_line("Error: Cannot follow " + filename);
+            follow = false;
+        }
     }
     
+    // Candle aggregates for drawing and for the visible price range
+    CandlePyramid pyramid;
+    pyramid.build(predictor.series);
+    ChartView view;
+    show_all_bars(view, pyramid, predictor.series);
+    
+    // Prefix sums for refitting the trend line to the view, built on first use
+    RegressionPrefix visible_fit;
+    bool refit_visible = false;
+    bool was_down = false, dragging = false;
+    
+    ChartIndicators indicators;
+    
+    // M cycles the Monte Carlo inset: GBM, bootstrap, off. The simulation runs
+    // once per press; in follow mode the inset keeps the bar it started from.
+    MonteCarloResult simulation;
+    bool show_simulation = false;
+    unsigned int simulated_at = 0;
+    
+    // The static layers are rendered once into `scene` and re-blitted; input
+    // only invalidates the regions it changes. P toggles the frame profiler
+    // line (its summary is also logged every couple of seconds).
+    bitmap scene = create_bitmap("scene", WINDOW_WIDTH, WINDOW_HEIGHT);
+    unsigned int dirty = DIRTY_ALL;
+    unsigned int last_present = 0;
+    bool show_profiler = false;
+    FrameProfiler profiler;
+    
     while (!quit_requested()) {
+        profiler.begin_frame();
         process_events();
         
         if (mouse_clicked(LEFT_BUTTON)) {
@@ -450,22 +1192,191 @@ int main(int argc, char* argv[]) {
             double my = mouse_y();
             
             int panel_x = MARGIN + CHART_WIDTH + 30;
-            if (mx >= panel_x + 10 && mx <= panel_x + 150) {
-                if (my >= 120 && my <= 150) predictor.model = LINEAR_REGRESSION;
-                else if (my >= 160 && my <= 190) predictor.model = MOVING_AVERAGE;
-                else if (my >= 200 && my <= 230) predictor.model = EXPONENTIAL_SMOOTHING;
+            double buttons_y = my - 80 - MODEL_BUTTON_TOP;
+            int button = buttons_y >= 0 ? static_cast<int>(buttons_y / MODEL_BUTTON_SPACING) : -1;
+            bool on_button = button >= 0 && button < MODEL_COUNT &&
+                             buttons_y - button * MODEL_BUTTON_SPACING <= MODEL_BUTTON_HEIGHT;
+            if (mx >= panel_x + 10 && mx <= panel_x + 150 && on_button) {
+                predictor.model = ALL_MODELS[button];
+                if (have_snapshot) predictor.stats = snapshot.stats[predictor.model];
+                else calculate_predictions(predictor);
+                dirty |= DIRTY_CONTROLS | DIRTY_OVERLAY;
+            }
+        }
+        
+        if (key_typed(O_KEY)) {
+            optimize_parameters(predictor, pool);
+            if (follow) pipeline.reconfigure(predictor.params, predictor.confidence);
+            dirty |= DIRTY_CONTROLS | DIRTY_OVERLAY;
+        }
+        
+        // Append whatever the pipeline delivered since the last frame; a view
+        // that showed the newest bar keeps following it. A bar that revised
+        // the newest one rewinds the aggregates to it before they catch up.
+        new_bars.clear();
+        if (follow && pipeline.drain(new_bars) > 0) {
+            unsigned int old_size = predictor.series.size;
+            bool at_end = view.end == old_size;
+            bool whole = at_end && view.begin == 0;
+            bool revised = false;
+            for (size_t i = 0; i < new_bars.size(); i++) {
+                if (!add_followed_bar(predictor.series, new_bars[i]) && predictor.series.size == old_size) {
+                    revised = true;
+                }
+            }
+            if (revised) {
+                pyramid.rewind(old_size - 1);
+                visible_fit.rewind(old_size - 1);
+                indicators.set.reset();
+            }
+            pyramid.sync(predictor.series);
+            if (refit_visible) visible_fit.sync(predictor.series);
+            if (indicators.active()) indicators.set.update(predictor.series);
+            if (whole) {
+                view.begin = 0;
+                view.end = predictor.series.size;
+            } else if (at_end) {
+                pan_view(view, predictor.series.size, predictor.series.size - old_size);
+            }
+            update_view_range(view, pyramid, predictor.series);
+            dirty |= DIRTY_ALL;
+        }
+        if (follow && pipeline.latest(snapshot)) {
+            have_snapshot = true;
+            predictor.stats = snapshot.stats[predictor.model];
+            dirty |= DIRTY_CONTROLS | DIRTY_OVERLAY;
+        }
+        
+        // Wheel zooms around the mouse, dragging the chart pans, H shows everything
+        bool view_changed = false;
+        double mx = mouse_x(), my = mouse_y();
+        bool over_chart = mx >= MARGIN && mx <= MARGIN + CHART_WIDTH && my >= 80 && my <= 80 + CHART_HEIGHT;
+        vector_2d scroll = mouse_wheel_scroll();
+        if (scroll.y != 0) {
+            double anchor = over_chart ? (mx - MARGIN) / CHART_WIDTH : 0.5;
+            view_changed = zoom_view(view, predictor.series.size, pow(ZOOM_STEP, scroll.y), anchor);
+        }
+        
+        bool down = mouse_down(LEFT_BUTTON);
+        if (down && !was_down) dragging = over_chart;
+        if (!down) dragging = false;
+        was_down = down;
+        if (dragging) {
+            double dx = mouse_movement().x;
+            if (dx != 0) view_changed |= pan_view(view, predictor.series.size, -dx * view.visible() / CHART_WIDTH);
+        }
+        
+        if (key_typed(H_KEY)) {
+            show_all_bars(view, pyramid, predictor.series);
+            view_changed = true;
+        }
+        
+        if (view_changed) {
+            update_view_range(view, pyramid, predictor.series);
+            dirty |= DIRTY_CHART | DIRTY_OVERLAY;
+        }
+        
+        if (key_typed(R_KEY)) {
+            refit_visible = !refit_visible;
+            if (refit_visible) visible_fit.sync(predictor.series);
+            dirty |= DIRTY_OVERLAY;
+        }
+        
+        if (key_typed(P_KEY)) {
+            show_profiler = !show_profiler;
+            dirty |= DIRTY_OVERLAY;
+        }
+        
+        if (key_typed(I_KEY)) {
+            indicators.overlay = static_cast<IndicatorOverlay>((indicators.overlay + 1) % OVERLAY_COUNT);
+            if (indicators.active() && !indicators.set.update(predictor.series)) {
+                write_line("Error: Not enough memory for the indicators");
+                indicators.overlay = OVERLAY_NONE;
+            }
+            dirty |= DIRTY_CHART;
+        }
+        
+        if (key_typed(M_KEY)) {
+            if (!show_simulation || simulation.model == MC_GBM) {
+                MonteCarloModel model = show_simulation ? MC_BOOTSTRAP : MC_GBM;
+                show_simulation = run_forecast_simulation(predictor, model, pool, simulation);
+                simulated_at = predictor.series.size;
+            } else {
+                show_simulation = false;
+            }
+            dirty |= DIRTY_CHART;
+        }
+        
+        // T steps through the timeframes that have fewer bars than the data
+        // (see resampler.hpp); the chart, indicators and models start over on
+        // the new bars. Following a file only adds raw bars, so it stays put.
+        if (key_typed(T_KEY)) {
+            Timeframe next = resolutions.next();
+            if (follow) {
+                write_line("Warning: The timeframe cannot change while following a file");
+            } else if (next != resolutions.active && select_timeframe(resolutions, predictor.series, next)) {
+                pyramid.build(predictor.series);
+                show_all_bars(view, pyramid, predictor.series);
+                visible_fit.clear();
+                if (refit_visible) visible_fit.sync(predictor.series);
+                indicators.set.reset();
+                if (indicators.active() && !indicators.set.update(predictor.series)) {
+                    write_line("Error: Not enough memory for the indicators");
+                    indicators.overlay = OVERLAY_NONE;
+                }
+                show_simulation = false;
+                write_line("Timeframe: " + string(TIMEFRAME_NAMES[next]) + ", " +
+                           std::to_string(predictor.series.size) + " bars");
+                run_and_report_backtest(predictor);
                 calculate_predictions(predictor);
+                dirty |= DIRTY_ALL;
             }
         }
         
-        draw_background(predictor);
-        draw_grid_and_axes(predictor, min_price, max_price);
-        draw_chart(predictor);
-        draw_controls(predictor);
-        draw_info_panel(predictor);
-        refresh_screen(60);
+        // Clearing the chart layer wipes the panels drawn on top of it
+        if (dirty & DIRTY_CHART) {
+            dirty |= DIRTY_CONTROLS | DIRTY_INFO;
+            draw_background(scene, predictor);
+            draw_grid_and_axes(scene, view);
+            draw_chart(scene, predictor, pyramid, view);
+            draw_indicator_overlay(scene, indicators, view);
+            if (show_simulation) draw_monte_carlo_inset(scene, simulation, predictor.series, simulated_at);
+        }
+        if (dirty & DIRTY_CONTROLS) draw_controls(scene, predictor);
+        if (dirty & DIRTY_INFO) draw_info_panel(scene, predictor, view, indicators, resolutions.active);
+        
+        unsigned int now = current_ticks();
+        bool present = dirty != 0 || now - last_present >= IDLE_REFRESH_MS;
+        if (present) {
+            draw_bitmap(scene, 0, 0);
+            draw_trend_line(predictor, view, refit_visible ? &visible_fit : nullptr);
+            draw_forecast_fan(predictor, view);
+            if (show_profiler && !profiler.last_summary.empty()) {
+                draw_text(profiler.last_summary, COLOR_DARK_GRAY, "Arial", 10, MARGIN, WINDOW_HEIGHT - 20);
+                if (follow) draw_text(pipeline.summary(), COLOR_DARK_GRAY, "Arial", 10, MARGIN, WINDOW_HEIGHT - 8);
+            }
+            {
+                TRACE_SCOPE("refresh_screen");
+                refresh_screen(60);
+            }
+            last_present = now;
+            dirty = 0;
+        } else if (follow && !pipeline.finished()) {
+            pipeline.wait(IDLE_DELAY_MS);   // wakes as soon as a bar is modelled
+        } else {
+            delay(IDLE_DELAY_MS);
+        }
+        
+        if (profiler.end_frame(present)) {
+            write_line(profiler.last_summary);
+            if (follow) write_line(pipeline.summary());
+            if (show_profiler) dirty |= DIRTY_OVERLAY;
+        }
     }
     
+    pipeline.stop();
+    free_bitmap(scene);
     close_all_windows();
+    finish_trace_output(trace_path);
     return 0;
 }
\ No newline at end of file
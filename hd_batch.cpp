@@ -0,0 +1,164 @@
+// hd_batch.cpp - Headless batch scoring: every model on every ticker, no window
+//
+// Build: clang++ -O2 -std=c++11 -pthread hd_batch.cpp -o hd_batch
+// (no SplashKit needed)
+
+#include "batch_scoring.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+void print_usage(const char *program) {
+    cerr << "Usage: " << program << " [--format csv|json] [--threads N] [--output FILE] [--list FILE]"
+         << " [--cache] [--verify-cache] [--optimize] [--objective mae|rmse|mape] [--surface FILE]"
+         << " [--ar-order N] [--season N] [--trace FILE] <csv file or directory>..." << endl;
+    cerr << "  Scores every CSV with all prediction models and writes one row per ticker." << endl;
+    cerr << "  --list FILE reads additional paths from FILE, one per line." << endl;
+    cerr << "  --cache maps <file>.cache when the CSV is unchanged and writes it otherwise;" << endl;
+    cerr << "  --verify-cache also checks its checksum and rebuilds corrupt caches." << endl;
+    cerr << "  --optimize picks each model's lookback/window/alpha/order by walk-forward error" << endl;
+    cerr << "  (--objective, default mae); --surface FILE writes every evaluated value." << endl;
+    cerr << "  --ar-order N sets the autoregressive lags (1-" << AR_MAX_ORDER << ", default " << AR_ORDER << ");" << endl;
+    cerr << "  --season N gives Holt-Winters an N-bar season (default none: Holt's trend)." << endl;
+    cerr << "  --trace FILE writes Chrome trace events and prints p50/p99 per phase (builds with -DHD_TRACING)." << endl;
+}
+
+bool read_file_list(const string& list_file, vector<string>& paths) {
+    ifstream in(list_file);
+    if (!in.is_open()) return false;
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) paths.push_back(line);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    string format = "csv";
+    string output;
+    unsigned int threads = 0;
+    ScoreOptions options;
+    options.batched_autoregressive = true;    // several tickers per SIMD pass
+    string surface_output;
+    string trace_output;
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--format" && has_value) {
+            format = argv[++i];
+        } else if (arg == "--threads" && has_value) {
+            threads = static_cast<unsigned int>(atoi(argv[++i]));
+        } else if (arg == "--output" && has_value) {
+            output = argv[++i];
+        } else if (arg == "--list" && has_value) {
+            if (!read_file_list(argv[++i], paths)) {
+                cerr << "Error: Cannot open list " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--cache") {
+            options.cache.enabled = true;
+        } else if (arg == "--verify-cache") {
+            options.cache.enabled = true;
+            options.cache.verify_checksum = true;
+        } else if (arg == "--optimize") {
+            options.optimize = true;
+        } else if (arg == "--objective" && has_value) {
+            string objective = argv[++i];
+            if (objective == "mae") options.grid.objective = OBJECTIVE_MAE;
+            else if (objective == "rmse") options.grid.objective = OBJECTIVE_RMSE;
+            else if (objective == "mape") options.grid.objective = OBJECTIVE_MAPE;
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--ar-order" && has_value) {
+            options.params.ar_order = clamp_ar_order(atoi(argv[++i]));
+        } else if (arg == "--season" && has_value) {
+            int season = atoi(argv[++i]);
+            options.params.season_length = season > 1 ? static_cast<unsigned int>(season) : 0;
+        } else if (arg == "--surface" && has_value) {
+            surface_output = argv[++i];
+            options.optimize = true;
+        } else if (arg == "--trace" && has_value) {
+            trace_output = argv[++i];
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty() || (format != "csv" && format != "json")) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    vector<string> files;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!collect_csv_files(paths[i], files)) {
+            cerr << "Warning: " << paths[i] << " not found" << endl;
+        }
+    }
+
+    if (!trace_output.empty()) {
+        if (TRACING_COMPILED_IN) start_tracing();
+        else cerr << "Warning: --trace needs a build with -DHD_TRACING; not tracing" << endl;
+    }
+
+    thread_pool pool(threads);
+    vector<TickerScore> scores;
+    auto start = chrono::steady_clock::now();
+    score_tickers(files, scores, pool, options);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ofstream file_out;
+    if (!output.empty()) {
+        file_out.open(output);
+        if (!file_out.is_open()) {
+            cerr << "Error: Cannot write " << output << endl;
+            return 1;
+        }
+    }
+    ostream& out = output.empty() ? cout : file_out;
+    if (format == "json") {
+        write_scores_json(out, scores);
+    } else {
+        write_scores_csv(out, scores);
+    }
+
+    if (!surface_output.empty()) {
+        ofstream surface_out(surface_output);
+        if (!surface_out.is_open()) {
+            cerr << "Error: Cannot write " << surface_output << endl;
+            return 1;
+        }
+        write_surfaces_csv(surface_out, scores);
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < scores.size(); i++) {
+        if (!scores[i].loaded) failed++;
+    }
+    cerr << "Scored " << files.size() << " files (" << failed << " unreadable) in " << secs
+         << " s on " << pool.size() << " threads" << endl;
+
+    if (!trace_output.empty() && TRACING_COMPILED_IN) {
+        stop_tracing();
+        vector<string> summary = trace_summary_lines();
+        for (size_t i = 0; i < summary.size(); i++) cerr << summary[i] << endl;
+        if (!write_chrome_trace(trace_output)) cerr << "Error: Cannot write " << trace_output << endl;
+    }
+    return failed == static_cast<int>(files.size()) && !files.empty() ? 1 : 0;
+}
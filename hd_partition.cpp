@@ -0,0 +1,120 @@
+// hd_partition.cpp - Splits an intraday CSV into day partitions and exports date ranges from them
+//
+// Build: clang++ -O2 -std=c++11 -pthread hd_partition.cpp -o hd_partition
+// (no SplashKit needed)
+
+#include "day_partitions.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+void print_usage(const char *program) {
+    cerr << "Usage: " << program << " <csv file> <directory>" << endl;
+    cerr << "       " << program << " [--from DATE] [--to DATE] [--timeframe raw|1m|5m|1h|1d|1w] [--output FILE]"
+         << " [--verify] <directory>" << endl;
+    cerr << "  The first form reads the CSV (Date,Open,High,Low,Close,Volume bars or Time,Price,Size" << endl;
+    cerr << "  trades) once and writes one file per day with its 1m, 5m and 1h bars, plus the daily" << endl;
+    cerr << "  bars, into the directory." << endl;
+    cerr << "  The second form writes the bars of a date range (inclusive, default everything) as CSV," << endl;
+    cerr << "  reading only the day files in the range; --verify also checks their checksums." << endl;
+}
+
+int split_csv(const string& csv_path, const string& dir) {
+    CsvLoadResult result;
+    PartitionManifest manifest;
+    auto start = chrono::steady_clock::now();
+    if (!write_day_partitions(csv_path, dir, result, &manifest)) {
+        cerr << "Error: Cannot partition " << csv_path << " into " << dir << endl;
+        return 1;
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "Wrote " << manifest.days.size() << " days of " << manifest.ticker << " (" << result.valid_rows
+         << (manifest.trades ? " trades" : " rows") << ", " << result.skipped_rows << " skipped) to " << dir << " in "
+         << secs << " s" << endl;
+    return 0;
+}
+
+int export_range(const string& dir, int64_t from_time, int64_t to_time, Timeframe timeframe, const string& output,
+                 bool verify) {
+    int32_t from_day = from_time == INVALID_TIMESTAMP ? INT32_MIN : epoch_day(from_time);
+    int32_t to_day = to_time == INVALID_TIMESTAMP ? INT32_MAX : epoch_day(to_time);
+    ResolutionSet set;
+    PriceSeries series;
+    PartitionManifest manifest;
+    if (!load_partition_range(dir, from_day, to_day, set, series, manifest, verify)) {
+        cerr << "Error: Cannot read the partitions in " << dir << endl;
+        return 1;
+    }
+    if (!select_timeframe(set, series, timeframe)) {
+        cerr << "Warning: " << TIMEFRAME_NAMES[timeframe] << " bars are no coarser than the data; writing raw rows"
+             << endl;
+    }
+
+    FILE *out = output.empty() ? stdout : fopen(output.c_str(), "w");
+    if (!out) {
+        cerr << "Error: Cannot write " << output << endl;
+        return 1;
+    }
+    fprintf(out, "Date,Open,High,Low,Close,Volume\n");
+    for (unsigned int i = 0; i < series.size; i++) {
+        fprintf(out, "%s,%.10g,%.10g,%.10g,%.10g,%.10g\n", format_timestamp(series.time[i]).c_str(), series.open[i],
+                series.high[i], series.low[i], series.close[i], series.volume[i]);
+    }
+    bool written = !ferror(out);
+    if (out != stdout) written = fclose(out) == 0 && written;
+    if (!written) {
+        cerr << "Error: Cannot write " << (output.empty() ? "the bars" : output) << endl;
+        return 1;
+    }
+    cerr << "Exported " << series.size << " " << TIMEFRAME_NAMES[set.active] << " bars of " << manifest.ticker
+         << endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int64_t from_time = INVALID_TIMESTAMP, to_time = INVALID_TIMESTAMP;
+    Timeframe timeframe = TIMEFRAME_RAW;
+    string output;
+    bool verify = false;
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if ((arg == "--from" || arg == "--to") && has_value) {
+            int64_t& bound = arg == "--from" ? from_time : to_time;
+            bound = parse_timestamp(argv[++i]);
+            if (bound == INVALID_TIMESTAMP) {
+                cerr << "Error: Cannot read the date " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--timeframe" && has_value) {
+            if (!parse_timeframe(argv[++i], timeframe)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--output" && has_value) {
+            output = argv[++i];
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.size() == 2) return split_csv(paths[0], paths[1]);
+    if (paths.size() == 1) return export_range(paths[0], from_time, to_time, timeframe, output, verify);
+    print_usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,384 @@
+// incremental_model.hpp - O(1)-per-bar model updates for appended bars
+#ifndef INCREMENTAL_MODEL_HPP
+#define INCREMENTAL_MODEL_HPP
+
+#include "stock_predictor.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// A cached autoregressive fit is reused by next_prediction() until the
+// regression has grown by 1/AR_REFIT_DIVISOR of its rows (every new row
+// early on); stats() always solves the current equations.
+const double AR_REFIT_DIVISOR = 256;
+
+// Neumaier's variant of Kahan summation: the running error term also
+// captures the case where the addend is larger than the sum.
+struct neumaier_sum {
+    double sum;
+    double compensation;
+
+    neumaier_sum() : sum(0), compensation(0) {}
+
+    void add(double value) {
+        double t = sum + value;
+        if (std::fabs(sum) >= std::fabs(value)) {
+            compensation += (sum - t) + value;
+        } else {
+            compensation += (value - t) + sum;
+        }
+        sum = t;
+    }
+
+    double value() const {
+        return sum + compensation;
+    }
+
+    void reset() {
+        sum = 0;
+        compensation = 0;
+    }
+};
+
+// Keeps every model's state so each appended bar costs O(1):
+//  - regression over the whole history: Welford-style co-moments around the
+//    running means, accumulated with compensated sums, so slope/intercept/r^2
+//    match a full recompute even after tens of millions of bars;
+//  - regression over the last regression_lookback bars: compensated sliding
+//    sums of y, x*y and y^2 in window-local x, with y shifted by the first
+//    close to keep the terms small;
+//  - moving average: a ring buffer of the last sma_period closes, summed
+//    newest first exactly as calculate_predictions does;
+//  - exponential smoothing: the EMA recurrence itself;
+//  - autoregressive: the normal equations gain one row per bar, and the
+//    last ar_order changes are kept for the lag vector;
+//  - Holt-Winters: level, trend and season are updated in place.
+struct IncrementalPredictor {
+    ModelParams params;
+    unsigned long long count;
+    neumaier_sum sum_y;     // sum of closes
+    neumaier_sum co_xy;     // sum of (x - x_mean)(y - y_mean)
+    neumaier_sum m2_y;      // sum of (y - y_mean)^2
+    std::vector<double> window;   // last regression_lookback shifted closes (lookback mode)
+    unsigned int window_pos;
+    double shift;
+    neumaier_sum win_y;     // sum of y - shift over the window
+    neumaier_sum win_xy;    // sum of (x - window start) * (y - shift)
+    neumaier_sum win_yy;    // sum of (y - shift)^2
+    std::vector<double> ring;
+    int ring_pos;
+    double ema_value;
+    NormalEquations ar_equations;
+    double ar_lags[AR_MAX_ORDER];   // latest changes of the close, newest first
+    double last_close;
+    mutable ArFit ar_fit;           // see autoregressive_fit()
+    mutable double ar_fit_rows;
+    HoltWinters holt;
+
+    explicit IncrementalPredictor(const ModelParams& model_params = ModelParams())
+        : params(model_params), holt(make_holt_winters(model_params)) {
+        if (params.sma_period < 1) params.sma_period = 1;
+        params.ar_order = clamp_ar_order(params.ar_order);
+        window.assign(uses_lookback() ? params.regression_lookback : 0, 0.0);
+        ring.assign(params.sma_period, 0.0);
+        reset();
+    }
+
+    void reset() {
+        count = 0;
+        sum_y.reset();
+        co_xy.reset();
+        m2_y.reset();
+        for (size_t i = 0; i < window.size(); i++) window[i] = 0;
+        window_pos = 0;
+        shift = 0;
+        win_y.reset();
+        win_xy.reset();
+        win_yy.reset();
+        for (int i = 0; i < params.sma_period; i++) ring[i] = 0;
+        ring_pos = 0;
+        ema_value = 0;
+        ar_equations.reset(params.ar_order + 1);
+        for (int k = 0; k < AR_MAX_ORDER; k++) ar_lags[k] = 0;
+        last_close = 0;
+        ar_fit = ArFit();
+        ar_fit_rows = -1;
+        holt.reset();
+    }
+
+    // Same rule as calculate_predictions: a lookback below 2 means the whole history
+    bool uses_lookback() const {
+        return params.regression_lookback >= 2;
+    }
+
+    void on_bar(const StockData& bar) {
+        on_close(bar.close);
+    }
+
+    void on_close(double y) {
+        if (uses_lookback()) {
+            slide_window(y);
+        } else {
+            // Bar index x runs 0, 1, 2, ... so its mean is (count - 1) / 2
+            double x = static_cast<double>(count);
+            double x_mean_before = count > 0 ? (count - 1) / 2.0 : 0;
+            double y_mean_before = count > 0 ? sum_y.value() / count : 0;
+
+            sum_y.add(y);
+            double y_mean = sum_y.value() / (count + 1);
+
+            double dx = x - x_mean_before;
+            double dy = y - y_mean_before;
+            co_xy.add(dx * (y - y_mean));
+            m2_y.add(dy * (y - y_mean));
+        }
+        count++;
+
+        ring[ring_pos] = y;
+        ring_pos = ring_pos + 1 == params.sma_period ? 0 : ring_pos + 1;
+
+        ema_value = (count == 1) ? y : params.ema_alpha * y + (1 - params.ema_alpha) * ema_value;
+
+        // Same rows as autoregressive_equations: one per bar once ar_order
+        // changes precede it
+        if (count > 1) {
+            double d = y - last_close;
+            if (count > static_cast<unsigned long long>(params.ar_order) + 1) {
+                double x[LSQ_MAX_TERMS];
+                x[0] = 1;
+                for (int k = 0; k < params.ar_order; k++) x[k + 1] = ar_lags[k];
+                ar_equations.add(x, d);
+            }
+            for (int k = params.ar_order - 1; k > 0; k--) ar_lags[k] = ar_lags[k - 1];
+            ar_lags[0] = d;
+        }
+        last_close = y;
+        holt.add(y);
+    }
+
+    // Bars the regression currently fits
+    unsigned long long regression_size() const {
+        unsigned long long lookback = params.regression_lookback;
+        return uses_lookback() && count > lookback ? lookback : count;
+    }
+
+    // Mean bar index of the fitted bars, in whole-history coordinates
+    double x_mean() const {
+        unsigned long long m = regression_size();
+        return m > 0 ? static_cast<double>(count - m) + (m - 1) / 2.0 : 0;
+    }
+
+    double y_mean() const {
+        unsigned long long m = regression_size();
+        if (m == 0) return 0;
+        return uses_lookback() ? shift + win_y.value() / m : sum_y.value() / count;
+    }
+
+    // Sum of (x - x_mean)^2 over the fitted bars
+    double m2_x() const {
+        double n = static_cast<double>(regression_size());
+        return n * (n * n - 1) / 12.0;
+    }
+
+    // Sum of (x - x_mean)(y - y_mean) over the fitted bars
+    double m_xy() const {
+        if (!uses_lookback()) return co_xy.value();
+        unsigned long long m = regression_size();
+        return m > 0 ? win_xy.value() - (m - 1) / 2.0 * win_y.value() : 0;
+    }
+
+    // Sum of (y - y_mean)^2 over the fitted bars
+    double m_yy() const {
+        if (!uses_lookback()) return m2_y.value();
+        unsigned long long m = regression_size();
+        return m > 0 ? win_yy.value() - win_y.value() * win_y.value() / m : 0;
+    }
+
+    double slope() const {
+        double sxx = m2_x();
+        return sxx != 0 ? m_xy() / sxx : 0;
+    }
+
+    double intercept() const {
+        return y_mean() - slope() * x_mean();
+    }
+
+    double r_squared() const {
+        double sxx = m2_x();
+        double syy = m_yy();
+        if (sxx <= 0 || syy <= 0) return 0;
+        double sxy = m_xy();
+        double r2 = sxy * sxy / (sxx * syy);
+        return r2 > 1 ? 1 : r2;
+    }
+
+    bool has_sma() const {
+        return count >= static_cast<unsigned long long>(params.sma_period);
+    }
+
+    // Mean of the last sma_period closes (newest first, as in calculate_predictions)
+    double sma() const {
+        if (!has_sma()) return 0;
+        double sum = 0;
+        int period = params.sma_period;
+        for (int i = 1; i <= period; i++) {
+            sum += ring[(ring_pos - i + period) % period];
+        }
+        return sum / period;
+    }
+
+    double ema() const {
+        return ema_value;
+    }
+
+    // The autoregressive coefficients; `exact` solves the equations as they
+    // stand, otherwise a fit up to AR_REFIT_DIVISOR-th of the rows old is
+    // reused (a walk-forward asks every bar, and a solve costs O(order^3)).
+    const ArFit& autoregressive_fit(bool exact) const {
+        double rows = ar_equations.rows;
+        if (ar_fit_rows != rows && (exact || rows - ar_fit_rows >= std::max(1.0, rows / AR_REFIT_DIVISOR))) {
+            ar_fit = solve_autoregressive(ar_equations);
+            ar_fit_rows = rows;
+        }
+        return ar_fit;
+    }
+
+    double autoregressive_next() const {
+        const ArFit& fit = autoregressive_fit(false);
+        double d = fit.intercept;
+        for (int k = 0; k < fit.order; k++) d += fit.phi[k] * ar_lags[k];
+        return last_close + d;
+    }
+
+    // Whether `model` has seen enough bars to predict
+    bool ready(PredictionModel model) const {
+        switch (model) {
+            case MOVING_AVERAGE: return has_sma();
+            case AUTOREGRESSIVE: return autoregressive_fit(false).ok;
+            case HOLT_WINTERS: return holt.errors > 0;
+            default: return true;
+        }
+    }
+
+    double next_prediction(PredictionModel model) const {
+        switch (model) {
+            case LINEAR_REGRESSION: return slope() * static_cast<double>(count) + intercept();
+            case MOVING_AVERAGE: return sma();
+            case EXPONENTIAL_SMOOTHING: return ema();
+            case AUTOREGRESSIVE: return autoregressive_next();
+            case HOLT_WINTERS: return holt.next();
+        }
+        return 0;
+    }
+
+    // Stats as calculate_predictions would report them for `model`.
+    PredictionStats stats(PredictionModel model, const double *confidence = DEFAULT_CONFIDENCE) const {
+        PredictionStats s;
+        if (count < 2) return s;
+        switch (model) {
+            case LINEAR_REGRESSION:
+                s.slope = slope();
+                s.intercept = intercept();
+                s.r_squared = r_squared();
+                s.next_prediction = next_prediction(model);
+                s.confidence = confidence[LINEAR_REGRESSION];
+                break;
+            case MOVING_AVERAGE:
+                if (has_sma()) {
+                    s.next_prediction = sma();
+                    s.confidence = confidence[MOVING_AVERAGE];
+                }
+                break;
+            case EXPONENTIAL_SMOOTHING:
+                s.next_prediction = ema();
+                s.confidence = confidence[EXPONENTIAL_SMOOTHING];
+                break;
+            case AUTOREGRESSIVE: {
+                const ArFit& fit = autoregressive_fit(true);
+                s.r_squared = fit.r_squared;
+                apply_forecast(s, autoregressive_forecast(fit, ar_lags, last_close), last_close);
+                break;
+            }
+            case HOLT_WINTERS:
+                apply_forecast(s, holt.forecast(), last_close);
+                break;
+        }
+        return s;
+    }
+
+private:
+    // Adds a close to the lookback window, dropping the oldest one when full.
+    // Removing the oldest bar moves every remaining bar one step left in
+    // window-local x, which takes sum(y) off the x*y sum.
+    void slide_window(double y) {
+        if (count == 0) shift = y;
+        double value = y - shift;
+        unsigned int lookback = params.regression_lookback;
+        if (count >= lookback) {
+            double oldest = window[window_pos];
+            win_y.add(-oldest);
+            win_yy.add(-oldest * oldest);
+            win_xy.add(-win_y.value());
+        }
+        unsigned long long m = count >= lookback ? lookback : count + 1;
+        win_xy.add(static_cast<double>(m - 1) * value);
+        win_y.add(value);
+        win_yy.add(value * value);
+        window[window_pos] = value;
+        window_pos = window_pos + 1 == lookback ? 0 : window_pos + 1;
+    }
+};
+
+// Feeds an already loaded series through the incremental state.
+inline void prime_incremental(IncrementalPredictor& live, const PriceSeries& series) {
+    live.reset();
+    for (unsigned int i = 0; i < series.size; i++) {
+        live.on_close(series.close[i]);
+    }
+}
+
+// Puts a followed bar (StockData or LiveBar) on the end of the series. A bar
+// with the newest bar's timestamp revises it in place - the later row wins,
+// as when a load sorts the file - and false is returned; older bars never
+// get here (tail_follower drops them). True when the bar was added.
+template <typename Bar>
+inline bool add_followed_bar(PriceSeries& series, const Bar& bar) {
+    if (series.size == 0 || bar.time != series.time[series.size - 1]) {
+        series.add(bar.time, bar.open, bar.high, bar.low, bar.close, bar.volume);
+        return true;
+    }
+    unsigned int last = series.size - 1;
+    series.open[last] = bar.open;
+    series.high[last] = bar.high;
+    series.low[last] = bar.low;
+    series.close[last] = bar.close;
+    series.volume[last] = bar.volume;
+    return false;
+}
+
+// Appends a bar to the loaded history and advances the models in O(1).
+// `live` must have been built with predictor.params. The row is also kept
+// in predictor.data while that still mirrors the series; after a cache load
+// (or once a follower dropped the rows) only the series grows. A bar that
+// revises the newest one (see add_followed_bar) cannot be undone in the
+// running sums, so the models are primed again over the series - O(n), paid
+// only by feeds that update their current bar.
+inline void append_bar(StockPredictor& predictor, IncrementalPredictor& live, const StockData& bar) {
+    bool keep_rows = predictor.data.size == predictor.series.size;
+    if (add_followed_bar(predictor.series, bar)) {
+        live.on_bar(bar);
+        if (keep_rows) predictor.data.add(bar);
+    } else {
+        prime_incremental(live, predictor.series);
+        if (keep_rows) predictor.data[predictor.data.size - 1] = bar;
+    }
+
+    if (keep_rows) {
+        StockData& stored = predictor.data[predictor.data.size - 1];
+        stored.sma5 = live.sma();
+        stored.prediction = live.next_prediction(predictor.model);
+    }
+    predictor.stats = live.stats(predictor.model, predictor.confidence);
+}
+
+#endif
@@ -0,0 +1,485 @@
+// indicators.hpp - Technical indicators computed together in one streaming pass over the columns
+#ifndef INDICATORS_HPP
+#define INDICATORS_HPP
+
+#include "price_series.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Bars processed per block. Every indicator consumes a block while its
+// slice of the input columns (6 x 8 KB) is still in L1/L2, so the inputs
+// are streamed from memory once however many indicators are requested.
+const unsigned int INDICATOR_BLOCK = 1024;
+
+// Sliding sums pick up rounding error as bars enter and leave the window;
+// they are recomputed exactly from the window every this many bars.
+const unsigned int INDICATOR_RESYNC_BARS = 65536;
+
+enum IndicatorKind {
+    INDICATOR_SMA,          // mean close over `period` bars
+    INDICATOR_EMA,          // exponential average of closes, alpha 2 / (period + 1), seeded with the SMA
+    INDICATOR_STDDEV,       // population standard deviation of closes over `period` bars
+    INDICATOR_BOLLINGER,    // SMA and SMA +/- multiplier standard deviations
+    INDICATOR_RSI,          // Wilder's relative strength index, 0-100
+    INDICATOR_MACD,         // EMA(period) - EMA(slow_period), its EMA(signal_period), and the difference
+    INDICATOR_ATR,          // Wilder's average true range
+    INDICATOR_VWAP,         // volume-weighted typical price over `period` bars; period 0 resets each day
+    INDICATOR_ROLLING_MIN,  // lowest low over `period` bars
+    INDICATOR_ROLLING_MAX   // highest high over `period` bars
+};
+
+struct IndicatorSpec {
+    IndicatorKind kind;
+    unsigned int period;
+    unsigned int slow_period;       // MACD only
+    unsigned int signal_period;     // MACD only
+    double multiplier;              // BOLLINGER only
+
+    IndicatorSpec(IndicatorKind indicator_kind, unsigned int bars, double width = 2.0, unsigned int slow = 26,
+                  unsigned int signal = 9)
+        : kind(indicator_kind), period(bars), slow_period(slow), signal_period(signal), multiplier(width) {}
+
+    // Columns the indicator writes (BOLLINGER: middle, upper, lower; MACD:
+    // line, signal, histogram).
+    int outputs() const {
+        return kind == INDICATOR_BOLLINGER || kind == INDICATOR_MACD ? 3 : 1;
+    }
+
+    std::string name(int output = 0) const {
+        std::string n = std::to_string(period);
+        switch (kind) {
+            case INDICATOR_SMA: return "SMA " + n;
+            case INDICATOR_EMA: return "EMA " + n;
+            case INDICATOR_STDDEV: return "StdDev " + n;
+            case INDICATOR_BOLLINGER: return output == 0 ? "BB " + n : (output == 1 ? "BB upper" : "BB lower");
+            case INDICATOR_RSI: return "RSI " + n;
+            case INDICATOR_MACD: {
+                const char *parts[3] = { "MACD ", "Signal ", "Histogram " };
+                return parts[output] + n + "/" + std::to_string(slow_period) + "/" + std::to_string(signal_period);
+            }
+            case INDICATOR_ATR: return "ATR " + n;
+            case INDICATOR_VWAP: return period > 0 ? "VWAP " + n : "VWAP session";
+            case INDICATOR_ROLLING_MIN: return "Low " + n;
+            case INDICATOR_ROLLING_MAX: return "High " + n;
+        }
+        return "";
+    }
+};
+
+// A set of indicators and their output columns, row-aligned with the series
+// they were computed from. Rows before an indicator has a full window hold
+// NaN. update() continues from the last computed row, so bars appended to
+// the series (follow mode) cost O(new bars) per indicator.
+struct IndicatorSet {
+    IndicatorSet() : rows(0), capacity(0) {}
+
+    ~IndicatorSet() {
+        for (size_t c = 0; c < columns.size(); c++) aligned_free(columns[c]);
+    }
+
+    // Adds an indicator and returns the index of its first column. Clears
+    // any computed rows; the next update() recomputes every column.
+    size_t add(const IndicatorSpec& spec) {
+        IndicatorSpec checked = spec;
+        if (checked.period < 1 && checked.kind != INDICATOR_VWAP) checked.period = 1;
+        if (checked.slow_period < 1) checked.slow_period = 1;
+        if (checked.signal_period < 1) checked.signal_period = 1;
+        size_t first = columns.size();
+        specs.push_back(checked);
+        first_column.push_back(first);
+        for (int o = 0; o < checked.outputs(); o++) {
+            columns.push_back(nullptr);
+            names.push_back(checked.name(o));
+        }
+        for (size_t c = 0; c < columns.size(); c++) {
+            aligned_free(columns[c]);
+            columns[c] = nullptr;
+        }
+        capacity = 0;
+        reset();
+        return first;
+    }
+
+    // Forgets the computed rows (the indicators stay).
+    void reset() {
+        rows = 0;
+        states.assign(specs.size(), IndicatorState());
+    }
+
+    // Computes rows [size(), series.size) of every indicator in one pass.
+    // Call reset() first if earlier rows of the series changed.
+    bool update(const PriceSeries& series) {
+        if (series.size < rows) reset();
+        if (series.size > capacity && !reserve_rows(series.size)) return false;
+        unsigned int end;
+        for (unsigned int begin = rows; begin < series.size; begin = end) {
+            // Blocks also break at resync rows, so the sums are rebuilt at the
+            // same rows however the bars were batched
+            unsigned int to_resync = INDICATOR_RESYNC_BARS - begin % INDICATOR_RESYNC_BARS;
+            end = begin + std::min(std::min(INDICATOR_BLOCK, to_resync), series.size - begin);
+            for (size_t s = 0; s < specs.size(); s++) {
+                run_block(series, specs[s], states[s], &columns[first_column[s]], begin, end);
+            }
+        }
+        rows = series.size;
+        return true;
+    }
+
+    unsigned int size() const {
+        return rows;
+    }
+
+    size_t column_count() const {
+        return columns.size();
+    }
+
+    const double *column(size_t c) const {
+        return columns[c];
+    }
+
+    const std::string& column_name(size_t c) const {
+        return names[c];
+    }
+
+    // Value of column c at a row, NaN while the indicator is warming up
+    double value(size_t c, unsigned int row) const {
+        return row < rows ? columns[c][row] : std::numeric_limits<double>::quiet_NaN();
+    }
+
+private:
+    // Running state of one indicator between blocks. Each kind uses the
+    // fields its update reads.
+    struct IndicatorState {
+        double sum, sum_volume;     // SMA, VWAP window sums; EMA/ATR/RSI warm-up sums
+        double mean, m2;            // Welford mean and squared deviations (STDDEV, BOLLINGER)
+        double fast, slow, signal;  // EMA and the MACD averages
+        double gain, loss;          // RSI averages
+        double signal_sum;          // MACD signal warm-up sum
+        int32_t session;            // VWAP day
+        std::vector<double> tail;   // ROLLING_MIN/MAX: suffix extremes of the previous chunk
+        double head;                // ROLLING_MIN/MAX: extreme of the current chunk so far
+        unsigned int chunk_offset;  // ROLLING_MIN/MAX: row position within its chunk
+
+        IndicatorState()
+            : sum(0), sum_volume(0), mean(0), m2(0), fast(0), slow(0), signal(0), gain(0), loss(0), signal_sum(0),
+              session(0), head(0), chunk_offset(0) {}
+    };
+
+    std::vector<IndicatorSpec> specs;
+    std::vector<IndicatorState> states;
+    std::vector<size_t> first_column;
+    std::vector<double *> columns;
+    std::vector<std::string> names;
+    unsigned int rows;
+    unsigned int capacity;
+
+    bool reserve_rows(unsigned int needed) {
+        unsigned int new_capacity = capacity > 0 ? capacity : 64;
+        while (new_capacity < needed) new_capacity = new_capacity * 2 > new_capacity ? new_capacity * 2 : needed;
+        for (size_t c = 0; c < columns.size(); c++) {
+            double *grown = static_cast<double *>(aligned_malloc(new_capacity * sizeof(double)));
+            if (!grown) return false;
+            if (columns[c] && rows > 0) memcpy(grown, columns[c], rows * sizeof(double));
+            aligned_free(columns[c]);
+            columns[c] = grown;
+        }
+        capacity = new_capacity;
+        return true;
+    }
+
+    // True range of row i > 0.
+    static double true_range(const PriceSeries& s, unsigned int i) {
+        double prev = s.close[i - 1];
+        return std::max(s.high[i] - s.low[i], std::max(std::fabs(s.high[i] - prev), std::fabs(s.low[i] - prev)));
+    }
+
+    static double relative_strength(double gain, double loss) {
+        return gain + loss > 0 ? 100 * gain / (gain + loss) : 50;
+    }
+
+    // Exact Welford mean and m2 of closes [end - n, end).
+    static void window_moments(const double *close, unsigned int end, unsigned int n, double& mean, double& m2) {
+        mean = 0;
+        m2 = 0;
+        for (unsigned int k = 0; k < n; k++) {
+            double x = close[end - n + k];
+            double d = x - mean;
+            mean += d / (k + 1);
+            m2 += d * (x - mean);
+        }
+    }
+
+    // Rolling maximum (or minimum) of v over n rows by van Herk/Gil-Werman:
+    // rows are split into n-row chunks, and a window ending in chunk c is the
+    // tail of chunk c - 1 (whose suffix extremes are computed backwards once,
+    // when c starts) plus the head of chunk c (a running extreme). That is
+    // three comparisons per row and no data-dependent branch; a monotonic
+    // deque does fewer comparisons but mispredicts about once per bar on
+    // noisy prices.
+    template <bool Max>
+    static void rolling_extreme(const double *v, double *out, unsigned int n, IndicatorState& st, unsigned int begin,
+                                unsigned int end) {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        if (st.tail.size() != n) st.tail.assign(n, 0);
+        double *tail = st.tail.data();
+        double head = st.head;
+        unsigned int offset = st.chunk_offset;
+        for (unsigned int i = begin; i < end; i++) {
+            if (offset == 0) {
+                if (i >= n) {
+                    const double *chunk = v + i - n;
+                    double e = chunk[n - 1];
+                    tail[n - 1] = e;
+                    for (unsigned int k = n - 1; k-- > 0;) {
+                        e = Max ? (chunk[k] > e ? chunk[k] : e) : (chunk[k] < e ? chunk[k] : e);
+                        tail[k] = e;
+                    }
+                }
+                head = v[i];
+            } else {
+                head = Max ? (v[i] > head ? v[i] : head) : (v[i] < head ? v[i] : head);
+            }
+            // The window (i - n, i] starts at offset + 1 in the previous chunk
+            double x = head;
+            if (offset + 1 < n) x = Max ? (tail[offset + 1] > x ? tail[offset + 1] : x) : (tail[offset + 1] < x ? tail[offset + 1] : x);
+            out[i] = i + 1 >= n ? x : nan;
+            offset = offset + 1 == n ? 0 : offset + 1;
+        }
+        st.head = head;
+        st.chunk_offset = offset;
+    }
+
+    // Rows [begin, end) of one indicator. Each kind copies its state into
+    // locals (the output stores could otherwise alias it), runs the rows
+    // still warming up, then a branch-free loop for the rest. A block that
+    // starts on a multiple of INDICATOR_RESYNC_BARS first recomputes its
+    // window sums exactly.
+    static void run_block(const PriceSeries& s, const IndicatorSpec& spec, IndicatorState& st, double **out,
+                          unsigned int begin, unsigned int end) {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        const double *close = s.close;
+        const unsigned int n = spec.period;
+        const double inv_n = n > 0 ? 1.0 / n : 0;
+        const bool resync = begin > 0 && begin % INDICATOR_RESYNC_BARS == 0 && begin >= n;
+        unsigned int i = begin;
+
+        switch (spec.kind) {
+            case INDICATOR_SMA: {
+                double *sma = out[0];
+                double sum = st.sum;
+                if (resync) {
+                    sum = 0;
+                    for (unsigned int k = begin - n; k < begin; k++) sum += close[k];
+                }
+                for (; i < end && i + 1 < n; i++) {
+                    sum += close[i];
+                    sma[i] = nan;
+                }
+                if (i < end && i < n) {
+                    sum += close[i];
+                    sma[i] = sum * inv_n;
+                    i++;
+                }
+                for (; i < end; i++) {
+                    sum += close[i] - close[i - n];
+                    sma[i] = sum * inv_n;
+                }
+                st.sum = sum;
+                break;
+            }
+            case INDICATOR_EMA: {
+                double *ema = out[0];
+                double alpha = 2.0 / (n + 1), decay = 1 - alpha;
+                double sum = st.sum, average = st.fast;
+                for (; i < end && i + 1 < n; i++) {
+                    sum += close[i];
+                    ema[i] = nan;
+                }
+                if (i < end && i + 1 == n) {
+                    average = (sum + close[i]) * inv_n;
+                    ema[i] = average;
+                    i++;
+                }
+                for (; i < end; i++) {
+                    average = decay * average + alpha * close[i];   // one multiply-add on the dependency chain
+                    ema[i] = average;
+                }
+                st.sum = sum;
+                st.fast = average;
+                break;
+            }
+            case INDICATOR_STDDEV:
+            case INDICATOR_BOLLINGER: {
+                bool bands = spec.kind == INDICATOR_BOLLINGER;
+                double mean = st.mean, m2 = st.m2;
+                if (resync) window_moments(close, begin, n, mean, m2);
+                for (; i < end; i++) {
+                    double x = close[i];
+                    if (i < n) {
+                        double d = x - mean;
+                        mean += d / (i + 1);
+                        m2 += d * (x - mean);
+                    } else {
+                        double y = close[i - n];
+                        double old_mean = mean;
+                        mean += (x - y) * inv_n;
+                        m2 += (x - y) * (x - mean + y - old_mean);
+                    }
+                    double sd = i + 1 < n ? nan : std::sqrt(m2 > 0 ? m2 * inv_n : 0);
+                    if (bands) {
+                        out[0][i] = i + 1 < n ? nan : mean;
+                        out[1][i] = mean + spec.multiplier * sd;
+                        out[2][i] = mean - spec.multiplier * sd;
+                    } else {
+                        out[0][i] = sd;
+                    }
+                }
+                st.mean = mean;
+                st.m2 = m2;
+                break;
+            }
+            case INDICATOR_RSI: {
+                // The first averages are simple means of n changes, then Wilder smoothing
+                double *rsi = out[0];
+                double gain = st.gain, loss = st.loss, decay = 1 - inv_n;
+                if (i == 0 && i < end) rsi[i++] = nan;
+                for (; i < end && i <= n; i++) {
+                    double change = close[i] - close[i - 1];
+                    double up = 0.5 * (change + std::fabs(change));    // branch-free max(change, 0)
+                    gain += up * inv_n;
+                    loss += (up - change) * inv_n;
+                    rsi[i] = i < n ? nan : relative_strength(gain, loss);
+                }
+                for (; i < end; i++) {
+                    double change = close[i] - close[i - 1];
+                    double up = 0.5 * (change + std::fabs(change));
+                    gain = decay * gain + up * inv_n;
+                    loss = decay * loss + (up - change) * inv_n;
+                    rsi[i] = relative_strength(gain, loss);
+                }
+                st.gain = gain;
+                st.loss = loss;
+                break;
+            }
+            case INDICATOR_MACD: {
+                unsigned int slow_n = spec.slow_period, signal_n = spec.signal_period;
+                double fast_alpha = 2.0 / (n + 1), slow_alpha = 2.0 / (slow_n + 1), signal_alpha = 2.0 / (signal_n + 1);
+                double fast_decay = 1 - fast_alpha, slow_decay = 1 - slow_alpha, signal_decay = 1 - signal_alpha;
+                unsigned int macd_start = std::max(n, slow_n) - 1;     // first row with both averages
+                unsigned int steady = macd_start + signal_n;           // first row past every warm-up
+                // st.sum and st.sum_volume hold the two EMAs' warm-up sums
+                double fast = st.fast, slow = st.slow, signal = st.signal;
+                for (; i < end && i < steady; i++) {
+                    double x = close[i];
+                    if (i + 1 < n) st.sum += x;
+                    else if (i + 1 == n) fast = (st.sum + x) / n;
+                    else fast = fast_decay * fast + fast_alpha * x;
+                    if (i + 1 < slow_n) st.sum_volume += x;
+                    else if (i + 1 == slow_n) slow = (st.sum_volume + x) / slow_n;
+                    else slow = slow_decay * slow + slow_alpha * x;
+
+                    double macd = fast - slow;
+                    out[0][i] = i < macd_start ? nan : macd;
+                    out[1][i] = out[2][i] = nan;
+                    if (i < macd_start) continue;
+                    if (i + 1 < steady) {
+                        st.signal_sum += macd;
+                    } else {
+                        signal = (st.signal_sum + macd) / signal_n;
+                        out[1][i] = signal;
+                        out[2][i] = macd - signal;
+                    }
+                }
+                for (; i < end; i++) {
+                    double x = close[i];
+                    fast = fast_decay * fast + fast_alpha * x;
+                    slow = slow_decay * slow + slow_alpha * x;
+                    double macd = fast - slow;
+                    signal = signal_decay * signal + signal_alpha * macd;
+                    out[0][i] = macd;
+                    out[1][i] = signal;
+                    out[2][i] = macd - signal;
+                }
+                st.fast = fast;
+                st.slow = slow;
+                st.signal = signal;
+                break;
+            }
+            case INDICATOR_ATR: {
+                // Seeded with the mean true range of the first n bars, then Wilder smoothing
+                double *atr = out[0];
+                double sum = st.sum, average = st.fast, decay = 1 - inv_n;
+                for (; i < end && i < n; i++) {
+                    sum += i > 0 ? true_range(s, i) : s.high[0] - s.low[0];
+                    atr[i] = nan;
+                    if (i + 1 == n) atr[i] = average = sum * inv_n;
+                }
+                for (; i < end; i++) {
+                    average = decay * average + true_range(s, i) * inv_n;
+                    atr[i] = average;
+                }
+                st.sum = sum;
+                st.fast = average;
+                break;
+            }
+            case INDICATOR_VWAP: {
+                double *vwap = out[0];
+                const double *high = s.high, *low = s.low, *volume = s.volume;
+                double price_volume = st.sum, total_volume = st.sum_volume;
+                if (n == 0) {
+                    int32_t session = st.session;
+                    for (; i < end; i++) {
+                        int32_t day = epoch_day(s.time[i]);
+                        if (i == 0 || day != session) {
+                            session = day;
+                            price_volume = total_volume = 0;
+                        }
+                        double typical = (high[i] + low[i] + close[i]) * (1.0 / 3);
+                        price_volume += typical * volume[i];
+                        total_volume += volume[i];
+                        vwap[i] = total_volume > 0 ? price_volume / total_volume : typical;
+                    }
+                    st.session = session;
+                } else {
+                    if (resync) {
+                        price_volume = total_volume = 0;
+                        for (unsigned int k = begin - n; k < begin; k++) {
+                            price_volume += (high[k] + low[k] + close[k]) * (1.0 / 3) * volume[k];
+                            total_volume += volume[k];
+                        }
+                    }
+                    for (; i < end && i < n; i++) {
+                        price_volume += (high[i] + low[i] + close[i]) * (1.0 / 3) * volume[i];
+                        total_volume += volume[i];
+                        vwap[i] = nan;
+                    }
+                    if (begin < n && i == n) vwap[n - 1] = total_volume > 0 ? price_volume / total_volume : close[n - 1];
+                    for (; i < end; i++) {
+                        unsigned int old = i - n;
+                        double typical = (high[i] + low[i] + close[i]) * (1.0 / 3);
+                        price_volume += typical * volume[i] - (high[old] + low[old] + close[old]) * (1.0 / 3) * volume[old];
+                        total_volume += volume[i] - volume[old];
+                        vwap[i] = total_volume > 0 ? price_volume / total_volume : typical;
+                    }
+                }
+                st.sum = price_volume;
+                st.sum_volume = total_volume;
+                break;
+            }
+            case INDICATOR_ROLLING_MIN:
+                rolling_extreme<false>(s.low, out[0], n, st, begin, end);
+                break;
+            case INDICATOR_ROLLING_MAX:
+                rolling_extreme<true>(s.high, out[0], n, st, begin, end);
+                break;
+        }
+    }
+
+    IndicatorSet(const IndicatorSet&);
+    IndicatorSet& operator=(const IndicatorSet&);
+};
+
+#endif
@@ -0,0 +1,472 @@
+// ingest_pipeline.hpp - Parser, model and render stages joined by lock-free queues
+#ifndef INGEST_PIPELINE_HPP
+#define INGEST_PIPELINE_HPP
+
+#include "incremental_model.hpp"
+#include "spsc_ring.hpp"
+#include "tail_follower.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+inline long long pipeline_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Latency distribution in power-of-two buckets: bucket b counts samples in
+// [2^b, 2^(b+1)) ns. One thread records, any thread may read.
+struct LatencyHistogram {
+    static const int BUCKETS = 40;      // up to ~18 minutes
+
+    LatencyHistogram() {
+        reset();
+    }
+
+    void reset() {
+        for (int b = 0; b < BUCKETS; b++) counts[b].store(0, std::memory_order_relaxed);
+        samples.store(0, std::memory_order_relaxed);
+        largest.store(0, std::memory_order_relaxed);
+    }
+
+    void record(long long ns) {
+        if (ns < 1) ns = 1;
+        int b = 0;
+        while (b < BUCKETS - 1 && (ns >> (b + 1)) != 0) b++;
+        counts[b].fetch_add(1, std::memory_order_relaxed);
+        samples.fetch_add(1, std::memory_order_relaxed);
+        if (ns > largest.load(std::memory_order_relaxed)) largest.store(ns, std::memory_order_relaxed);
+    }
+
+    unsigned long long count() const {
+        return samples.load(std::memory_order_relaxed);
+    }
+
+    // Upper edge of the bucket holding the p quantile (0 < p <= 1), in
+    // microseconds; within a factor of two of the true value.
+    double percentile_us(double p) const {
+        unsigned long long total = count();
+        if (total == 0) return 0;
+        unsigned long long rank = static_cast<unsigned long long>(p * total);
+        if (rank < 1) rank = 1;
+        unsigned long long seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += counts[b].load(std::memory_order_relaxed);
+            if (seen >= rank) return static_cast<double>(1ULL << (b + 1)) / 1e3;
+        }
+        return max_us();
+    }
+
+    double max_us() const {
+        return largest.load(std::memory_order_relaxed) / 1e3;
+    }
+
+private:
+    std::atomic<unsigned long long> counts[BUCKETS];
+    std::atomic<unsigned long long> samples;
+    std::atomic<long long> largest;
+};
+
+// Latest-value handoff from one writer to one reader with three slots: the
+// writer fills its back slot and swaps it into the middle; the reader swaps
+// the middle into its front slot when a newer one is there. Neither side
+// ever waits and the reader never sees a half-written snapshot.
+template <typename T>
+struct snapshot_buffer {
+    snapshot_buffer() : back(0), middle(1), front(2) {}
+
+    // Writer: fill this, then publish().
+    T& write_slot() {
+        return slots[back];
+    }
+
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader: copies the newest snapshot into `out` if one was published
+    // since the last successful read.
+    bool read(T& out) {
+        if (!(middle.load(std::memory_order_acquire) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        out = slots[front];
+        return true;
+    }
+
+private:
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4;
+    T slots[3];
+    unsigned int back;                  // writer only
+    std::atomic<unsigned int> middle;   // slot index | FRESH
+    unsigned int front;                 // reader only
+};
+
+// Sleep/wake for a consumer polling a lock-free queue. The producer only
+// takes the mutex when the consumer is actually asleep, so the hot path
+// stays lock-free; timeouts bound any missed wakeup.
+struct wake_signal {
+    wake_signal() : sleeping(false) {}
+
+    template <typename Ready>
+    void wait(Ready ready, int timeout_ms) {
+        sleeping.store(true, std::memory_order_seq_cst);
+        if (!ready()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready);
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            cv.notify_one();
+        }
+    }
+
+private:
+    std::atomic<bool> sleeping;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+// A bar in flight, with the time it passed each stage.
+struct LiveBar {
+    int64_t time;
+    double open, high, low, close, volume;
+    long long read_ns;      // parser got the bytes
+    long long queued_ns;    // parser offered it to the model queue
+    long long modeled_ns;   // model thread published its predictions
+};
+
+// What the model thread publishes after every bar.
+struct ModelSnapshot {
+    PredictionStats stats[MODEL_COUNT];     // indexed by PredictionModel
+    ModelParams params;
+    unsigned long long bars;                // history plus live bars included
+    long long published_ns;
+
+    ModelSnapshot() : bars(0), published_ns(0) {}
+};
+
+struct IngestOptions {
+    size_t queue_capacity;      // parsed bars waiting for the model thread
+    size_t render_capacity;     // modelled bars waiting for the render loop
+    bool drop_when_full;        // drop bars on a full model queue instead of waiting
+
+    IngestOptions() : queue_capacity(1 << 16), render_capacity(1 << 16), drop_when_full(false) {}
+};
+
+// Follow-mode ingest on two threads of its own:
+//
+//   parser thread  --spsc_ring<LiveBar>-->  model thread  --spsc_ring<LiveBar>-->  render loop
+//                                                 \--snapshot_buffer<ModelSnapshot>--/
+//
+// The parser reads and parses new lines (tail_follower) and pushes bars; on
+// a full queue it waits (counted as a stall) or, with drop_when_full, drops
+// the bar. The model thread runs the incremental models and publishes stats
+// for every model after each bar, then forwards the bar for drawing. If the
+// render loop falls behind, forwarded bars pile up in an unbounded backlog
+// on the model side rather than stalling predictions, so a slow frame never
+// delays ingest or modelling and a burst of bars never delays a frame.
+// Bars older than the newest are dropped by the parser; a bar repeating the
+// newest timestamp makes the model thread refit its closes and is drawn
+// with add_followed_bar, which replaces the newest bar.
+//
+// Depths, drops and a latency histogram per stage (parse, queue wait,
+// model, handoff to the renderer, end to end) are readable at any time.
+struct IngestPipeline {
+    LatencyHistogram parse_latency;     // bytes read -> bar queued (includes the rest of its batch)
+    LatencyHistogram queue_latency;     // queued -> popped by the model thread
+    LatencyHistogram model_latency;     // popped -> predictions published
+    LatencyHistogram handoff_latency;   // published -> drained by the render loop
+    LatencyHistogram total_latency;     // bytes read -> drained by the render loop
+    std::atomic<unsigned long long> bars_parsed;
+    std::atomic<unsigned long long> bars_dropped;
+    std::atomic<unsigned long long> full_stalls;
+    std::atomic<unsigned long long> rows_rejected;
+    std::atomic<unsigned long long> bars_modeled;
+    std::atomic<unsigned long long> bars_delivered;
+
+    explicit IngestPipeline(const IngestOptions& pipeline_options = IngestOptions())
+        : bars_parsed(0), bars_dropped(0), full_stalls(0), rows_rejected(0), bars_modeled(0), bars_delivered(0),
+          options(pipeline_options), input(pipeline_options.queue_capacity), output(pipeline_options.render_capacity),
+          stopping(false), parser_done(false), newest_time(INVALID_TIMESTAMP), backlog(0), max_backlog(0), reconfigure_pending(false) {}
+
+    ~IngestPipeline() {
+        stop();
+    }
+
+    // Follows `source` ("-" = stdin) from byte `offset`, with the models
+    // primed on `history`. The history is copied; the caller keeps its series.
+    bool start(const std::string& source, size_t offset, const PriceSeries& history, const ModelParams& params,
+               const double *confidence) {
+        stop();
+        int64_t newest = history.size > 0 ? history.time[history.size - 1] : INVALID_TIMESTAMP;
+        bool watching = source == "-" ? follower.follow_stdin(newest) : follower.follow_file(source, offset, newest);
+        if (!watching) return false;
+
+        closes.assign(history.close, history.close + history.size);
+        newest_time = newest;
+        model_params = params;
+        for (int m = 0; m < MODEL_COUNT; m++) model_confidence[m] = confidence[m];
+        rebuild_models();
+
+        stopping.store(false);
+        parser_done.store(false);
+        parser = std::thread(&IngestPipeline::parser_loop, this);
+        modeler = std::thread(&IngestPipeline::model_loop, this);
+        return true;
+    }
+
+    void stop() {
+        if (!parser.joinable() && !modeler.joinable()) return;
+        stopping.store(true);
+        model_wake.notify();
+        if (parser.joinable()) parser.join();
+        if (modeler.joinable()) modeler.join();
+        follower.close();
+    }
+
+    // True once a stdin feed ended and every bar has been handed over.
+    bool finished() const {
+        return parser_done.load() && input.empty() && output.empty() && backlog.load() == 0;
+    }
+
+    // Render loop: moves up to `max_bars` modelled bars into `out`.
+    size_t drain(std::vector<LiveBar>& out, size_t max_bars = 1 << 20) {
+        size_t taken = 0;
+        LiveBar bar;
+        while (taken < max_bars && output.try_pop(bar)) {
+            long long now = pipeline_now_ns();
+            handoff_latency.record(now - bar.modeled_ns);
+            total_latency.record(now - bar.read_ns);
+            out.push_back(bar);
+            taken++;
+        }
+        if (taken > 0) {
+            bars_delivered.fetch_add(taken, std::memory_order_relaxed);
+            model_wake.notify();    // room for the backlog
+        }
+        return taken;
+    }
+
+    // Render loop: newest predictions, if any were published since the last call.
+    bool latest(ModelSnapshot& out) {
+        return snapshots.read(out);
+    }
+
+    // Render loop: sleeps until bars are ready to draw or timeout_ms passes.
+    void wait(int timeout_ms) {
+        render_wake.wait([this]() { return !output.empty() || stopping.load(); }, timeout_ms);
+    }
+
+    // New model parameters (after an optimization); the model thread refits
+    // its whole close history and publishes a fresh snapshot.
+    void reconfigure(const ModelParams& params, const double *confidence) {
+        {
+            std::lock_guard<std::mutex> lock(control);
+            pending_params = params;
+            for (int m = 0; m < MODEL_COUNT; m++) pending_confidence[m] = confidence[m];
+        }
+        reconfigure_pending.store(true);
+        model_wake.notify();
+    }
+
+    size_t queue_depth() const {
+        return input.size();
+    }
+
+    size_t render_backlog() const {
+        return output.size() + backlog.load(std::memory_order_relaxed);
+    }
+
+    // One line for the console or the screen.
+    std::string summary() const {
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                 "ingest: %llu parsed, %llu dropped, %llu stalls, %llu rejected | queue %zu (max %zu of %zu), "
+                 "render backlog %zu (max %zu) | p50/p99 us: parse %.0f/%.0f, queue %.0f/%.0f, model %.0f/%.0f, "
+                 "handoff %.0f/%.0f, total %.0f/%.0f",
+                 bars_parsed.load(), bars_dropped.load(), full_stalls.load(), rows_rejected.load(), queue_depth(),
+                 input.max_depth(), input.capacity(), render_backlog(), max_backlog.load() + output.max_depth(),
+                 parse_latency.percentile_us(0.5), parse_latency.percentile_us(0.99),
+                 queue_latency.percentile_us(0.5), queue_latency.percentile_us(0.99),
+                 model_latency.percentile_us(0.5), model_latency.percentile_us(0.99),
+                 handoff_latency.percentile_us(0.5), handoff_latency.percentile_us(0.99),
+                 total_latency.percentile_us(0.5), total_latency.percentile_us(0.99));
+        return buf;
+    }
+
+private:
+    // Parser and model threads poll at least this often for stop requests.
+    static const int STAGE_POLL_MS = 10;
+
+    IngestOptions options;
+    tail_follower follower;
+    spsc_ring<LiveBar> input;
+    spsc_ring<LiveBar> output;
+    snapshot_buffer<ModelSnapshot> snapshots;
+    wake_signal model_wake;
+    wake_signal render_wake;
+    std::thread parser;
+    std::thread modeler;
+    std::atomic<bool> stopping;
+    std::atomic<bool> parser_done;
+
+    // Model thread state
+    std::vector<double> closes;
+    int64_t newest_time;
+    IncrementalPredictor live;
+    ModelParams model_params;
+    double model_confidence[MODEL_COUNT];
+    std::deque<LiveBar> overflow;
+    std::atomic<size_t> backlog;
+    std::atomic<size_t> max_backlog;
+
+    // Reconfiguration requests from the render loop
+    std::mutex control;
+    std::atomic<bool> reconfigure_pending;
+    ModelParams pending_params;
+    double pending_confidence[MODEL_COUNT];
+
+    void parser_loop() {
+        std::vector<StockData> rows;
+        CsvLoadResult result;
+        while (!stopping.load()) {
+            follower.wait(STAGE_POLL_MS);
+            TRACE_SCOPE("pipeline_parse");
+            long long read_ns = pipeline_now_ns();
+            rows.clear();
+            if (follower.read_bars(rows, result) == 0) {
+                if (follower.finished()) break;
+                continue;
+            }
+            TRACE_COUNTER("pipeline_bars_read", rows.size());
+            rows_rejected.store(result.skipped_rows, std::memory_order_relaxed);
+            for (size_t i = 0; i < rows.size() && !stopping.load(); i++) {
+                const StockData& row = rows[i];
+                LiveBar bar;
+                bar.time = row.time;
+                bar.open = row.open;
+                bar.high = row.high;
+                bar.low = row.low;
+                bar.close = row.close;
+                bar.volume = row.volume;
+                bar.read_ns = read_ns;
+                bar.queued_ns = pipeline_now_ns();
+                bar.modeled_ns = 0;
+                parse_latency.record(bar.queued_ns - read_ns);
+                if (!offer(bar)) continue;
+                bars_parsed.fetch_add(1, std::memory_order_relaxed);
+                model_wake.notify();
+            }
+        }
+        parser_done.store(true);
+        model_wake.notify();
+    }
+
+    // Queues a bar for the model thread, waiting while the queue is full
+    // unless bars may be dropped. False if the bar was not queued.
+    bool offer(const LiveBar& bar) {
+        if (input.try_push(bar)) return true;
+        if (options.drop_when_full) {
+            bars_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        full_stalls.fetch_add(1, std::memory_order_relaxed);
+        while (!input.try_push(bar)) {
+            if (stopping.load()) return false;
+            model_wake.notify();
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        return true;
+    }
+
+    void model_loop() {
+        LiveBar bar;
+        while (!stopping.load()) {
+            if (reconfigure_pending.exchange(false)) {
+                {
+                    std::lock_guard<std::mutex> lock(control);
+                    model_params = pending_params;
+                    for (int m = 0; m < MODEL_COUNT; m++) model_confidence[m] = pending_confidence[m];
+                }
+                rebuild_models();
+            }
+
+            bool forwarded = false;
+            {
+                TRACE_SCOPE("pipeline_model");
+                while (input.try_pop(bar)) {
+                    long long popped = pipeline_now_ns();
+                    queue_latency.record(popped - bar.queued_ns);
+                    if (!closes.empty() && bar.time == newest_time) {
+                        // A revision of the newest bar (add_followed_bar): refit
+                        closes.back() = bar.close;
+                        rebuild_models();
+                    } else {
+                        closes.push_back(bar.close);
+                        newest_time = bar.time;
+                        live.on_close(bar.close);
+                        publish();
+                    }
+                    bar.modeled_ns = pipeline_now_ns();
+                    model_latency.record(bar.modeled_ns - popped);
+                    bars_modeled.fetch_add(1, std::memory_order_relaxed);
+                    if (!overflow.empty() || !output.try_push(bar)) overflow.push_back(bar);
+                    forwarded = true;
+                    if (reconfigure_pending.load(std::memory_order_relaxed)) break;
+                }
+            }
+            forwarded |= flush_overflow();
+            if (forwarded) render_wake.notify();
+
+            int timeout = overflow.empty() ? STAGE_POLL_MS : 1;
+            model_wake.wait([this]() { return !input.empty() || stopping.load() || reconfigure_pending.load(); },
+                            timeout);
+        }
+    }
+
+    // Moves backlog into the render queue as space frees up.
+    bool flush_overflow() {
+        bool moved = false;
+        while (!overflow.empty() && output.try_push(overflow.front())) {
+            overflow.pop_front();
+            moved = true;
+        }
+        backlog.store(overflow.size(), std::memory_order_relaxed);
+        if (overflow.size() > max_backlog.load(std::memory_order_relaxed)) {
+            max_backlog.store(overflow.size(), std::memory_order_relaxed);
+        }
+        return moved;
+    }
+
+    void rebuild_models() {
+        live = IncrementalPredictor(model_params);
+        for (size_t i = 0; i < closes.size(); i++) live.on_close(closes[i]);
+        publish();
+    }
+
+    void publish() {
+        ModelSnapshot& snapshot = snapshots.write_slot();
+        for (int m = 0; m < MODEL_COUNT; m++) snapshot.stats[m] = live.stats(ALL_MODELS[m], model_confidence);
+        snapshot.params = model_params;
+        snapshot.bars = live.count;
+        snapshot.published_ns = pipeline_now_ns();
+        snapshots.publish();
+    }
+
+    IngestPipeline(const IngestPipeline&);
+    IngestPipeline& operator=(const IngestPipeline&);
+};
+
+#endif
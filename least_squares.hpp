@@ -0,0 +1,122 @@
+// least_squares.hpp - Small dense least squares: one-pass normal equations solved by Cholesky
+#ifndef LEAST_SQUARES_HPP
+#define LEAST_SQUARES_HPP
+
+#include <cmath>
+#include <cstring>
+
+// Most regressors a fit can have (an AR(16) and its intercept; see
+// forecast_models.hpp). X'X is kept as a packed lower triangle.
+const int LSQ_MAX_TERMS = 17;
+const int LSQ_MAX_PACKED = LSQ_MAX_TERMS * (LSQ_MAX_TERMS + 1) / 2;
+
+// Position of element (row, col), col <= row, in a packed lower triangle.
+inline int packed_index(int row, int col) {
+    return row * (row + 1) / 2 + col;
+}
+
+// In-place Cholesky factorisation A = L L' of a packed symmetric n x n
+// matrix. False when A is not (numerically) positive definite.
+inline bool cholesky_factor(double *a, int n) {
+    for (int j = 0; j < n; j++) {
+        double *row_j = a + packed_index(j, 0);
+        double d = row_j[j];
+        for (int k = 0; k < j; k++) d -= row_j[k] * row_j[k];
+        if (!(d > 0)) return false;
+        double l = std::sqrt(d);
+        row_j[j] = l;
+        for (int i = j + 1; i < n; i++) {
+            double *row_i = a + packed_index(i, 0);
+            double s = row_i[j];
+            for (int k = 0; k < j; k++) s -= row_i[k] * row_j[k];
+            row_i[j] = s / l;
+        }
+    }
+    return true;
+}
+
+// Solves L L' x = b in place, L from cholesky_factor.
+inline void cholesky_solve(const double *l, int n, double *b) {
+    for (int i = 0; i < n; i++) {
+        const double *row = l + packed_index(i, 0);
+        double s = b[i];
+        for (int k = 0; k < i; k++) s -= row[k] * b[k];
+        b[i] = s / row[i];
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        double s = b[i];
+        for (int k = i + 1; k < n; k++) s -= l[packed_index(k, i)] * b[k];
+        b[i] = s / l[packed_index(i, i)];
+    }
+}
+
+// X'X, X'y and y'y of a regression, accumulated one row at a time, so a fit
+// costs one pass over the data and O(terms^3) to solve however many rows it
+// has. Rows can keep arriving after a solve (the incremental models do).
+struct NormalEquations {
+    int terms;
+    double rows;
+    double xtx[LSQ_MAX_PACKED];
+    double xty[LSQ_MAX_TERMS];
+    double yty;
+
+    explicit NormalEquations(int regressors = 1) {
+        reset(regressors);
+    }
+
+    void reset(int regressors) {
+        terms = regressors < 1 ? 1 : (regressors > LSQ_MAX_TERMS ? LSQ_MAX_TERMS : regressors);
+        rows = 0;
+        yty = 0;
+        memset(xtx, 0, sizeof(xtx));
+        memset(xty, 0, sizeof(xty));
+    }
+
+    void add(const double *x, double y) {
+        for (int i = 0; i < terms; i++) {
+            double xi = x[i];
+            double *row = xtx + packed_index(i, 0);
+            for (int j = 0; j <= i; j++) row[j] += xi * x[j];
+            xty[i] += xi * y;
+        }
+        yty += y * y;
+        rows += 1;
+    }
+
+    // Least-squares coefficients. A singular system (a flat series, exactly
+    // collinear regressors) is retried once with a ridge of 1e-10 of the
+    // mean diagonal, which keeps the coefficients small instead of failing.
+    bool solve(double *beta) const {
+        double l[LSQ_MAX_PACKED];
+        double ridge = 0;
+        for (int attempt = 0; attempt < 2; attempt++) {
+            memcpy(l, xtx, packed_index(terms, 0) * sizeof(double));
+            for (int i = 0; i < terms; i++) l[packed_index(i, i)] += ridge;
+            if (cholesky_factor(l, terms)) {
+                memcpy(beta, xty, terms * sizeof(double));
+                cholesky_solve(l, terms, beta);
+                return true;
+            }
+            double trace = 0;
+            for (int i = 0; i < terms; i++) trace += xtx[packed_index(i, i)];
+            ridge = trace > 0 ? 1e-10 * trace / terms : 1e-12;
+        }
+        return false;
+    }
+
+    // Residual sum of squares of `beta`: y'y - 2 b'X'y + b'X'X b.
+    double residual_ss(const double *beta) const {
+        double fitted = 0;
+        for (int i = 0; i < terms; i++) {
+            double row_dot = 0;
+            for (int j = 0; j < terms; j++) {
+                row_dot += xtx[i >= j ? packed_index(i, j) : packed_index(j, i)] * beta[j];
+            }
+            fitted += beta[i] * (row_dot - 2 * xty[i]);
+        }
+        double rss = yty + fitted;
+        return rss > 0 ? rss : 0;
+    }
+};
+
+#endif
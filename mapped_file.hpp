@@ -0,0 +1,104 @@
+// mapped_file.hpp - Read-only memory-mapped view of a whole file, and directory creation
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file. Uses mmap where available and falls back
+// to reading the file into memory elsewhere.
+struct mapped_file {
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    std::string buffer;
+#else
+    void *mapping;
+#endif
+
+    mapped_file() : data(nullptr), size(0)
+#ifndef _WIN32
+        , mapping(nullptr)
+#endif
+    {}
+
+    ~mapped_file() {
+        close();
+    }
+
+    bool open(const std::string& filename) {
+        close();
+#ifdef _WIN32
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+        return true;
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+
+        size = static_cast<size_t>(st.st_size);
+        if (size > 0) {
+            mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                size = 0;
+                ::close(fd);
+                return false;
+            }
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const char *>(mapping);
+        }
+        ::close(fd);
+        return true;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        buffer.clear();
+#else
+        if (mapping) {
+            munmap(mapping, size);
+            mapping = nullptr;
+        }
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+private:
+    mapped_file(const mapped_file&);
+    mapped_file& operator=(const mapped_file&);
+};
+
+// Creates `dir` (one level); an existing directory is fine.
+inline bool make_directory(const std::string& dir) {
+#ifdef _WIN32
+    return _mkdir(dir.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+#endif
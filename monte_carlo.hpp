@@ -0,0 +1,425 @@
+// monte_carlo.hpp - Simulated price paths (GBM or bootstrapped returns) on a counter-based RNG
+#ifndef MONTE_CARLO_HPP
+#define MONTE_CARLO_HPP
+
+#include "simd_kernels.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+// 3"): 128 random bits per (counter, key), with no state between calls. A
+// path's numbers depend only on its index and the seed, so a simulation
+// gives the same paths on any number of threads and at any SIMD level.
+// ---------------------------------------------------------------------------
+
+const uint32_t PHILOX_M0 = 0xD2511F53;
+const uint32_t PHILOX_M1 = 0xCD9E8D57;
+const uint32_t PHILOX_W0 = 0x9E3779B9;
+const uint32_t PHILOX_W1 = 0xBB67AE85;
+const int PHILOX_ROUNDS = 10;
+
+inline void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t x0 = counter[0], x1 = counter[1], x2 = counter[2], x3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        uint64_t p0 = static_cast<uint64_t>(PHILOX_M0) * x0;
+        uint64_t p1 = static_cast<uint64_t>(PHILOX_M1) * x2;
+        uint32_t y0 = static_cast<uint32_t>(p1 >> 32) ^ x1 ^ k0;
+        uint32_t y2 = static_cast<uint32_t>(p0 >> 32) ^ x3 ^ k1;
+        x1 = static_cast<uint32_t>(p1);
+        x3 = static_cast<uint32_t>(p0);
+        x0 = y0;
+        x2 = y2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = x0;
+    out[1] = x1;
+    out[2] = x2;
+    out[3] = x3;
+}
+
+// Paths generated together; every SIMD level fills the same block layout.
+const unsigned int MC_LANES = 8;
+
+// Block `block` of paths first_path .. first_path + 7: out[word][lane] is
+// word `word` of philox4x32({block, path, path >> 32, stream}, key).
+inline void philox_lanes_scalar(uint32_t block, uint64_t first_path, uint32_t stream, const uint32_t key[2],
+                                uint32_t out[4][MC_LANES]) {
+    for (unsigned int lane = 0; lane < MC_LANES; lane++) {
+        uint64_t path = first_path + lane;
+        uint32_t counter[4] = { block, static_cast<uint32_t>(path), static_cast<uint32_t>(path >> 32), stream };
+        uint32_t words[4];
+        philox4x32(counter, key, words);
+        for (int w = 0; w < 4; w++) out[w][lane] = words[w];
+    }
+}
+
+#ifdef SIMD_KERNELS_X86
+// 32x32 -> 64 bit products of every 32-bit lane: _mm256_mul_epu32 covers
+// the even lanes, and again on the odd lanes shifted down.
+SIMD_TARGET_AVX2 inline void mulhilo_avx2(__m256i x, __m256i m, __m256i& hi, __m256i& lo) {
+    const __m256i low_half = _mm256_set1_epi64x(0xFFFFFFFFLL);
+    __m256i even = _mm256_mul_epu32(x, m);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), m);
+    lo = _mm256_or_si256(_mm256_and_si256(even, low_half), _mm256_slli_epi64(odd, 32));
+    hi = _mm256_or_si256(_mm256_srli_epi64(even, 32), _mm256_andnot_si256(low_half, odd));
+}
+
+SIMD_TARGET_AVX2 inline void philox_lanes_avx2(uint32_t block, uint64_t first_path, uint32_t stream,
+                                               const uint32_t key[2], uint32_t out[4][MC_LANES]) {
+    uint32_t low[MC_LANES], high[MC_LANES];
+    for (unsigned int lane = 0; lane < MC_LANES; lane++) {
+        low[lane] = static_cast<uint32_t>(first_path + lane);
+        high[lane] = static_cast<uint32_t>((first_path + lane) >> 32);
+    }
+    __m256i x0 = _mm256_set1_epi32(static_cast<int>(block));
+    __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(low));
+    __m256i x2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(high));
+    __m256i x3 = _mm256_set1_epi32(static_cast<int>(stream));
+    __m256i k0 = _mm256_set1_epi32(static_cast<int>(key[0]));
+    __m256i k1 = _mm256_set1_epi32(static_cast<int>(key[1]));
+    const __m256i m0 = _mm256_set1_epi32(static_cast<int>(PHILOX_M0));
+    const __m256i m1 = _mm256_set1_epi32(static_cast<int>(PHILOX_M1));
+    const __m256i w0 = _mm256_set1_epi32(static_cast<int>(PHILOX_W0));
+    const __m256i w1 = _mm256_set1_epi32(static_cast<int>(PHILOX_W1));
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        __m256i hi0, lo0, hi1, lo1;
+        mulhilo_avx2(x0, m0, hi0, lo0);
+        mulhilo_avx2(x2, m1, hi1, lo1);
+        x0 = _mm256_xor_si256(_mm256_xor_si256(hi1, x1), k0);
+        x2 = _mm256_xor_si256(_mm256_xor_si256(hi0, x3), k1);
+        x1 = lo1;
+        x3 = lo0;
+        k0 = _mm256_add_epi32(k0, w0);
+        k1 = _mm256_add_epi32(k1, w1);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out[0]), x0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out[1]), x1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out[2]), x2);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out[3]), x3);
+}
+
+SIMD_TARGET_SSE2 inline void mulhilo_sse2(__m128i x, __m128i m, __m128i& hi, __m128i& lo) {
+    const __m128i low_half = _mm_set1_epi64x(0xFFFFFFFFLL);
+    __m128i even = _mm_mul_epu32(x, m);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), m);
+    lo = _mm_or_si128(_mm_and_si128(even, low_half), _mm_slli_epi64(odd, 32));
+    hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(low_half, odd));
+}
+
+// Two passes of four lanes
+SIMD_TARGET_SSE2 inline void philox_lanes_sse2(uint32_t block, uint64_t first_path, uint32_t stream,
+                                               const uint32_t key[2], uint32_t out[4][MC_LANES]) {
+    const __m128i m0 = _mm_set1_epi32(static_cast<int>(PHILOX_M0));
+    const __m128i m1 = _mm_set1_epi32(static_cast<int>(PHILOX_M1));
+    const __m128i w0 = _mm_set1_epi32(static_cast<int>(PHILOX_W0));
+    const __m128i w1 = _mm_set1_epi32(static_cast<int>(PHILOX_W1));
+    for (unsigned int half = 0; half < MC_LANES; half += 4) {
+        uint32_t low[4], high[4];
+        for (unsigned int lane = 0; lane < 4; lane++) {
+            low[lane] = static_cast<uint32_t>(first_path + half + lane);
+            high[lane] = static_cast<uint32_t>((first_path + half + lane) >> 32);
+        }
+        __m128i x0 = _mm_set1_epi32(static_cast<int>(block));
+        __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(low));
+        __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(high));
+        __m128i x3 = _mm_set1_epi32(static_cast<int>(stream));
+        __m128i k0 = _mm_set1_epi32(static_cast<int>(key[0]));
+        __m128i k1 = _mm_set1_epi32(static_cast<int>(key[1]));
+        for (int r = 0; r < PHILOX_ROUNDS; r++) {
+            __m128i hi0, lo0, hi1, lo1;
+            mulhilo_sse2(x0, m0, hi0, lo0);
+            mulhilo_sse2(x2, m1, hi1, lo1);
+            x0 = _mm_xor_si128(_mm_xor_si128(hi1, x1), k0);
+            x2 = _mm_xor_si128(_mm_xor_si128(hi0, x3), k1);
+            x1 = lo1;
+            x3 = lo0;
+            k0 = _mm_add_epi32(k0, w0);
+            k1 = _mm_add_epi32(k1, w1);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[0] + half), x0);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[1] + half), x1);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[2] + half), x2);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[3] + half), x3);
+    }
+}
+#endif
+
+inline void philox_lanes(uint32_t block, uint64_t first_path, uint32_t stream, const uint32_t key[2],
+                         uint32_t out[4][MC_LANES], SimdLevel level = active_simd_level()) {
+    switch (level) {
+#ifdef SIMD_KERNELS_X86
+        case SIMD_AVX2: philox_lanes_avx2(block, first_path, stream, key, out); break;
+        case SIMD_SSE2: philox_lanes_sse2(block, first_path, stream, key, out); break;
+#endif
+        default: philox_lanes_scalar(block, first_path, stream, key, out); break;
+    }
+}
+
+// Uniform in (0, 1) from 32 random bits; never 0, so log() is safe.
+inline double philox_uniform(uint32_t bits) {
+    return (bits + 0.5) * (1.0 / 4294967296.0);
+}
+
+// ---------------------------------------------------------------------------
+// Simulation
+// ---------------------------------------------------------------------------
+
+enum MonteCarloModel { MC_GBM, MC_BOOTSTRAP };
+
+const int MC_QUANTILE_COUNT = 5;
+const double MC_QUANTILES[MC_QUANTILE_COUNT] = { 0.05, 0.25, 0.50, 0.75, 0.95 };
+const unsigned int MC_MAX_HORIZON = 252;
+const unsigned int MC_DEFAULT_PATHS = 1 << 20;
+const unsigned int MC_DEFAULT_HORIZON = 20;
+
+// Per-step quantiles come from a histogram of the cumulative log return over
+// its mean +- MC_HISTOGRAM_SPAN standard deviations (outliers land in the
+// end bins). Counts are integers, so merging the threads' histograms gives
+// the same bands whatever the thread count.
+const unsigned int MC_HISTOGRAM_BINS = 1024;
+const double MC_HISTOGRAM_SPAN = 8.0;
+
+// Paths per pool task (a multiple of MC_LANES)
+const unsigned int MC_TASK_PATHS = 16384;
+
+struct MonteCarloOptions {
+    MonteCarloModel model;
+    unsigned int paths;
+    unsigned int horizon;       // bars ahead, at most MC_MAX_HORIZON
+    unsigned int lookback;      // log returns the fit uses, newest first; 0 = all
+    uint64_t seed;
+    double tail;                // VaR/CVaR tail probability (0.05 = 95% VaR)
+
+    MonteCarloOptions()
+        : model(MC_GBM), paths(MC_DEFAULT_PATHS), horizon(MC_DEFAULT_HORIZON), lookback(0), seed(42), tail(0.05) {}
+};
+
+// Log returns close[t] / close[t - 1] of the last `lookback` bars (all if
+// 0) and their mean and standard deviation: the drift and volatility per
+// bar of the GBM fit. Non-positive closes end the sample.
+struct ReturnSample {
+    std::vector<double> returns;
+    double drift;
+    double volatility;
+
+    ReturnSample() : drift(0), volatility(0) {}
+};
+
+inline bool fit_log_returns(const double *close, unsigned int n, unsigned int lookback, ReturnSample& sample) {
+    sample = ReturnSample();
+    if (n < 3) return false;
+    unsigned int first = lookback > 0 && lookback < n - 1 ? n - 1 - lookback : 0;
+    for (unsigned int t = n - 1; t > first; t--) {
+        if (!(close[t] > 0) || !(close[t - 1] > 0)) break;
+        sample.returns.push_back(std::log(close[t] / close[t - 1]));
+    }
+    std::reverse(sample.returns.begin(), sample.returns.end());
+    size_t m = sample.returns.size();
+    if (m < 2) return false;
+    double mean = 0;
+    for (size_t i = 0; i < m; i++) mean += sample.returns[i];
+    mean /= m;
+    double ss = 0;
+    for (size_t i = 0; i < m; i++) ss += (sample.returns[i] - mean) * (sample.returns[i] - mean);
+    sample.drift = mean;
+    sample.volatility = std::sqrt(ss / (m - 1));
+    return true;
+}
+
+struct MonteCarloResult {
+    bool ok;
+    MonteCarloModel model;
+    unsigned int paths;
+    unsigned int horizon;
+    double last_close;
+    double drift, volatility;                       // per bar, of the log returns
+    double bands[MC_QUANTILE_COUNT][MC_MAX_HORIZON];  // price quantiles 1..horizon bars ahead
+    double tail;
+    double var;                 // loss at the horizon exceeded with probability `tail`, as a fraction
+    double cvar;                // mean loss in that tail (expected shortfall)
+    double expected_return;     // mean simple return at the horizon
+    double seconds;
+
+    MonteCarloResult()
+        : ok(false), model(MC_GBM), paths(0), horizon(0), last_close(0), drift(0), volatility(0), tail(0), var(0),
+          cvar(0), expected_return(0), seconds(0) {}
+
+    // Price quantile MC_QUANTILES[q] at step h (0 = one bar ahead)
+    double band(int q, unsigned int h) const { return bands[q][h]; }
+};
+
+// Histogram geometry of one step: lo and 1 / bin width
+struct McStepRange {
+    double lo;
+    double inv_width;
+};
+
+// Per-step increment source: a normal for GBM, a resampled return for the bootstrap
+struct McStepSource {
+    MonteCarloModel model;
+    double drift, volatility;
+    const double *returns;
+    uint64_t count;
+};
+
+// Simulates paths [first, end): appends each step's cumulative log return
+// to `histogram` (horizon x MC_HISTOGRAM_BINS) and stores each path's final
+// log return in terminal[path]. Path p draws block b of its numbers from
+// philox({b, p, p >> 32, 0}, seed): four normals (two Box-Muller pairs) or
+// four resampling indices per block.
+inline void simulate_paths(const McStepSource& source, unsigned int horizon, const McStepRange *ranges, uint64_t first,
+                           uint64_t end, const uint32_t key[2], uint32_t *histogram, double *terminal,
+                           SimdLevel level) {
+    uint32_t bits[4][MC_LANES];
+    double x[MC_LANES], step[4][MC_LANES];
+    for (uint64_t base = first; base < end; base += MC_LANES) {
+        unsigned int lanes = static_cast<unsigned int>(std::min<uint64_t>(MC_LANES, end - base));
+        for (unsigned int l = 0; l < MC_LANES; l++) x[l] = 0;
+        for (unsigned int h0 = 0; h0 < horizon; h0 += 4) {
+            philox_lanes(h0 / 4, base, 0, key, bits, level);
+            for (unsigned int l = 0; l < lanes; l++) {
+                if (source.model == MC_GBM) {
+                    for (int pair = 0; pair < 2; pair++) {
+                        double r = std::sqrt(-2 * std::log(philox_uniform(bits[2 * pair][l])));
+                        double angle = 6.283185307179586 * philox_uniform(bits[2 * pair + 1][l]);
+                        step[2 * pair][l] = source.drift + source.volatility * r * std::cos(angle);
+                        step[2 * pair + 1][l] = source.drift + source.volatility * r * std::sin(angle);
+                    }
+                } else {
+                    for (int k = 0; k < 4; k++) step[k][l] = source.returns[(bits[k][l] * source.count) >> 32];
+                }
+            }
+            unsigned int steps = std::min(4u, horizon - h0);
+            for (unsigned int k = 0; k < steps; k++) {
+                const McStepRange& range = ranges[h0 + k];
+                uint32_t *counts = histogram + static_cast<size_t>(h0 + k) * MC_HISTOGRAM_BINS;
+                for (unsigned int l = 0; l < lanes; l++) {
+                    x[l] += step[k][l];
+                    double position = (x[l] - range.lo) * range.inv_width;
+                    int bin = position <= 0 ? 0 : position >= MC_HISTOGRAM_BINS - 1 ? MC_HISTOGRAM_BINS - 1
+                                                                                   : static_cast<int>(position);
+                    counts[bin]++;
+                }
+            }
+        }
+        for (unsigned int l = 0; l < lanes; l++) terminal[base - first + l] = x[l];
+    }
+}
+
+// Value at `fraction` of the counts, interpolated linearly inside its bin
+inline double histogram_quantile(const uint32_t *counts, uint64_t total, double fraction, const McStepRange& range) {
+    double target = fraction * total;
+    uint64_t below = 0;
+    for (unsigned int b = 0; b < MC_HISTOGRAM_BINS; b++) {
+        if (below + counts[b] >= target && counts[b] > 0) {
+            double within = (target - below) / counts[b];
+            return range.lo + (b + within) / range.inv_width;
+        }
+        below += counts[b];
+    }
+    return range.lo + MC_HISTOGRAM_BINS / range.inv_width;
+}
+
+// Simulates options.paths paths of options.horizon bars from the last
+// close: GBM with the drift and volatility of the sampled log returns, or a
+// bootstrap that draws each bar's log return from the sample. Fills the
+// 5/25/50/75/95% price bands at every step and VaR/CVaR of the simple
+// return at the horizon. Paths are spread over `pool` (the calling thread
+// alone without one); the result is bit-identical for any thread count and
+// SIMD level. False if there are fewer than 3 closes.
+inline bool run_monte_carlo(const double *close, unsigned int n, const MonteCarloOptions& options,
+                            MonteCarloResult& result, thread_pool *pool = nullptr,
+                            SimdLevel level = active_simd_level()) {
+    TRACE_SCOPE("run_monte_carlo");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    result = MonteCarloResult();
+    ReturnSample sample;
+    if (options.paths == 0 || options.horizon == 0 || !fit_log_returns(close, n, options.lookback, sample)) return false;
+
+    unsigned int horizon = std::min(options.horizon, MC_MAX_HORIZON);
+    McStepSource source;
+    source.model = options.model;
+    source.drift = sample.drift;
+    source.volatility = sample.volatility;
+    source.returns = sample.returns.data();
+    source.count = sample.returns.size();
+
+    // Bootstrap steps are centred on the same mean; its tails can be fatter,
+    // which the end bins absorb
+    std::vector<McStepRange> ranges(horizon);
+    double spread = std::max(sample.volatility, 1e-12);
+    for (unsigned int h = 0; h < horizon; h++) {
+        double half_width = MC_HISTOGRAM_SPAN * spread * std::sqrt(h + 1.0);
+        ranges[h].lo = sample.drift * (h + 1) - half_width;
+        ranges[h].inv_width = MC_HISTOGRAM_BINS / (2 * half_width);
+    }
+
+    uint32_t key[2] = { static_cast<uint32_t>(options.seed), static_cast<uint32_t>(options.seed >> 32) };
+    unsigned int threads = pool ? pool->size() : 1;
+    size_t histogram_size = static_cast<size_t>(horizon) * MC_HISTOGRAM_BINS;
+    std::vector<uint32_t> histograms(histogram_size * threads, 0);
+    std::vector<double> terminal(options.paths);
+    unsigned int tasks = (options.paths + MC_TASK_PATHS - 1) / MC_TASK_PATHS;
+    auto task = [&](unsigned int t, unsigned int worker) {
+        uint64_t first = static_cast<uint64_t>(t) * MC_TASK_PATHS;
+        uint64_t end = std::min<uint64_t>(first + MC_TASK_PATHS, options.paths);
+        simulate_paths(source, horizon, ranges.data(), first, end, key, &histograms[worker * histogram_size],
+                       &terminal[first], level);
+    };
+    if (pool) {
+        pool->run(tasks, task);
+    } else {
+        for (unsigned int t = 0; t < tasks; t++) task(t, 0);
+    }
+    for (unsigned int w = 1; w < threads; w++) {
+        const uint32_t *part = &histograms[w * histogram_size];
+        for (size_t i = 0; i < histogram_size; i++) histograms[i] += part[i];
+    }
+
+    double last_close = close[n - 1];
+    for (unsigned int h = 0; h < horizon; h++) {
+        const uint32_t *counts = &histograms[h * MC_HISTOGRAM_BINS];
+        for (int q = 0; q < MC_QUANTILE_COUNT; q++) {
+            double log_return = histogram_quantile(counts, options.paths, MC_QUANTILES[q], ranges[h]);
+            result.bands[q][h] = last_close * std::exp(log_return);
+        }
+    }
+
+    // Tail of the exact terminal returns. Each path wrote its own slot, so
+    // the array (and the partition below) does not depend on the threads.
+    double sum = 0;
+    for (unsigned int p = 0; p < options.paths; p++) {
+        terminal[p] = std::expm1(terminal[p]);
+        sum += terminal[p];
+    }
+    double tail = std::min(std::max(options.tail, 1e-6), 0.5);
+    size_t k = std::max<size_t>(1, static_cast<size_t>(tail * options.paths));
+    std::nth_element(terminal.begin(), terminal.begin() + (k - 1), terminal.end());
+    double threshold = terminal[k - 1];
+    double tail_sum = 0;
+    for (size_t i = 0; i < k; i++) tail_sum += std::min(terminal[i], threshold);
+
+    result.ok = true;
+    result.model = options.model;
+    result.paths = options.paths;
+    result.horizon = horizon;
+    result.last_close = last_close;
+    result.drift = sample.drift;
+    result.volatility = sample.volatility;
+    result.tail = tail;
+    result.var = -threshold;
+    result.cvar = -tail_sum / k;
+    result.expected_return = sum / options.paths;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+#endif
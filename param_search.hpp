@@ -0,0 +1,393 @@
+// param_search.hpp - Walk-forward grid search over each model's parameter
+#ifndef PARAM_SEARCH_HPP
+#define PARAM_SEARCH_HPP
+
+#include "backtest.hpp"
+#include "simd_kernels.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Which walk-forward error the search minimises
+enum SearchObjective { OBJECTIVE_MAE, OBJECTIVE_RMSE, OBJECTIVE_MAPE };
+
+inline double objective_value(const ForecastAccuracy& accuracy, SearchObjective objective) {
+    switch (objective) {
+        case OBJECTIVE_MAE: return accuracy.mae();
+        case OBJECTIVE_RMSE: return accuracy.rmse();
+        case OBJECTIVE_MAPE: return accuracy.mape();
+    }
+    return accuracy.mae();
+}
+
+inline const char *objective_name(SearchObjective objective) {
+    switch (objective) {
+        case OBJECTIVE_MAE: return "mae";
+        case OBJECTIVE_RMSE: return "rmse";
+        case OBJECTIVE_MAPE: return "mape";
+    }
+    return "mae";
+}
+
+// Candidate values per model. Each model has one parameter, so its error
+// surface is a curve over these values.
+struct SearchGrid {
+    std::vector<unsigned int> regression_lookbacks;   // 0 = whole history
+    std::vector<int> sma_periods;
+    std::vector<double> ema_alphas;
+    std::vector<int> ar_orders;
+    std::vector<double> holt_alphas;  // Holt-Winters level factor; beta, gamma and the season stay fixed
+    int alpha_refinements;        // coarse-to-fine rounds around the best alpha
+    SearchObjective objective;
+
+    SearchGrid() : alpha_refinements(2), objective(OBJECTIVE_MAE) {}
+};
+
+inline SearchGrid default_search_grid() {
+    SearchGrid grid;
+    const unsigned int lookbacks[] = { 0, 10, 20, 50, 100, 250, 500, 1000 };
+    const int periods[] = { 2, 3, 5, 8, 10, 15, 20, 30, 50 };
+    grid.regression_lookbacks.assign(lookbacks, lookbacks + sizeof(lookbacks) / sizeof(lookbacks[0]));
+    grid.sma_periods.assign(periods, periods + sizeof(periods) / sizeof(periods[0]));
+    for (int i = 1; i <= 19; i++) grid.ema_alphas.push_back(i * 0.05);
+    const int orders[] = { 1, 2, 3, 5, 8 };
+    grid.ar_orders.assign(orders, orders + sizeof(orders) / sizeof(orders[0]));
+    for (int i = 1; i <= 9; i++) grid.holt_alphas.push_back(i * 0.1);
+    return grid;
+}
+
+// Name and current value of the one parameter each model is searched over
+inline const char *model_param_name(PredictionModel model) {
+    switch (model) {
+        case LINEAR_REGRESSION: return "lookback";
+        case MOVING_AVERAGE: return "window";
+        case EXPONENTIAL_SMOOTHING: return "alpha";
+        case AUTOREGRESSIVE: return "order";
+        case HOLT_WINTERS: return "alpha";
+    }
+    return "parameter";
+}
+
+inline double model_param_value(const ModelParams& params, PredictionModel model) {
+    switch (model) {
+        case LINEAR_REGRESSION: return params.regression_lookback;
+        case MOVING_AVERAGE: return params.sma_period;
+        case EXPONENTIAL_SMOOTHING: return params.ema_alpha;
+        case AUTOREGRESSIVE: return params.ar_order;
+        case HOLT_WINTERS: return params.holt_alpha;
+    }
+    return 0;
+}
+
+// One evaluated parameter value. `value` is the lookback, window, alpha or order.
+struct SearchPoint {
+    double value;
+    ForecastAccuracy accuracy;
+};
+
+struct SearchResult {
+    ModelParams best;
+    unsigned int score_from;                     // first scored bar, the same for every candidate
+    std::vector<SearchPoint> surface[MODEL_COUNT];   // indexed by PredictionModel, sorted by value
+};
+
+// EMA forecasts for many alphas in one pass
+// ---------------------------------------------------------------------------
+//
+// Every alpha sees the same closes, so several alphas are carried side by
+// side in SIMD lanes: one load of y[t] feeds all of them, and the
+// independent recurrences hide each other's latency. Each lane performs
+// exactly the operations of the scalar walk in the same order, so the
+// accumulated errors match walk_forward_model(EXPONENTIAL_SMOOTHING) (up to
+// FMA contraction if the scalar build enables it).
+
+// Alphas evaluated per pass at each level (two vectors per pass)
+inline unsigned int ema_sweep_lanes(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX2: return 8;
+        case SIMD_SSE2: return 4;
+        default: return 1;
+    }
+}
+
+inline void ema_sweep_scalar(const double *y, unsigned int n, double alpha, unsigned int score_from, ForecastAccuracy& out) {
+    out = ForecastAccuracy();
+    if (n == 0) return;
+    double ema = y[0];
+    for (unsigned int t = 1; t < n; t++) {
+        if (t >= score_from) out.add(ema, y[t], y[t - 1]);
+        ema = alpha * y[t] + (1 - alpha) * ema;
+    }
+}
+
+// Copies lane sums into ForecastAccuracy records; counts that do not depend
+// on alpha are shared by every lane.
+inline void store_sweep_lanes(const double *abs_err, const double *sq_err, const double *pct_err, const double *calls,
+                              const double *hits, unsigned int lanes, unsigned long long forecasts,
+                              unsigned long long pct_forecasts, ForecastAccuracy *out) {
+    for (unsigned int k = 0; k < lanes; k++) {
+        out[k].forecasts = forecasts;
+        out[k].sum_abs_error = abs_err[k];
+        out[k].sum_sq_error = sq_err[k];
+        out[k].sum_abs_pct_error = pct_err[k];
+        out[k].pct_forecasts = pct_forecasts;
+        out[k].direction_calls = static_cast<unsigned long long>(calls[k]);
+        out[k].direction_hits = static_cast<unsigned long long>(hits[k]);
+    }
+}
+
+#ifdef SIMD_KERNELS_X86
+SIMD_TARGET_SSE2 inline void ema_sweep_sse2(const double *y, unsigned int n, const double *alphas, unsigned int score_from,
+                                            ForecastAccuracy *out) {
+    __m128d a[2], b[2], e[2], abs_err[2], sq_err[2], pct_err[2], calls[2], hits[2];
+    const __m128d sign = _mm_set1_pd(-0.0), one = _mm_set1_pd(1.0), zero = _mm_setzero_pd();
+    for (int v = 0; v < 2; v++) {
+        a[v] = _mm_loadu_pd(alphas + 2 * v);
+        b[v] = _mm_sub_pd(one, a[v]);
+        e[v] = _mm_set1_pd(y[0]);
+        abs_err[v] = sq_err[v] = pct_err[v] = calls[v] = hits[v] = zero;
+    }
+    unsigned long long forecasts = 0, pct_forecasts = 0;
+    for (unsigned int t = 1; t < n; t++) {
+        __m128d actual = _mm_set1_pd(y[t]);
+        if (t >= score_from) {
+            __m128d previous = _mm_set1_pd(y[t - 1]);
+            double moved = y[t] - y[t - 1];
+            forecasts++;
+            if (y[t] != 0) pct_forecasts++;
+            for (int v = 0; v < 2; v++) {
+                __m128d err = _mm_sub_pd(e[v], actual);
+                abs_err[v] = _mm_add_pd(abs_err[v], _mm_andnot_pd(sign, err));
+                sq_err[v] = _mm_add_pd(sq_err[v], _mm_mul_pd(err, err));
+                if (y[t] != 0) pct_err[v] = _mm_add_pd(pct_err[v], _mm_andnot_pd(sign, _mm_div_pd(err, actual)));
+                if (moved != 0) {
+                    __m128d called = _mm_sub_pd(e[v], previous);
+                    calls[v] = _mm_add_pd(calls[v], _mm_and_pd(_mm_cmpneq_pd(called, zero), one));
+                    __m128d same = moved > 0 ? _mm_cmpgt_pd(called, zero) : _mm_cmplt_pd(called, zero);
+                    hits[v] = _mm_add_pd(hits[v], _mm_and_pd(same, one));
+                }
+            }
+        }
+        for (int v = 0; v < 2; v++) {
+            e[v] = _mm_add_pd(_mm_mul_pd(a[v], actual), _mm_mul_pd(b[v], e[v]));
+        }
+    }
+    double lanes[5][4];
+    for (int v = 0; v < 2; v++) {
+        _mm_storeu_pd(lanes[0] + 2 * v, abs_err[v]);
+        _mm_storeu_pd(lanes[1] + 2 * v, sq_err[v]);
+        _mm_storeu_pd(lanes[2] + 2 * v, pct_err[v]);
+        _mm_storeu_pd(lanes[3] + 2 * v, calls[v]);
+        _mm_storeu_pd(lanes[4] + 2 * v, hits[v]);
+    }
+    store_sweep_lanes(lanes[0], lanes[1], lanes[2], lanes[3], lanes[4], 4, forecasts, pct_forecasts, out);
+}
+
+SIMD_TARGET_AVX2 inline void ema_sweep_avx2(const double *y, unsigned int n, const double *alphas, unsigned int score_from,
+                                            ForecastAccuracy *out) {
+    __m256d a[2], b[2], e[2], abs_err[2], sq_err[2], pct_err[2], calls[2], hits[2];
+    const __m256d sign = _mm256_set1_pd(-0.0), one = _mm256_set1_pd(1.0), zero = _mm256_setzero_pd();
+    for (int v = 0; v < 2; v++) {
+        a[v] = _mm256_loadu_pd(alphas + 4 * v);
+        b[v] = _mm256_sub_pd(one, a[v]);
+        e[v] = _mm256_set1_pd(y[0]);
+        abs_err[v] = sq_err[v] = pct_err[v] = calls[v] = hits[v] = zero;
+    }
+    unsigned long long forecasts = 0, pct_forecasts = 0;
+    for (unsigned int t = 1; t < n; t++) {
+        __m256d actual = _mm256_set1_pd(y[t]);
+        if (t >= score_from) {
+            __m256d previous = _mm256_set1_pd(y[t - 1]);
+            double moved = y[t] - y[t - 1];
+            forecasts++;
+            if (y[t] != 0) pct_forecasts++;
+            for (int v = 0; v < 2; v++) {
+                __m256d err = _mm256_sub_pd(e[v], actual);
+                abs_err[v] = _mm256_add_pd(abs_err[v], _mm256_andnot_pd(sign, err));
+                sq_err[v] = _mm256_add_pd(sq_err[v], _mm256_mul_pd(err, err));
+                if (y[t] != 0) pct_err[v] = _mm256_add_pd(pct_err[v], _mm256_andnot_pd(sign, _mm256_div_pd(err, actual)));
+                if (moved != 0) {
+                    __m256d called = _mm256_sub_pd(e[v], previous);
+                    calls[v] = _mm256_add_pd(calls[v], _mm256_and_pd(_mm256_cmp_pd(called, zero, _CMP_NEQ_OQ), one));
+                    __m256d same = moved > 0 ? _mm256_cmp_pd(called, zero, _CMP_GT_OQ) : _mm256_cmp_pd(called, zero, _CMP_LT_OQ);
+                    hits[v] = _mm256_add_pd(hits[v], _mm256_and_pd(same, one));
+                }
+            }
+        }
+        for (int v = 0; v < 2; v++) {
+            e[v] = _mm256_add_pd(_mm256_mul_pd(a[v], actual), _mm256_mul_pd(b[v], e[v]));
+        }
+    }
+    double lanes[5][8];
+    for (int v = 0; v < 2; v++) {
+        _mm256_storeu_pd(lanes[0] + 4 * v, abs_err[v]);
+        _mm256_storeu_pd(lanes[1] + 4 * v, sq_err[v]);
+        _mm256_storeu_pd(lanes[2] + 4 * v, pct_err[v]);
+        _mm256_storeu_pd(lanes[3] + 4 * v, calls[v]);
+        _mm256_storeu_pd(lanes[4] + 4 * v, hits[v]);
+    }
+    store_sweep_lanes(lanes[0], lanes[1], lanes[2], lanes[3], lanes[4], 8, forecasts, pct_forecasts, out);
+}
+#endif
+
+// Evaluates alphas [first, first + ema_sweep_lanes(level)) in one pass. A
+// short final group is padded by repeating its last alpha; only `count`
+// results are written.
+inline void ema_sweep_group(const double *y, unsigned int n, const double *alphas, unsigned int count,
+                            unsigned int score_from, ForecastAccuracy *out, SimdLevel level = active_simd_level()) {
+    unsigned int lanes = ema_sweep_lanes(level);
+    if (score_from < 2) score_from = 2;
+    if (n == 0 || lanes == 1) {
+        for (unsigned int k = 0; k < count; k++) ema_sweep_scalar(y, n, alphas[k], score_from, out[k]);
+        return;
+    }
+    double padded[8];
+    ForecastAccuracy results[8];
+    for (unsigned int k = 0; k < lanes; k++) padded[k] = alphas[k < count ? k : count - 1];
+    switch (level) {
+#ifdef SIMD_KERNELS_X86
+        case SIMD_AVX2: ema_sweep_avx2(y, n, padded, score_from, results); break;
+        case SIMD_SSE2: ema_sweep_sse2(y, n, padded, score_from, results); break;
+#endif
+        default:
+            for (unsigned int k = 0; k < count; k++) ema_sweep_scalar(y, n, padded[k], score_from, results[k]);
+            break;
+    }
+    for (unsigned int k = 0; k < count; k++) out[k] = results[k];
+}
+
+// Search driver
+// ---------------------------------------------------------------------------
+
+// Runs `count` tasks on the pool, or inline when there is no pool (for
+// callers that are themselves pool tasks, such as batch scoring).
+template <typename Fn>
+inline void run_search_tasks(thread_pool *pool, unsigned int count, Fn fn) {
+    if (pool) {
+        pool->run(count, [&](unsigned int task, unsigned int) { fn(task); });
+    } else {
+        for (unsigned int task = 0; task < count; task++) fn(task);
+    }
+}
+
+inline unsigned int best_point(const std::vector<SearchPoint>& points, SearchObjective objective) {
+    unsigned int best = 0;
+    for (unsigned int i = 1; i < points.size(); i++) {
+        if (objective_value(points[i].accuracy, objective) < objective_value(points[best].accuracy, objective)) best = i;
+    }
+    return best;
+}
+
+inline bool point_value_less(const SearchPoint& a, const SearchPoint& b) {
+    return a.value < b.value;
+}
+
+// Sweeps the alphas in groups of SIMD lanes, one task per group.
+inline void sweep_alphas(const PriceSeries& series, const std::vector<double>& alphas, unsigned int score_from,
+                         thread_pool *pool, std::vector<SearchPoint>& points) {
+    unsigned int lanes = ema_sweep_lanes(active_simd_level());
+    unsigned int groups = static_cast<unsigned int>((alphas.size() + lanes - 1) / lanes);
+    size_t first_new = points.size();
+    points.resize(first_new + alphas.size());
+    std::vector<ForecastAccuracy> results(alphas.size());
+    run_search_tasks(pool, groups, [&](unsigned int g) {
+        unsigned int first = g * lanes;
+        unsigned int count = std::min(lanes, static_cast<unsigned int>(alphas.size()) - first);
+        ema_sweep_group(series.close, series.size, &alphas[first], count, score_from, &results[first]);
+    });
+    for (size_t i = 0; i < alphas.size(); i++) {
+        points[first_new + i].value = alphas[i];
+        points[first_new + i].accuracy = results[i];
+    }
+}
+
+// Evaluates every grid value of every model walk-forward and picks the
+// lowest error per model. Lookbacks, windows, AR orders and Holt-Winters
+// alphas are one task each; EMA alphas are batched into SIMD lanes, one task
+// per batch. With alpha_refinements, each round re-samples one batch of EMA
+// alphas between the best alpha's neighbours (coarse to fine). Every
+// candidate is scored on the same bars, starting once the largest window is
+// full and the highest AR order is fitted, so the surfaces are comparable.
+// Parameters outside the grid (Holt-Winters beta, gamma and season) are
+// taken from `base`.
+inline SearchResult search_parameters(const PriceSeries& series, const SearchGrid& grid, thread_pool *pool = nullptr,
+                                      const ModelParams& base = ModelParams()) {
+    TRACE_SCOPE("search_parameters");
+    SearchResult result;
+    result.best = base;
+    unsigned int score_from = 2;
+    for (size_t i = 0; i < grid.sma_periods.size(); i++) {
+        if (grid.sma_periods[i] > 0) score_from = std::max(score_from, static_cast<unsigned int>(grid.sma_periods[i]));
+    }
+    for (size_t i = 0; i < grid.ar_orders.size(); i++) score_from = std::max(score_from, ar_min_bars(grid.ar_orders[i]));
+    result.score_from = score_from;
+
+    // Lookbacks, windows, orders and Holt-Winters alphas: one walk per value, spread over the pool
+    std::vector<SearchPoint>& lr = result.surface[LINEAR_REGRESSION];
+    std::vector<SearchPoint>& ma = result.surface[MOVING_AVERAGE];
+    std::vector<SearchPoint>& ar = result.surface[AUTOREGRESSIVE];
+    std::vector<SearchPoint>& hw = result.surface[HOLT_WINTERS];
+    unsigned int lookbacks = static_cast<unsigned int>(grid.regression_lookbacks.size());
+    unsigned int periods = static_cast<unsigned int>(grid.sma_periods.size());
+    unsigned int orders = static_cast<unsigned int>(grid.ar_orders.size());
+    unsigned int holt_alphas = static_cast<unsigned int>(grid.holt_alphas.size());
+    lr.resize(lookbacks);
+    ma.resize(periods);
+    ar.resize(orders);
+    hw.resize(holt_alphas);
+    run_search_tasks(pool, lookbacks + periods + orders + holt_alphas, [&](unsigned int task) {
+        ModelParams params = base;
+        if (task < lookbacks) {
+            params.regression_lookback = grid.regression_lookbacks[task];
+            lr[task].value = params.regression_lookback;
+            lr[task].accuracy = walk_forward_model(series, LINEAR_REGRESSION, params, score_from);
+        } else if (task < lookbacks + periods) {
+            unsigned int i = task - lookbacks;
+            params.sma_period = grid.sma_periods[i] > 0 ? grid.sma_periods[i] : 1;
+            ma[i].value = params.sma_period;
+            ma[i].accuracy = walk_forward_model(series, MOVING_AVERAGE, params, score_from);
+        } else if (task < lookbacks + periods + orders) {
+            unsigned int i = task - lookbacks - periods;
+            params.ar_order = clamp_ar_order(grid.ar_orders[i]);
+            ar[i].value = params.ar_order;
+            ar[i].accuracy = walk_forward_model(series, AUTOREGRESSIVE, params, score_from);
+        } else {
+            unsigned int i = task - lookbacks - periods - orders;
+            params.holt_alpha = grid.holt_alphas[i];
+            hw[i].value = params.holt_alpha;
+            hw[i].accuracy = walk_forward_model(series, HOLT_WINTERS, params, score_from);
+        }
+    });
+
+    // Alphas: SIMD batches, then coarse-to-fine refinement around the best
+    std::vector<SearchPoint>& es = result.surface[EXPONENTIAL_SMOOTHING];
+    sweep_alphas(series, grid.ema_alphas, score_from, pool, es);
+    unsigned int lanes = ema_sweep_lanes(active_simd_level());
+    unsigned int per_round = std::max(lanes, 4u);
+    for (int round = 0; round < grid.alpha_refinements && !es.empty(); round++) {
+        std::sort(es.begin(), es.end(), point_value_less);
+        unsigned int best = best_point(es, grid.objective);
+        double lo = best > 0 ? es[best - 1].value : 0;
+        double hi = best + 1 < es.size() ? es[best + 1].value : 1;
+        std::vector<double> alphas;
+        for (unsigned int k = 1; k <= per_round; k++) {
+            double alpha = lo + (hi - lo) * k / (per_round + 1);
+            if (alpha > 0 && alpha <= 1 && alpha != es[best].value) alphas.push_back(alpha);
+        }
+        if (alphas.empty()) break;
+        sweep_alphas(series, alphas, score_from, pool, es);
+    }
+
+    for (int m = 0; m < MODEL_COUNT; m++) {
+        std::sort(result.surface[m].begin(), result.surface[m].end(), point_value_less);
+    }
+    if (!lr.empty()) result.best.regression_lookback = static_cast<unsigned int>(lr[best_point(lr, grid.objective)].value);
+    if (!ma.empty()) result.best.sma_period = static_cast<int>(ma[best_point(ma, grid.objective)].value);
+    if (!es.empty()) result.best.ema_alpha = es[best_point(es, grid.objective)].value;
+    if (!ar.empty()) result.best.ar_order = static_cast<int>(ar[best_point(ar, grid.objective)].value);
+    if (!hw.empty()) result.best.holt_alpha = hw[best_point(hw, grid.objective)].value;
+    return result;
+}
+
+#endif
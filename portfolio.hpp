@@ -0,0 +1,166 @@
+// portfolio.hpp - Many tickers in one process: arena-backed series, per-ticker scores and sparklines
+#ifndef PORTFOLIO_HPP
+#define PORTFOLIO_HPP
+
+#include "batch_scoring.hpp"
+#include "series_arena.hpp"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Closes sampled per ticker for its mini chart.
+const int SPARKLINE_POINTS = 64;
+
+// Bytes of arena per bar: an int64 timestamp and five double columns.
+const size_t PORTFOLIO_BYTES_PER_BAR = sizeof(int64_t) + 5 * sizeof(double);
+
+struct PortfolioTicker {
+    TickerScore score;
+    float sparkline[SPARKLINE_POINTS];  // closes at evenly spaced bars, scaled to [0, 1]
+    double change_pct[MODEL_COUNT];     // next prediction vs. last close, indexed by PredictionModel
+
+    PortfolioTicker() {
+        for (int p = 0; p < SPARKLINE_POINTS; p++) sparkline[p] = 0;
+        for (int m = 0; m < MODEL_COUNT; m++) change_pct[m] = 0;
+    }
+};
+
+// Every ticker's columns live in one series_arena; `series[i]` borrows the
+// columns of tickers[i] (empty if it failed to load).
+struct Portfolio {
+    series_arena arena;
+    std::vector<PortfolioTicker> tickers;
+    PriceSeries *series;
+    unsigned long long bars;
+    double load_seconds;
+
+    Portfolio() : series(nullptr), bars(0), load_seconds(0) {}
+
+    ~Portfolio() {
+        clear();
+    }
+
+    size_t size() const {
+        return tickers.size();
+    }
+
+    void clear() {
+        delete[] series;
+        series = nullptr;
+        tickers.clear();
+        arena.release();
+        bars = 0;
+    }
+
+private:
+    Portfolio(const Portfolio&);
+    Portfolio& operator=(const Portfolio&);
+};
+
+inline void build_sparkline(const PriceSeries& series, float *points) {
+    if (series.size == 0) return;
+    double values[SPARKLINE_POINTS];
+    double lo = series.close[0], hi = lo;
+    for (int p = 0; p < SPARKLINE_POINTS; p++) {
+        size_t i = static_cast<size_t>(p) * (series.size - 1) / (SPARKLINE_POINTS - 1);
+        values[p] = series.close[i];
+        lo = std::min(lo, values[p]);
+        hi = std::max(hi, values[p]);
+    }
+    double range = hi > lo ? hi - lo : 1;
+    for (int p = 0; p < SPARKLINE_POINTS; p++) points[p] = static_cast<float>((values[p] - lo) / range);
+}
+
+// Loads and scores every file on the pool, one task per file; results keep
+// the input order. Each task loads its ticker as usual (binary cache first)
+// then copies the columns into the arena and scores the arena copy, so only
+// the pool's in-flight tickers ever exist outside it. The autoregressive
+// model is fitted afterwards for all tickers together, several per SIMD
+// pass (see score_autoregressive_batch), since every series is resident by then.
+inline void load_portfolio(const std::vector<std::string>& files, Portfolio& portfolio, thread_pool& pool,
+                           const ScoreOptions& options = ScoreOptions()) {
+    TRACE_SCOPE("load_portfolio");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    portfolio.clear();
+    portfolio.tickers.assign(files.size(), PortfolioTicker());
+    portfolio.series = new PriceSeries[files.size()];
+    ScoreOptions scoring = options;
+    scoring.batched_autoregressive = true;
+
+    pool.run(static_cast<unsigned int>(files.size()), [&](unsigned int task, unsigned int) {
+        PortfolioTicker& ticker = portfolio.tickers[task];
+        TickerScore& score = ticker.score;
+        score.file = files[task];
+
+        StockPredictor predictor;
+        CsvLoadResult result;
+        score.loaded = load_stock_cached(predictor, files[task], result, options.cache, 1);
+        score.company = predictor.company_name;
+        score.rows = result.valid_rows;
+        score.skipped = result.skipped_rows;
+        if (!score.loaded || predictor.series.size == 0) return;
+
+        PriceSeries& series = portfolio.series[task];
+        if (!portfolio.arena.copy_series(predictor.series, series)) {
+            score.loaded = false;
+            return;
+        }
+        predictor.data.clear();
+        predictor.series.borrow(series);
+        score_predictor(predictor, scoring, score);
+        build_sparkline(series, ticker.sparkline);
+        for (int m = 0; m < MODEL_COUNT; m++) {
+            double last = score.last_close;
+            ticker.change_pct[m] = last != 0 ? (score.models[m].next_prediction - last) / last * 100 : 0;
+        }
+    });
+
+    std::vector<TickerScore *> scores(files.size());
+    std::vector<const double *> closes(files.size());
+    std::vector<unsigned int> sizes(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        scores[i] = &portfolio.tickers[i].score;
+        closes[i] = portfolio.series[i].close;
+        sizes[i] = portfolio.series[i].size;
+    }
+    score_autoregressive_batch(scores.data(), closes.data(), sizes.data(), files.size(), pool);
+    for (size_t i = 0; i < files.size(); i++) {
+        const TickerScore& score = portfolio.tickers[i].score;
+        double last = score.last_close;
+        portfolio.tickers[i].change_pct[AUTOREGRESSIVE] =
+            last != 0 ? (score.models[AUTOREGRESSIVE].next_prediction - last) / last * 100 : 0;
+    }
+
+    for (size_t i = 0; i < files.size(); i++) portfolio.bars += portfolio.series[i].size;
+    portfolio.load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+enum PortfolioColumn { SORT_TICKER, SORT_LAST_CLOSE, SORT_CHANGE, SORT_CONFIDENCE };
+
+// Ticker indices ordered by `column` (the change and confidence of `model`).
+// Tickers that failed to load always sort last.
+inline void sort_portfolio(const Portfolio& portfolio, PortfolioColumn column, PredictionModel model, bool descending,
+                           std::vector<unsigned int>& order) {
+    order.resize(portfolio.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = static_cast<unsigned int>(i);
+    const std::vector<PortfolioTicker>& tickers = portfolio.tickers;
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        const TickerScore& x = tickers[a].score;
+        const TickerScore& y = tickers[b].score;
+        bool x_ok = x.loaded && x.last_close != 0, y_ok = y.loaded && y.last_close != 0;
+        if (x_ok != y_ok) return x_ok;
+        if (descending) std::swap(a, b);
+        const TickerScore& first = tickers[a].score;
+        const TickerScore& second = tickers[b].score;
+        switch (column) {
+            case SORT_TICKER: return first.company < second.company;
+            case SORT_LAST_CLOSE: return first.last_close < second.last_close;
+            case SORT_CHANGE: return tickers[a].change_pct[model] < tickers[b].change_pct[model];
+            case SORT_CONFIDENCE: return first.models[model].confidence < second.models[model].confidence;
+        }
+        return false;
+    });
+}
+
+#endif
@@ -0,0 +1,114 @@
+// prefix_regression.hpp - O(1) least-squares fits over any range of bars via prefix sums
+#ifndef PREFIX_REGRESSION_HPP
+#define PREFIX_REGRESSION_HPP
+
+#include "incremental_model.hpp"
+#include <cmath>
+#include <vector>
+
+// Prefix sums of y, x*y and y^2 over the closes, with x the bar index and y
+// shifted by the first close. A fit over bars [begin, end) is then three
+// differences plus fit_from_sums, whatever the range length, which is what
+// lets the chart refit its trend line to the visible bars every frame.
+//
+// The products grow with the bar index (x*y reaches n^2 * price) and a short
+// window far into the history is a small difference of huge prefixes, so
+// every rounding error is carried: each prefix keeps its Neumaier running
+// error next to the sum, the x*y terms add their exact product error (fma),
+// and differences and the re-centring product are formed in two parts.
+// Slopes of 10-bar windows at the end of 10M bars then match a direct
+// regression_sums pass to ~1e-12 relative (see bench/bench_view.cpp).
+struct RegressionPrefix {
+    std::vector<neumaier_sum> y;    // y[i] = sum of (close - shift) over bars [0, i)
+    std::vector<neumaier_sum> xy;   // sum of x * (close - shift)
+    std::vector<neumaier_sum> yy;   // sum of (close - shift)^2
+    double shift;
+    unsigned int bars;              // bars of the series summed so far
+
+    RegressionPrefix() : shift(0), bars(0) {}
+
+    void clear() {
+        y.clear();
+        xy.clear();
+        yy.clear();
+        shift = 0;
+        bars = 0;
+    }
+
+    // Drops the sums of bars from `row` on, so the next sync adds them again
+    // (after a followed bar revised the newest one).
+    void rewind(unsigned int row) {
+        if (row >= bars) return;
+        if (row == 0) {
+            clear();
+            return;
+        }
+        y.resize(row + 1);
+        xy.resize(row + 1);
+        yy.resize(row + 1);
+        bars = row;
+    }
+
+    // Extends the prefixes to bars appended since the last call, O(appended).
+    // A series that shrank is summed again from the start.
+    void sync(const PriceSeries& series) {
+        if (series.size < bars) clear();
+        if (series.size == bars) return;
+        if (bars == 0) {
+            shift = series.close[0];
+            y.assign(1, neumaier_sum());
+            xy.assign(1, neumaier_sum());
+            yy.assign(1, neumaier_sum());
+        }
+        y.reserve(series.size + 1);
+        xy.reserve(series.size + 1);
+        yy.reserve(series.size + 1);
+        for (unsigned int i = bars; i < series.size; i++) {
+            double d = series.close[i] - shift;
+            neumaier_sum sy = y.back(), sxy = xy.back(), syy = yy.back();
+            sy.add(d);
+            double x = static_cast<double>(i);
+            double product = x * d;
+            sxy.add(product);
+            sxy.add(std::fma(x, d, -product));
+            syy.add(d * d);
+            y.push_back(sy);
+            xy.push_back(sxy);
+            yy.push_back(syy);
+        }
+        bars = series.size;
+    }
+
+    // Sums for a regression over bars [begin, end) with x counted from
+    // `begin`, in the form fit_from_sums expects.
+    RegressionSums sums(unsigned int begin, unsigned int end) const {
+        RegressionSums s;
+        if (end > bars) end = bars;
+        if (begin >= end) return s;
+        s.n = end - begin;
+        s.x_mean = (s.n - 1) / 2.0;
+        s.shift = shift;
+        double y_hi = y[end].sum - y[begin].sum;
+        double y_lo = y[end].compensation - y[begin].compensation;
+        s.sum_y = y_hi + y_lo;
+        // sum of (i - begin - x_mean) * d = sum(i * d) - (begin + x_mean) * sum(d),
+        // with the product split into its rounded value and exact error
+        double centre = begin + s.x_mean;
+        double product = centre * y_hi;
+        double product_error = std::fma(centre, y_hi, -product);
+        s.sum_xy = ((xy[end].sum - xy[begin].sum) - product) +
+                   ((xy[end].compensation - xy[begin].compensation) - product_error) - centre * y_lo;
+        s.sum_yy = (yy[end].sum - yy[begin].sum) + (yy[end].compensation - yy[begin].compensation);
+        return s;
+    }
+
+    // Line through bars [begin, end); the intercept is at bar 0 of the
+    // series, like PredictionStats.
+    RegressionFit fit(unsigned int begin, unsigned int end) const {
+        RegressionFit f = fit_from_sums(sums(begin, end));
+        f.intercept -= f.slope * begin;
+        return f;
+    }
+};
+
+#endif
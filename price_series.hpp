@@ -0,0 +1,382 @@
+// price_series.hpp - Columnar (structure-of-arrays) price history for the compute path
+#ifndef PRICE_SERIES_HPP
+#define PRICE_SERIES_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "allocation_counter.hpp"
+#include "mapped_file.hpp"
+#include "simd_kernels.hpp"
+
+// Column alignment in bytes: one cache line, and enough for any SIMD load.
+const size_t SERIES_ALIGNMENT = 64;
+
+// Marker for timestamps that could not be parsed.
+const int64_t INVALID_TIMESTAMP = INT64_MIN;
+
+const int64_t SECONDS_PER_DAY = 86400;
+
+inline void *aligned_malloc(size_t bytes, size_t alignment = SERIES_ALIGNMENT) {
+    void *raw = malloc(bytes + alignment + sizeof(void *));
+    if (!raw) return nullptr;
+    note_allocation(bytes);
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(void *);
+    uintptr_t aligned = (start + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    reinterpret_cast<void **>(aligned)[-1] = raw;
+    return reinterpret_cast<void *>(aligned);
+}
+
+inline void aligned_free(void *ptr) {
+    if (ptr) {
+        free(reinterpret_cast<void **>(ptr)[-1]);
+    }
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (Howard Hinnant's
+// days_from_civil).
+inline int32_t days_from_civil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yoe = year - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+inline void civil_from_days(int32_t days, int& year, int& month, int& day) {
+    days += 719468;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int doe = days - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp + (mp < 10 ? 3 : -9);
+    year = yoe + era * 400 + (month <= 2);
+}
+
+// Reads up to max_digits digits into `value`; returns how many were read.
+inline int read_date_digits(const char *&p, const char *end, int max_digits, int& value) {
+    int digits = 0;
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9' && digits < max_digits) {
+        value = value * 10 + (*p - '0');
+        ++p;
+        ++digits;
+    }
+    return digits;
+}
+
+// Parses "MM/DD/YYYY" (1-2 digit month/day) or "YYYY-MM-DD", optionally
+// quoted and optionally followed by a time of day (" HH:MM[:SS]" or
+// "THH:MM[:SS]"), into seconds since 1970-01-01 00:00. Times are taken as
+// written; no time zone is applied.
+inline int64_t parse_timestamp(const char *str, size_t len) {
+    const char *p = str;
+    const char *end = str + len;
+    if (p < end && *p == '"') ++p;
+
+    int first, second, third;
+    int first_digits = read_date_digits(p, end, 4, first);
+    if (first_digits == 0 || p >= end || (*p != '/' && *p != '-')) return INVALID_TIMESTAMP;
+    char separator = *p++;
+    if (read_date_digits(p, end, 2, second) == 0 || p >= end || *p != separator) return INVALID_TIMESTAMP;
+    ++p;
+    if (read_date_digits(p, end, 4, third) == 0) return INVALID_TIMESTAMP;
+
+    bool iso = separator == '-' && first_digits == 4;
+    int year = iso ? first : third, month = iso ? second : first, day = iso ? third : second;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return INVALID_TIMESTAMP;
+    int64_t seconds = static_cast<int64_t>(days_from_civil(year, month, day)) * SECONDS_PER_DAY;
+
+    if (p < end && (*p == ' ' || *p == 'T')) {
+        const char *time = p + 1;
+        int hour, minute, second_of_minute = 0;
+        if (read_date_digits(time, end, 2, hour) > 0 && time < end && *time == ':' &&
+            read_date_digits(++time, end, 2, minute) == 2) {
+            if (time < end && *time == ':' && read_date_digits(++time, end, 2, second_of_minute) != 2) {
+                return INVALID_TIMESTAMP;
+            }
+            if (hour > 23 || minute > 59 || second_of_minute > 60) return INVALID_TIMESTAMP;
+            seconds += hour * 3600 + minute * 60 + second_of_minute;
+        }
+    }
+    return seconds;
+}
+
+inline int64_t parse_timestamp(const std::string& str) {
+    return parse_timestamp(str.data(), str.size());
+}
+
+// Days since 1970-01-01 of a timestamp (rounded down for times before it).
+inline int32_t epoch_day(int64_t timestamp) {
+    int64_t day = timestamp / SECONDS_PER_DAY;
+    if (timestamp % SECONDS_PER_DAY < 0) day--;
+    return static_cast<int32_t>(day);
+}
+
+// "MM/DD/YYYY", the format the CSV files use, with " HH:MM" (and ":SS")
+// appended for intraday bars.
+inline std::string format_timestamp(int64_t timestamp) {
+    if (timestamp == INVALID_TIMESTAMP) return "?";
+    int32_t days = epoch_day(timestamp);
+    int64_t seconds = timestamp - static_cast<int64_t>(days) * SECONDS_PER_DAY;
+    int year, month, day;
+    civil_from_days(days, year, month, day);
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%02d/%02d/%04d", month, day, year);
+    if (seconds != 0) {
+        n += snprintf(buf + n, sizeof(buf) - n, " %02d:%02d", static_cast<int>(seconds / 3600),
+                      static_cast<int>(seconds / 60 % 60));
+        if (seconds % 60 != 0) snprintf(buf + n, sizeof(buf) - n, ":%02d", static_cast<int>(seconds % 60));
+    }
+    return buf;
+}
+
+// One contiguous, 64-byte aligned array per field. Scans that only need
+// closes (every prediction model) stream through 8 bytes per bar instead of
+// a ~100 byte StockData record.
+//
+// The columns can also point straight into a read-only mapped file (see
+// attach()) or into memory owned by someone else, such as a series_arena
+// (see borrow()). Such a series must not be written in place; appending
+// copies it into owned memory first.
+struct PriceSeries {
+    unsigned int size;
+    unsigned int capacity;
+    int64_t *time;          // seconds since 1970-01-01 (see parse_timestamp)
+    double *open;
+    double *high;
+    double *low;
+    double *close;
+    double *volume;
+    mapped_file *backing;   // non-null while the columns live in a mapping
+    bool borrowed;          // columns owned elsewhere; never freed here
+
+    PriceSeries() : size(0), capacity(0), time(nullptr), open(nullptr), high(nullptr), low(nullptr), close(nullptr), volume(nullptr), backing(nullptr), borrowed(false) {}
+
+    ~PriceSeries() {
+        release();
+    }
+
+    bool reserve(unsigned int new_capacity) {
+        if (new_capacity <= capacity) return true;
+
+        int64_t *new_time = static_cast<int64_t *>(aligned_malloc(new_capacity * sizeof(int64_t)));
+        double *new_columns[5] = { nullptr, nullptr, nullptr, nullptr, nullptr };
+        bool ok = new_time != nullptr;
+        for (int c = 0; c < 5 && ok; c++) {
+            new_columns[c] = static_cast<double *>(aligned_malloc(new_capacity * sizeof(double)));
+            ok = new_columns[c] != nullptr;
+        }
+        if (!ok) {
+            aligned_free(new_time);
+            for (int c = 0; c < 5; c++) aligned_free(new_columns[c]);
+            return false;
+        }
+
+        double **columns[5] = { &open, &high, &low, &close, &volume };
+        if (size > 0) {
+            memcpy(new_time, time, size * sizeof(int64_t));
+            for (int c = 0; c < 5; c++) memcpy(new_columns[c], *columns[c], size * sizeof(double));
+        }
+        release_columns();
+        time = new_time;
+        for (int c = 0; c < 5; c++) {
+            *columns[c] = new_columns[c];
+        }
+        capacity = new_capacity;
+        return true;
+    }
+
+    // Points the columns at memory owned by `mapping` (which the series takes
+    // over). Each column must hold `rows` values and stay valid while mapped.
+    void attach(mapped_file *mapping, unsigned int rows, const int64_t *times, const double *opens, const double *highs,
+                const double *lows, const double *closes, const double *volumes) {
+        release();
+        backing = mapping;
+        time = const_cast<int64_t *>(times);
+        open = const_cast<double *>(opens);
+        high = const_cast<double *>(highs);
+        low = const_cast<double *>(lows);
+        close = const_cast<double *>(closes);
+        volume = const_cast<double *>(volumes);
+        size = capacity = rows;
+    }
+
+    // Points the columns at `rows` values owned by the caller, which must
+    // outlive the series (or its next reserve/clear).
+    void borrow(unsigned int rows, int64_t *times, double *opens, double *highs, double *lows, double *closes,
+                double *volumes) {
+        release();
+        borrowed = true;
+        time = times;
+        open = opens;
+        high = highs;
+        low = lows;
+        close = closes;
+        volume = volumes;
+        size = capacity = rows;
+    }
+
+    void borrow(const PriceSeries& other) {
+        borrow(other.size, other.time, other.open, other.high, other.low, other.close, other.volume);
+    }
+
+    // True while the columns are not this series' own heap memory.
+    bool attached() const {
+        return backing != nullptr || borrowed;
+    }
+
+    bool add(int64_t timestamp, double o, double h, double l, double c, double v) {
+        if (size >= capacity && !reserve(capacity > 0 ? capacity * 2 : 64)) {
+            return false;
+        }
+        time[size] = timestamp;
+        open[size] = o;
+        high[size] = h;
+        low[size] = l;
+        close[size] = c;
+        volume[size] = v;
+        size++;
+        return true;
+    }
+
+    // Appends `rows` bars given column by column (a slice of another series
+    // or of a mapped file). An attached series is copied into owned memory
+    // first. False, with the series unchanged, if memory runs out.
+    bool append(unsigned int rows, const int64_t *times, const double *opens, const double *highs, const double *lows,
+                const double *closes, const double *volumes) {
+        if (rows == 0) return true;
+        unsigned int needed = size + rows;
+        if (attached()) {
+            capacity = 0;
+            if (!reserve(needed)) {
+                capacity = size;
+                return false;
+            }
+        } else if (needed > capacity && !reserve(std::max(needed, capacity * 2))) {
+            return false;
+        }
+        memcpy(time + size, times, rows * sizeof(int64_t));
+        const double *sources[5] = { opens, highs, lows, closes, volumes };
+        double *columns[5] = { open, high, low, close, volume };
+        for (int c = 0; c < 5; c++) memcpy(columns[c] + size, sources[c], rows * sizeof(double));
+        size = needed;
+        return true;
+    }
+
+    bool append(const PriceSeries& other, unsigned int begin, unsigned int end) {
+        return begin >= end || append(end - begin, other.time + begin, other.open + begin, other.high + begin,
+                                      other.low + begin, other.close + begin, other.volume + begin);
+    }
+
+    // Exchanges the columns (and their ownership) with `other` in O(1).
+    void swap(PriceSeries& other) {
+        std::swap(size, other.size);
+        std::swap(capacity, other.capacity);
+        std::swap(time, other.time);
+        std::swap(open, other.open);
+        std::swap(high, other.high);
+        std::swap(low, other.low);
+        std::swap(close, other.close);
+        std::swap(volume, other.volume);
+        std::swap(backing, other.backing);
+        std::swap(borrowed, other.borrowed);
+    }
+
+    // Reorders the rows to old[order[0]], old[order[1]], ..., old[order[count - 1]]
+    // (rows left out of `order` are dropped). Columns are gathered one at a
+    // time, so the extra memory is a single column; an attached series is
+    // copied into owned memory first. On failure the series is left empty.
+    bool permute(const uint32_t *order, unsigned int count) {
+        if (attached()) {
+            capacity = 0;
+            if (!reserve(size)) {
+                release();
+                return false;
+            }
+        }
+        if (!gather_column(time, order, count)) return false;
+        double **columns[5] = { &open, &high, &low, &close, &volume };
+        for (int c = 0; c < 5; c++) {
+            if (!gather_column(*columns[c], order, count)) return false;
+        }
+        size = capacity = count;
+        return true;
+    }
+
+    void clear() {
+        if (attached()) {
+            release();
+        }
+        size = 0;
+    }
+
+    bool empty() const {
+        return size == 0;
+    }
+
+private:
+    void release_columns() {
+        if (backing) {
+            delete backing;
+            backing = nullptr;
+        } else if (borrowed) {
+            borrowed = false;
+        } else {
+            aligned_free(time);
+            aligned_free(open);
+            aligned_free(high);
+            aligned_free(low);
+            aligned_free(close);
+            aligned_free(volume);
+        }
+        time = nullptr;
+        open = high = low = close = volume = nullptr;
+    }
+
+    void release() {
+        release_columns();
+        size = capacity = 0;
+    }
+
+    template <typename T>
+    bool gather_column(T *&column, const uint32_t *order, unsigned int count) {
+        T *gathered = static_cast<T *>(aligned_malloc((count > 0 ? count : 1) * sizeof(T)));
+        if (!gathered) {
+            release();
+            return false;
+        }
+        for (unsigned int i = 0; i < count; i++) gathered[i] = column[order[i]];
+        aligned_free(column);
+        column = gathered;
+        return true;
+    }
+
+    PriceSeries(const PriceSeries&);
+    PriceSeries& operator=(const PriceSeries&);
+};
+
+// Lowest low and highest high over [begin, end). Only the two columns are read.
+inline void price_range(const PriceSeries& series, unsigned int begin, unsigned int end, double& min_price, double& max_price) {
+    if (begin >= end) {
+        min_price = max_price = 0;
+        return;
+    }
+    min_price = series.low[begin];
+    max_price = series.high[begin];
+    minmax_reduce(series.low + begin, series.high + begin, end - begin, min_price, max_price);
+}
+
+inline void price_range(const PriceSeries& series, double& min_price, double& max_price) {
+    price_range(series, 0, series.size, min_price, max_price);
+}
+
+#endif
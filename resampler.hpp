@@ -0,0 +1,323 @@
+// resampler.hpp - OHLCV aggregation of bars or trades into coarser timeframes
+#ifndef RESAMPLER_HPP
+#define RESAMPLER_HPP
+
+#include "price_series.hpp"
+#include "series_order.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Bucket grid of a timeframe. A bar belongs to the bucket
+// [origin + k * seconds, origin + (k + 1) * seconds) its timestamp falls in,
+// and the aggregated bar is stamped with the bucket's start. Days run from
+// midnight as written in the file (timestamps carry no time zone, see
+// parse_timestamp) and weeks from Monday.
+struct BarPeriod {
+    int64_t seconds;
+    int64_t origin;
+
+    explicit BarPeriod(int64_t length = 60, int64_t start = 0) : seconds(length), origin(start) {}
+};
+
+// 1970-01-05, the first Monday after the epoch
+const int64_t WEEK_ORIGIN = 4 * SECONDS_PER_DAY;
+const int64_t SECONDS_PER_WEEK = 7 * SECONDS_PER_DAY;
+
+inline int64_t bucket_start(int64_t timestamp, const BarPeriod& period) {
+    int64_t offset = timestamp - period.origin;
+    int64_t k = offset / period.seconds;
+    if (offset % period.seconds < 0) k--;
+    return period.origin + k * period.seconds;
+}
+
+// A count and a unit: "30s", "1m", "5m", "1h", "4h", "1d", "1w". False for
+// anything else.
+inline bool parse_bar_period(const std::string& text, BarPeriod& period) {
+    const char *begin = text.c_str();
+    char *unit = nullptr;
+    long count = strtol(begin, &unit, 10);
+    if (count <= 0 || unit == begin || unit[0] == '\0' || unit[1] != '\0') return false;
+    int64_t seconds;
+    switch (*unit) {
+        case 's': seconds = 1; break;
+        case 'm': seconds = 60; break;
+        case 'h': seconds = 3600; break;
+        case 'd': seconds = SECONDS_PER_DAY; break;
+        case 'w': seconds = SECONDS_PER_WEEK; break;
+        default: return false;
+    }
+    period = BarPeriod(count * seconds, *unit == 'w' ? WEEK_ORIGIN : 0);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Aggregation
+// ---------------------------------------------------------------------------
+
+// Aggregates bars (or trades, as one-trade bars) into `period` buckets in a
+// single pass, holding only the bucket in progress. The open is that of the
+// earliest bar in the bucket and the close that of the latest, whatever
+// order they arrive in, so a newest-first export gives the same bars as an
+// oldest-first one; high and low are the extremes and volume the sum. A
+// bucket is emitted when a bar of another bucket arrives. finish() emits the
+// last one and leaves `bars` in chronological order, merging buckets that
+// were split because the input went back to them. Input bars must not
+// repeat: a duplicated row counts twice.
+struct BarResampler {
+    BarPeriod period;
+    PriceSeries bars;
+
+    explicit BarResampler(const BarPeriod& bucket_period = BarPeriod())
+        : period(bucket_period), pending(false), bucket(0), first_time(0), last_time(0), open(0), high(0), low(0),
+          close(0), volume(0) {}
+
+    bool add(int64_t time, double o, double h, double l, double c, double v) {
+        int64_t start = bucket_start(time, period);
+        if (pending && start != bucket && !emit()) return false;
+        if (!pending) {
+            pending = true;
+            bucket = start;
+            first_time = last_time = time;
+            open = o;
+            high = h;
+            low = l;
+            close = c;
+            volume = v;
+            return true;
+        }
+        if (time < first_time) {
+            first_time = time;
+            open = o;
+        }
+        if (time >= last_time) {
+            last_time = time;
+            close = c;
+        }
+        high = std::max(high, h);
+        low = std::min(low, l);
+        volume += v;
+        return true;
+    }
+
+    bool add_trade(int64_t time, double price, double size) {
+        return add(time, price, price, price, price, size);
+    }
+
+    bool finish() {
+        TRACE_SCOPE("resampler_finish");
+        if (pending && !emit()) return false;
+        bool ascending = true, descending = true;
+        for (unsigned int i = 1; i < bars.size && (ascending || descending); i++) {
+            ascending = ascending && bars.time[i - 1] < bars.time[i];
+            descending = descending && bars.time[i - 1] > bars.time[i];
+        }
+        bool ok = true;
+        if (!ascending && descending) {
+            std::vector<uint32_t> order(bars.size);
+            for (unsigned int i = 0; i < bars.size; i++) order[i] = bars.size - 1 - i;
+            ok = bars.permute(order.data(), bars.size);
+        } else if (!ascending) {
+            ok = merge_split_buckets();
+        }
+        first_times.clear();
+        last_times.clear();
+        return ok;
+    }
+
+    // Starts over with no bars (the period is kept).
+    void clear() {
+        bars.clear();
+        first_times.clear();
+        last_times.clear();
+        pending = false;
+    }
+
+private:
+    bool pending;
+    int64_t bucket, first_time, last_time;
+    double open, high, low, close, volume;
+    std::vector<int64_t> first_times, last_times;   // of every emitted bar, for merge_split_buckets
+
+    bool emit() {
+        if (!bars.add(bucket, open, high, low, close, volume)) return false;
+        first_times.push_back(first_time);
+        last_times.push_back(last_time);
+        pending = false;
+        return true;
+    }
+
+    // Sorts the emitted bars by bucket and folds the pieces of each bucket
+    // together, taking the open and close by the times they were seen at.
+    bool merge_split_buckets() {
+        std::vector<uint32_t> order;
+        radix_sort_order(bars.time, bars.size, order);
+        PriceSeries merged;
+        if (!merged.reserve(bars.size)) return false;
+        for (size_t k = 0; k < order.size();) {
+            uint32_t i = order[k];
+            int64_t earliest = first_times[i], latest = last_times[i];
+            double o = bars.open[i], h = bars.high[i], l = bars.low[i], c = bars.close[i], v = bars.volume[i];
+            for (k++; k < order.size() && bars.time[order[k]] == bars.time[i]; k++) {
+                uint32_t j = order[k];
+                if (first_times[j] < earliest) {
+                    earliest = first_times[j];
+                    o = bars.open[j];
+                }
+                if (last_times[j] >= latest) {
+                    latest = last_times[j];
+                    c = bars.close[j];
+                }
+                h = std::max(h, bars.high[j]);
+                l = std::min(l, bars.low[j]);
+                v += bars.volume[j];
+            }
+            merged.add(bars.time[i], o, h, l, c, v);
+        }
+        bars.swap(merged);
+        return true;
+    }
+
+    BarResampler(const BarResampler&);
+    BarResampler& operator=(const BarResampler&);
+};
+
+// Aggregates bars [begin, end) of a chronological series (as
+// load_stock_file leaves it) into `out`, replacing its contents. The same
+// bars as a BarResampler, without tracking arrival order.
+inline bool resample_series(const PriceSeries& in, unsigned int begin, unsigned int end, const BarPeriod& period,
+                            PriceSeries& out) {
+    TRACE_SCOPE("resample_series");
+    out.clear();
+    if (begin >= end) return true;
+    int64_t span = in.time[end - 1] - in.time[begin];
+    unsigned int estimate = static_cast<unsigned int>(std::min<int64_t>(end - begin, span / period.seconds + 2));
+    if (!out.reserve(estimate)) return false;
+    for (unsigned int i = begin; i < end;) {
+        int64_t bucket = bucket_start(in.time[i], period), next = bucket + period.seconds;
+        double high = in.high[i], low = in.low[i], volume = in.volume[i];
+        unsigned int j = i + 1;
+        for (; j < end && in.time[j] < next; j++) {
+            high = std::max(high, in.high[j]);
+            low = std::min(low, in.low[j]);
+            volume += in.volume[j];
+        }
+        if (!out.add(bucket, in.open[i], high, low, in.close[j - 1], volume)) return false;
+        i = j;
+    }
+    return true;
+}
+
+inline bool resample_series(const PriceSeries& in, const BarPeriod& period, PriceSeries& out) {
+    return resample_series(in, 0, in.size, period, out);
+}
+
+// ---------------------------------------------------------------------------
+// Precomputed resolutions
+// ---------------------------------------------------------------------------
+
+enum Timeframe { TIMEFRAME_RAW, TIMEFRAME_1M, TIMEFRAME_5M, TIMEFRAME_1H, TIMEFRAME_1D, TIMEFRAME_1W };
+
+const int TIMEFRAME_COUNT = 6;
+const char *const TIMEFRAME_NAMES[TIMEFRAME_COUNT] = { "raw", "1m", "5m", "1h", "1d", "1w" };
+
+// Period of each timeframe; TIMEFRAME_RAW has none (one second is returned).
+inline BarPeriod timeframe_period(Timeframe timeframe) {
+    switch (timeframe) {
+        case TIMEFRAME_1M: return BarPeriod(60);
+        case TIMEFRAME_5M: return BarPeriod(300);
+        case TIMEFRAME_1H: return BarPeriod(3600);
+        case TIMEFRAME_1D: return BarPeriod(SECONDS_PER_DAY);
+        case TIMEFRAME_1W: return BarPeriod(SECONDS_PER_WEEK, WEEK_ORIGIN);
+        default: return BarPeriod(1);
+    }
+}
+
+inline bool parse_timeframe(const std::string& name, Timeframe& timeframe) {
+    for (int t = 0; t < TIMEFRAME_COUNT; t++) {
+        if (name == TIMEFRAME_NAMES[t]) {
+            timeframe = static_cast<Timeframe>(t);
+            return true;
+        }
+    }
+    return false;
+}
+
+// One history at every timeframe, so the chart switches between them
+// without going back to the source. bars[t] holds timeframe t, except for
+// the active one, which select_timeframe() has swapped into the caller's
+// series (the raw bars start out there). A timeframe is available when it
+// has fewer bars than the raw data; resampling daily bars to 1h would only
+// copy them.
+struct ResolutionSet {
+    PriceSeries bars[TIMEFRAME_COUNT];
+    unsigned int rows[TIMEFRAME_COUNT];     // bars of each timeframe, also of the active one
+    Timeframe active;
+
+    ResolutionSet() : active(TIMEFRAME_RAW) {
+        for (int t = 0; t < TIMEFRAME_COUNT; t++) rows[t] = 0;
+    }
+
+    bool available(Timeframe timeframe) const {
+        return timeframe == TIMEFRAME_RAW || (rows[timeframe] > 0 && rows[timeframe] < rows[TIMEFRAME_RAW]);
+    }
+
+    // The next available timeframe after the active one, wrapping to raw.
+    Timeframe next() const {
+        for (int step = 1; step < TIMEFRAME_COUNT; step++) {
+            Timeframe t = static_cast<Timeframe>((active + step) % TIMEFRAME_COUNT);
+            if (available(t)) return t;
+        }
+        return active;
+    }
+
+    void clear() {
+        for (int t = 0; t < TIMEFRAME_COUNT; t++) {
+            bars[t].clear();
+            rows[t] = 0;
+        }
+        active = TIMEFRAME_RAW;
+    }
+};
+
+// Fills `set` from the chronological series `raw`, which stays where it is
+// as the active timeframe. Each timeframe is aggregated from the previous
+// one (1m -> 5m -> 1h -> 1d -> 1w; their buckets nest), so only the first
+// step reads every raw bar. Timeframes no coarser than the raw bars are
+// left empty. False if memory runs out.
+inline bool build_resolutions(const PriceSeries& raw, ResolutionSet& set) {
+    TRACE_SCOPE("build_resolutions");
+    set.clear();
+    set.rows[TIMEFRAME_RAW] = raw.size;
+    const PriceSeries *source = &raw;
+    for (int t = TIMEFRAME_1M; t < TIMEFRAME_COUNT; t++) {
+        PriceSeries& bars = set.bars[t];
+        if (!resample_series(*source, timeframe_period(static_cast<Timeframe>(t)), bars)) {
+            set.clear();
+            return false;
+        }
+        set.rows[t] = bars.size;
+        if (bars.size == raw.size) {
+            bars.clear();
+        } else {
+            source = &bars;
+        }
+    }
+    return true;
+}
+
+// Makes `timeframe` the one in `shown`, putting the bars shown so far back
+// into their slot. O(1); false if the timeframe is not available.
+inline bool select_timeframe(ResolutionSet& set, PriceSeries& shown, Timeframe timeframe) {
+    if (!set.available(timeframe)) return false;
+    if (timeframe == set.active) return true;
+    shown.swap(set.bars[set.active]);
+    shown.swap(set.bars[timeframe]);
+    set.active = timeframe;
+    return true;
+}
+
+#endif
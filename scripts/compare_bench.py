@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""compare_bench.py - Compare two `bench_suite --json` runs case by case.
+
+Matches results by case name and row count and prints the change in time
+per item and in allocations. A case is a regression when it is slower by
+more than --threshold (default 10%) or allocates more than before. Cases
+present in only one run are listed but not judged. Cases that took under
+--min-ms in the baseline are not judged on time (timer noise), but an
+increase in allocations still counts, since allocation counts are
+deterministic. Exits 1 if anything regressed, so it can gate a change:
+
+    ./bench_suite --rows 1K,1M --json before.json
+    # ... rebuild with the change ...
+    ./bench_suite --rows 1K,1M --json after.json
+    python3 scripts/compare_bench.py before.json after.json
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_results(path):
+    with open(path) as f:
+        run = json.load(f)
+    results = {}
+    for r in run["results"]:
+        results[(r["name"], r["rows"])] = r
+    return run, results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative slowdown that counts as a regression (default 0.10)")
+    parser.add_argument("--min-ms", type=float, default=0.1,
+                        help="baseline time below which a case is too short to judge on time (default 0.1)")
+    args = parser.parse_args()
+
+    base_run, base = load_results(args.baseline)
+    new_run, new = load_results(args.candidate)
+    for key in ("simd", "threads", "bars", "seed"):
+        if base_run.get(key) != new_run.get(key):
+            print("note: %s differs (%s vs %s)" % (key, base_run.get(key), new_run.get(key)))
+
+    regressions = 0
+    print("%-28s %10s %10s %10s %-8s %8s %9s" % ("case", "rows", "before", "after", "unit", "change", "allocs"))
+    for key in sorted(set(base) | set(new), key=lambda k: (k[1], k[0])):
+        name, rows = key
+        if key not in base or key not in new:
+            print("%-28s %10d  only in %s" % (name, rows, "baseline" if key in base else "candidate"))
+            continue
+        b, n = base[key], new[key]
+        change = n["ns_per_item"] / b["ns_per_item"] - 1 if b["ns_per_item"] > 0 else 0.0
+        alloc_delta = n["allocations"] - b["allocations"]
+        flags = []
+        if b["seconds"] * 1e3 < args.min_ms:
+            flags.append("(too short)")
+        elif change > args.threshold:
+            flags.append("SLOWER")
+        if alloc_delta > 0:
+            flags.append("MORE ALLOCS")
+        if "SLOWER" in flags or alloc_delta > 0:
+            regressions += 1
+        print("%-28s %10d %10.2f %10.2f %-8s %+7.1f%% %+9d  %s" % (
+            name, rows, b["ns_per_item"], n["ns_per_item"], "ns/" + n["unit"], change * 100, alloc_delta,
+            " ".join(flags)))
+
+    print("\n%d regression%s" % (regressions, "" if regressions == 1 else "s"))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""feed_writer.py - Simulated live bar feed for `hd --follow`.
+
+Writes a newest-first history in the loader's CSV format, then appends one
+bar per line at a fixed rate (the bars due at each tick go out in a single
+write, as a real feed handler would). With "-" as the path the bars go to
+stdout instead, for piping into `hd --follow -`.
+
+    python3 scripts/feed_writer.py live.csv --history 5000 --rate 10000 --seconds 60 &
+    ./hd --follow live.csv
+
+    python3 scripts/feed_writer.py - --rate 50 | ./hd --follow -
+"""
+
+import argparse
+import datetime
+import os
+import random
+import sys
+import time
+
+
+def bar_line(day, price, step, rng):
+    volume = rng.randrange(1000000, 21000000)
+    open_price = price - step / 2
+    return '%s,"%.2f","%.2f","%.2f","%.2f","%s"\n' % (
+        day.strftime("%m/%d/%Y"), open_price, max(open_price, price) + 1.25,
+        min(open_price, price) - 1.25, price, format(volume, ","))
+
+
+def walk(rng, price):
+    step = rng.uniform(-1.0, 1.0)
+    return (price + step if price + step > 1.0 else price), step
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("path", help='CSV file to create and append to, or "-" for stdout')
+    parser.add_argument("--history", type=int, default=1000, help="bars written before the feed starts")
+    parser.add_argument("--rate", type=float, default=10000, help="bars per second")
+    parser.add_argument("--seconds", type=float, default=30, help="how long to feed (0 = forever)")
+    parser.add_argument("--seed", type=int, default=42)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    price = 150.0
+    day = datetime.date(2000, 1, 3)
+    one_day = datetime.timedelta(days=1)
+
+    history = []
+    for _ in range(args.history):
+        price, step = walk(rng, price)
+        history.append(bar_line(day, price, step, rng))
+        day += one_day
+
+    if args.path == "-":
+        out = sys.stdout.fileno()
+        os.write(out, b"Date,Open,High,Low,Close,Volume\n")
+        os.write(out, "".join(history).encode())
+    else:
+        # Newest first, like the files the loader reverses; appended bars follow in time order
+        with open(args.path, "w") as f:
+            f.write("Date,Open,High,Low,Close,Volume\n")
+            f.writelines(reversed(history))
+        out = os.open(args.path, os.O_WRONLY | os.O_APPEND)
+
+    start = time.perf_counter()
+    sent = 0
+    try:
+        while args.seconds <= 0 or sent < args.rate * args.seconds:
+            due = int((time.perf_counter() - start) * args.rate) + 1
+            if args.seconds > 0:
+                due = min(due, int(args.rate * args.seconds))
+            lines = []
+            while sent < due:
+                price, step = walk(rng, price)
+                lines.append(bar_line(day, price, step, rng))
+                day += one_day
+                sent += 1
+            if lines:
+                os.write(out, "".join(lines).encode())
+            time.sleep(max(0.0, start + sent / args.rate - time.perf_counter()))
+    except (KeyboardInterrupt, BrokenPipeError):
+        pass
+    print("feed_writer: %d bars in %.1f s" % (sent, time.perf_counter() - start), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
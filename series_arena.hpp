@@ -0,0 +1,108 @@
+// series_arena.hpp - Bump allocator that packs the columns of many price series into a few large blocks
+#ifndef SERIES_ARENA_HPP
+#define SERIES_ARENA_HPP
+
+#include "price_series.hpp"
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Hands out 64-byte aligned slices of large blocks and frees them all at
+// once. Hundreds of tickers then cost a handful of allocations instead of
+// six growing arrays each, with no per-array slack or allocator headers
+// between them. allocate() may be called from several threads.
+struct series_arena {
+    static const size_t DEFAULT_BLOCK_BYTES = 64 << 20;
+
+    explicit series_arena(size_t block_bytes = DEFAULT_BLOCK_BYTES)
+        : block_size(block_bytes), cursor(nullptr), remaining(0), used_bytes(0), reserved_bytes(0) {}
+
+    ~series_arena() {
+        release();
+    }
+
+    // Null if the memory cannot be had. Requests larger than a block get a
+    // block of their own.
+    void *allocate(size_t bytes) {
+        bytes = align(bytes);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (bytes > remaining) {
+            size_t size = bytes > block_size ? bytes : block_size;
+            char *block = static_cast<char *>(aligned_malloc(size));
+            if (!block) return nullptr;
+            blocks.push_back(block);
+            reserved_bytes += size;
+            if (bytes == size) {
+                used_bytes += bytes;
+                return block;   // keep filling the current block
+            }
+            cursor = block;
+            remaining = size;
+        }
+        void *slice = cursor;
+        cursor += bytes;
+        remaining -= bytes;
+        used_bytes += bytes;
+        return slice;
+    }
+
+    // Copies the columns of `source` into the arena and points `target` at
+    // them (the two may be the same series).
+    bool copy_series(const PriceSeries& source, PriceSeries& target) {
+        unsigned int rows = source.size;
+        size_t time_bytes = align(rows * sizeof(int64_t));
+        size_t column_bytes = align(rows * sizeof(double));
+        char *base = static_cast<char *>(allocate(time_bytes + 5 * column_bytes));
+        if (!base) return false;
+
+        int64_t *time = reinterpret_cast<int64_t *>(base);
+        double *columns[5];
+        const double *from[5] = { source.open, source.high, source.low, source.close, source.volume };
+        memcpy(time, source.time, rows * sizeof(int64_t));
+        for (int c = 0; c < 5; c++) {
+            columns[c] = reinterpret_cast<double *>(base + time_bytes + c * column_bytes);
+            memcpy(columns[c], from[c], rows * sizeof(double));
+        }
+        target.borrow(rows, time, columns[0], columns[1], columns[2], columns[3], columns[4]);
+        return true;
+    }
+
+    // Bytes handed out (including alignment) and bytes held in blocks.
+    size_t used() const {
+        return used_bytes;
+    }
+
+    size_t reserved() const {
+        return reserved_bytes;
+    }
+
+    size_t block_count() const {
+        return blocks.size();
+    }
+
+    // Frees every block; series borrowing from the arena must be gone.
+    void release() {
+        for (size_t i = 0; i < blocks.size(); i++) aligned_free(blocks[i]);
+        blocks.clear();
+        cursor = nullptr;
+        remaining = used_bytes = reserved_bytes = 0;
+    }
+
+private:
+    size_t block_size;
+    char *cursor;
+    size_t remaining;
+    size_t used_bytes;
+    size_t reserved_bytes;
+    std::vector<char *> blocks;
+    std::mutex mutex;
+
+    static size_t align(size_t bytes) {
+        return (bytes + SERIES_ALIGNMENT - 1) & ~(SERIES_ALIGNMENT - 1);
+    }
+
+    series_arena(const series_arena&);
+    series_arena& operator=(const series_arena&);
+};
+
+#endif
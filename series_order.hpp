@@ -0,0 +1,183 @@
+// series_order.hpp - Chronological ordering of price series: monotonic check, radix sort and k-way merge
+#ifndef SERIES_ORDER_HPP
+#define SERIES_ORDER_HPP
+
+#include "price_series.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Widest digit of the radix sort: 2,048 buckets, an 8 KB histogram per pass
+// that stays in L1. The key bits are split evenly over the passes, so the
+// digits are often narrower (fewer buckets scatter with better locality).
+const int TIME_RADIX_BITS = 11;
+const unsigned int TIME_RADIX_BUCKETS = 1u << TIME_RADIX_BITS;
+
+// Indices of `keys` in ascending key order; equal keys keep their input
+// order. Keys are first rebased to the minimum and divided by the coarsest
+// unit they are all multiples of (a day, a minute or a second), then
+// packed with the index into one 64-bit word and sorted by an LSD radix
+// sort over only the bits the keys actually use: two passes for decades of
+// daily bars, three for intraday seconds. Falls back to std::stable_sort
+// when a key and an index do not fit in 64 bits together.
+inline void radix_sort_order(const int64_t *keys, uint32_t n, std::vector<uint32_t>& order) {
+    order.resize(n);
+    if (n == 0) return;
+
+    int64_t lo = keys[0], hi = keys[0];
+    for (uint32_t i = 1; i < n; i++) {
+        lo = std::min(lo, keys[i]);
+        hi = std::max(hi, keys[i]);
+    }
+    // Multiplicative checks with constant divisors; both stop at the first miss
+    int64_t unit = 1;
+    bool whole_days = true, whole_minutes = true;
+    for (uint32_t i = 0; i < n && whole_minutes; i++) {
+        uint64_t offset = static_cast<uint64_t>(keys[i]) - static_cast<uint64_t>(lo);
+        whole_days = whole_days && offset % SECONDS_PER_DAY == 0;
+        whole_minutes = offset % 60 == 0;
+    }
+    if (whole_days) {
+        unit = SECONDS_PER_DAY;
+    } else if (whole_minutes) {
+        unit = 60;
+    }
+
+    uint64_t range = (static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo)) / static_cast<uint64_t>(unit);
+    int key_bits = 0;
+    while (key_bits < 64 && (range >> key_bits) != 0) key_bits++;
+    int index_bits = 0;
+    while (index_bits < 32 && ((n - 1) >> index_bits) != 0) index_bits++;
+
+    if (key_bits + index_bits > 64) {
+        for (uint32_t i = 0; i < n; i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        return;
+    }
+
+    std::vector<uint64_t> packed(n), scratch(n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t offset = static_cast<uint64_t>(keys[i]) - static_cast<uint64_t>(lo);
+        uint64_t key = unit == SECONDS_PER_DAY ? offset / SECONDS_PER_DAY : (unit == 60 ? offset / 60 : offset);
+        packed[i] = key << index_bits | i;
+    }
+
+    // One read of the data builds every pass's histogram
+    int passes = (key_bits + TIME_RADIX_BITS - 1) / TIME_RADIX_BITS;
+    int digit_bits = passes > 0 ? (key_bits + passes - 1) / passes : 0;
+    uint64_t digit_mask = (1ULL << digit_bits) - 1;
+    std::vector<uint32_t> counts(static_cast<size_t>(passes) * TIME_RADIX_BUCKETS, 0);
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t key = packed[i] >> index_bits;
+        for (int pass = 0; pass < passes; pass++) {
+            counts[pass * TIME_RADIX_BUCKETS + ((key >> (pass * digit_bits)) & digit_mask)]++;
+        }
+    }
+
+    uint64_t *from = packed.data(), *to = scratch.data();
+    for (int pass = 0; pass < passes; pass++) {
+        uint32_t *count = &counts[pass * TIME_RADIX_BUCKETS];
+        int shift = index_bits + pass * digit_bits;
+        if (count[(from[0] >> shift) & digit_mask] == n) continue;    // every key shares this digit
+
+        uint32_t offset = 0;
+        for (uint64_t b = 0; b <= digit_mask; b++) {
+            uint32_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t value = from[i];
+            to[count[(value >> shift) & digit_mask]++] = value;
+        }
+        std::swap(from, to);
+    }
+
+    uint64_t index_mask = index_bits > 0 ? (~0ULL >> (64 - index_bits)) : 0;
+    for (uint32_t i = 0; i < n; i++) order[i] = static_cast<uint32_t>(from[i] & index_mask);
+}
+
+// Rows to keep, oldest first, when the timestamps are not already strictly
+// ascending: `order` lists them for PriceSeries::permute and the function
+// returns true. Of several rows with the same timestamp the last one in
+// input order is kept. Returns false (and clears `order`) when the rows are
+// already in order, so the common cases cost one O(n) scan: an ascending
+// file needs nothing and a strictly descending one (the usual newest-first
+// export) is just reversed; anything else is radix sorted.
+inline bool chronological_order(const int64_t *time, uint32_t n, std::vector<uint32_t>& order) {
+    order.clear();
+    bool ascending = true, descending = true;
+    for (uint32_t i = 1; i < n && (ascending || descending); i++) {
+        ascending = ascending && time[i - 1] < time[i];
+        descending = descending && time[i - 1] > time[i];
+    }
+    if (ascending) return false;
+
+    if (descending) {
+        order.resize(n);
+        for (uint32_t i = 0; i < n; i++) order[i] = n - 1 - i;
+        return true;
+    }
+
+    radix_sort_order(time, n, order);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (kept > 0 && time[order[kept - 1]] == time[order[i]]) {
+            order[kept - 1] = order[i];
+        } else {
+            order[kept++] = order[i];
+        }
+    }
+    order.resize(kept);
+    return true;
+}
+
+// Puts the series in chronological order with duplicate timestamps removed,
+// permuting each column once. `scratch` is reused for the order, if given.
+inline bool sort_series(PriceSeries& series, std::vector<uint32_t> *scratch = nullptr) {
+    TRACE_SCOPE("sort_series");
+    std::vector<uint32_t> local;
+    std::vector<uint32_t>& order = scratch ? *scratch : local;
+    if (!chronological_order(series.time, series.size, order)) return true;
+    return series.permute(order.data(), static_cast<uint32_t>(order.size()));
+}
+
+// Merges `count` chronologically ordered series without duplicate
+// timestamps (as load_stock_file leaves them) into `out`, which must not be
+// one of the inputs. Where several inputs have a bar at the same time the
+// one from the later input wins, so overlapping exports of one ticker can be
+// listed oldest first and the newest values are kept.
+inline bool merge_series(const PriceSeries *const *inputs, size_t count, PriceSeries& out) {
+    TRACE_SCOPE("merge_series");
+    out.clear();
+    size_t total = 0;
+    for (size_t s = 0; s < count; s++) total += inputs[s]->size;
+    if (total > UINT32_MAX || !out.reserve(static_cast<unsigned int>(total))) return false;
+
+    std::vector<unsigned int> next(count, 0);
+    for (;;) {
+        // Linear scan of the heads; the inputs are a handful of files
+        size_t pick = count;
+        int64_t earliest = 0;
+        for (size_t s = 0; s < count; s++) {
+            if (next[s] >= inputs[s]->size) continue;
+            int64_t t = inputs[s]->time[next[s]];
+            if (pick == count || t <= earliest) {
+                pick = s;
+                earliest = t;
+            }
+        }
+        if (pick == count) break;
+
+        for (size_t s = 0; s < pick; s++) {
+            if (next[s] < inputs[s]->size && inputs[s]->time[next[s]] == earliest) next[s]++;
+        }
+        const PriceSeries& from = *inputs[pick];
+        unsigned int i = next[pick]++;
+        out.add(earliest, from.open[i], from.high[i], from.low[i], from.close[i], from.volume[i]);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,444 @@
+// simd_kernels.hpp - Vectorized reductions over price columns with runtime dispatch
+//
+// Each kernel has a scalar version and, on x86, SSE2 and AVX2 versions. The
+// widest one the CPU supports is picked on first use; set_simd_level() forces
+// a level (used by bench/bench_kernels.cpp to compare them).
+//
+// Accuracy against the scalar kernels (checked by bench_kernels):
+//   - min/max: exact.
+//   - regression intercept and next prediction: within
+//     REGRESSION_ULP_TOLERANCE ULPs. Slope and r_squared can sit near zero,
+//     so they are held to the same count of ULPs of their natural scale
+//     (|slope| + |intercept| / n, and 1 for r_squared). The vector kernels
+//     only change summation order inside a block; see REDUCTION_BLOCK.
+//   - EMA: the segmented recurrence differs by rounding only, within
+//     EMA_ULP_TOLERANCE ULPs.
+//   - rank-2 row update: exact (the same multiplies and adds per element,
+//     up to FMA contraction if the scalar build enables it).
+#ifndef SIMD_KERNELS_HPP
+#define SIMD_KERNELS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_KERNELS_X86 1
+#include <immintrin.h>
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#endif
+
+const int REGRESSION_ULP_TOLERANCE = 64;
+const int EMA_ULP_TOLERANCE = 16;
+
+enum SimdLevel { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+
+inline const char *simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX2: return "avx2";
+        case SIMD_SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+inline SimdLevel detect_simd_level() {
+#ifdef SIMD_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+inline SimdLevel& simd_level_slot() {
+    static SimdLevel level = detect_simd_level();
+    return level;
+}
+
+inline SimdLevel active_simd_level() {
+    return simd_level_slot();
+}
+
+// Forces a level; requests above what the CPU supports are clamped.
+inline void set_simd_level(SimdLevel level) {
+    SimdLevel supported = detect_simd_level();
+    simd_level_slot() = level > supported ? supported : level;
+}
+
+// Distance between two doubles in units in the last place.
+inline int64_t ulp_distance(double a, double b) {
+    if (a == b) return 0;
+    if (std::isnan(a) || std::isnan(b)) return INT64_MAX;
+    int64_t ia, ib;
+    memcpy(&ia, &a, sizeof(double));
+    memcpy(&ib, &b, sizeof(double));
+    if (ia < 0) ia = INT64_MIN - ia;
+    if (ib < 0) ib = INT64_MIN - ib;
+    return ia > ib ? ia - ib : ib - ia;
+}
+
+// ---------------------------------------------------------------------------
+// Fused regression sums
+// ---------------------------------------------------------------------------
+
+// Single-pass sums for a least-squares line through (i, y[i]). x is centred
+// on its mean and y is shifted by `shift` (normally y[0]) so the sums stay
+// small and the closing formulas do not cancel catastrophically.
+struct RegressionSums {
+    double n;
+    double x_mean;
+    double shift;
+    double sum_y;   // sum of (y - shift)
+    double sum_xy;  // sum of (x - x_mean) * (y - shift)
+    double sum_yy;  // sum of (y - shift)^2
+
+    RegressionSums() : n(0), x_mean(0), shift(0), sum_y(0), sum_xy(0), sum_yy(0) {}
+};
+
+// The kernels sum in blocks of this many bars and fold each block into the
+// totals, so rounding error grows with n / block + block instead of n. All
+// levels use the same blocking, which keeps them close to one another.
+const unsigned int REDUCTION_BLOCK = 2048;
+
+inline void regression_block_scalar(const double *y, unsigned int begin, unsigned int end, RegressionSums& s) {
+    double sy = 0, sxy = 0, syy = 0;
+    for (unsigned int i = begin; i < end; i++) {
+        double x = i - s.x_mean;
+        double d = y[i] - s.shift;
+        sy += d;
+        sxy += x * d;
+        syy += d * d;
+    }
+    s.sum_y += sy;
+    s.sum_xy += sxy;
+    s.sum_yy += syy;
+}
+
+inline void regression_sums_scalar(const double *y, unsigned int n, RegressionSums& s) {
+    for (unsigned int begin = 0; begin < n; begin += REDUCTION_BLOCK) {
+        unsigned int end = n - begin > REDUCTION_BLOCK ? begin + REDUCTION_BLOCK : n;
+        regression_block_scalar(y, begin, end, s);
+    }
+}
+
+#ifdef SIMD_KERNELS_X86
+SIMD_TARGET_SSE2 inline void regression_block_sse2(const double *y, unsigned int begin, unsigned int end, RegressionSums& s) {
+    unsigned int vec_end = begin + ((end - begin) & ~3u);
+    __m128d shift = _mm_set1_pd(s.shift);
+    __m128d x0 = _mm_set_pd(begin + 1 - s.x_mean, begin - s.x_mean);
+    __m128d x1 = _mm_set_pd(begin + 3 - s.x_mean, begin + 2 - s.x_mean);
+    __m128d step = _mm_set1_pd(4.0);
+    __m128d sy0 = _mm_setzero_pd(), sy1 = _mm_setzero_pd();
+    __m128d sxy0 = _mm_setzero_pd(), sxy1 = _mm_setzero_pd();
+    __m128d syy0 = _mm_setzero_pd(), syy1 = _mm_setzero_pd();
+
+    for (unsigned int i = begin; i < vec_end; i += 4) {
+        __m128d d0 = _mm_sub_pd(_mm_loadu_pd(y + i), shift);
+        __m128d d1 = _mm_sub_pd(_mm_loadu_pd(y + i + 2), shift);
+        sy0 = _mm_add_pd(sy0, d0);
+        sy1 = _mm_add_pd(sy1, d1);
+        sxy0 = _mm_add_pd(sxy0, _mm_mul_pd(x0, d0));
+        sxy1 = _mm_add_pd(sxy1, _mm_mul_pd(x1, d1));
+        syy0 = _mm_add_pd(syy0, _mm_mul_pd(d0, d0));
+        syy1 = _mm_add_pd(syy1, _mm_mul_pd(d1, d1));
+        x0 = _mm_add_pd(x0, step);
+        x1 = _mm_add_pd(x1, step);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sy0, sy1));
+    s.sum_y += lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, _mm_add_pd(sxy0, sxy1));
+    s.sum_xy += lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, _mm_add_pd(syy0, syy1));
+    s.sum_yy += lanes[0] + lanes[1];
+
+    regression_block_scalar(y, vec_end, end, s);
+}
+
+SIMD_TARGET_AVX2 inline void regression_block_avx2(const double *y, unsigned int begin, unsigned int end, RegressionSums& s) {
+    unsigned int vec_end = begin + ((end - begin) & ~7u);
+    __m256d shift = _mm256_set1_pd(s.shift);
+    __m256d x0 = _mm256_set_pd(begin + 3 - s.x_mean, begin + 2 - s.x_mean, begin + 1 - s.x_mean, begin - s.x_mean);
+    __m256d x1 = _mm256_set_pd(begin + 7 - s.x_mean, begin + 6 - s.x_mean, begin + 5 - s.x_mean, begin + 4 - s.x_mean);
+    __m256d step = _mm256_set1_pd(8.0);
+    __m256d sy0 = _mm256_setzero_pd(), sy1 = _mm256_setzero_pd();
+    __m256d sxy0 = _mm256_setzero_pd(), sxy1 = _mm256_setzero_pd();
+    __m256d syy0 = _mm256_setzero_pd(), syy1 = _mm256_setzero_pd();
+
+    for (unsigned int i = begin; i < vec_end; i += 8) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(y + i), shift);
+        __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(y + i + 4), shift);
+        sy0 = _mm256_add_pd(sy0, d0);
+        sy1 = _mm256_add_pd(sy1, d1);
+        sxy0 = _mm256_add_pd(sxy0, _mm256_mul_pd(x0, d0));
+        sxy1 = _mm256_add_pd(sxy1, _mm256_mul_pd(x1, d1));
+        syy0 = _mm256_add_pd(syy0, _mm256_mul_pd(d0, d0));
+        syy1 = _mm256_add_pd(syy1, _mm256_mul_pd(d1, d1));
+        x0 = _mm256_add_pd(x0, step);
+        x1 = _mm256_add_pd(x1, step);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sy0, sy1));
+    s.sum_y += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sxy0, sxy1));
+    s.sum_xy += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, _mm256_add_pd(syy0, syy1));
+    s.sum_yy += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    regression_block_scalar(y, vec_end, end, s);
+}
+
+SIMD_TARGET_SSE2 inline void regression_sums_sse2(const double *y, unsigned int n, RegressionSums& s) {
+    for (unsigned int begin = 0; begin < n; begin += REDUCTION_BLOCK) {
+        unsigned int end = n - begin > REDUCTION_BLOCK ? begin + REDUCTION_BLOCK : n;
+        regression_block_sse2(y, begin, end, s);
+    }
+}
+
+SIMD_TARGET_AVX2 inline void regression_sums_avx2(const double *y, unsigned int n, RegressionSums& s) {
+    for (unsigned int begin = 0; begin < n; begin += REDUCTION_BLOCK) {
+        unsigned int end = n - begin > REDUCTION_BLOCK ? begin + REDUCTION_BLOCK : n;
+        regression_block_avx2(y, begin, end, s);
+    }
+}
+#endif
+
+inline RegressionSums regression_sums(const double *y, unsigned int n, SimdLevel level = active_simd_level()) {
+    RegressionSums s;
+    s.n = n;
+    if (n == 0) return s;
+    s.x_mean = (n - 1) / 2.0;
+    s.shift = y[0];
+
+    switch (level) {
+#ifdef SIMD_KERNELS_X86
+        case SIMD_AVX2: regression_sums_avx2(y, n, s); break;
+        case SIMD_SSE2: regression_sums_sse2(y, n, s); break;
+#endif
+        default: regression_sums_scalar(y, n, s); break;
+    }
+    return s;
+}
+
+struct RegressionFit {
+    double slope, intercept, r_squared;
+
+    RegressionFit() : slope(0), intercept(0), r_squared(0) {}
+};
+
+// Closes the sums into a fitted line y = slope * x + intercept.
+inline RegressionFit fit_from_sums(const RegressionSums& s) {
+    RegressionFit fit;
+    if (s.n < 2) return fit;
+
+    // Sum of (x - x_mean)^2 for x = 0..n-1 in closed form
+    double sxx = s.n * (s.n * s.n - 1) / 12.0;
+    double y_mean = s.shift + s.sum_y / s.n;
+    double syy = s.sum_yy - s.sum_y * s.sum_y / s.n;
+
+    fit.slope = (sxx != 0) ? s.sum_xy / sxx : 0;
+    fit.intercept = y_mean - fit.slope * s.x_mean;
+    fit.r_squared = (syy > 0 && sxx > 0) ? (s.sum_xy * s.sum_xy) / (sxx * syy) : 0;
+    if (fit.r_squared > 1) fit.r_squared = 1;
+    return fit;
+}
+
+// ---------------------------------------------------------------------------
+// Min/max reduction
+// ---------------------------------------------------------------------------
+
+inline void minmax_scalar(const double *low, const double *high, unsigned int begin, unsigned int end, double& lo, double& hi) {
+    for (unsigned int i = begin; i < end; i++) {
+        lo = low[i] < lo ? low[i] : lo;
+        hi = high[i] > hi ? high[i] : hi;
+    }
+}
+
+#ifdef SIMD_KERNELS_X86
+SIMD_TARGET_SSE2 inline void minmax_sse2(const double *low, const double *high, unsigned int n, double& lo, double& hi) {
+    unsigned int vec_end = n & ~3u;
+    __m128d lo0 = _mm_set1_pd(lo), lo1 = lo0;
+    __m128d hi0 = _mm_set1_pd(hi), hi1 = hi0;
+    for (unsigned int i = 0; i < vec_end; i += 4) {
+        lo0 = _mm_min_pd(_mm_loadu_pd(low + i), lo0);
+        lo1 = _mm_min_pd(_mm_loadu_pd(low + i + 2), lo1);
+        hi0 = _mm_max_pd(_mm_loadu_pd(high + i), hi0);
+        hi1 = _mm_max_pd(_mm_loadu_pd(high + i + 2), hi1);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_min_pd(lo0, lo1));
+    lo = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_pd(lanes, _mm_max_pd(hi0, hi1));
+    hi = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    minmax_scalar(low, high, vec_end, n, lo, hi);
+}
+
+SIMD_TARGET_AVX2 inline void minmax_avx2(const double *low, const double *high, unsigned int n, double& lo, double& hi) {
+    unsigned int vec_end = n & ~7u;
+    __m256d lo0 = _mm256_set1_pd(lo), lo1 = lo0;
+    __m256d hi0 = _mm256_set1_pd(hi), hi1 = hi0;
+    for (unsigned int i = 0; i < vec_end; i += 8) {
+        lo0 = _mm256_min_pd(_mm256_loadu_pd(low + i), lo0);
+        lo1 = _mm256_min_pd(_mm256_loadu_pd(low + i + 4), lo1);
+        hi0 = _mm256_max_pd(_mm256_loadu_pd(high + i), hi0);
+        hi1 = _mm256_max_pd(_mm256_loadu_pd(high + i + 4), hi1);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_min_pd(lo0, lo1));
+    for (int k = 0; k < 4; k++) lo = lanes[k] < lo ? lanes[k] : lo;
+    _mm256_storeu_pd(lanes, _mm256_max_pd(hi0, hi1));
+    for (int k = 0; k < 4; k++) hi = lanes[k] > hi ? lanes[k] : hi;
+    minmax_scalar(low, high, vec_end, n, lo, hi);
+}
+#endif
+
+// Lowest low[i] and highest high[i] over [0, n). lo/hi must be seeded (for
+// example with low[0] and high[0]); NaN entries are skipped like the scalar loop.
+inline void minmax_reduce(const double *low, const double *high, unsigned int n, double& lo, double& hi,
+                          SimdLevel level = active_simd_level()) {
+    switch (level) {
+#ifdef SIMD_KERNELS_X86
+        case SIMD_AVX2: minmax_avx2(low, high, n, lo, hi); break;
+        case SIMD_SSE2: minmax_sse2(low, high, n, lo, hi); break;
+#endif
+        default: minmax_scalar(low, high, 0, n, lo, hi); break;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Exponential moving average
+// ---------------------------------------------------------------------------
+
+// Reference recurrence: ema = y[0], then ema = alpha * y[i] + (1 - alpha) * ema.
+inline double ema_last_scalar(const double *y, unsigned int n, double alpha) {
+    if (n == 0) return 0;
+    double ema = y[0];
+    for (unsigned int i = 1; i < n; i++) {
+        ema = alpha * y[i] + (1 - alpha) * ema;
+    }
+    return ema;
+}
+
+// Below this length the segmented form is not worth its set-up.
+const unsigned int EMA_SEGMENT_MIN = 256;
+
+// Parallel-prefix form of the recurrence. The series is cut into one segment
+// per lane; every lane runs the recurrence from a zero state, and the lane
+// results are chained afterwards with
+//     ema_after = local + (1 - alpha)^segment_length * ema_before
+// which is exact in real arithmetic because the recurrence is linear. The
+// serial dependency chain becomes n / lanes long instead of n.
+#ifdef SIMD_KERNELS_X86
+SIMD_TARGET_SSE2 inline double ema_last_sse2(const double *y, unsigned int n, double alpha) {
+    unsigned int seg = n / 2;
+    __m128d a = _mm_set1_pd(alpha);
+    __m128d b = _mm_set1_pd(1 - alpha);
+    __m128d e = _mm_setzero_pd();
+    for (unsigned int j = 0; j < seg; j++) {
+        __m128d v = _mm_set_pd(y[seg + j], y[j]);
+        e = _mm_add_pd(_mm_mul_pd(a, v), _mm_mul_pd(b, e));
+    }
+    double local[2];
+    _mm_storeu_pd(local, e);
+
+    double decay = std::pow(1 - alpha, static_cast<double>(seg));
+    double ema = local[0] + decay * y[0];    // state before y[0] is y[0]
+    ema = local[1] + decay * ema;
+    for (unsigned int i = 2 * seg; i < n; i++) {
+        ema = alpha * y[i] + (1 - alpha) * ema;
+    }
+    return ema;
+}
+
+SIMD_TARGET_AVX2 inline double ema_last_avx2(const double *y, unsigned int n, double alpha) {
+    unsigned int seg = n / 4;
+    __m256d a = _mm256_set1_pd(alpha);
+    __m256d b = _mm256_set1_pd(1 - alpha);
+    __m256d e = _mm256_setzero_pd();
+    for (unsigned int j = 0; j < seg; j++) {
+        __m256d v = _mm256_set_pd(y[3 * seg + j], y[2 * seg + j], y[seg + j], y[j]);
+        e = _mm256_add_pd(_mm256_mul_pd(a, v), _mm256_mul_pd(b, e));
+    }
+    double local[4];
+    _mm256_storeu_pd(local, e);
+
+    double decay = std::pow(1 - alpha, static_cast<double>(seg));
+    double ema = y[0];
+    for (int k = 0; k < 4; k++) {
+        ema = local[k] + decay * ema;
+    }
+    for (unsigned int i = 4 * seg; i < n; i++) {
+        ema = alpha * y[i] + (1 - alpha) * ema;
+    }
+    return ema;
+}
+#endif
+
+inline double ema_last(const double *y, unsigned int n, double alpha, SimdLevel level = active_simd_level()) {
+    if (n < EMA_SEGMENT_MIN) return ema_last_scalar(y, n, alpha);
+    switch (level) {
+#ifdef SIMD_KERNELS_X86
+        case SIMD_AVX2: return ema_last_avx2(y, n, alpha);
+        case SIMD_SSE2: return ema_last_sse2(y, n, alpha);
+#endif
+        default: return ema_last_scalar(y, n, alpha);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Rank-2 row update
+// ---------------------------------------------------------------------------
+
+// row[j] += a * x[j] + b * y[j] for j in [0, n): one row of the outer-product
+// update behind the rolling covariance matrix (correlation_matrix.hpp). Every
+// level computes each element the same way, so results match exactly.
+inline void rank2_update_scalar(double *row, const double *x, double a, const double *y, double b, unsigned int n) {
+    for (unsigned int j = 0; j < n; j++) {
+        row[j] += a * x[j] + b * y[j];
+    }
+}
+
+#ifdef SIMD_KERNELS_X86
+SIMD_TARGET_SSE2 inline void rank2_update_sse2(double *row, const double *x, double a, const double *y, double b,
+                                               unsigned int n) {
+    unsigned int vec_end = n & ~3u;
+    __m128d va = _mm_set1_pd(a), vb = _mm_set1_pd(b);
+    for (unsigned int j = 0; j < vec_end; j += 4) {
+        __m128d t0 = _mm_add_pd(_mm_mul_pd(va, _mm_loadu_pd(x + j)), _mm_mul_pd(vb, _mm_loadu_pd(y + j)));
+        __m128d t1 = _mm_add_pd(_mm_mul_pd(va, _mm_loadu_pd(x + j + 2)), _mm_mul_pd(vb, _mm_loadu_pd(y + j + 2)));
+        _mm_storeu_pd(row + j, _mm_add_pd(_mm_loadu_pd(row + j), t0));
+        _mm_storeu_pd(row + j + 2, _mm_add_pd(_mm_loadu_pd(row + j + 2), t1));
+    }
+    rank2_update_scalar(row + vec_end, x + vec_end, a, y + vec_end, b, n - vec_end);
+}
+
+SIMD_TARGET_AVX2 inline void rank2_update_avx2(double *row, const double *x, double a, const double *y, double b,
+                                               unsigned int n) {
+    unsigned int vec_end = n & ~7u;
+    __m256d va = _mm256_set1_pd(a), vb = _mm256_set1_pd(b);
+    for (unsigned int j = 0; j < vec_end; j += 8) {
+        __m256d t0 = _mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(x + j)), _mm256_mul_pd(vb, _mm256_loadu_pd(y + j)));
+        __m256d t1 = _mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(x + j + 4)),
+                                   _mm256_mul_pd(vb, _mm256_loadu_pd(y + j + 4)));
+        _mm256_storeu_pd(row + j, _mm256_add_pd(_mm256_loadu_pd(row + j), t0));
+        _mm256_storeu_pd(row + j + 4, _mm256_add_pd(_mm256_loadu_pd(row + j + 4), t1));
+    }
+    rank2_update_scalar(row + vec_end, x + vec_end, a, y + vec_end, b, n - vec_end);
+}
+#endif
+
+inline void rank2_update(double *row, const double *x, double a, const double *y, double b, unsigned int n,
+                         SimdLevel level = active_simd_level()) {
+    switch (level) {
+#ifdef SIMD_KERNELS_X86
+        case SIMD_AVX2: rank2_update_avx2(row, x, a, y, b, n); break;
+        case SIMD_SSE2: rank2_update_sse2(row, x, a, y, b, n); break;
+#endif
+        default: rank2_update_scalar(row, x, a, y, b, n); break;
+    }
+}
+
+#endif
@@ -0,0 +1,87 @@
+// spsc_ring.hpp - Lock-free single-producer/single-consumer ring buffer
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded FIFO between exactly one producer thread and one consumer thread.
+// head and tail are free-running counters (slot = counter & mask) on their
+// own cache lines; each side also caches the other side's counter and only
+// reloads it when the ring looks full (producer) or empty (consumer), so in
+// steady state a push or pop touches no line the other thread writes.
+template <typename T>
+struct spsc_ring {
+    explicit spsc_ring(size_t min_capacity = 1024) : head(0), cached_tail(0), high_water(0), tail(0), cached_head(0) {
+        size_t capacity = 2;
+        while (capacity < min_capacity) capacity *= 2;
+        slots.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // Producer: false when the ring is full.
+    bool try_push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head > mask) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head > mask) return false;
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: false when the ring is empty.
+    bool try_pop(T& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h == cached_tail) return false;
+            size_t depth = cached_tail - h;
+            if (depth > high_water.load(std::memory_order_relaxed)) high_water.store(depth, std::memory_order_relaxed);
+        }
+        out = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Items queued right now; exact from either end, approximate elsewhere.
+    size_t size() const {
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_acquire);
+        return t - h;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Deepest the queue has been, sampled by the consumer whenever it
+    // catches up with the producer (so short spikes between samples may be
+    // missed, but never overstated).
+    size_t max_depth() const {
+        return high_water.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+    char pad0[64];
+    std::atomic<size_t> head;       // next slot to pop, written by the consumer
+    size_t cached_tail;             // consumer's last view of tail
+    std::atomic<size_t> high_water;
+    char pad1[64];
+    std::atomic<size_t> tail;       // next slot to fill, written by the producer
+    size_t cached_head;             // producer's last view of head
+    char pad2[64];
+
+    spsc_ring(const spsc_ring&);
+    spsc_ring& operator=(const spsc_ring&);
+};
+
+#endif
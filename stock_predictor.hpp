@@ -0,0 +1,189 @@
+// stock_predictor.hpp - Core stock data types shared by the loader, models and UI
+#ifndef STOCK_PREDICTOR_HPP
+#define STOCK_PREDICTOR_HPP
+
+#include "dynamic_array.hpp"
+#include "forecast_models.hpp"
+#include "price_series.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <climits>
+#include <string>
+
+// Default model parameters
+const int SMA_PERIOD = 5;
+const double EMA_ALPHA = 0.3;
+const int AR_ORDER = 5;
+const double HOLT_ALPHA = 0.5;
+const double HOLT_BETA = 0.1;
+const double HOLT_GAMMA = 0.1;
+
+// Enums and structures
+enum PredictionModel { LINEAR_REGRESSION, MOVING_AVERAGE, EXPONENTIAL_SMOOTHING, AUTOREGRESSIVE, HOLT_WINTERS };
+
+const int MODEL_COUNT = 5;
+const PredictionModel ALL_MODELS[MODEL_COUNT] = { LINEAR_REGRESSION, MOVING_AVERAGE, EXPONENTIAL_SMOOTHING,
+                                                  AUTOREGRESSIVE, HOLT_WINTERS };
+
+// Confidence reported before a backtest has measured the model on the
+// loaded history (see backtest.hpp), indexed by PredictionModel. The
+// autoregressive and Holt-Winters models report the confidence of their own
+// forecast interval instead (see forecast_models.hpp).
+const double DEFAULT_CONFIDENCE[MODEL_COUNT] = { 0.8, 0.7, 0.75, 0.7, 0.7 };
+
+// Models whose stats carry a forecast path with prediction intervals
+inline bool has_forecast_path(PredictionModel model) {
+    return model == AUTOREGRESSIVE || model == HOLT_WINTERS;
+}
+
+struct StockData {
+    int64_t time;                       // seconds since 1970-01-01, parsed from the Date column
+    double open, high, low, close, volume;
+    double sma5, prediction;
+    
+    StockData() : time(INVALID_TIMESTAMP), open(0), high(0), low(0), close(0), volume(0), sma5(0), prediction(0) {}
+};
+
+// Tunable parameters of each model (see param_search.hpp for choosing them).
+struct ModelParams {
+    int sma_period;                     // MOVING_AVERAGE window in bars
+    double ema_alpha;                   // EXPONENTIAL_SMOOTHING factor in (0, 1]
+    unsigned int regression_lookback;   // LINEAR_REGRESSION fits the last N bars; 0 = whole history
+    int ar_order;                       // AUTOREGRESSIVE lags, 1..AR_MAX_ORDER
+    double holt_alpha, holt_beta, holt_gamma;   // HOLT_WINTERS level, trend and season factors
+    unsigned int season_length;         // HOLT_WINTERS season in bars; 0 = Holt's linear trend
+
+    ModelParams()
+        : sma_period(SMA_PERIOD), ema_alpha(EMA_ALPHA), regression_lookback(0), ar_order(AR_ORDER),
+          holt_alpha(HOLT_ALPHA), holt_beta(HOLT_BETA), holt_gamma(HOLT_GAMMA), season_length(0) {}
+    ModelParams(int period, double alpha, unsigned int lookback = 0)
+        : sma_period(period > 0 ? period : 1), ema_alpha(alpha), regression_lookback(lookback), ar_order(AR_ORDER),
+          holt_alpha(HOLT_ALPHA), holt_beta(HOLT_BETA), holt_gamma(HOLT_GAMMA), season_length(0) {}
+};
+
+struct PredictionStats {
+    double slope, intercept, r_squared, next_prediction, confidence;
+    ForecastPath forecast;              // AUTOREGRESSIVE and HOLT_WINTERS only
+    
+    PredictionStats() : slope(0), intercept(0), r_squared(0), next_prediction(0), confidence(0) {}
+};
+
+// Next prediction and confidence from a fitted forecast path; an unfitted
+// model keeps the previous prediction, like a moving average still short of
+// its period.
+inline void apply_forecast(PredictionStats& stats, const ForecastPath& path, double last_close) {
+    stats.forecast = path;
+    if (path.steps == 0) return;
+    stats.next_prediction = path.mean[0];
+    stats.confidence = direction_confidence(path, last_close);
+}
+
+inline HoltWinters make_holt_winters(const ModelParams& params) {
+    return HoltWinters(params.holt_alpha, params.holt_beta, params.holt_gamma, params.season_length);
+}
+
+struct StockPredictor {
+    dynamic_array<StockData> data;      // parse buffer and live rows; empty once a file is loaded
+    PriceSeries series;                 // columnar copy used by models and chart scans
+    PredictionModel model;
+    ModelParams params;
+    PredictionStats stats;
+    double confidence[MODEL_COUNT];     // per model; replaced by backtest results when available
+    std::string company_name;
+    std::string filename;
+    
+    StockPredictor() : data(), model(LINEAR_REGRESSION), params(), stats(), company_name("Unknown"), filename("") {
+        for (int m = 0; m < MODEL_COUNT; m++) confidence[m] = DEFAULT_CONFIDENCE[m];
+    }
+};
+
+// Rebuilds the columnar series from the loaded rows.
+inline bool build_price_series(const dynamic_array<StockData>& rows, PriceSeries& series) {
+    TRACE_SCOPE("build_price_series");
+    series.clear();
+    if (rows.size > UINT_MAX || !series.reserve(static_cast<unsigned int>(rows.size))) return false;
+    for (const StockData& row : rows) {
+        series.add(row.time, row.open, row.high, row.low, row.close, row.volume);
+    }
+    return true;
+}
+
+// Utility functions
+inline std::string extract_company_name(const std::string& filename) {
+    // Extract company ticker from filename like "STOCK_US_XNAS_GOOG.csv"
+    size_t last_underscore = filename.find_last_of('_');
+    size_t dot_pos = filename.find_last_of('.');
+    
+    if (last_underscore != std::string::npos && dot_pos != std::string::npos && dot_pos > last_underscore) {
+        return filename.substr(last_underscore + 1, dot_pos - last_underscore - 1);
+    }
+    
+    // Fallback: use filename without extension
+    size_t last_slash = filename.find_last_of("/\\");
+    std::string base_name = (last_slash != std::string::npos) ? filename.substr(last_slash + 1) : filename;
+    size_t ext_pos = base_name.find_last_of('.');
+    return (ext_pos != std::string::npos) ? base_name.substr(0, ext_pos) : base_name;
+}
+
+// Simplified prediction calculations (close-only scans over the columnar series)
+inline void calculate_predictions(StockPredictor& predictor) {
+    TRACE_SCOPE("calculate_predictions");
+    const PriceSeries& series = predictor.series;
+    if (series.size < 2) return;
+    const double *close = series.close;
+    
+    const ModelParams& params = predictor.params;
+    
+    switch (predictor.model) {
+        case LINEAR_REGRESSION: {
+            // One fused pass for slope, intercept and r^2 (see simd_kernels.hpp)
+            // over the last regression_lookback bars. The intercept is moved
+            // back to bar 0 so the trend line is drawn on the full x axis.
+            unsigned int lookback = params.regression_lookback;
+            unsigned int window = (lookback >= 2 && lookback < series.size) ? lookback : series.size;
+            unsigned int start = series.size - window;
+            RegressionFit fit = fit_from_sums(regression_sums(close + start, window));
+            predictor.stats.slope = fit.slope;
+            predictor.stats.intercept = fit.intercept - fit.slope * start;
+            predictor.stats.r_squared = fit.r_squared;
+            predictor.stats.next_prediction = fit.slope * series.size + predictor.stats.intercept;
+            predictor.stats.confidence = predictor.confidence[LINEAR_REGRESSION];
+            break;
+        }
+        
+        case MOVING_AVERAGE: {
+            if (series.size >= static_cast<unsigned int>(params.sma_period)) {
+                double sum = 0;
+                for (int i = 0; i < params.sma_period; i++) {
+                    sum += close[series.size - 1 - i];
+                }
+                predictor.stats.next_prediction = sum / params.sma_period;
+                predictor.stats.confidence = predictor.confidence[MOVING_AVERAGE];
+            }
+            break;
+        }
+        
+        case EXPONENTIAL_SMOOTHING: {
+            predictor.stats.next_prediction = ema_last(close, series.size, params.ema_alpha);
+            predictor.stats.confidence = predictor.confidence[EXPONENTIAL_SMOOTHING];
+            break;
+        }
+        
+        case AUTOREGRESSIVE: {
+            ArFit fit = fit_autoregressive(close, series.size, params.ar_order);
+            predictor.stats.r_squared = fit.r_squared;
+            apply_forecast(predictor.stats, autoregressive_series_forecast(fit, close, series.size),
+                           close[series.size - 1]);
+            break;
+        }
+        
+        case HOLT_WINTERS: {
+            HoltWinters smoother = make_holt_winters(params);
+            for (unsigned int i = 0; i < series.size; i++) smoother.add(close[i]);
+            apply_forecast(predictor.stats, smoother.forecast(), close[series.size - 1]);
+            break;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,248 @@
+// tail_follower.hpp - Incremental reader for a growing CSV (like tail -f) or a bar feed on stdin
+#ifndef TAIL_FOLLOWER_HPP
+#define TAIL_FOLLOWER_HPP
+
+#include "csv_loader.hpp"
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#endif
+
+// Bars of headroom reserved in the series when following starts (48 MB, about
+// 100 s at 10k bars/s), so the column reallocation - a copy of the whole
+// history - does not stall the first live bars.
+const unsigned int FOLLOW_RESERVE_BARS = 1 << 20;
+
+// Reads only the bytes appended since the last call and parses the complete
+// lines among them with the loader's row parser; a partial last line waits
+// for its newline. Appended bars are passed on in arrival order, which must
+// also be time order: a bar older than the newest one passed on so far (or
+// than the loaded history) is counted as skipped and dropped. A bar
+// repeating the newest timestamp is passed on and replaces that bar (see
+// add_followed_bar), just as the later row wins when the initial load
+// sorts. A file is watched with inotify on Linux (polled elsewhere); stdin
+// is read as it becomes readable, and a header line there is simply skipped
+// as an invalid row.
+//
+// Follow mode needs POSIX file descriptors; on Windows follow_file and
+// follow_stdin return false.
+struct tail_follower {
+    // Bytes parsed per read_bars call at most, so a burst (or a file that
+    // was appended to while the app was closed) is spread over several frames.
+    static const size_t MAX_READ_BYTES = 1 << 20;
+
+    tail_follower() : fd(-1), notify_fd(-1), from_stdin(false), at_eof(false), offset(0), newest(INVALID_TIMESTAMP),
+                      buffer(64 * 1024), parsed(64, StockData()) {}
+
+    ~tail_follower() {
+        close();
+    }
+
+    // Follows `filename` from byte `start` (normally CsvLoadResult::source_bytes).
+    // `newest_time` is the newest loaded bar's timestamp; older bars are dropped.
+    bool follow_file(const std::string& filename, size_t start, int64_t newest_time = INVALID_TIMESTAMP) {
+        close();
+#ifdef _WIN32
+        (void)filename;
+        (void)start;
+        (void)newest_time;
+        return false;
+#else
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        offset = start;
+        newest = newest_time;
+#ifdef __linux__
+        notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notify_fd >= 0 && inotify_add_watch(notify_fd, filename.c_str(), IN_MODIFY) < 0) {
+            ::close(notify_fd);
+            notify_fd = -1;
+        }
+#endif
+        return true;
+#endif
+    }
+
+    bool follow_stdin(int64_t newest_time = INVALID_TIMESTAMP) {
+        close();
+#ifdef _WIN32
+        (void)newest_time;
+        return false;
+#else
+        fd = STDIN_FILENO;
+        from_stdin = true;
+        newest = newest_time;
+        return true;
+#endif
+    }
+
+    bool following() const {
+        return fd >= 0;
+    }
+
+    // True once stdin reached end of input; a followed file never ends.
+    bool finished() const {
+        return at_eof;
+    }
+
+    // Appends the valid, in-order bars among the complete lines received
+    // since the last call to `bars`. Never blocks; returns the number of
+    // bars added.
+    size_t read_bars(std::vector<StockData>& bars, CsvLoadResult& result) {
+        size_t before = bars.size();
+#ifndef _WIN32
+        size_t budget = MAX_READ_BYTES;
+        while (fd >= 0 && !at_eof && budget > 0) {
+            ssize_t got = read_some(budget < buffer.size() ? budget : buffer.size());
+            if (got <= 0) break;
+            budget -= static_cast<size_t>(got);
+            parse_chunk(&buffer[0], &buffer[0] + got, bars, result);
+        }
+#else
+        (void)result;
+#endif
+        return bars.size() - before;
+    }
+
+    // Sleeps until more input may be available or timeout_ms passes, so an
+    // idle loop wakes as soon as a bar is written. Returns false on timeout.
+    bool wait(int timeout_ms) {
+#ifndef _WIN32
+        if (fd < 0 || at_eof) return false;
+        struct pollfd waiter;
+        waiter.fd = from_stdin ? fd : notify_fd;
+        waiter.events = POLLIN;
+        waiter.revents = 0;
+        if (waiter.fd < 0) {
+            // No inotify: poll the file size every couple of milliseconds
+            for (int waited = 0; waited < timeout_ms; waited += 2) {
+                struct stat st;
+                if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > offset) return true;
+                usleep(2000);
+            }
+            return false;
+        }
+        if (::poll(&waiter, 1, timeout_ms) <= 0) return false;
+        if (!from_stdin) {
+            char events[4096];
+            while (::read(notify_fd, events, sizeof(events)) > 0) {}
+        }
+        return true;
+#else
+        (void)timeout_ms;
+        return false;
+#endif
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (fd >= 0 && !from_stdin) ::close(fd);
+        if (notify_fd >= 0) ::close(notify_fd);
+#endif
+        fd = -1;
+        notify_fd = -1;
+        from_stdin = false;
+        at_eof = false;
+        offset = 0;
+        newest = INVALID_TIMESTAMP;
+        pending.clear();
+    }
+
+private:
+    int fd;
+    int notify_fd;
+    bool from_stdin;
+    bool at_eof;
+    size_t offset;              // next byte of the file to read
+    int64_t newest;             // timestamp of the newest bar passed on
+    std::string pending;        // start of a line whose newline has not arrived
+    std::vector<char> buffer;
+    dynamic_array<StockData> parsed;
+
+#ifndef _WIN32
+    // One read of up to `limit` bytes; 0 when nothing is available now.
+    ssize_t read_some(size_t limit) {
+        if (from_stdin) {
+            struct pollfd ready;
+            ready.fd = fd;
+            ready.events = POLLIN;
+            ready.revents = 0;
+            if (::poll(&ready, 1, 0) <= 0) return 0;
+            ssize_t got = ::read(fd, &buffer[0], limit);
+            if (got == 0) at_eof = true;
+            return got;
+        }
+        ssize_t got = ::pread(fd, &buffer[0], limit, static_cast<off_t>(offset));
+        if (got > 0) {
+            offset += static_cast<size_t>(got);
+        } else if (got == 0) {
+            // A file truncated below our position was rewritten: follow its new end
+            struct stat st;
+            if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) < offset) {
+                offset = static_cast<size_t>(st.st_size);
+                pending.clear();
+            }
+        }
+        return got;
+    }
+#endif
+
+    // Parses the complete lines of pending + [begin, end) and keeps the tail.
+    void parse_chunk(const char *begin, const char *end, std::vector<StockData>& bars, CsvLoadResult& result) {
+        const char *complete_end = nullptr;   // just past the last newline
+        for (const char *p = end; p > begin; p--) {
+            if (p[-1] == '\n') {
+                complete_end = p;
+                break;
+            }
+        }
+        if (!complete_end) {
+            pending.append(begin, end);
+            return;
+        }
+
+        parsed.clear();
+        if (!pending.empty()) {
+            // Finish the carried-over line first
+            const char *newline = static_cast<const char *>(memchr(begin, '\n', end - begin));
+            pending.append(begin, newline + 1);
+            parse_csv_lines(pending.data(), pending.data() + pending.size(), parsed, result);
+            pending.clear();
+            begin = newline + 1;
+        }
+        parse_csv_lines(begin, complete_end, parsed, result);
+        pending.assign(complete_end, end);
+        for (StockData& bar : parsed) {
+            if (bar.time < newest) {
+                // Out of order: counted with the rows the parser rejected
+                result.valid_rows--;
+                result.skipped_rows++;
+                continue;
+            }
+            newest = bar.time;
+            bars.push_back(std::move(bar));
+        }
+    }
+
+    tail_follower(const tail_follower&);
+    tail_follower& operator=(const tail_follower&);
+};
+
+// Readies a loaded predictor for live appends: the row copies are dropped
+// (the models and chart read the series) so append_bar only grows the
+// columns, and the series gets its headroom now rather than mid-feed. A
+// mapped cache is copied into owned memory here for the same reason.
+inline void prepare_follow(StockPredictor& predictor) {
+    predictor.data.clear();
+    predictor.series.reserve(predictor.series.size + FOLLOW_RESERVE_BARS);
+}
+
+#endif
@@ -0,0 +1,187 @@
+// thread_pool.hpp - Fixed-size worker pool for data-parallel jobs
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs batches of indexed tasks on a fixed set of threads. The calling thread
+// takes part in every batch, so a pool of N threads owns N - 1 workers.
+//
+// Each batch is split into one contiguous range of task indices per thread.
+// A thread takes tasks from the front of its own range; when that runs dry
+// it steals the back half of the fullest other range. Cheap uniform tasks
+// therefore never touch shared state, while a few slow tasks (one huge
+// ticker among thousands of small ones) cannot leave cores idle.
+struct thread_pool {
+    typedef std::function<void(unsigned int task, unsigned int worker)> task_fn;
+
+    explicit thread_pool(unsigned int thread_count = 0) : job(nullptr), generation(0), busy_workers(0), stopping(false) {
+        if (thread_count == 0) {
+            thread_count = default_thread_count();
+        }
+        for (unsigned int i = 0; i < thread_count; i++) {
+            ranges.push_back(new task_range());
+        }
+        for (unsigned int i = 1; i < thread_count; i++) {
+            workers.push_back(std::thread(&thread_pool::worker_loop, this, i));
+        }
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+        for (size_t i = 0; i < ranges.size(); i++) {
+            delete ranges[i];
+        }
+    }
+
+    unsigned int size() const {
+        return static_cast<unsigned int>(workers.size()) + 1;
+    }
+
+    static unsigned int default_thread_count() {
+        unsigned int n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+    // Calls fn(task, worker) for every task in [0, count) and returns once all
+    // of them have finished. Worker ids are in [0, size()).
+    void run(unsigned int count, const task_fn& fn) {
+        if (count == 0) return;
+        if (workers.empty() || count == 1) {
+            for (unsigned int i = 0; i < count; i++) fn(i, 0);
+            return;
+        }
+
+        unsigned int threads = size();
+        for (unsigned int i = 0; i < threads; i++) {
+            std::lock_guard<std::mutex> lock(ranges[i]->mutex);
+            ranges[i]->begin = static_cast<unsigned int>(static_cast<unsigned long long>(count) * i / threads);
+            ranges[i]->end = static_cast<unsigned int>(static_cast<unsigned long long>(count) * (i + 1) / threads);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            busy_workers = static_cast<unsigned int>(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        drain(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy_workers == 0; });
+        job = nullptr;
+    }
+
+private:
+    // Remaining task indices [begin, end) owned by one thread
+    struct task_range {
+        std::mutex mutex;
+        unsigned int begin;
+        unsigned int end;
+
+        task_range() : begin(0), end(0) {}
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<task_range *> ranges;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const task_fn *job;
+    unsigned long generation;
+    unsigned int busy_workers;
+    bool stopping;
+
+    bool pop_own(unsigned int worker, unsigned int& task) {
+        task_range& own = *ranges[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.begin >= own.end) return false;
+        task = own.begin++;
+        return true;
+    }
+
+    unsigned int remaining(unsigned int i) {
+        std::lock_guard<std::mutex> lock(ranges[i]->mutex);
+        return ranges[i]->begin < ranges[i]->end ? ranges[i]->end - ranges[i]->begin : 0;
+    }
+
+    // Moves the back half of the largest other range into this thread's range.
+    bool steal(unsigned int worker) {
+        unsigned int threads = size();
+        for (;;) {
+            unsigned int victim = worker;
+            unsigned int most = 0;
+            for (unsigned int k = 1; k < threads; k++) {
+                unsigned int i = (worker + k) % threads;
+                unsigned int left = remaining(i);
+                if (left > most) {
+                    most = left;
+                    victim = i;
+                }
+            }
+            if (victim == worker) return false;
+
+            unsigned int begin, end;
+            {
+                std::lock_guard<std::mutex> lock(ranges[victim]->mutex);
+                task_range& v = *ranges[victim];
+                if (v.begin >= v.end) continue;
+                unsigned int take = (v.end - v.begin + 1) / 2;
+                end = v.end;
+                begin = end - take;
+                v.end = begin;
+            }
+            std::lock_guard<std::mutex> lock(ranges[worker]->mutex);
+            ranges[worker]->begin = begin;
+            ranges[worker]->end = end;
+            return true;
+        }
+    }
+
+    void drain(unsigned int worker) {
+        unsigned int task;
+        for (;;) {
+            while (pop_own(worker, task)) {
+                (*job)(task, worker);
+            }
+            if (!steal(worker)) break;
+        }
+    }
+
+    void worker_loop(unsigned int worker) {
+        unsigned long seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+
+            drain(worker);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy_workers == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    thread_pool(const thread_pool&);
+    thread_pool& operator=(const thread_pool&);
+};
+
+#endif
@@ -0,0 +1,283 @@
+// trace.hpp - Scoped timers and counters, exported as Chrome trace events and per-phase percentiles
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// TRACE_SCOPE("name") times the rest of the enclosing block and
+// TRACE_COUNTER("name", value) records a value. Both compile to nothing
+// unless the program is built with -DHD_TRACING, and record nothing until
+// start_tracing() is called, so a tracing build costs one relaxed load per
+// scope while it is off. Names must be string literals: only the pointer is
+// stored. Scopes sit around whole phases (a file, a chunk of lines, a draw
+// call), never around a single row.
+#ifdef HD_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) trace_counter(name, static_cast<int64_t>(value))
+const bool TRACING_COMPILED_IN = true;
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+const bool TRACING_COMPILED_IN = false;
+#endif
+
+// Events per chunk of a thread's buffer, and the most one thread keeps
+// (about 32 MB); later events are counted as dropped.
+const size_t TRACE_CHUNK_EVENTS = 4096;
+const size_t TRACE_MAX_EVENTS_PER_THREAD = 1 << 20;
+
+enum TraceEventKind { TRACE_SPAN, TRACE_COUNTER_VALUE };
+
+struct TraceEvent {
+    const char *name;
+    int64_t start_ns;       // since the trace clock's epoch
+    int64_t value;          // duration in ns for spans, the value for counters
+    TraceEventKind kind;
+};
+
+struct TraceChunk {
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+    std::atomic<size_t> count;
+    std::atomic<TraceChunk *> next;
+
+    TraceChunk() : count(0), next(nullptr) {}
+};
+
+// Events of one thread. Only the owning thread appends, publishing each
+// event with a release store of the chunk's count, so an exporter on
+// another thread can read everything published so far without a lock.
+// Buffers live until the process exits (a thread's events outlive it).
+struct TraceBuffer {
+    unsigned int thread_id;
+    TraceChunk *head;
+    TraceChunk *tail;
+    size_t events;
+    std::atomic<size_t> dropped;
+    TraceBuffer *next_buffer;
+
+    explicit TraceBuffer(unsigned int id)
+        : thread_id(id), head(new TraceChunk()), tail(head), events(0), dropped(0), next_buffer(nullptr) {}
+
+    void append(const TraceEvent& event) {
+        if (events >= TRACE_MAX_EVENTS_PER_THREAD) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        size_t n = tail->count.load(std::memory_order_relaxed);
+        if (n == TRACE_CHUNK_EVENTS) {
+            TraceChunk *chunk = new TraceChunk();
+            tail->next.store(chunk, std::memory_order_release);
+            tail = chunk;
+            n = 0;
+        }
+        tail->events[n] = event;
+        tail->count.store(n + 1, std::memory_order_release);
+        events++;
+    }
+
+    // Calls fn(event) for every event published so far.
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (const TraceChunk *chunk = head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t n = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < n; i++) fn(chunk->events[i]);
+        }
+    }
+};
+
+inline std::atomic<bool>& trace_enabled() {
+    static std::atomic<bool> enabled(false);
+    return enabled;
+}
+
+// Every thread's buffer, newest first; threads register with a CAS push.
+inline std::atomic<TraceBuffer *>& trace_buffers() {
+    static std::atomic<TraceBuffer *> buffers(nullptr);
+    return buffers;
+}
+
+inline TraceBuffer *register_trace_buffer() {
+    static std::atomic<unsigned int> next_id(1);
+    TraceBuffer *buffer = new TraceBuffer(next_id.fetch_add(1, std::memory_order_relaxed));
+    TraceBuffer *head = trace_buffers().load(std::memory_order_relaxed);
+    do {
+        buffer->next_buffer = head;
+    } while (!trace_buffers().compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+    return buffer;
+}
+
+inline TraceBuffer& thread_trace_buffer() {
+    static thread_local TraceBuffer *buffer = register_trace_buffer();
+    return *buffer;
+}
+
+inline std::chrono::steady_clock::time_point trace_epoch() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return epoch;
+}
+
+inline int64_t trace_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch()).count();
+}
+
+// Threads are numbered as they first record, so the thread that starts
+// tracing registers here to be thread 1 ("main" in the export).
+inline void start_tracing() {
+    trace_epoch();
+    thread_trace_buffer();
+    trace_enabled().store(true, std::memory_order_relaxed);
+}
+
+inline void stop_tracing() {
+    trace_enabled().store(false, std::memory_order_relaxed);
+}
+
+inline void trace_record(TraceEventKind kind, const char *name, int64_t start_ns, int64_t value) {
+    TraceEvent event;
+    event.name = name;
+    event.start_ns = start_ns;
+    event.value = value;
+    event.kind = kind;
+    thread_trace_buffer().append(event);
+}
+
+inline void trace_counter(const char *name, int64_t value) {
+    if (trace_enabled().load(std::memory_order_relaxed)) trace_record(TRACE_COUNTER_VALUE, name, trace_now_ns(), value);
+}
+
+struct TraceScope {
+    const char *name;
+    int64_t start_ns;       // -1 while tracing is off
+
+    explicit TraceScope(const char *scope_name)
+        : name(scope_name), start_ns(trace_enabled().load(std::memory_order_relaxed) ? trace_now_ns() : -1) {}
+
+    ~TraceScope() {
+        if (start_ns >= 0) trace_record(TRACE_SPAN, name, start_ns, trace_now_ns() - start_ns);
+    }
+
+private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+};
+
+// Calls fn(thread_id, event) for every recorded event of every thread.
+template <typename Fn>
+inline void for_each_trace_event(Fn fn) {
+    for (TraceBuffer *buffer = trace_buffers().load(std::memory_order_acquire); buffer; buffer = buffer->next_buffer) {
+        unsigned int id = buffer->thread_id;
+        buffer->for_each([&](const TraceEvent& event) { fn(id, event); });
+    }
+}
+
+inline size_t dropped_trace_events() {
+    size_t dropped = 0;
+    for (TraceBuffer *buffer = trace_buffers().load(std::memory_order_acquire); buffer; buffer = buffer->next_buffer) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+// Writes the events in Chrome's trace-event JSON (open it in
+// chrome://tracing or ui.perfetto.dev): spans as complete ("X") events and
+// counters as "C" events, timestamps in microseconds. False if the file
+// cannot be written.
+inline bool write_chrome_trace(const std::string& path) {
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+    std::vector<unsigned int> threads;
+    for_each_trace_event([&](unsigned int thread, const TraceEvent& event) {
+        if (std::find(threads.begin(), threads.end(), thread) == threads.end()) threads.push_back(thread);
+        if (event.kind == TRACE_SPAN) {
+            fprintf(f, "%s{\"name\": \"%s\", \"cat\": \"hd\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                    first ? "" : ",\n", event.name, thread, event.start_ns / 1e3, event.value / 1e3);
+        } else {
+            fprintf(f, "%s{\"name\": \"%s\", \"cat\": \"hd\", \"ph\": \"C\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, "
+                       "\"args\": {\"value\": %lld}}",
+                    first ? "" : ",\n", event.name, thread, event.start_ns / 1e3, static_cast<long long>(event.value));
+        }
+        first = false;
+    });
+    for (size_t i = 0; i < threads.size(); i++) {
+        fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s %u\"}}",
+                first ? "" : ",\n", threads[i], threads[i] == 1 ? "main" : "thread", threads[i]);
+        first = false;
+    }
+    fprintf(f, "\n]}\n");
+    bool ok = ferror(f) == 0;
+    return fclose(f) == 0 && ok;
+}
+
+// Duration percentiles of one span name over all threads
+struct TracePhase {
+    std::string name;
+    size_t count;
+    double total_ms, p50_ms, p99_ms, max_ms;
+};
+
+// Nearest-rank percentile of sorted durations
+inline double trace_percentile_ms(const std::vector<int64_t>& sorted, double fraction) {
+    size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    rank = std::max<size_t>(1, std::min(rank, sorted.size()));
+    return sorted[rank - 1] / 1e6;
+}
+
+// Phases by total time, largest first.
+inline std::vector<TracePhase> trace_phases() {
+    std::map<std::string, std::vector<int64_t> > durations;
+    for_each_trace_event([&](unsigned int, const TraceEvent& event) {
+        if (event.kind == TRACE_SPAN) durations[event.name].push_back(event.value);
+    });
+    std::vector<TracePhase> phases;
+    for (std::map<std::string, std::vector<int64_t> >::iterator it = durations.begin(); it != durations.end(); ++it) {
+        std::vector<int64_t>& d = it->second;
+        std::sort(d.begin(), d.end());
+        TracePhase phase;
+        phase.name = it->first;
+        phase.count = d.size();
+        phase.total_ms = 0;
+        for (size_t i = 0; i < d.size(); i++) phase.total_ms += d[i] / 1e6;
+        phase.p50_ms = trace_percentile_ms(d, 0.50);
+        phase.p99_ms = trace_percentile_ms(d, 0.99);
+        phase.max_ms = d.back() / 1e6;
+        phases.push_back(phase);
+    }
+    std::sort(phases.begin(), phases.end(),
+              [](const TracePhase& a, const TracePhase& b) { return a.total_ms > b.total_ms; });
+    return phases;
+}
+
+// One line per phase: count, total, p50, p99 and max in milliseconds.
+inline std::vector<std::string> trace_summary_lines() {
+    std::vector<std::string> lines;
+    std::vector<TracePhase> phases = trace_phases();
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%-26s %8s %11s %10s %10s %10s", "phase", "count", "total ms", "p50 ms", "p99 ms", "max ms");
+    lines.push_back(buf);
+    for (size_t i = 0; i < phases.size(); i++) {
+        const TracePhase& p = phases[i];
+        snprintf(buf, sizeof(buf), "%-26s %8zu %11.3f %10.4f %10.4f %10.4f", p.name.c_str(), p.count, p.total_ms,
+                 p.p50_ms, p.p99_ms, p.max_ms);
+        lines.push_back(buf);
+    }
+    size_t dropped = dropped_trace_events();
+    if (dropped > 0) {
+        snprintf(buf, sizeof(buf), "(%zu events dropped: over %zu per thread)", dropped, TRACE_MAX_EVENTS_PER_THREAD);
+        lines.push_back(buf);
+    }
+    return lines;
+}
+
+#endif